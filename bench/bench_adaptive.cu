@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Time to tolerance with each fixed cycle configuration and with the adaptive
+// controller, for smoothers with different convergence. The decisions of the
+// controller are printed.
+// Usage: bench_adaptive [l] [eps]
+
+template <typename S>
+void run(const int l, const double eps, const CycleOptions cycle, const int adaptive) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        Poisson<double> problem(l, h, 1.0);
+        srand(1);
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        problem.u[j + i * n] = (double)rand() / RAND_MAX - 0.5;
+        Multigrid<S, Poisson<double>, double> mg(problem);
+        mg.cycle = cycle;
+        SolverOptions opts;
+        opts.eps = eps;
+        opts.max_iterations = 200;
+        opts.adaptive = adaptive;
+        double start = omp_get_wtime();
+        SolverOutput out = solve(mg, problem, opts);
+        double elapsed = omp_get_wtime() - start;
+        char from[32], to[32];
+        printf("%-40s %-8s \t %-4d \t %-8.3f \t %-8.3g \n", mg.name(),
+               adaptive ? "adaptive" : cycle.name(from, sizeof(from)), out.iterations,
+               1e3 * elapsed, out.residual);
+        for (size_t k = 0; k < out.decisions.size(); ++k) {
+                const CycleDecision& d = out.decisions[k];
+                printf("        after %d: %s -> %s (%s, rate %.3f, %.3f ms per cycle) \n",
+                       d.iteration, d.from.name(from, sizeof(from)),
+                       d.to.name(to, sizeof(to)), d.reason, d.rate, 1e3 * d.seconds);
+        }
+}
+
+template <typename S>
+void run_all(const int l, const double eps) {
+        const cycle_type types[3] = {V_CYCLE, F_CYCLE, W_CYCLE};
+        for (int t = 0; t < 3; ++t)
+                for (int s = 1; s <= 2; ++s)
+                        run<S>(l, eps, CycleOptions(types[t], s, s), 0);
+        run<S>(l, eps, CycleOptions(), 1);
+}
+
+int main(int argc, char **argv) {
+
+        int l = argc > 1 ? atoi(argv[1]) : 11;
+        double eps = argc > 2 ? atof(argv[2]) : 1e-9;
+        int n = (1 << l) + 1;
+
+        printf("Grid size: %d x %d, threads: %d, tolerance: %g \n", n, n,
+               omp_get_max_threads(), eps);
+        printf("Solver \t\t\t\t\t Cycle \t\t Its \t Time (ms) \t Residual \n");
+        run_all<GaussSeidelRedBlack>(l, eps);
+        run_all<Jacobi>(l, eps);
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <additive.hpp>
+#include <krylov.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Compares the multiplicative V-cycle against additive multigrid for an
+// increasing number of threads.
+// Usage: bench_additive [l] [max threads]
+
+template <typename S, typename P, typename T=double>
+void benchmark(S& solver, P& problem, SolverOptions opts, const int threads) {
+        double start = omp_get_wtime();
+        SolverOutput out = solve(solver, problem, opts);
+        double elapsed = 1e3 * (omp_get_wtime() - start);
+        printf("%-48s \t %-7d \t %-7d \t %-5.5f \t %-5.5g \n", solver.name(),
+               threads, out.iterations, elapsed, out.residual);
+}
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        using Problem = Poisson<Number>;
+        int l = argc > 1 ? atoi(argv[1]) : 11;
+        int max_threads = argc > 2 ? atoi(argv[2]) : omp_get_max_threads();
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+        Number modes = 1.0;
+
+        SolverOptions opts;
+        opts.max_iterations = 1e3;
+        opts.eps = 1e-8;
+
+        printf("Grid size: %d x %d \n", n, n);
+        printf("Solver \t\t\t\t\t\t\t Threads \t Iterations \t Time (ms) \t Residual \n");
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+                omp_set_num_threads(threads);
+                {
+                        Problem problem(l, h, modes);
+                        Multigrid<GaussSeidelRedBlack, Problem, Number> mg(problem);
+                        benchmark(mg, problem, opts, threads);
+                }
+                {
+                        Problem problem(l, h, modes);
+                        AdditiveMultigrid<GaussSeidelRedBlack, Problem, Number> mg(problem);
+                        benchmark(mg, problem, opts, threads);
+                }
+                {
+                        using MG = AdditiveMultigrid<Jacobi, Problem, Number>;
+                        Problem problem(l, h, modes);
+                        ConjugateGradient<MG, Problem, Number> cg(problem);
+                        cg.get_preconditioner().type = BPX;
+                        benchmark(cg, problem, opts, threads);
+                }
+        }
+}
@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <amg.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Geometric multigrid on the grid against algebraic multigrid on the
+// assembled matrix of the same problem: setup time, cycles to convergence and
+// solve time.
+// Usage: bench_amg [l] [eps]
+
+template <typename F, typename P>
+void run(F& solver, P& problem, const SolverOptions& opts, const double setup) {
+        double start = omp_get_wtime();
+        SolverOutput out = solve(solver, problem, opts);
+        double elapsed = omp_get_wtime() - start;
+        printf("%-40s \t %-8.3f \t %-6d \t %-8.3f \t %-8.3f \t %-8.3g \n", solver.name(),
+               1e3 * setup, out.iterations, 1e3 * elapsed, 1e3 * elapsed / out.iterations,
+               out.error);
+}
+
+int main(int argc, char **argv) {
+
+        int l = argc > 1 ? atoi(argv[1]) : 10;
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        SolverOptions opts;
+        opts.eps = argc > 2 ? atof(argv[2]) : 1e-8;
+        opts.mms = 1;
+
+        printf("Grid size: %d x %d, threads: %d \n", n, n, omp_get_max_threads());
+        printf("Solver \t\t\t\t\t Setup (ms) \t Cycles \t Solve (ms) \t Cycle (ms) \t Error \n");
+        {
+                Poisson<double> problem(l, h, 1.0);
+                double start = omp_get_wtime();
+                Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(problem);
+                run(mg, problem, opts, omp_get_wtime() - start);
+        }
+        {
+                Poisson<double> problem(l, h, 1.0);
+                SparseProblem<double> sparse(problem);
+                double start = omp_get_wtime();
+                AlgebraicMultigrid<SparseJacobi, SparseProblem<double>, double> amg(sparse);
+                run(amg, sparse, opts, omp_get_wtime() - start);
+        }
+        {
+                Poisson<double> problem(l, h, 1.0);
+                SparseProblem<double> sparse(problem);
+                double start = omp_get_wtime();
+                AlgebraicMultigrid<SparseChebyshev, SparseProblem<double>, double> amg(sparse);
+                run(amg, sparse, opts, omp_get_wtime() - start);
+                printf("Levels: %d, operator complexity: %g \n", amg.num_levels(),
+                       amg.operator_complexity());
+        }
+}
@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <async.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Compares red-black Gauss-Seidel against asynchronous Gauss-Seidel, both as a
+// stand-alone iteration with a fixed number of sweeps and as multigrid
+// smoother, for an increasing number of threads.
+// Usage: bench_async [l] [sweeps] [max threads] [max staleness]
+
+template <typename S, typename P, typename T=double>
+void benchmark(S& solver, P& problem, SolverOptions opts, const int threads) {
+        double start = omp_get_wtime();
+        SolverOutput out = solve(solver, problem, opts);
+        double elapsed = 1e3 * (omp_get_wtime() - start);
+        printf("%-40s \t %-7d \t %-7d \t %-5.5f \t %-5.5g \n", solver.name(),
+               threads, out.iterations, elapsed, out.residual);
+}
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        using Problem = Poisson<Number>;
+        int l = argc > 1 ? atoi(argv[1]) : 9;
+        int sweeps = argc > 2 ? atoi(argv[2]) : 1000;
+        int max_threads = argc > 3 ? atoi(argv[3]) : omp_get_max_threads();
+        int max_staleness = argc > 4 ? atoi(argv[4]) : 1;
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+        Number modes = 1.0;
+
+        printf("Grid size: %d x %d, sweeps: %d, max staleness: %d \n", n, n,
+               sweeps, max_staleness);
+        printf("Solver \t\t\t\t\t Threads \t Iterations \t Time (ms) \t Residual \n");
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+                omp_set_num_threads(threads);
+                SolverOptions opts;
+                opts.max_iterations = sweeps;
+                opts.eps = 0.0;
+                {
+                        Problem problem(l, h, modes);
+                        GaussSeidelRedBlack smoother;
+                        benchmark(smoother, problem, opts, threads);
+                }
+                {
+                        // A single call performs all sweeps without barriers
+                        opts.max_iterations = 1;
+                        Problem problem(l, h, modes);
+                        AsyncGaussSeidel smoother;
+                        smoother.max_sweeps = sweeps;
+                        smoother.max_staleness = max_staleness;
+                        benchmark(smoother, problem, opts, threads);
+                }
+
+                opts.max_iterations = 1e3;
+                opts.eps = 1e-8;
+                {
+                        Problem problem(l, h, modes);
+                        Multigrid<GaussSeidelRedBlack, Problem, Number> mg(problem);
+                        benchmark(mg, problem, opts, threads);
+                }
+                {
+                        Problem problem(l, h, modes);
+                        Multigrid<AsyncGaussSeidel, Problem, Number> mg(problem);
+                        benchmark(mg, problem, opts, threads);
+                }
+        }
+}
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <batch.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Throughput of many solves with the same operator: one solve after the other
+// with all threads, and the level-pipelined batch, for 1 .. max threads.
+// Usage: bench_batch [l] [right-hand sides] [cycles per solve]
+
+using Solver = Multigrid<GaussSeidelRedBlack, Poisson<double>, double>;
+using Batch = BatchMultigrid<GaussSeidelRedBlack, Poisson<double>, double>;
+
+int main(int argc, char **argv) {
+
+        int l = argc > 1 ? atoi(argv[1]) : 9;
+        int m = argc > 2 ? atoi(argv[2]) : 64;
+        int cycles = argc > 3 ? atoi(argv[3]) : 5;
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        int max_threads = omp_get_max_threads();
+
+        SolverOptions opts;
+        opts.max_iterations = cycles;
+        opts.eps = 0.0;
+
+        std::vector<Poisson<double>*> problems;
+        for (int j = 0; j < m; ++j)
+                problems.push_back(new Poisson<double>(l, h, 1.0));
+
+        printf("Grid size: %d x %d, right-hand sides: %d, cycles per solve: %d \n",
+               n, n, m, cycles);
+        printf("Threads \t Sequential (solves/s) \t Batch (solves/s) \t Groups \n");
+        for (int p = 1; p <= max_threads; p *= 2) {
+                omp_set_num_threads(p);
+                Solver mg(*problems[0]);
+                for (int j = 0; j < m; ++j)
+                        memset(problems[j]->u, 0, sizeof(double) * n * n);
+                double start = omp_get_wtime();
+                for (int j = 0; j < m; ++j)
+                        solve(mg, *problems[j], opts);
+                double sequential = omp_get_wtime() - start;
+
+                Batch batch(*problems[0]);
+                for (int j = 0; j < m; ++j)
+                        memset(problems[j]->u, 0, sizeof(double) * n * n);
+                start = omp_get_wtime();
+                batch.solve(problems, opts);
+                double pipelined = omp_get_wtime() - start;
+
+                char groups[256] = "";
+                for (size_t g = 0; g < batch.threads.size(); ++g)
+                        sprintf(groups + strlen(groups), "%s%d", g ? "+" : "",
+                                batch.threads[g]);
+                printf("%-7d \t %-8.1f \t\t %-8.1f \t\t %s \n", p, m / sequential,
+                       m / pipelined, groups);
+                if (p < max_threads && 2 * p > max_threads) p = max_threads / 2;
+        }
+        omp_set_num_threads(max_threads);
+
+        for (int j = 0; j < m; ++j)
+                delete problems[j];
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <checkpoint.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Time of a multigrid solve with and without checkpoints written every
+// `interval` iterations, and how often the solve had to wait for a write.
+// Usage: bench_checkpoint [l] [path] [interval] [state] [codec]
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        int l = argc > 1 ? atoi(argv[1]) : 11;
+        const char *path = argc > 2 ? argv[2] : "bench_checkpoint.bin";
+        int interval = argc > 3 ? atoi(argv[3]) : 1;
+        int state = argc > 4 ? atoi(argv[4]) : 0;
+        compression_codec codec = argc > 5 ? (compression_codec)atoi(argv[5])
+                                           : COMPRESSION_NONE;
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+        Number modes = 1.0;
+
+        SolverOptions opts;
+        opts.max_iterations = 20;
+        opts.eps = 1e-14;
+
+        using Problem = Poisson<Number>;
+        using MG = Multigrid<GaussSeidelRedBlack, Problem, Number>;
+        printf("Grid size: %d x %d, interval: %d, state: %d, codec: %d \n", n, n,
+               interval, state, codec);
+        printf("Checkpoints \t Iterations \t Time (ms) \t Writes \t Waits \n");
+        {
+                Problem problem(l, h, modes);
+                MG mg(problem);
+                double start = omp_get_wtime();
+                SolverOutput out = solve(mg, problem, opts);
+                double elapsed = 1e3 * (omp_get_wtime() - start);
+                printf("%-11s \t %-7d \t %-5.5f \t %d \t\t %d \n", "no",
+                       out.iterations, elapsed, 0, 0);
+        }
+        {
+                Problem problem(l, h, modes);
+                MG mg(problem);
+                Checkpoint<Number> checkpoint(path, interval, state);
+                checkpoint.codec = codec;
+                double start = omp_get_wtime();
+                SolverOutput out = solve(mg, problem, opts, checkpoint,
+                                         SolverOutput());
+                double solved = 1e3 * (omp_get_wtime() - start);
+                checkpoint.wait();
+                double elapsed = 1e3 * (omp_get_wtime() - start);
+                printf("%-11s \t %-7d \t %-5.5f \t %d \t\t %d \n", "yes",
+                       out.iterations, solved, checkpoint.num_writes,
+                       checkpoint.num_waits);
+                printf("Time including the last write: %.5f ms \n", elapsed);
+        }
+        remove(path);
+}
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <compression.hpp>
+#include <grid.hpp>
+
+// Compression ratio and throughput of each codec for a smooth solution. The
+// lossy codec uses the tolerance factor * h^2.
+// Usage: bench_compression [l] [factor]
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        int l = argc > 1 ? atoi(argv[1]) : 12;
+        double factor = argc > 2 ? atof(argv[2]) : 0.01;
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+        size_t num_bytes = sizeof(Number) * n * n;
+        Number *u = grid_alloc<Number>(n, n);
+        Number *v = grid_alloc<Number>(n, n);
+        exact_solution(u, n, h, (Number)1.0);
+
+        const char *names[] = {"none", "shuffle", "lz", "lossy"};
+        printf("Grid size: %d x %d (%zu MB), tolerance: %g \n", n, n, num_bytes >> 20,
+               compression_tolerance(h, factor));
+        printf("Codec \t\t Ratio \t\t Compress (MB/s) \t Decompress (MB/s) \t Max error \n");
+        for (int codec = COMPRESSION_NONE; codec <= COMPRESSION_LOSSY; ++codec) {
+                CompressionOptions opts;
+                opts.codec = (compression_codec)codec;
+                opts.tolerance = compression_tolerance(h, factor);
+                opts.nx = n;
+                std::vector<char> packed;
+                double start = omp_get_wtime();
+                compress(packed, u, num_bytes, sizeof(Number), opts);
+                double compressed = omp_get_wtime();
+                decompress(v, packed.data(), packed.size());
+                double decompressed = omp_get_wtime();
+                double error = 0.0;
+                for (int i = 0; i < n * n; ++i)
+                        error = std::max(error, fabs(u[i] - v[i]));
+                double mb = num_bytes / 1048576.0;
+                printf("%-8s \t %-8.4f \t %-10.1f \t\t %-10.1f \t\t %g \n", names[codec],
+                       (double)num_bytes / packed.size(), mb / (compressed - start),
+                       mb / (decompressed - compressed), error);
+        }
+
+        grid_free(u, n, n);
+        grid_free(v, n, n);
+}
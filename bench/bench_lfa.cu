@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <lfa.hpp>
+
+// Offline LFA report: predicted smoothing and two-grid factors of each
+// smoother and transfer operator pair for several sweep counts, the damping of
+// Jacobi and the sweeps chosen at setup, and the time of the analysis.
+// Usage: bench_lfa [resolution]
+
+int main(int argc, char **argv) {
+        int resolution = argc > 1 ? atoi(argv[1]) : 64;
+        const lfa_smoother smoothers[4] = {LFA_JACOBI, LFA_GAUSS_SEIDEL, LFA_RED_BLACK,
+                                           LFA_CHEBYSHEV};
+        const lfa_restriction restrictions[2] = {LFA_FULL_WEIGHTING, LFA_HALF_WEIGHTING};
+        const lfa_prolongation prolongations[2] = {LFA_BILINEAR, LFA_CUBIC};
+        for (int s = 0; s < 4; ++s)
+                for (int r = 0; r < 2; ++r)
+                        for (int p = 0; p < 2; ++p) {
+                                LFAOptions opts;
+                                opts.resolution = resolution;
+                                opts.smoother = smoothers[s];
+                                opts.restriction = restrictions[r];
+                                opts.prolongation = prolongations[p];
+                                lfa_report(stdout, opts);
+                                printf("\n");
+                        }
+
+        LFAOptions opts;
+        opts.resolution = resolution;
+        double start = omp_get_wtime();
+        double omega = lfa_best_omega(opts);
+        double elapsed = omp_get_wtime() - start;
+        printf("Best Jacobi damping: %.2f (%.3f ms) \n", omega, 1e3 * elapsed);
+        for (int s = 0; s < 4; ++s) {
+                opts.smoother = smoothers[s];
+                opts.omega = omega;
+                start = omp_get_wtime();
+                int nu = lfa_best_sweeps(opts);
+                elapsed = omp_get_wtime() - start;
+                printf("Best sweeps for %s: (%d,%d) (%.3f ms) \n", opts.name(), nu, nu,
+                       1e3 * elapsed);
+        }
+        return 0;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include <poisson.hpp>
+#include <additive.hpp>
+#include <amg.hpp>
+#include <batch.hpp>
+#include <decomposition.hpp>
+#include <krylov.hpp>
+#include <memory.hpp>
+#include <pipeline.hpp>
+
+// Bytes per unknown of each solver configuration together with its problem,
+// per memory category, for several grid sizes. The peak includes the
+// temporaries of the setup and of one iteration.
+// Usage: bench_memory [max l]
+
+using Problem = Poisson<double>;
+
+// Bytes since `before` per unknown of `num_problems` problems
+void print_row(const char *name, const int l, const MemoryUsage& before,
+               const int num_problems=1) {
+        int n = (1 << l) + 1;
+        double m = 1.0 / ((double)n * n * num_problems);
+        MemoryUsage usage = memory_usage();
+        printf("%-56s %-6d", name, n);
+        for (int k = 0; k < MEMORY_NUM_CATEGORIES; ++k)
+                printf(" %-9.2f", m * (usage.current[k] - before.current[k]));
+        printf(" %-9.2f %-9.2f \n", m * (usage.total - before.total),
+               m * (usage.total_peak - before.total));
+}
+
+template <typename S>
+void run(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        memory_reset_peak();
+        MemoryUsage before = memory_usage();
+        Problem problem(l, h, 1.0);
+        S solver(problem);
+        solver(problem);
+        print_row(solver.name(), l, before);
+}
+
+void run_batch(const int l, const int m) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        memory_reset_peak();
+        MemoryUsage before = memory_usage();
+        std::vector<Problem*> problems;
+        for (int j = 0; j < m; ++j)
+                problems.push_back(new Problem(l, h, 1.0));
+        BatchMultigrid<GaussSeidelRedBlack, Problem, double> batch(*problems[0]);
+        SolverOptions opts;
+        opts.max_iterations = 1;
+        batch.solve(problems, opts);
+        std::string name = std::string(batch.name()) + " x " + std::to_string(m);
+        print_row(name.c_str(), l, before, m);
+        for (int j = 0; j < m; ++j)
+                delete problems[j];
+}
+
+void run_decomposed(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        memory_reset_peak();
+        MemoryUsage before = memory_usage();
+        DecomposedPoisson<double> problem(l, h, 1.0);
+        DecomposedMultigrid<GaussSeidelRedBlack, DecomposedPoisson<double>, double>
+            solver(problem);
+        solver(problem);
+        print_row(solver.name(), l, before);
+}
+
+void run_amg(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        // The grid problem is only used to build the sparse problem
+        Problem problem(l, h, 1.0);
+        memory_reset_peak();
+        MemoryUsage before = memory_usage();
+        SparseProblem<double> sparse(problem);
+        AlgebraicMultigrid<SparseJacobi, SparseProblem<double>, double> amg(sparse);
+        amg(sparse);
+        print_row(amg.name(), l, before);
+}
+
+int main(int argc, char **argv) {
+        int max_l = argc > 1 ? atoi(argv[1]) : 11;
+        printf("Bytes per unknown \n");
+        printf("%-56s %-6s", "Solver", "n");
+        for (int k = 0; k < MEMORY_NUM_CATEGORIES; ++k)
+                printf(" %-9s", memory_category_name(k));
+        printf(" %-9s %-9s \n", "total", "peak");
+        for (int l = 7; l <= max_l; l += 2) {
+                run<Multigrid<GaussSeidelRedBlack, Problem, double>>(l);
+                run<Multigrid<GaussSeidelRedBlackResidual, Problem, double>>(l);
+                run<PipelinedMultigrid<Problem, double>>(l);
+                run<AdditiveMultigrid<Jacobi, Problem, double>>(l);
+                run<ConjugateGradient<AdditiveMultigrid<Jacobi, Problem, double>, Problem,
+                                      double>>(l);
+                run_batch(l, 4);
+                run_decomposed(l);
+                run_amg(l);
+        }
+        return 0;
+}
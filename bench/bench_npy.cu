@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <npy.hpp>
+#include <grid.hpp>
+
+// Compares reading a field with fread into a new buffer against mapping the
+// .npy file, with and without data type conversion. The time includes one
+// pass over the data (its L1 norm), so that the mapped pages are faulted in.
+// Usage: bench_npy [l] [path]
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        int l = argc > 1 ? atoi(argv[1]) : 12;
+        const char *path = argc > 2 ? argv[2] : "bench_npy.npy";
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+
+        Number *f = grid_alloc<Number>(n, n);
+        forcing_function(f, n, h);
+        double start = omp_get_wtime();
+        npy_write(path, f, n, n);
+        double elapsed = 1e3 * (omp_get_wtime() - start);
+        grid_free(f, n, n);
+
+        printf("Grid size: %d x %d, file: %zu MB \n", n, n,
+               (sizeof(Number) * n * n) >> 20);
+        printf("Method \t\t\t Time (ms) \t Norm \n");
+        printf("%-24s \t %-5.5f \n", "write (mapped)", elapsed);
+        {
+                start = omp_get_wtime();
+                NpyHeader header;
+                FILE *fh = fopen(path, "rb");
+                char head[4096];
+                size_t len = fread(head, 1, sizeof(head), fh);
+                npy_parse_header(head, len, header);
+                fseek(fh, header.offset, SEEK_SET);
+                Number *x = (Number*)malloc(sizeof(Number) * n * n);
+                if (fread(x, sizeof(Number), (size_t)n * n, fh) != (size_t)n * n)
+                        fprintf(stderr, "short read\n");
+                fclose(fh);
+                double norm = grid_l1norm(x, n, n, h, h);
+                elapsed = 1e3 * (omp_get_wtime() - start);
+                printf("%-24s \t %-5.5f \t %-5.5g \n", "fread", elapsed, norm);
+                free(x);
+        }
+        {
+                start = omp_get_wtime();
+                NpyArray<Number> x(path);
+                double norm = grid_l1norm(x.x, n, n, h, h);
+                elapsed = 1e3 * (omp_get_wtime() - start);
+                printf("%-24s \t %-5.5f \t %-5.5g \n", "mapped", elapsed, norm);
+        }
+        {
+                start = omp_get_wtime();
+                NpyArray<float> x(path);
+                double norm = grid_l1norm(x.x, n, n, (float)h, (float)h);
+                elapsed = 1e3 * (omp_get_wtime() - start);
+                printf("%-24s \t %-5.5f \t %-5.5g \n", "mapped (to float)", elapsed, norm);
+        }
+        unlink(path);
+}
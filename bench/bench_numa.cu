@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <memory.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Compares serial, first-touch and interleaved placement of the grids for each
+// thread pinning policy. The pages of u, f and r are reported per NUMA node.
+// Usage: bench_numa [l] [threads]
+
+const char *placement_name(const memory_placement placement) {
+        switch (placement) {
+                case SERIAL: return "serial";
+                case FIRST_TOUCH: return "first touch";
+                case INTERLEAVE: return "interleave";
+        }
+        return "";
+}
+
+const char *pinning_name(const pinning_policy policy) {
+        switch (policy) {
+                case NO_PINNING: return "none";
+                case COMPACT: return "compact";
+                case SCATTER: return "scatter";
+        }
+        return "";
+}
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        using Problem = Poisson<Number>;
+        int l = argc > 1 ? atoi(argv[1]) : 12;
+        int threads = argc > 2 ? atoi(argv[2]) : omp_get_max_threads();
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+        Number modes = 1.0;
+        omp_set_num_threads(threads);
+
+        SolverOptions opts;
+        opts.max_iterations = 1e3;
+        opts.eps = 1e-8;
+
+        std::vector<std::vector<int>> nodes = numa_nodes();
+        printf("Grid size: %d x %d, threads: %d, NUMA nodes: %zu \n", n, n,
+               threads, nodes.size());
+
+        pinning_policy policies[] = {NO_PINNING, COMPACT, SCATTER};
+        memory_placement placements[] = {SERIAL, FIRST_TOUCH, INTERLEAVE};
+        for (pinning_policy policy : policies) {
+                std::vector<int> cpus = pin_threads(policy);
+                printf("Pinning: %s, thread nodes:", pinning_name(policy));
+                for (size_t t = 0; t < cpus.size(); ++t)
+                        printf(" %d", cpus[t] < 0 ? -1 : numa_node_of_cpu(nodes, cpus[t]));
+                printf("\n");
+
+                for (memory_placement placement : placements) {
+                        memory_options.placement = placement;
+                        Problem problem(l, h, modes);
+                        Multigrid<GaussSeidelRedBlack, Problem, Number> mg(problem);
+                        double start = omp_get_wtime();
+                        SolverOutput out = solve(mg, problem, opts);
+                        double elapsed = 1e3 * (omp_get_wtime() - start);
+                        printf("Placement: %-12s \t Iterations: %-4d \t Time (ms): %-5.5f \t Residual: %-5.5g \n",
+                               placement_name(placement), out.iterations,
+                               elapsed, out.residual);
+                        memory_placement_report("u", problem.u, problem.num_bytes);
+                        memory_placement_report("f", problem.f, problem.num_bytes);
+                        memory_placement_report("r", problem.r, problem.num_bytes);
+                }
+        }
+}
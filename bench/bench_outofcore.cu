@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <outofcore.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Solves with the fine grid stored in files under `prefix` and reports the
+// time per cycle and the peak resident set size. The in-memory solver is run
+// for comparison unless `skip` is set.
+// Usage: bench_outofcore [l] [prefix] [block rows] [skip in-memory]
+
+long peak_rss_mb(void) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss >> 10;
+}
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        int l = argc > 1 ? atoi(argv[1]) : 12;
+        const char *prefix = argc > 2 ? argv[2] : "bench_outofcore";
+        int block_rows = argc > 3 ? atoi(argv[3]) : 64;
+        int skip = argc > 4 ? atoi(argv[4]) : 0;
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+        Number modes = 1.0;
+
+        SolverOptions opts;
+        opts.max_iterations = 20;
+        opts.eps = 1e-8;
+
+        printf("Grid size: %d x %d, fine grid: %zu MB, block rows: %d \n", n, n,
+               (sizeof(Number) * n * n) >> 20, block_rows);
+        printf("Solver \t\t\t\t\t\t\t Iterations \t Time (ms) \t Residual \t Peak RSS (MB) \n");
+        {
+                using Problem = OutOfCorePoisson<Number>;
+                Problem problem(l, h, modes, prefix, block_rows);
+                OutOfCoreMultigrid<Problem, Number> mg(problem);
+                double start = omp_get_wtime();
+                SolverOutput out = solve(mg, problem, opts);
+                double elapsed = 1e3 * (omp_get_wtime() - start);
+                printf("%-48s \t %-7d \t %-5.5f \t %-5.5g \t %ld \n", mg.name(),
+                       out.iterations, elapsed, out.residual, peak_rss_mb());
+        }
+        if (skip) return 0;
+        {
+                using Problem = Poisson<Number>;
+                Problem problem(l, h, modes);
+                Multigrid<GaussSeidelRedBlack, Problem, Number> mg(problem);
+                double start = omp_get_wtime();
+                SolverOutput out = solve(mg, problem, opts);
+                double elapsed = 1e3 * (omp_get_wtime() - start);
+                printf("%-48s \t %-7d \t %-5.5f \t %-5.5g \t %ld \n", mg.name(),
+                       out.iterations, elapsed, out.residual, peak_rss_mb());
+        }
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <output.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Time stepping stand-in: a few multigrid cycles per step followed by writing
+// the solution, synchronously or with the asynchronous output stage.
+// Usage: bench_output [l] [steps] [prefix] [format] [codec] [buffers]
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        int l = argc > 1 ? atoi(argv[1]) : 11;
+        int num_steps = argc > 2 ? atoi(argv[2]) : 10;
+        const char *prefix = argc > 3 ? argv[3] : "bench_output";
+        output_format format = argc > 4 ? (output_format)atoi(argv[4]) : OUTPUT_NPY;
+        compression_codec codec = argc > 5 ? (compression_codec)atoi(argv[5])
+                                           : COMPRESSION_NONE;
+        int num_buffers = argc > 6 ? atoi(argv[6]) : 2;
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+        Number modes = 1.0;
+
+        SolverOptions opts;
+        opts.max_iterations = 3;
+        opts.eps = 0.0;
+
+        using Problem = Poisson<Number>;
+        Problem problem(l, h, modes);
+        Multigrid<GaussSeidelRedBlack, Problem, Number> mg(problem);
+        char path[1024];
+
+        printf("Grid size: %d x %d, steps: %d, format: %d, codec: %d, buffers: %d \n",
+               n, n, num_steps, format, codec, num_buffers);
+        printf("Output \t\t Time (ms) \t Waits \t MB written \n");
+        for (int async = 0; async < 2; ++async) {
+                OutputWriter<Number> output(n, n, format, codec, num_buffers);
+                output.tolerance = compression_tolerance(h);
+                double start = omp_get_wtime();
+                for (int step = 0; step < num_steps; ++step) {
+                        solve(mg, problem, opts);
+                        sprintf(path, "%s_%d.out", prefix, step);
+                        output.write(path, problem.u);
+                        if (!async) output.wait();
+                }
+                output.wait();
+                double elapsed = 1e3 * (omp_get_wtime() - start);
+                printf("%-12s \t %-5.5f \t %d \t %zu \n",
+                       async ? "asynchronous" : "synchronous", elapsed,
+                       output.num_waits, output.bytes_written >> 20);
+                for (int step = 0; step < num_steps; ++step) {
+                        sprintf(path, "%s_%d.out", prefix, step);
+                        remove(path);
+                }
+        }
+}
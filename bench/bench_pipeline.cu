@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <pipeline.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Compares the V-cycle against the V-cycle with the fused smooth, residual and
+// restriction pass for different block sizes.
+// Usage: bench_pipeline [l]
+
+template <typename S, typename P, typename T=double>
+void benchmark(S& solver, P& problem, SolverOptions opts, const int block) {
+        double start = omp_get_wtime();
+        SolverOutput out = solve(solver, problem, opts);
+        double elapsed = 1e3 * (omp_get_wtime() - start);
+        printf("%-48s \t %-5d \t %-7d \t %-5.5f \t %-5.5g \n", solver.name(),
+               block, out.iterations, elapsed, out.residual);
+}
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        using Problem = Poisson<Number>;
+        int l = argc > 1 ? atoi(argv[1]) : 12;
+        int n = (1 << l) + 1;
+        Number h = 1.0 / (n - 1);
+        Number modes = 1.0;
+
+        SolverOptions opts;
+        opts.max_iterations = 1e3;
+        opts.eps = 1e-8;
+
+        printf("Grid size: %d x %d, threads: %d \n", n, n, omp_get_max_threads());
+        printf("Solver \t\t\t\t\t\t\t Block \t Iterations \t Time (ms) \t Residual \n");
+        {
+                Problem problem(l, h, modes);
+                Multigrid<GaussSeidelRedBlack, Problem, Number> mg(problem);
+                benchmark(mg, problem, opts, 0);
+        }
+        int blocks[] = {4, 8, 16, 32, 64, 128};
+        for (int block : blocks) {
+                Problem problem(l, h, modes);
+                PipelinedMultigrid<Problem, Number> mg(problem, block);
+                benchmark(mg, problem, opts, block);
+        }
+}
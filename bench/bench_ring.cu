@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <ring.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Round trip through a shared ring with the solver in a separate process,
+// compared to solving in the producer process. The difference is the cost of
+// the hand-over (no grid data is copied).
+// Usage: bench_ring [l] [solves] [slots] [cycles per solve]
+
+using Solver = Multigrid<GaussSeidelRedBlack, Poisson<double>, double>;
+
+int main(int argc, char **argv) {
+
+        int l = argc > 1 ? atoi(argv[1]) : 6;
+        int num_solves = argc > 2 ? atoi(argv[2]) : 1000;
+        int num_slots = argc > 3 ? atoi(argv[3]) : 4;
+        int cycles = argc > 4 ? atoi(argv[4]) : 1;
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        const char *name = "/bench_ring";
+
+        // Fork before any OpenMP threads are started
+        SharedRing ring(name, l, num_slots);
+        pid_t pid = fork();
+        if (pid == 0) {
+                SharedRing solver_ring(name);
+                ring_serve<Solver>(solver_ring);
+                _exit(0);
+        }
+
+        SolverOptions opts;
+        opts.max_iterations = cycles;
+        opts.eps = 0.0;
+
+        printf("Grid size: %d x %d, solves: %d, slots: %d, cycles per solve: %d \n",
+               n, n, num_solves, num_slots, cycles);
+        printf("Solver \t\t\t Time per solve (us) \n");
+
+        // One request in flight: latency of the hand-over
+        double start = omp_get_wtime();
+        for (int s = 0; s < num_solves; ++s) {
+                int k = ring.acquire();
+                forcing_function(ring.f(k), n, h, 1.0);
+                memset(ring.u(k), 0, sizeof(double) * n * n);
+                ring.submit(k, opts);
+                ring.release(ring.wait_solution());
+        }
+        double ring_time = omp_get_wtime() - start;
+
+        Poisson<double> problem(l, h, 1.0);
+        Solver mg(problem);
+        start = omp_get_wtime();
+        for (int s = 0; s < num_solves; ++s) {
+                forcing_function(problem.f, n, h, 1.0);
+                memset(problem.u, 0, sizeof(double) * n * n);
+                solve(mg, problem, opts);
+        }
+        double local_time = omp_get_wtime() - start;
+
+        ring.close_ring();
+        waitpid(pid, nullptr, 0);
+
+        printf("%-16s \t %-8.3f \n", "shared ring", 1e6 * ring_time / num_solves);
+        printf("%-16s \t %-8.3f \n", "in process", 1e6 * local_time / num_solves);
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <amg.hpp>
+#include <csr.hpp>
+#include <sell.hpp>
+#include <grid.hpp>
+
+// Operator application with the matrix-free stencil, CSR and SELL-C-sigma:
+// the assembled Poisson operator and the first Galerkin coarse operator of
+// algebraic multigrid, whose stencil is no longer uniform.
+// Usage: bench_sell [l] [repetitions]
+
+template <typename F>
+double timeit(F kernel, const int repetitions) {
+        kernel();
+        double start = omp_get_wtime();
+        for (int k = 0; k < repetitions; ++k)
+                kernel();
+        return (omp_get_wtime() - start) / repetitions;
+}
+
+void compare(const char *name, const CSRMatrix<double>& A, const int repetitions) {
+        SELLMatrix<double> S(A);
+        int n = A.rows;
+        std::vector<double> x(n, 1.0), b(n, 1.0), y(n), dinv = csr_diagonal(A);
+        for (int i = 0; i < n; ++i)
+                dinv[i] = 1.0 / dinv[i];
+        double csr_spmv_time = timeit([&]() { csr_spmv(y.data(), A, x.data()); }, repetitions);
+        double sell_spmv_time = timeit([&]() { sell_spmv(y.data(), S, x.data()); }, repetitions);
+        double csr_jacobi_time = timeit([&]() {
+                csr_jacobi(y.data(), A, x.data(), b.data(), dinv.data(), 0.7); }, repetitions);
+        double sell_jacobi_time = timeit([&]() {
+                sell_jacobi(y.data(), S, x.data(), b.data(), dinv.data(), 0.7); }, repetitions);
+        printf("%-12s \t %-8d \t %-6.3f \t %-8.3f \t %-8.3f \t %-8.3f \t %-8.3f \n", name, n,
+               (double)S.size() / A.nnz(), 1e3 * csr_spmv_time, 1e3 * sell_spmv_time,
+               1e3 * csr_jacobi_time, 1e3 * sell_jacobi_time);
+}
+
+int main(int argc, char **argv) {
+
+        int l = argc > 1 ? atoi(argv[1]) : 11;
+        int repetitions = argc > 2 ? atoi(argv[2]) : 20;
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+
+        printf("Grid size: %d x %d, threads: %d \n", n, n, omp_get_max_threads());
+        double *u = grid_alloc<double>(n, n);
+        double *v = grid_alloc<double>(n, n);
+        double stencil = timeit([&]() { poisson_operator(v, u, n, h); }, repetitions);
+        printf("Stencil (matrix-free) operator: %.3f ms \n", 1e3 * stencil);
+        grid_free(u, n, n);
+        grid_free(v, n, n);
+
+        printf("Operator \t Rows \t\t Fill \t\t CSR (ms) \t SELL (ms) \t "
+               "CSR Jacobi \t SELL Jacobi \n");
+        Poisson<double> problem(l, h, 1.0);
+        SparseProblem<double> sparse(problem);
+        compare("Poisson", sparse.A, repetitions);
+        AlgebraicMultigrid<SparseJacobi, SparseProblem<double>, double> amg(sparse);
+        compare("Galerkin", amg.level(1).A, repetitions);
+}
@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <service.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Throughput and latency of the solve service with `clients` concurrent
+// clients that each submit `solves` requests, without batching and with
+// batches of up to `max batch` requests.
+// Usage: bench_service [l] [clients] [solves] [max batch] [window (us)]
+
+int main(int argc, char **argv) {
+
+        int l = argc > 1 ? atoi(argv[1]) : 7;
+        int num_clients = argc > 2 ? atoi(argv[2]) : 8;
+        int num_solves = argc > 3 ? atoi(argv[3]) : 50;
+        int max_batch = argc > 4 ? atoi(argv[4]) : 16;
+        double window = 1e-6 * (argc > 5 ? atof(argv[5]) : 100.0);
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        const char *path = "bench_service.sock";
+
+        SolverOptions opts;
+        opts.max_iterations = 10;
+        opts.eps = 1e-10;
+
+        printf("Grid size: %d x %d, clients: %d, solves per client: %d \n", n, n,
+               num_clients, num_solves);
+        printf("Max batch \t Batches \t Solves/s \t p50 (ms) \t p99 (ms) \n");
+        int batches[2] = {1, max_batch};
+        for (int b = 0; b < 2; ++b) {
+                SolveService service(path);
+                service.max_batch = batches[b];
+                service.batch_window = batches[b] > 1 ? window : 0.0;
+                std::thread server([&service]() { service.run(); });
+
+                std::vector<double> latencies(num_clients * num_solves);
+                double start = omp_get_wtime();
+                std::vector<std::thread> clients;
+                for (int c = 0; c < num_clients; ++c) {
+                        clients.emplace_back([&, c]() {
+                                SolveClient client(path);
+                                ServiceBuffer buffer(l);
+                                for (int s = 0; s < num_solves; ++s) {
+                                        forcing_function(buffer.f, n, h, 1.0);
+                                        memset(buffer.u, 0, sizeof(double) * n * n);
+                                        double t0 = omp_get_wtime();
+                                        client.solve(buffer, opts);
+                                        latencies[c * num_solves + s] =
+                                            1e3 * (omp_get_wtime() - t0);
+                                }
+                        });
+                }
+                for (auto& t : clients) t.join();
+                double elapsed = omp_get_wtime() - start;
+                SolveClient(path).shutdown();
+                server.join();
+
+                std::sort(latencies.begin(), latencies.end());
+                size_t m = latencies.size();
+                printf("%-9d \t %-7ld \t %-8.1f \t %-8.4f \t %-8.4f \n", batches[b],
+                       service.num_batches, m / elapsed, latencies[m / 2],
+                       latencies[std::min(m - 1, m * 99 / 100)]);
+        }
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Time per V-cycle with red-black Gauss-Seidel followed by a separate
+// residual pass, and with the smoother that computes the residual during the
+// black half-sweep. The first row clears the hierarchy before every cycle
+// instead of starting the coarse corrections from zero in the first sweep.
+// Usage: bench_smoother [l] [cycles]
+
+template <typename S>
+void run(const int l, const int cycles) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        Poisson<double> problem(l, h, 1.0);
+        Multigrid<S, Poisson<double>, double> mg(problem);
+        mg(problem);
+        double start = omp_get_wtime();
+        for (int k = 0; k < cycles; ++k)
+                mg(problem);
+        double elapsed = omp_get_wtime() - start;
+        problem.residual();
+        printf("%-48s \t %-8.3f \t %-8.3g \n", mg.name(), 1e3 * elapsed / cycles,
+               problem.norm());
+}
+
+// Previous behavior: the hierarchy is cleared before every cycle and the
+// first sweep on each coarse grid reads the zero initial guess
+class ClearedRedBlack {
+        public:
+        template <typename T>
+        void operator()(T *u, const T *f, const int n, const T h) {
+                gauss_seidel_red_black(u, f, n, h);
+        }
+        template <typename T>
+        void zero(T *u, const T *f, const int n, const T h) {
+                gauss_seidel_red_black(u, f, n, h);
+        }
+};
+
+void run_cleared(const int l, const int cycles) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        Poisson<double> problem(l, h, 1.0);
+        double *v = multigrid_alloc<double>(l);
+        double *w = multigrid_alloc<double>(l);
+        double *r = grid_alloc<double>(n, n);
+        size_t num_bytes = sizeof(double) * multigrid_size(l);
+        ClearedRedBlack smoother;
+        double start = 0.0;
+        for (int k = 0; k <= cycles; ++k) {
+                if (k == 1) start = omp_get_wtime();
+                memset(v, 0, num_bytes);
+                memset(w, 0, num_bytes);
+                multigrid_v_cycle(l, smoother, problem.u, problem.f, r, v, w, h);
+        }
+        double elapsed = omp_get_wtime() - start;
+        problem.residual();
+        printf("%-48s \t %-8.3f \t %-8.3g \n",
+               "Multi-Grid<Gauss-Seidel (red-black)>, cleared", 1e3 * elapsed / cycles,
+               problem.norm());
+        multigrid_free(v, l);
+        multigrid_free(w, l);
+        grid_free(r, n, n);
+}
+
+int main(int argc, char **argv) {
+
+        int l = argc > 1 ? atoi(argv[1]) : 12;
+        int cycles = argc > 2 ? atoi(argv[2]) : 10;
+        int n = (1 << l) + 1;
+
+        printf("Grid size: %d x %d, threads: %d \n", n, n, omp_get_max_threads());
+        printf("Solver \t\t\t\t\t\t\t Cycle (ms) \t Residual \n");
+        run_cleared(l, cycles);
+        run<GaussSeidelRedBlack>(l, cycles);
+        run<GaussSeidelRedBlackResidual>(l, cycles);
+}
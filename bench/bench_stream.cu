@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <memory.hpp>
+#include <stream.hpp>
+#include <grid.hpp>
+
+// Compares regular stores against streaming stores for the kernels with
+// write-only outputs, and sweeps the prefetch distance of the residual kernel.
+// Traffic is the number of bytes that have to be moved to and from memory: a
+// regular store reads the line before writing it back, a streaming store only
+// writes it. Bandwidth is the traffic divided by the time.
+// Usage: bench_stream [l] [repetitions]
+
+template <typename K>
+void benchmark(const char *kernel, const char *mode, const int pf, K fun,
+               const double reads, const double writes, const bool stream,
+               const int reps) {
+        fun();
+        double start = omp_get_wtime();
+        for (int k = 0; k < reps; ++k)
+                fun();
+        double elapsed = (omp_get_wtime() - start) / reps;
+        double traffic = reads + (stream ? 1 : 2) * writes;
+        printf("%-12s \t %-8s \t %-4d \t %-5.5f \t %-8.1f \t %-5.2f \n", kernel,
+               mode, pf, 1e3 * elapsed, traffic / (1 << 20),
+               traffic / elapsed / 1e9);
+}
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        int l = argc > 1 ? atoi(argv[1]) : 12;
+        int reps = argc > 2 ? atoi(argv[2]) : 10;
+        int n = (1 << l) + 1;
+        int nc = (1 << (l - 1)) + 1;
+        Number h = 1.0 / (n - 1);
+        double grid = sizeof(Number) * (double)n * n;
+        double coarse = sizeof(Number) * (double)nc * nc;
+
+        Number *u = grid_alloc<Number>(n, n);
+        Number *f = grid_alloc<Number>(n, n);
+        Number *r = grid_alloc<Number>(n, n);
+        Number *rc = grid_alloc<Number>(nc, nc);
+        exact_solution(u, n, h);
+
+        printf("Grid size: %d x %d, threads: %d, LLC: %zu MB \n", n, n,
+               omp_get_max_threads(), llc_bytes() >> 20);
+        printf("Kernel \t\t Stores \t PF \t Time (ms) \t Traffic (MB) \t Bandwidth (GB/s) \n");
+        stream_mode modes[] = {STREAM_NEVER, STREAM_ALWAYS};
+        for (stream_mode mode : modes) {
+                stream_options.stores = mode;
+                stream_options.prefetch_distance = 0;
+                bool stream = mode == STREAM_ALWAYS;
+                const char *name = stream ? "stream" : "regular";
+                benchmark("Forcing", name, 0, [&]() {
+                        forcing_function(f, n, h);
+                }, 0, grid, stream, reps);
+                benchmark("Residual", name, 0, [&]() {
+                        poisson_residual(r, u, f, n, h);
+                }, 2 * grid, grid, stream, reps);
+                benchmark("Restriction", name, 0, [&]() {
+                        grid_restrict(rc, nc, nc, r, n, n);
+                }, grid, coarse, stream, reps);
+        }
+
+        // Prefetch distance, in elements, of the streaming residual
+        stream_options.stores = STREAM_ALWAYS;
+        int distances[] = {0, 8, 16, 32, 64, 128, 256};
+        for (int pf : distances) {
+                stream_options.prefetch_distance = pf;
+                benchmark("Residual", "stream", pf, [&]() {
+                        poisson_residual(r, u, f, n, h);
+                }, 2 * grid, grid, true, reps);
+        }
+
+        grid_free(u, n, n);
+        grid_free(f, n, n);
+        grid_free(r, n, n);
+        grid_free(rc, nc, nc);
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <memory.hpp>
+#include <perf.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Compares small pages against transparent and explicit huge pages for the
+// fine grid kernels. Reports the time and the number of data TLB misses (loads
+// and stores, summed over all threads) per kernel call.
+// Usage: bench_tlb [l] [repetitions]
+
+template <typename K>
+void benchmark(const char *kernel, K fun, const int reps) {
+        PerfCounter loads(PERF_DTLB_LOAD_MISSES);
+        PerfCounter stores(PERF_DTLB_STORE_MISSES);
+        loads.start();
+        stores.start();
+        double start = omp_get_wtime();
+        for (int k = 0; k < reps; ++k)
+                fun();
+        double elapsed = 1e3 * (omp_get_wtime() - start) / reps;
+        loads.stop();
+        stores.stop();
+        long long load_misses = loads.value();
+        long long store_misses = stores.value();
+        if (load_misses < 0 || store_misses < 0)
+                printf("%-24s \t %-5.5f \t %-12s \t %-12s \n", kernel, elapsed,
+                       "n/a", "n/a");
+        else
+                printf("%-24s \t %-5.5f \t %-12lld \t %-12lld \n", kernel,
+                       elapsed, load_misses / reps, store_misses / reps);
+}
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        using Problem = Poisson<Number>;
+        int l = argc > 1 ? atoi(argv[1]) : 12;
+        int reps = argc > 2 ? atoi(argv[2]) : 10;
+        int n = (1 << l) + 1;
+        int nc = (1 << (l - 1)) + 1;
+        Number h = 1.0 / (n - 1);
+        Number modes = 1.0;
+
+        SolverOptions opts;
+        opts.max_iterations = 1e3;
+        opts.eps = 1e-8;
+
+        printf("Grid size: %d x %d, threads: %d \n", n, n, omp_get_max_threads());
+        memory_pages kinds[] = {SMALL_PAGES, TRANSPARENT_HUGE_PAGES,
+                                HUGE_PAGES_2MB, HUGE_PAGES_1GB};
+        for (memory_pages pages : kinds) {
+                memory_options.pages = pages;
+                Problem problem(l, h, modes);
+                Number *rc = grid_alloc<Number>(nc, nc);
+                printf("Requested: %s, mapped: %s, transparent huge: %zu MB of %zu MB \n",
+                       memory_pages_name(pages),
+                       memory_pages_name(memory_pages_of(problem.u)),
+                       memory_transparent_bytes(problem.u) >> 20,
+                       problem.num_bytes >> 20);
+                printf("Kernel \t\t\t\t Time (ms) \t dTLB load \t dTLB store \n");
+
+                benchmark("Gauss-Seidel (red-black)", [&]() {
+                        gauss_seidel_red_black(problem.u, problem.f, n, h);
+                }, reps);
+                benchmark("Residual", [&]() {
+                        poisson_residual(problem.r, problem.u, problem.f, n, h);
+                }, reps);
+                benchmark("Restriction", [&]() {
+                        grid_restrict(rc, nc, nc, problem.r, n, n, 0.0, 1.0);
+                }, reps);
+                benchmark("Prolongation", [&]() {
+                        grid_prolongate(problem.u, n, n, rc, nc, nc, 1.0, 1.0);
+                }, reps);
+
+                Problem solve_problem(l, h, modes);
+                Multigrid<GaussSeidelRedBlack, Problem, Number> mg(solve_problem);
+                benchmark("Multi-Grid solve", [&]() {
+                        solve(mg, solve_problem, opts);
+                }, 1);
+                grid_free(rc, nc, nc);
+        }
+}
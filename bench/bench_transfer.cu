@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Trade-off of the transfer operators: cost of the restriction kernel, V-cycles
+// and time to reduce the residual from a random initial guess, and the error
+// of one full multigrid cycle compared to the discretization error.
+// Usage: bench_transfer [l] [eps]
+
+template <typename X>
+void run(const int l, const double eps) {
+        int n = (1 << l) + 1;
+        int nc = (n + 1) / 2;
+        double h = 1.0 / (n - 1);
+        using Solver = Multigrid<GaussSeidelRedBlack, Poisson<double>, double, X>;
+
+        Poisson<double> problem(l, h, 1.0);
+        srand(1);
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        problem.u[j + i * n] = (double)rand() / RAND_MAX - 0.5;
+        Solver mg(problem);
+
+        double *rc = grid_alloc<double>(nc, nc);
+        const int num_restrict = 10;
+        double start = omp_get_wtime();
+        for (int k = 0; k < num_restrict; ++k)
+                mg.transfer.restriction(rc, nc, problem.u, n);
+        double restrict_time = (omp_get_wtime() - start) / num_restrict;
+        grid_free(rc, nc, nc);
+
+        SolverOptions opts;
+        opts.eps = eps;
+        opts.max_iterations = 200;
+        opts.mms = 1;
+        start = omp_get_wtime();
+        SolverOutput out = solve(mg, problem, opts);
+        double solve_time = omp_get_wtime() - start;
+        double rate = pow(out.history.back() / out.history[0],
+                          1.0 / (out.history.size() - 1));
+
+        Poisson<double> fmg_problem(l, h, 1.0);
+        Solver fmg(fmg_problem);
+        fmg.fmg(fmg_problem);
+
+        printf("%-18s %-10s \t %-8.3f \t %-4d \t %-6.3f \t %-8.3f \t %-8.3g \t %-8.3g \n",
+               mg.transfer.restriction.name(), mg.transfer.prolongation.name(),
+               1e3 * restrict_time, out.iterations, rate, 1e3 * solve_time,
+               fmg_problem.error(), out.error);
+}
+
+int main(int argc, char **argv) {
+
+        int l = argc > 1 ? atoi(argv[1]) : 11;
+        double eps = argc > 2 ? atof(argv[2]) : 1e-9;
+        int n = (1 << l) + 1;
+
+        printf("Grid size: %d x %d, threads: %d, tolerance: %g \n", n, n,
+               omp_get_max_threads(), eps);
+        printf("Restriction        Prolongation \t R (ms) \t Its \t Rate \t\t Solve (ms) \t FMG error \t Disc. error \n");
+        run<Transfer<FullWeighting, Bilinear>>(l, eps);
+        run<Transfer<HalfWeighting, Bilinear>>(l, eps);
+        run<Transfer<Injection, Bilinear>>(l, eps);
+        run<Transfer<FullWeighting, Cubic>>(l, eps);
+        run<Transfer<HalfWeighting, Cubic>>(l, eps);
+        run<Transfer<Injection, Cubic>>(l, eps);
+}
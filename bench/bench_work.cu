@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <pipeline.hpp>
+#include <solver.hpp>
+#include <work.hpp>
+
+// Work units, flops and estimated bytes to reach the tolerance from a random
+// initial guess for several configurations, with the achieved rates (roofline
+// inputs). The work units rank the configurations independently of the
+// machine.
+// Usage: bench_work [l] [eps]
+
+template <typename S, typename P>
+void report(S& solver, P& problem, const char *cycle, const double eps) {
+        int n = problem.n;
+        srand(1);
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        problem.u[j + i * n] = (double)rand() / RAND_MAX - 0.5;
+        SolverOptions opts;
+        opts.eps = eps;
+        opts.max_iterations = 200;
+        double start = omp_get_wtime();
+        SolverOutput out = solve(solver, problem, opts);
+        double seconds = omp_get_wtime() - start;
+        const WorkCounts& w = out.work;
+        printf("%-72s %-7s %-4d %-8.2f %-8.3f %-8.3f %-7.3f %-9.2f %-8.3f %-8.3f \n",
+               solver.name(), cycle, out.iterations, w.work_units(),
+               1e-9 * w.total_flops(), 1e-9 * w.total_bytes(), w.intensity(), 1e3 * seconds,
+               1e-9 * w.total_flops() / seconds, 1e-9 * w.total_bytes() / seconds);
+}
+
+template <typename S, typename X=Transfer<>>
+void run(const int l, const double eps, const CycleOptions cycle) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        Poisson<double> problem(l, h, 1.0);
+        Multigrid<S, Poisson<double>, double, X> mg(problem);
+        mg.cycle = cycle;
+        char name[32];
+        report(mg, problem, cycle.name(name, sizeof(name)), eps);
+}
+
+int main(int argc, char **argv) {
+        int l = argc > 1 ? atoi(argv[1]) : 10;
+        double eps = argc > 2 ? atof(argv[2]) : 1e-9;
+        printf("%-72s %-7s %-4s %-8s %-8s %-8s %-7s %-9s %-8s %-8s \n", "Solver", "Cycle",
+               "Its", "WU", "GFLOP", "GB", "Flop/B", "Time (ms)", "GFLOP/s", "GB/s");
+        run<GaussSeidelRedBlack>(l, eps, CycleOptions(V_CYCLE, 1, 1));
+        run<GaussSeidelRedBlack>(l, eps, CycleOptions(V_CYCLE, 2, 2));
+        run<GaussSeidelRedBlack>(l, eps, CycleOptions(W_CYCLE, 1, 1));
+        run<GaussSeidelRedBlack>(l, eps, CycleOptions(F_CYCLE, 1, 1));
+        run<GaussSeidelRedBlackResidual>(l, eps, CycleOptions(V_CYCLE, 1, 1));
+        run<GaussSeidelRedBlackResidual, Transfer<HalfWeighting>>(l, eps,
+                                                                  CycleOptions(V_CYCLE, 1, 1));
+        run<GaussSeidel>(l, eps, CycleOptions(V_CYCLE, 1, 1));
+        run<Jacobi>(l, eps, CycleOptions(V_CYCLE, 2, 2));
+
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        Poisson<double> problem(l, h, 1.0);
+        PipelinedMultigrid<Poisson<double>, double> pipelined(problem);
+        report(pipelined, problem, "V(1,1)", eps);
+
+        // Counts per kernel of the default configuration
+        Poisson<double> p(l, h, 1.0);
+        Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(p);
+        SolverOptions opts;
+        opts.eps = eps;
+        opts.max_iterations = 200;
+        double start = omp_get_wtime();
+        SolverOutput out = solve(mg, p, opts);
+        printf("\n%s \n", mg.name());
+        work_report(stdout, out.work, omp_get_wtime() - start);
+        return 0;
+}
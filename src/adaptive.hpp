@@ -0,0 +1,178 @@
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+// Multigrid cycle configurations and the controller that `solve` uses to
+// choose between them at run time (SolverOptions::adaptive). The controller
+// measures the contraction factor of the residual and the time of every
+// cycle. Each candidate configuration is scored by the predicted time per
+// factor e of residual reduction,
+//
+//   score = seconds per cycle / -log(contraction factor per cycle),
+//
+// which is proportional to the predicted time to reach the tolerance. The
+// controller first tries the candidates for `window` cycles each, as long as
+// enough cycles remain for the exploration to pay off, and then keeps the one
+// with the best score. It explores again if the score of the chosen
+// configuration degrades by a factor `drift`.
+
+enum cycle_type {V_CYCLE, W_CYCLE, F_CYCLE};
+
+// Shape of a multigrid cycle and sweeps of pre- and post-smoothing (zero or
+// more)
+class CycleOptions {
+        public:
+                cycle_type type = V_CYCLE;
+                int pre = 1;
+                int post = 1;
+
+                CycleOptions() { }
+                CycleOptions(const cycle_type type, const int pre, const int post)
+                    : type(type), pre(pre), post(post) { }
+
+                bool operator==(const CycleOptions& other) const {
+                        return type == other.type && pre == other.pre && post == other.post;
+                }
+
+                // E.g., "V(1,1)", written to `out` (32 bytes are enough)
+                const char *name(char *out, const size_t size) const {
+                        snprintf(out, size, "%c(%d,%d)",
+                                 type == V_CYCLE ? 'V' : type == W_CYCLE ? 'W' : 'F', pre,
+                                 post);
+                        return out;
+                }
+};
+
+class CycleDecision {
+        public:
+                // Iteration after which the configuration changed
+                int iteration = 0;
+                CycleOptions from, to;
+                // Contraction factor and seconds per cycle measured for `from`
+                double rate = 0.0;
+                double seconds = 0.0;
+                // "explore" (try the next candidate) or "best"
+                const char *reason = "";
+};
+
+class CycleController {
+        private:
+                struct Stats {
+                        int cycles = 0;
+                        // Averages of log(contraction factor) and seconds
+                        double log_rate = 0.0;
+                        double seconds = 0.0;
+                };
+                std::vector<Stats> stats;
+                int current = -1;
+                // Cycles since the last switch
+                int count = 0;
+                bool exploring = true;
+                // Score of the current configuration when it was chosen
+                double chosen = 0.0;
+
+                double score(const int k) {
+                        const Stats& s = stats[k];
+                        if (s.log_rate >= 0.0) return HUGE_VAL;
+                        return s.seconds / -s.log_rate;
+                }
+
+                int best(void) {
+                        int k = current;
+                        for (size_t i = 0; i < candidates.size(); ++i)
+                                if (stats[i].cycles > 0 && score(i) < (1 - margin) * score(k))
+                                        k = i;
+                        return k;
+                }
+
+        public:
+                std::vector<CycleOptions> candidates;
+                // Cycles per decision. The first cycle after a switch is not
+                // measured, since the error still has the components that the
+                // previous configuration left.
+                int window = 3;
+                // Relative improvement of the score needed to switch
+                double margin = 0.05;
+                // Weight of the last cycle in the averages
+                double weight = 0.5;
+                // Explore again when the score of the chosen configuration
+                // becomes `drift` times worse
+                double drift = 2.0;
+                // No decisions after the exploration when the contraction
+                // factor of the last cycle or the average is above `stall`
+                // (e.g., the residual is at the round-off level)
+                double stall = 0.95;
+
+                CycleController() {
+                        const cycle_type types[3] = {V_CYCLE, F_CYCLE, W_CYCLE};
+                        for (int t = 0; t < 3; ++t)
+                                for (int s = 1; s <= 2; ++s)
+                                        candidates.push_back(CycleOptions(types[t], s, s));
+                }
+
+                // Called after each cycle with the residual before and after
+                // it. Updates `cycle` and returns true when it switches.
+                bool update(CycleOptions& cycle, const int iteration, const double prev,
+                            const double res, const double seconds, const double eps,
+                            CycleDecision& decision) {
+                        if (current < 0) {
+                                current = 0;
+                                while (current < (int)candidates.size() &&
+                                       !(candidates[current] == cycle))
+                                        current++;
+                                if (current == (int)candidates.size())
+                                        candidates.push_back(cycle);
+                                stats.resize(candidates.size());
+                        }
+                        count++;
+                        if (prev <= 0.0 || res <= 0.0)
+                                return false;
+                        Stats& s = stats[current];
+                        if (count > 1) {
+                                double a = s.cycles == 0 ? 1.0 : weight;
+                                s.log_rate = (1 - a) * s.log_rate + a * log(res / prev);
+                                s.seconds = (1 - a) * s.seconds + a * seconds;
+                                s.cycles++;
+                        }
+                        if (res <= eps || count < window)
+                                return false;
+                        if (!exploring && (res > stall * prev || s.log_rate > log(stall)))
+                                return false;
+
+                        int next = current;
+                        const char *reason = "best";
+                        if (!exploring && score(current) > drift * chosen) {
+                                for (size_t k = 0; k < candidates.size(); ++k)
+                                        if ((int)k != current) stats[k].cycles = 0;
+                                exploring = true;
+                        }
+                        if (exploring) {
+                                // Predicted cycles to the tolerance
+                                double remaining = log(res / eps) / -s.log_rate;
+                                int untried = -1;
+                                for (size_t k = 0; k < candidates.size() && untried < 0; ++k)
+                                        if (stats[k].cycles == 0) untried = k;
+                                if (untried >= 0 && remaining > 2 * window) {
+                                        next = untried;
+                                        reason = "explore";
+                                } else {
+                                        exploring = false;
+                                        next = best();
+                                        chosen = score(next);
+                                }
+                        }
+                        count = 0;
+                        if (next == current)
+                                return false;
+
+                        decision.iteration = iteration;
+                        decision.from = candidates[current];
+                        decision.to = candidates[next];
+                        decision.rate = exp(s.log_rate);
+                        decision.seconds = s.seconds;
+                        decision.reason = reason;
+                        current = next;
+                        cycle = candidates[next];
+                        return true;
+                }
+};
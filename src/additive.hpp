@@ -0,0 +1,164 @@
+#pragma once
+#include <omp.h>
+#include <vector>
+#include <batch.hpp>
+#include <poisson.hpp>
+// Additive multigrid: the corrections on all levels are computed concurrently
+// from the restricted fine grid residual and then summed.
+//
+// BPX:   e = sum_k P_k S_k R_k r
+// AFACx: e = sum_k P_k (S_k(R_k r; P y_k-1) - P y_k-1),  y_k-1 = S_k-1 R_k-1 r
+//
+// S_k denotes `sweeps` smoothing steps starting from a zero initial guess. The
+// AFACx variant removes the part of the level k correction that is already
+// captured by level k - 1 and is convergent as a stand-alone iteration. BPX is
+// symmetric when the smoother is (e.g., Jacobi) and is intended to be used as a
+// preconditioner, see `ConjugateGradient` in krylov.hpp.
+
+enum additive_type {BPX, AFACX};
+
+template <typename T, typename S>
+void additive_smooth(S& smoother, T *e, const T *f, const int l, const T h,
+                     const int sweeps) {
+        if (l == 1) {
+                base_case(e, f, h);
+                return;
+        }
+        int n = (1 << l) + 1;
+        memset(e, 0, sizeof(T) * n * n);
+        for (int s = 0; s < sweeps; ++s)
+                smoother(e, f, n, h);
+}
+
+// Computes the level l correction e = S_l r_l (BPX), or
+// e = S_l(r_l; Py) - Py (AFACx). t is scratch space on level l - 1
+template <typename T, typename S>
+void additive_correction(const additive_type type, S& smoother, T *e, T *t,
+                         const T *r, const T *rc, const int l, const T h,
+                         const int sweeps) {
+        if (type == BPX || l == 1) {
+                additive_smooth(smoother, e, r, l, h, sweeps);
+                return;
+        }
+
+        int n = (1 << l) + 1;
+        int nc = (1 << (l - 1)) + 1;
+        additive_smooth(smoother, t, rc, l - 1, 2 * h, sweeps);
+        grid_prolongate(e, n, n, t, nc, nc, (T)0.0, (T)1.0);
+        for (int s = 0; s < sweeps; ++s)
+                smoother(e, r, n, h);
+        grid_prolongate(e, n, n, t, nc, nc, (T)1.0, (T)-1.0);
+}
+
+// Apply the additive multigrid operator to the fine grid residual r (level l),
+// the result is written to the level l slot of v.
+// v, w, t: buffers of size multigrid_size(l)
+template <typename T, typename S>
+void additive_multigrid(const additive_type type, const int l, S *smoothers,
+                        const T *r, T *v, T *w, T *t, const T h,
+                        const int sweeps) {
+
+        // r^(k-1) := R r^k for all levels
+        const T *rk = r;
+        for (int k = l; k > 1; --k) {
+                int nf = (1 << k) + 1;
+                int nc = (1 << (k - 1)) + 1;
+                T *rc = &w[multigrid_offset(k - 1)];
+                grid_restrict(rc, nc, nc, rk, nf, nf, (T)0.0, (T)1.0);
+                rk = rc;
+        }
+
+        // Level corrections are independent. The levels are assigned to groups
+        // of threads in proportion to their work as in `BatchMultigrid` (the
+        // fine grid gets most of the threads, the coarsest grids share one
+        // group), and each group corrects its levels with a nested team.
+        std::vector<int> group, threads;
+        batch_groups(l, omp_get_max_threads(), group, threads);
+        int num_groups = threads.size();
+        WorkCounts *work = &work_target();
+        int max_levels = omp_get_max_active_levels();
+        omp_set_max_active_levels(2);
+        #pragma omp parallel num_threads(num_groups)
+        {
+                WorkScope scope(work);
+                int g = omp_get_thread_num();
+                omp_set_num_threads(threads[g]);
+                for (int k = l; k >= 1; --k) {
+                        if (group[k] != g) continue;
+                        T hk = h * (1 << (l - k));
+                        const T *rl = k == l ? r : &w[multigrid_offset(k)];
+                        const T *rc = k > 1 ? &w[multigrid_offset(k - 1)] : 0;
+                        T *tc = k > 1 ? &t[multigrid_offset(k - 1)] : 0;
+                        additive_correction(type, smoothers[k], &v[multigrid_offset(k)],
+                                            tc, rl, rc, k, hk, sweeps);
+                }
+        }
+        omp_set_max_active_levels(max_levels);
+
+        // e^k := e^k + P e^(k-1)
+        for (int k = 2; k <= l; ++k) {
+                int nf = (1 << k) + 1;
+                int nc = (1 << (k - 1)) + 1;
+                grid_prolongate(&v[multigrid_offset(k)], nf, nf,
+                                &v[multigrid_offset(k - 1)], nc, nc, (T)1.0,
+                                (T)1.0);
+        }
+}
+
+template <typename F, typename P, typename T>
+class AdditiveMultigrid {
+        private:
+                T *v = 0, *w = 0, *t = 0, *r = 0;
+                int l;
+                size_t num_bytes = 0;
+                // One smoother per level, the levels are smoothed concurrently
+                std::vector<F> smoothers;
+        public:
+                additive_type type = AFACX;
+                int sweeps = 1;
+                T damping = 1.0;
+
+                AdditiveMultigrid() { }
+                AdditiveMultigrid(P& p, const additive_type type=AFACX)
+                    : l(p.l), smoothers(p.l + 1), type(type) {
+                        num_bytes = multigrid_size(l) * sizeof(T);
+                        v = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        w = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        t = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        int n = (1 << p.l) + 1;
+                        r = grid_alloc<T>(n, n, MEMORY_SCRATCH);
+                }
+
+                // u := u + damping * B (f - Lu)
+                void operator()(P& p) {
+                        poisson_residual(r, p.u, p.f, p.n, p.h);
+                        additive_multigrid(type, l, smoothers.data(), r, v, w, t,
+                                           p.h, sweeps);
+                        grid_axpby(p.u, &v[multigrid_offset(l)], p.n, p.n,
+                                   damping, (T)1.0);
+                }
+
+                // z := B r
+                void precondition(T *z, const T *r, const int n, const T h) {
+                        additive_multigrid(type, l, smoothers.data(), r, v, w, t,
+                                           h, sweeps);
+                        memcpy(z, &v[multigrid_offset(l)], sizeof(T) * n * n);
+                }
+
+                ~AdditiveMultigrid(void) {
+                        int n = (1 << l) + 1;
+                        memory_free(v, num_bytes);
+                        memory_free(w, num_bytes);
+                        memory_free(t, num_bytes);
+                        if (r != nullptr) grid_free(r, n, n);
+                }
+
+                const char *name() {
+                        static char name[2048];
+                        F smoother;
+                        sprintf(name, "Additive Multi-Grid (%s)<%s>",
+                                type == BPX ? "BPX" : "AFACx", smoother.name());
+                        return name;
+                }
+
+};
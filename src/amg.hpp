@@ -0,0 +1,549 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <csr.hpp>
+#include <poisson.hpp>
+#include <sell.hpp>
+// Smoothed aggregation algebraic multigrid for assembled sparse (CSR)
+// operators, e.g., from unstructured finite element discretizations. The
+// hierarchy is built once from the matrix:
+//
+//   1. Strength of connection: j is a strong neighbor of i if
+//      |a_ij| >= theta sqrt(|a_ii a_jj|).
+//   2. Aggregation: roots are a distance-2 maximal independent set of the
+//      strength graph, selected in parallel rounds with hashed priorities.
+//      The remaining unknowns join a neighboring aggregate.
+//   3. Prolongation: the tentative prolongator (the near-nullspace vector,
+//      constant on the finest level, restricted to each aggregate) smoothed
+//      by one damped Jacobi step,
+//      P = (I - 4 / (3 rho) D^-1 A) P_0, where rho estimates the spectral
+//      radius of D^-1 A.
+//   4. Galerkin coarse operator A_c = P^T A P (sparse products).
+//
+// The coarsest operator is solved directly (dense LU) if it has at most
+// `AMGOptions::coarse_size` unknowns, otherwise (coarsening stalled or
+// `max_levels` reached) it is only smoothed. Every step is deterministic, so
+// the hierarchy and the iterates do not depend on the number of threads.
+//
+//   SparseProblem<double> problem(A);        (fill problem.f)
+//   AlgebraicMultigrid<SparseJacobi, SparseProblem<double>, double> amg(problem);
+//   solve(amg, problem, opts);
+
+class AMGOptions {
+        public:
+                // Strength of connection threshold
+                double theta = 0.08;
+                // Coarsening stops at this many unknowns. A coarsest level
+                // that stays larger (no aggregation progress or max_levels
+                // reached) is smoothed instead of factored.
+                int coarse_size = 256;
+                int max_levels = 25;
+                // Smoother applications before and after the coarse
+                // correction
+                int pre_smooth = 1;
+                int post_smooth = 1;
+                // Apply the level operators in SELL-C-sigma format
+                bool sell = false;
+};
+
+template <typename T>
+class AMGLevel {
+        public:
+                CSRMatrix<T> A;
+                // Prolongation from the next coarser level and restriction
+                // (P^T) to it
+                CSRMatrix<T> P, R;
+                std::vector<T> dinv;
+                // Estimate of the spectral radius of D^-1 A
+                double rho = 0.0;
+                // Solution, right-hand side and scratch vectors
+                std::vector<T> x, b, r, d;
+                // Copy of A used by the smoothers and residuals, if not empty
+                SELLMatrix<T> S;
+
+                void residual(T *r, const T *x, const T *b) {
+                        if (S.rows > 0) sell_residual(r, S, x, b);
+                        else csr_residual(r, A, x, b);
+                }
+
+                size_t bytes(void) const {
+                        return A.bytes() + P.bytes() + R.bytes() + S.bytes() +
+                               sizeof(T) * (dinv.capacity() + x.capacity() + b.capacity() +
+                                            r.capacity() + d.capacity());
+                }
+
+                // y := x + omega D^-1 (b - A x)
+                void jacobi(T *y, const T *x, const T *b, const T omega) {
+                        if (S.rows > 0) sell_jacobi(y, S, x, b, dinv.data(), omega);
+                        else csr_jacobi(y, A, x, b, dinv.data(), omega);
+                }
+};
+
+// Unique nonzero priority of unknown i
+__inline__ uint64_t amg_priority(const int i) {
+        uint32_t x = i;
+        x ^= x >> 16;
+        x *= 0x7feb352d;
+        x ^= x >> 15;
+        x *= 0x846ca68b;
+        x ^= x >> 16;
+        return ((uint64_t)x << 32) | (uint32_t)(i + 1);
+}
+
+// Estimate of the largest eigenvalue of D^-1 A (A symmetric positive
+// definite) by power iteration from a fixed pseudo-random start vector
+template <typename T>
+double amg_spectral_radius(const CSRMatrix<T>& A, const std::vector<T>& dinv,
+                           const int iterations=15) {
+        int n = A.rows;
+        std::vector<T> x(n), y(n);
+        for (int i = 0; i < n; ++i)
+                x[i] = (double)(amg_priority(i) >> 32) / 4294967296.0 - 0.5;
+        double rho = 0.0;
+        for (int k = 0; k < iterations; ++k) {
+                csr_spmv(y.data(), A, x.data());
+                // Rayleigh quotient (x, A x) / (x, D x)
+                double xax = vector_dot(x.data(), y.data(), n);
+                double xdx = 0.0;
+                for (int i = 0; i < n; ++i)
+                        xdx += x[i] * x[i] / dinv[i];
+                rho = xax / xdx;
+                for (int i = 0; i < n; ++i)
+                        y[i] *= dinv[i];
+                double norm = sqrt(vector_dot(y.data(), y.data(), n));
+                if (norm == 0.0) break;
+                for (int i = 0; i < n; ++i)
+                        x[i] = y[i] / norm;
+        }
+        return rho;
+}
+
+// Strong connections of A, without the diagonal
+template <typename T>
+CSRMatrix<T> amg_strength(const CSRMatrix<T>& A, const double theta) {
+        std::vector<T> d = csr_diagonal(A);
+        return csr_build<T>(A.rows, A.cols,
+                [&](const int i, std::vector<std::pair<int, T>>& entries) {
+                        for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k) {
+                                int j = A.idx[k];
+                                if (j != i && fabs(A.val[k]) >= theta * sqrt(fabs(d[i] * d[j])))
+                                        entries.push_back(std::make_pair(j, A.val[k]));
+                        }
+                });
+}
+
+// Aggregate index of each unknown. Returns the number of aggregates.
+template <typename T>
+int amg_aggregate(std::vector<int>& agg, const CSRMatrix<T>& S) {
+        int n = S.rows;
+        enum { UNDECIDED, ROOT, OUT };
+        std::vector<char> state(n, UNDECIDED);
+        std::vector<uint64_t> m1(n), m2(n);
+        std::vector<char> near1(n);
+        bool undecided = n > 0;
+        // Distance-2 maximal independent set: an undecided unknown becomes a
+        // root if it has the largest priority among the undecided unknowns
+        // within distance 2. Unknowns within distance 2 of a root are out.
+        while (undecided) {
+                #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                for (int i = 0; i < n; ++i) {
+                        uint64_t m = state[i] == UNDECIDED ? amg_priority(i) : 0;
+                        for (int k = S.ptr[i]; k < S.ptr[i + 1]; ++k)
+                                if (state[S.idx[k]] == UNDECIDED)
+                                        m = std::max(m, amg_priority(S.idx[k]));
+                        m1[i] = m;
+                }
+                #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                for (int i = 0; i < n; ++i) {
+                        uint64_t m = m1[i];
+                        for (int k = S.ptr[i]; k < S.ptr[i + 1]; ++k)
+                                m = std::max(m, m1[S.idx[k]]);
+                        m2[i] = m;
+                }
+                #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                for (int i = 0; i < n; ++i)
+                        if (state[i] == UNDECIDED && m2[i] == amg_priority(i))
+                                state[i] = ROOT;
+                #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                for (int i = 0; i < n; ++i) {
+                        bool near = state[i] == ROOT;
+                        for (int k = S.ptr[i]; k < S.ptr[i + 1]; ++k)
+                                near |= state[S.idx[k]] == ROOT;
+                        near1[i] = near;
+                }
+                undecided = false;
+                #pragma omp parallel for schedule(static) reduction(||:undecided) if (n >= CSR_OMP_MIN_ROWS)
+                for (int i = 0; i < n; ++i) {
+                        if (state[i] != UNDECIDED) continue;
+                        bool near = near1[i];
+                        for (int k = S.ptr[i]; k < S.ptr[i + 1]; ++k)
+                                near |= near1[S.idx[k]];
+                        if (near) state[i] = OUT;
+                        else undecided = true;
+                }
+        }
+
+        // Roots are numbered in order
+        agg.assign(n, -1);
+        int num_aggs = 0;
+        for (int i = 0; i < n; ++i)
+                if (state[i] == ROOT) agg[i] = num_aggs++;
+
+        // Unknowns join the aggregate of the strongest-priority root among
+        // their neighbors, then of an aggregated neighbor
+        for (int pass = 0; pass < 2; ++pass) {
+                std::vector<int> prev(agg);
+                #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                for (int i = 0; i < n; ++i) {
+                        if (prev[i] >= 0) continue;
+                        uint64_t best = 0;
+                        for (int k = S.ptr[i]; k < S.ptr[i + 1]; ++k) {
+                                int j = S.idx[k];
+                                bool candidate = pass == 0 ? state[j] == ROOT : prev[j] >= 0;
+                                if (candidate && amg_priority(j) > best) {
+                                        best = amg_priority(j);
+                                        agg[i] = prev[j];
+                                }
+                        }
+                }
+        }
+
+        // Not reached for a maximal independent set, but keep every unknown
+        // in an aggregate
+        for (int i = 0; i < n; ++i)
+                if (agg[i] < 0) agg[i] = num_aggs++;
+        return num_aggs;
+}
+
+// Smoothed prolongator P = (I - omega D^-1 A) P_0. The tentative prolongator
+// P_0 restricts the near-nullspace vector B (constant on the finest level) to
+// each aggregate and normalizes it, so that B = P_0 B_c. B is replaced by the
+// coarse near-nullspace vector B_c (the norms of B on the aggregates).
+template <typename T>
+CSRMatrix<T> amg_prolongator(const CSRMatrix<T>& A, const std::vector<T>& dinv,
+                             std::vector<T>& B, const std::vector<int>& agg,
+                             const int num_aggs, const double omega) {
+        int n = A.rows;
+        std::vector<T> norm(num_aggs, 0.0);
+        for (int i = 0; i < n; ++i)
+                norm[agg[i]] += B[i] * B[i];
+        for (int a = 0; a < num_aggs; ++a)
+                norm[a] = sqrt(norm[a]);
+        CSRMatrix<T> P = csr_build<T>(n, num_aggs,
+                [&](const int i, std::vector<std::pair<int, T>>& entries) {
+                        entries.push_back(std::make_pair(agg[i], B[i] / norm[agg[i]]));
+                        for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k) {
+                                int j = A.idx[k];
+                                entries.push_back(std::make_pair(
+                                    agg[j], (T)(-omega * dinv[i] * A.val[k] * B[j] / norm[agg[j]])));
+                        }
+                });
+        B = norm;
+        return P;
+}
+
+// Damped Jacobi, x := x + omega / rho D^-1 (b - A x). The damping is
+// relative to the spectral radius of each level (omega / rho = 2 / 3 for the
+// five-point Laplacian).
+class SparseJacobi {
+        public:
+                double omega = 4.0 / 3.0;
+                SparseJacobi() { }
+        template <typename T>
+        void operator()(AMGLevel<T>& level, T *x, const T *b) {
+                T *r = level.r.data();
+                int n = level.A.rows;
+                level.jacobi(r, x, b, (T)(omega / level.rho));
+                #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                for (int i = 0; i < n; ++i)
+                        x[i] = r[i];
+        }
+
+        const char *name() {
+                return "Jacobi";
+        }
+
+};
+
+// Chebyshev polynomial in D^-1 A of degree `degree` that damps the
+// eigenvalues in [lower rho, upper rho]. Aggregates are about three unknowns
+// wide, so the smoother has to reduce a wider part of the spectrum than with
+// geometric coarsening.
+class SparseChebyshev {
+        public:
+                int degree = 2;
+                double lower = 1.0 / 8.0;
+                double upper = 1.1;
+                SparseChebyshev() { }
+        template <typename T>
+        void operator()(AMGLevel<T>& level, T *x, const T *b) {
+                int n = level.A.rows;
+                T *r = level.r.data();
+                T *d = level.d.data();
+                double a = lower * level.rho, c = upper * level.rho;
+                double theta = 0.5 * (c + a), delta = 0.5 * (c - a);
+                double sigma = theta / delta;
+                double rho_k = 1.0 / sigma;
+                level.residual(r, x, b);
+                #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                for (int i = 0; i < n; ++i)
+                        d[i] = level.dinv[i] * r[i] / theta;
+                for (int k = 0; k < degree; ++k) {
+                        #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                        for (int i = 0; i < n; ++i)
+                                x[i] += d[i];
+                        if (k == degree - 1) break;
+                        level.residual(r, x, b);
+                        double rho_next = 1.0 / (2.0 * sigma - rho_k);
+                        T s = rho_next * rho_k, t = 2.0 * rho_next / delta;
+                        #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                        for (int i = 0; i < n; ++i)
+                                d[i] = s * d[i] + t * level.dinv[i] * r[i];
+                        rho_k = rho_next;
+                }
+        }
+
+        const char *name() {
+                return "Chebyshev";
+        }
+
+};
+
+// Sparse system A u = f. The norms weight each unknown by `weight` (h^2 for
+// grid problems, so that they are comparable to `Poisson`).
+template <typename T>
+class SparseProblem {
+        public:
+                CSRMatrix<T> A;
+                int n;
+                T *u, *f, *r;
+                T weight = 1.0;
+                // Exact solution, if known
+                std::vector<T> exact;
+                // Bytes of A and the exact solution, see memory.hpp
+                size_t num_bytes = 0;
+
+        SparseProblem(const CSRMatrix<T>& A, const T weight=1.0)
+            : A(A), n(A.rows), weight(weight) {
+                u = grid_alloc<T>(n, 1, MEMORY_PROBLEM);
+                f = grid_alloc<T>(n, 1, MEMORY_PROBLEM);
+                r = grid_alloc<T>(n, 1, MEMORY_PROBLEM);
+                num_bytes = this->A.bytes();
+                memory_account(MEMORY_PROBLEM, num_bytes);
+        }
+
+        // Interior unknowns of a Poisson problem: A = -L and f = -f, so that
+        // the solution and the residual norm are those of the grid problem
+        SparseProblem(Poisson<T>& p)
+            : SparseProblem(poisson_csr<T>(p.n, p.h), p.h * p.h) {
+                grid_to_interior(f, p.f, p.n, (T)-1.0);
+                grid_to_interior(u, p.u, p.n);
+                T *v = grid_alloc<T>(p.n, p.n, MEMORY_SCRATCH);
+                exact_solution(v, p.n, p.h, p.modes);
+                exact.resize(n);
+                grid_to_interior(exact.data(), v, p.n);
+                grid_free(v, p.n, p.n);
+                memory_account(MEMORY_PROBLEM, sizeof(T) * exact.capacity());
+                num_bytes += sizeof(T) * exact.capacity();
+        }
+
+        SparseProblem(const SparseProblem&) = delete;
+
+        T error() {
+                if (exact.empty()) return 0.0;
+                for (int i = 0; i < n; ++i)
+                        r[i] = u[i] - exact[i];
+                return vector_l1norm(r, n, weight);
+        }
+
+        void residual(void) {
+                csr_residual(r, A, u, f);
+        }
+
+        T norm(void) {
+                return vector_l1norm(r, n, weight);
+        }
+
+        ~SparseProblem() {
+                grid_free(u, n, 1);
+                grid_free(f, n, 1);
+                grid_free(r, n, 1);
+                memory_account(MEMORY_PROBLEM, -(long long)num_bytes);
+        }
+};
+
+template <typename S, typename P, typename T>
+class AlgebraicMultigrid {
+        private:
+                std::vector<AMGLevel<T>> levels;
+                // LU factorization (partial pivoting) of the coarsest operator
+                std::vector<T> lu;
+                std::vector<int> pivot;
+                // The coarsest level is solved with the factorization,
+                // otherwise it is only smoothed
+                bool direct = false;
+                AMGOptions opts;
+                // Bytes of the levels and the factorization, see memory.hpp
+                size_t num_bytes = 0;
+
+                void factor(const CSRMatrix<T>& A) {
+                        int m = A.rows;
+                        lu.assign((size_t)m * m, 0.0);
+                        pivot.resize(m);
+                        for (int i = 0; i < m; ++i)
+                                for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k)
+                                        lu[A.idx[k] + (size_t)m * i] = A.val[k];
+                        for (int k = 0; k < m; ++k) {
+                                int p = k;
+                                for (int i = k + 1; i < m; ++i)
+                                        if (fabs(lu[k + (size_t)m * i]) > fabs(lu[k + (size_t)m * p]))
+                                                p = i;
+                                pivot[k] = p;
+                                if (p != k)
+                                        for (int j = 0; j < m; ++j)
+                                                std::swap(lu[j + (size_t)m * k], lu[j + (size_t)m * p]);
+                                T pkk = lu[k + (size_t)m * k];
+                                if (pkk == 0.0) {
+                                        fprintf(stderr, "AlgebraicMultigrid: singular coarse operator.\n");
+                                        exit(EXIT_FAILURE);
+                                }
+                                for (int i = k + 1; i < m; ++i) {
+                                        T lik = lu[k + (size_t)m * i] / pkk;
+                                        lu[k + (size_t)m * i] = lik;
+                                        for (int j = k + 1; j < m; ++j)
+                                                lu[j + (size_t)m * i] -= lik * lu[j + (size_t)m * k];
+                                }
+                        }
+                }
+
+                void coarse_solve(T *x, const T *b) {
+                        int m = pivot.size();
+                        for (int i = 0; i < m; ++i)
+                                x[i] = b[i];
+                        for (int k = 0; k < m; ++k)
+                                std::swap(x[k], x[pivot[k]]);
+                        for (int i = 0; i < m; ++i)
+                                for (int j = 0; j < i; ++j)
+                                        x[i] -= lu[j + (size_t)m * i] * x[j];
+                        for (int i = m - 1; i >= 0; --i) {
+                                for (int j = i + 1; j < m; ++j)
+                                        x[i] -= lu[j + (size_t)m * i] * x[j];
+                                x[i] /= lu[i + (size_t)m * i];
+                        }
+                }
+
+                void cycle(const int k, T *x, const T *b) {
+                        AMGLevel<T>& level = levels[k];
+                        if (k == (int)levels.size() - 1) {
+                                if (direct) {
+                                        coarse_solve(x, b);
+                                        return;
+                                }
+                                int sweeps = std::max(opts.pre_smooth + opts.post_smooth, 1);
+                                for (int s = 0; s < sweeps; ++s)
+                                        smoother(level, x, b);
+                                return;
+                        }
+                        for (int s = 0; s < opts.pre_smooth; ++s)
+                                smoother(level, x, b);
+                        AMGLevel<T>& coarse = levels[k + 1];
+                        T *r = level.r.data();
+                        level.residual(r, x, b);
+                        csr_spmv(coarse.b.data(), level.R, r);
+                        std::fill(coarse.x.begin(), coarse.x.end(), (T)0.0);
+                        cycle(k + 1, coarse.x.data(), coarse.b.data());
+                        csr_spmv(r, level.P, coarse.x.data());
+                        int n = level.A.rows;
+                        #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+                        for (int i = 0; i < n; ++i)
+                                x[i] += r[i];
+                        for (int s = 0; s < opts.post_smooth; ++s)
+                                smoother(level, x, b);
+                }
+
+        public:
+                S smoother;
+
+                AlgebraicMultigrid(P& p, const AMGOptions& opts=AMGOptions())
+                    : opts(opts) {
+                        levels.emplace_back();
+                        levels[0].A = p.A;
+                        std::vector<T> B(p.A.rows, 1.0);
+                        for (;;) {
+                                AMGLevel<T>& level = levels.back();
+                                int n = level.A.rows;
+                                level.dinv = csr_diagonal(level.A);
+                                for (int i = 0; i < n; ++i)
+                                        level.dinv[i] = 1.0 / level.dinv[i];
+                                level.rho = amg_spectral_radius(level.A, level.dinv);
+                                level.x.resize(n);
+                                level.b.resize(n);
+                                level.r.resize(n);
+                                level.d.resize(n);
+                                if (opts.sell) level.S = SELLMatrix<T>(level.A);
+                                if (n <= opts.coarse_size ||
+                                    (int)levels.size() >= opts.max_levels)
+                                        break;
+
+                                std::vector<int> agg;
+                                CSRMatrix<T> strength = amg_strength(level.A, opts.theta);
+                                int num_aggs = amg_aggregate(agg, strength);
+                                // No coarsening, e.g., no strong connections
+                                if (num_aggs == n) break;
+                                level.P = amg_prolongator(level.A, level.dinv, B, agg, num_aggs,
+                                                          4.0 / (3.0 * level.rho));
+                                level.R = csr_transpose(level.P);
+                                CSRMatrix<T> AP = csr_spgemm(level.A, level.P);
+                                CSRMatrix<T> Ac = csr_spgemm(level.R, AP);
+                                levels.emplace_back();
+                                levels.back().A = std::move(Ac);
+                        }
+                        // A dense factorization of a large operator would need
+                        // O(n^2) memory and O(n^3) work
+                        direct = levels.back().A.rows <= opts.coarse_size;
+                        if (direct)
+                                factor(levels.back().A);
+                        num_bytes = sizeof(T) * lu.capacity() + sizeof(int) * pivot.capacity();
+                        for (auto& level : levels)
+                                num_bytes += level.bytes();
+                        memory_account(MEMORY_HIERARCHY, num_bytes);
+                }
+
+                AlgebraicMultigrid(const AlgebraicMultigrid&) = delete;
+
+                ~AlgebraicMultigrid(void) {
+                        memory_account(MEMORY_HIERARCHY, -(long long)num_bytes);
+                }
+
+                void operator()(P& p) {
+                        cycle(0, p.u, p.f);
+                }
+
+                int num_levels(void) {
+                        return levels.size();
+                }
+
+                const AMGLevel<T>& level(const int k) {
+                        return levels[k];
+                }
+
+                // Sum of the nonzeros of all levels relative to the finest
+                double operator_complexity(void) {
+                        double nnz = 0.0;
+                        for (auto& level : levels)
+                                nnz += level.A.nnz();
+                        return nnz / levels[0].A.nnz();
+                }
+
+                const char *name() {
+                        static char name[2048];
+                        sprintf(name, "Algebraic Multi-Grid<%s>", smoother.name());
+                        return name;
+                }
+
+};
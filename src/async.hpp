@@ -0,0 +1,220 @@
+#pragma once
+#include <poisson.hpp>
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <omp.h>
+// Asynchronous (chaotic) Gauss-Seidel relaxation. Each thread owns a tile of
+// rows and relaxes it repeatedly without waiting at barriers. The first and
+// last row of a tile are shared with the neighbouring tiles and are accessed
+// using relaxed atomic loads and stores. A tile may not get more than
+// `max_staleness` sweeps ahead of its neighbours, which bounds how stale the
+// halo data can get.
+
+template <typename T>
+__inline__ T async_load(const T *x) {
+        T out;
+        #pragma omp atomic read
+        out = *x;
+        return out;
+}
+
+template <typename T>
+__inline__ void async_store(T *x, const T value) {
+        #pragma omp atomic write
+        *x = value;
+}
+
+template <typename T>
+void async_relax_row(T *u, const T *f, const int n, const T h, const int i,
+                     const bool shared_up, const bool shared_down) {
+        const T *up = &u[(i - 1) * n];
+        const T *down = &u[(i + 1) * n];
+        T *row = &u[i * n];
+        if (!shared_up && !shared_down) {
+                for (int j = 1; j < n - 1; ++j)
+                        row[j] = -0.25 * (h * h * f[j + i * n] - row[j + 1] -
+                                          row[j - 1] - down[j] - up[j]);
+                return;
+        }
+
+        for (int j = 1; j < n - 1; ++j) {
+                T uu = shared_up ? async_load(&up[j]) : up[j];
+                T ud = shared_down ? async_load(&down[j]) : down[j];
+                async_store(&row[j], (T)(-0.25 * (h * h * f[j + i * n] -
+                                                  row[j + 1] - row[j - 1] - ud -
+                                                  uu)));
+        }
+}
+
+template <typename T>
+double async_residual_rows(const T *u, const T *f, const int n, const T h,
+                           const int i0, const int i1) {
+        T hi2 = 1.0 / (h * h);
+        double out = 0.0;
+        for (int i = i0; i < i1; ++i) {
+                bool shared_up = i == i0;
+                bool shared_down = i == i1 - 1;
+                for (int j = 1; j < n - 1; ++j) {
+                        T uu = shared_up ? async_load(&u[j + (i - 1) * n])
+                                         : u[j + (i - 1) * n];
+                        T ud = shared_down ? async_load(&u[j + (i + 1) * n])
+                                           : u[j + (i + 1) * n];
+                        T r = f[j + i * n] - (u[j + 1 + i * n] +
+                                              u[j - 1 + i * n] -
+                                              4.0 * u[j + i * n] + ud + uu) *
+                                                 hi2;
+                        out += fabs(r) * h * h;
+                }
+        }
+        return out;
+}
+
+// Sweep counter and latest residual of a tile. Padded to avoid false sharing.
+struct AsyncTile {
+        std::atomic<double> residual;
+        std::atomic<int> sweep;
+        char padding[64 - sizeof(std::atomic<double>) - sizeof(std::atomic<int>)];
+};
+
+struct AsyncStats {
+        // Fewest and most sweeps performed by any tile
+        int min_sweeps = 0;
+        int max_sweeps = 0;
+        // Number of times a tile had to wait for a neighbour
+        long waits = 0;
+        // Most sweeps a tile was ahead of a neighbour when it started a
+        // sweep, at most `max_staleness`
+        int max_lag = 0;
+        // Residual norm estimated by the convergence monitor
+        double residual = 0.0;
+};
+
+// Performs at most `sweeps` asynchronous sweeps. If eps > 0, the tiles report
+// their residual norm every `check` sweeps and all tiles stop once the sum
+// drops below eps.
+template <typename T>
+AsyncStats async_gauss_seidel(T *u, const T *f, const int n, const T h,
+                              const int sweeps, const int max_staleness = 1,
+                              const double eps = 0.0, const int check = 10) {
+        int num_rows = n - 2;
+        int max_tiles = std::min(omp_get_max_threads(), num_rows);
+        std::vector<AsyncTile> tiles(max_tiles);
+        for (int t = 0; t < max_tiles; ++t) {
+                tiles[t].sweep.store(0);
+                tiles[t].residual.store(std::numeric_limits<double>::infinity());
+        }
+        std::atomic<bool> stop(false);
+        std::atomic<long> waits(0);
+        std::atomic<int> max_lag(0);
+        std::atomic<int> used_tiles(1);
+        WorkCounts *work = &work_target();
+
+        #pragma omp parallel num_threads(max_tiles)
+        {
+                WorkScope scope(work);
+                // Fewer threads than requested may be available
+                int num_tiles = omp_get_num_threads();
+                int t = omp_get_thread_num();
+                if (t == 0) used_tiles.store(num_tiles);
+                int i0 = 1 + num_rows * t / num_tiles;
+                int i1 = 1 + num_rows * (t + 1) / num_tiles;
+                bool has_up = t > 0;
+                bool has_down = t < num_tiles - 1;
+                long num_waits = 0;
+                int num_checks = 0;
+                int lag_seen = 0;
+
+                for (int s = 0; s < sweeps && !stop.load(std::memory_order_relaxed); ++s) {
+
+                        // Bounded staleness: wait for slow neighbours
+                        int lag = s - max_staleness;
+                        while ((has_up && tiles[t - 1].sweep.load(std::memory_order_acquire) < lag) ||
+                               (has_down && tiles[t + 1].sweep.load(std::memory_order_acquire) < lag)) {
+                                num_waits++;
+                                if (stop.load(std::memory_order_relaxed)) break;
+                                std::this_thread::yield();
+                        }
+                        // Do not relax with neighbours the wait gave up on
+                        if (stop.load(std::memory_order_relaxed)) break;
+                        if (has_up)
+                                lag_seen = std::max(lag_seen, s -
+                                    tiles[t - 1].sweep.load(std::memory_order_acquire));
+                        if (has_down)
+                                lag_seen = std::max(lag_seen, s -
+                                    tiles[t + 1].sweep.load(std::memory_order_acquire));
+
+                        for (int i = i0; i < i1; ++i)
+                                async_relax_row(u, f, n, h, i,
+                                                has_up && i == i0,
+                                                has_down && i == i1 - 1);
+                        tiles[t].sweep.store(s + 1, std::memory_order_release);
+
+                        if (eps <= 0.0 || (s + 1) % check != 0) continue;
+
+                        // Convergence monitor
+                        num_checks++;
+                        tiles[t].residual.store(
+                            async_residual_rows(u, f, n, h, i0, i1),
+                            std::memory_order_relaxed);
+                        double res = 0.0;
+                        for (int k = 0; k < num_tiles; ++k)
+                                res += tiles[k].residual.load(std::memory_order_relaxed);
+                        if (res < eps) stop.store(true);
+                }
+                waits += num_waits;
+                int lag = max_lag.load();
+                while (lag < lag_seen && !max_lag.compare_exchange_weak(lag, lag_seen)) { }
+                // The sweeps of the tile, counted once
+                double points = (double)(i1 - i0) * (n - 2);
+                work_count(WORK_SMOOTH, points * tiles[t].sweep.load(), 6, 3 * sizeof(T),
+                           (double)num_rows * (n - 2));
+                if (num_checks > 0)
+                        work_count(WORK_RESIDUAL, points * num_checks, 7, 2 * sizeof(T));
+        }
+
+        AsyncStats stats;
+        stats.min_sweeps = sweeps;
+        for (int t = 0; t < used_tiles.load(); ++t) {
+                int s = tiles[t].sweep.load();
+                stats.min_sweeps = std::min(stats.min_sweeps, s);
+                stats.max_sweeps = std::max(stats.max_sweeps, s);
+                stats.residual += tiles[t].residual.load();
+        }
+        stats.waits = waits.load();
+        stats.max_lag = max_lag.load();
+        return stats;
+}
+
+class AsyncGaussSeidel {
+        public:
+                // Sweeps per call when used as a smoother
+                int sweeps = 1;
+                int max_staleness = 1;
+                // Stand-alone use: at most `max_sweeps` sweeps per call, stop
+                // early when the monitored residual drops below eps
+                int max_sweeps = 100;
+                double eps = 0.0;
+                int check = 10;
+                AsyncStats stats;
+
+                AsyncGaussSeidel() { }
+        template <typename P>
+                AsyncGaussSeidel(P& p) { }
+
+        template <typename T>
+        void operator()(T *u, const T *f, const int n, const T h) {
+                stats = async_gauss_seidel(u, f, n, h, sweeps, max_staleness);
+        }
+
+        template <typename P>
+        void operator()(P& p) {
+                stats = async_gauss_seidel(p.u, p.f, p.n, p.h, max_sweeps,
+                                           max_staleness, eps, check);
+        }
+        const char *name() {
+                return "Gauss-Seidel (asynchronous)";
+        }
+
+};
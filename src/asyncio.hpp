@@ -0,0 +1,153 @@
+#pragma once
+#include <unistd.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <memory.hpp>
+// Building blocks for writing data in the background while the solver keeps
+// running. The solver copies its state into a snapshot buffer from a pool and
+// hands it to a writer thread. When all buffers are in flight, acquiring a new
+// one blocks until the writer has released one (back-pressure).
+
+class SnapshotPool {
+        private:
+                std::vector<char*> buffers;
+                std::vector<char*> free_buffers;
+                size_t num_bytes = 0;
+                std::mutex mutex;
+                std::condition_variable released;
+        public:
+                SnapshotPool(const SnapshotPool&) = delete;
+                SnapshotPool(const int num_buffers, const size_t num_bytes)
+                    : num_bytes(num_bytes) {
+                        for (int k = 0; k < num_buffers; ++k) {
+                                char *buffer = (char*)memory_alloc(num_bytes);
+                                buffers.push_back(buffer);
+                                free_buffers.push_back(buffer);
+                        }
+                }
+
+                size_t size(void) {
+                        return num_bytes;
+                }
+
+                // Blocks until a buffer is available. `waited` is set if the
+                // call had to wait.
+                char *acquire(bool *waited=nullptr) {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        if (waited != nullptr) *waited = free_buffers.empty();
+                        released.wait(lock, [this]() { return !free_buffers.empty(); });
+                        char *buffer = free_buffers.back();
+                        free_buffers.pop_back();
+                        return buffer;
+                }
+
+                // Returns nullptr if all buffers are in use
+                char *try_acquire(void) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (free_buffers.empty()) return nullptr;
+                        char *buffer = free_buffers.back();
+                        free_buffers.pop_back();
+                        return buffer;
+                }
+
+                void release(char *buffer) {
+                        {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                free_buffers.push_back(buffer);
+                        }
+                        released.notify_one();
+                }
+
+                ~SnapshotPool(void) {
+                        for (size_t k = 0; k < buffers.size(); ++k)
+                                memory_free(buffers[k], num_bytes);
+                }
+};
+
+// Executes jobs in submission order on a background thread
+class WriterThread {
+        private:
+                std::deque<std::function<void()>> jobs;
+                std::mutex mutex;
+                std::condition_variable changed;
+                bool stop = false;
+                int busy = 0;
+                std::thread thread;
+
+                void run(void) {
+                        for (;;) {
+                                std::function<void()> job;
+                                {
+                                        std::unique_lock<std::mutex> lock(mutex);
+                                        changed.wait(lock, [this]() {
+                                                return stop || !jobs.empty();
+                                        });
+                                        if (jobs.empty()) return;
+                                        job = std::move(jobs.front());
+                                        jobs.pop_front();
+                                        busy = 1;
+                                }
+                                job();
+                                {
+                                        std::lock_guard<std::mutex> lock(mutex);
+                                        busy = 0;
+                                }
+                                changed.notify_all();
+                        }
+                }
+
+        public:
+                WriterThread(const WriterThread&) = delete;
+                WriterThread(void) : thread(&WriterThread::run, this) { }
+
+                void submit(std::function<void()> job) {
+                        {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                jobs.push_back(std::move(job));
+                        }
+                        changed.notify_all();
+                }
+
+                // Blocks until all submitted jobs have completed
+                void wait(void) {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        changed.wait(lock, [this]() { return jobs.empty() && !busy; });
+                }
+
+                ~WriterThread(void) {
+                        {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                stop = true;
+                        }
+                        changed.notify_all();
+                        thread.join();
+                }
+};
+
+// Copy num_bytes from src to dst using all threads
+__inline__ void parallel_copy(void *dst, const void *src, const size_t num_bytes) {
+        const size_t chunk = 1 << 20;
+        long num_chunks = (num_bytes + chunk - 1) / chunk;
+        #pragma omp parallel for schedule(static) if (num_chunks > 1)
+        for (long k = 0; k < num_chunks; ++k) {
+                size_t begin = k * chunk;
+                size_t len = std::min(chunk, num_bytes - begin);
+                memcpy((char*)dst + begin, (const char*)src + begin, len);
+        }
+}
+
+// Write all num_bytes to a file descriptor. Returns false on error.
+__inline__ bool write_all(int fd, const void *data, size_t num_bytes) {
+        const char *p = (const char*)data;
+        while (num_bytes > 0) {
+                ssize_t k = write(fd, p, num_bytes);
+                if (k <= 0) return false;
+                p += k;
+                num_bytes -= k;
+        }
+        return true;
+}
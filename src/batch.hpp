@@ -0,0 +1,228 @@
+#pragma once
+#include <omp.h>
+#include <deque>
+#include <vector>
+#include <poisson.hpp>
+#include <solver.hpp>
+// Level-pipelined multigrid for many right-hand sides that share the
+// operator. A V-cycle on l levels is split into 2 l - 1 stages:
+//
+//   down on levels l .. 2 (smoothing, residual and restriction),
+//   base case on level 1,
+//   up on levels 2 .. l (prolongation and smoothing).
+//
+// One cycle enters the pipeline per step and every cycle in flight advances
+// by one stage per step, so the cycles in flight are at different stages:
+// while one right-hand side is smoothed on the fine grid, the previous ones
+// work on the coarser grids. The levels are assigned to groups of threads in
+// proportion to their work (the fine grid gets most of the threads, the
+// coarsest grids share one), and each group runs the stages of its levels
+// with nested parallel regions. Each cycle in flight uses its own hierarchy
+// of coarse grids (slot); the scratch residual is shared per level since only
+// one down stage per level runs in a step.
+//
+// The stages perform the same operations as `multigrid_v_cycle`, so each
+// right-hand side gets the same iterates as solving it with `Multigrid`.
+
+// Groups of threads for the levels of an l-level hierarchy on p threads.
+// group[k] is the group of level k and threads[g] the size of group g.
+void batch_groups(const int l, const int p, std::vector<int>& group,
+                  std::vector<int>& threads) {
+        group.assign(l + 1, 0);
+        threads.clear();
+        // Work per level (down and up stage)
+        std::vector<double> work(l + 1, 0.0);
+        double remaining = 0.0;
+        for (int k = 1; k <= l; ++k) {
+                int n = (1 << k) + 1;
+                work[k] = 2.0 * n * n;
+                remaining += work[k];
+        }
+        int free_threads = p;
+        for (int k = l; k >= 1; --k) {
+                int t = (int)(free_threads * work[k] / remaining + 0.5);
+                t = std::min(t, free_threads - 1);
+                // The remaining levels share the remaining threads
+                if (k == 1 || t < 1) {
+                        for (int m = k; m >= 1; --m)
+                                group[m] = threads.size();
+                        threads.push_back(std::max(free_threads, 1));
+                        break;
+                }
+                group[k] = threads.size();
+                threads.push_back(t);
+                free_threads -= t;
+                remaining -= work[k];
+        }
+}
+
+template <typename F, typename P, typename T, typename X=Transfer<>>
+class BatchMultigrid {
+        private:
+                int l = 0;
+                // Coarse corrections and restricted residuals of levels
+                // 1 .. l - 1 at offset multigrid_offset(k), one per slot
+                std::vector<T*> e, b;
+                // Scratch residual of level k at offset multigrid_offset(k)
+                T *r = 0;
+                size_t slot_bytes = 0;
+
+                struct Job {
+                        int problem;
+                        int slot;
+                        int stage;
+                };
+
+                int num_stages(void) {
+                        return 2 * l - 1;
+                }
+
+                int level(const int stage) {
+                        return stage < l ? l - stage : stage - l + 2;
+                }
+
+                void run_stage(const Job& job, P& p, F& smoother, X& transfer) {
+                        int k = level(job.stage);
+                        int n = (1 << k) + 1;
+                        int nc = (1 << (k - 1)) + 1;
+                        T h = p.h * (1 << (l - k));
+                        T *x = k == l ? p.u : &e[job.slot][multigrid_offset(k)];
+                        T *f = k == l ? p.f : &b[job.slot][multigrid_offset(k)];
+                        if (k == 1) {
+                                base_case(x, f, h);
+                        } else if (job.stage < l - 1) {
+                                T *rk = &r[multigrid_offset(k)];
+                                if (k == l)
+                                        smooth_residual(smoother, x, f, rk, n, h, 0);
+                                else
+                                        smooth_residual_zero(smoother, x, f, rk, n, h, 0);
+                                transfer.restriction(&b[job.slot][multigrid_offset(k - 1)],
+                                                     nc, rk, n);
+                        } else {
+                                transfer.prolongation(x, n, &e[job.slot][multigrid_offset(k - 1)],
+                                                      nc, (T)1.0, (T)1.0);
+                                smoother(x, f, n, h);
+                        }
+                }
+
+        public:
+                X transfer;
+                // Group of each level and threads per group of the last solve
+                std::vector<int> group, threads;
+
+                BatchMultigrid() { }
+                BatchMultigrid(P& p) : l(p.l) {
+                        slot_bytes = multigrid_size(l - 1) * sizeof(T);
+                        r = (T*)memory_alloc(multigrid_size(l) * sizeof(T), MEMORY_SCRATCH);
+                }
+
+                // Solves each problem as `solve` does with the same options,
+                // using the threads of omp_get_max_threads()
+                std::vector<SolverOutput> solve(std::vector<P*>& problems,
+                                                SolverOptions opts) {
+                        int m = problems.size();
+                        std::vector<SolverOutput> out(m);
+                        std::vector<char> done(m, 0);
+                        batch_groups(l, omp_get_max_threads(), group, threads);
+                        int num_groups = threads.size();
+
+                        std::deque<int> ready;
+                        for (int j = 0; j < m; ++j)
+                                ready.push_back(j);
+                        std::vector<Job> jobs;
+                        bool finished = false;
+                        // With one group nothing overlaps, and cycles in
+                        // flight would only compete for the cache
+                        size_t depth = num_groups > 1 ? num_stages() : 1;
+                        // Slots are allocated for the cycles in flight only
+                        while (e.size() < depth) {
+                                e.push_back((T*)memory_alloc(slot_bytes, MEMORY_HIERARCHY));
+                                b.push_back((T*)memory_alloc(slot_bytes, MEMORY_HIERARCHY));
+                        }
+                        std::vector<int> free_slots;
+                        for (int s = depth - 1; s >= 0; --s)
+                                free_slots.push_back(s);
+
+                        int max_levels = omp_get_max_active_levels();
+                        omp_set_max_active_levels(2);
+                        #pragma omp parallel num_threads(num_groups)
+                        {
+                                int g = omp_get_thread_num();
+                                omp_set_num_threads(threads[g]);
+                                F smoother;
+                                X transfer = this->transfer;
+                                while (true) {
+                                        // Retire the cycles that ran their
+                                        // last stage and admit the next one
+                                        #pragma omp single
+                                        {
+                                                std::vector<Job> next;
+                                                for (size_t i = 0; i < jobs.size(); ++i) {
+                                                        Job job = jobs[i];
+                                                        if (job.stage < num_stages() - 1) {
+                                                                job.stage++;
+                                                                next.push_back(job);
+                                                                continue;
+                                                        }
+                                                        free_slots.push_back(job.slot);
+                                                        if (!done[job.problem])
+                                                                ready.push_back(job.problem);
+                                                }
+                                                if (!ready.empty() && next.size() < depth) {
+                                                        Job job = {ready.front(), free_slots.back(), 0};
+                                                        ready.pop_front();
+                                                        free_slots.pop_back();
+                                                        next.push_back(job);
+                                                }
+                                                jobs.swap(next);
+                                                finished = jobs.empty();
+                                        }
+                                        if (finished) break;
+                                        for (size_t i = 0; i < jobs.size(); ++i) {
+                                                const Job& job = jobs[i];
+                                                if (group[level(job.stage)] != g) continue;
+                                                P& p = *problems[job.problem];
+                                                SolverOutput& o = out[job.problem];
+                                                // A problem has one stage in flight
+                                                WorkScope scope(&o.work);
+                                                run_stage(job, p, smoother, transfer);
+                                                if (job.stage < num_stages() - 1) continue;
+                                                // End of the cycle
+                                                p.residual();
+                                                double res = p.norm();
+                                                o.iterations++;
+                                                o.residual = res;
+                                                o.history.push_back(res);
+                                                done[job.problem] = res <= opts.eps ||
+                                                        (o.iterations >= opts.max_iterations &&
+                                                         opts.max_iterations >= 0);
+                                        }
+                                        #pragma omp barrier
+                                }
+                        }
+                        omp_set_max_active_levels(max_levels);
+                        for (int j = 0; j < m; ++j)
+                                work_add(out[j].work);
+
+                        if (opts.mms)
+                                for (int j = 0; j < m; ++j)
+                                        out[j].error = problems[j]->error();
+                        return out;
+                }
+
+                ~BatchMultigrid(void) {
+                        for (size_t s = 0; s < e.size(); ++s) {
+                                memory_free(e[s], slot_bytes);
+                                memory_free(b[s], slot_bytes);
+                        }
+                        if (r != nullptr) memory_free(r, multigrid_size(l) * sizeof(T));
+                }
+
+                const char *name() {
+                        static char name[2048];
+                        F smoother;
+                        sprintf(name, "Batch Multi-Grid<%s>", smoother.name());
+                        return name;
+                }
+
+};
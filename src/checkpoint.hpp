@@ -0,0 +1,271 @@
+#pragma once
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <asyncio.hpp>
+#include <compression.hpp>
+#include <solver.hpp>
+// Checkpoint/restart of a solve. The checkpoint is an observer for `solve`
+// that every `interval` iterations copies the solution (and optionally the
+// solver state, e.g., the multigrid hierarchy) into one of two snapshot
+// buffers and writes it from a background thread, so the solve continues
+// while the file is written. Files are written to `path`.tmp and renamed, so
+// `path` always holds a complete checkpoint.
+//
+//   Checkpoint<T> checkpoint(path, interval);
+//   SolverOutput start = checkpoint.restore(solver, problem, opts);
+//   SolverOutput out = solve(solver, problem, opts, checkpoint, start);
+//
+// File layout: CheckpointHeader, residual history (double), u (T) and state,
+// optionally compressed with a lossless codec.
+
+struct CheckpointHeader {
+        char magic[8];
+        int32_t version;
+        int32_t type_size;
+        int32_t l;
+        int32_t iterations;
+        double h;
+        double modes;
+        // Plan: stopping criteria of the solve
+        double eps;
+        int32_t max_iterations;
+        // Compression of the solution and state (compression_codec)
+        int32_t codec;
+        int64_t history;
+        int64_t state_bytes;
+        // Bytes stored for the solution and state
+        int64_t payload_bytes;
+        // Name of the solver that wrote the state
+        char solver[256];
+};
+
+static const char checkpoint_magic[8] = {'M', 'G', 'C', 'K', 'P', 'T', '0', '1'};
+
+// Solver state is only saved if the solver provides state_bytes(),
+// save_state(char*) and load_state(const char*)
+template <typename F>
+auto checkpoint_state_bytes(F& solver, int) -> decltype(solver.state_bytes()) {
+        return solver.state_bytes();
+}
+template <typename F>
+size_t checkpoint_state_bytes(F& solver, long) { return 0; }
+
+template <typename F>
+auto checkpoint_save_state(F& solver, char *out, int)
+    -> decltype(solver.save_state(out)) {
+        return solver.save_state(out);
+}
+template <typename F>
+void checkpoint_save_state(F& solver, char *out, long) { }
+
+template <typename F>
+auto checkpoint_load_state(F& solver, const char *in, int)
+    -> decltype(solver.load_state(in)) {
+        return solver.load_state(in);
+}
+template <typename F>
+void checkpoint_load_state(F& solver, const char *in, long) { }
+
+template <typename T>
+class Checkpoint {
+        private:
+                std::string path;
+                size_t grid_bytes = 0, state_bytes = 0;
+                std::unique_ptr<SnapshotPool> pool;
+                std::unique_ptr<WriterThread> writer;
+
+                void write_file(CheckpointHeader header,
+                                std::vector<double> history, char *buffer) {
+                        std::vector<char> packed;
+                        const char *data = buffer;
+                        if (header.codec != COMPRESSION_NONE) {
+                                compress(packed, buffer, grid_bytes + state_bytes,
+                                         sizeof(T), (compression_codec)header.codec);
+                                data = packed.data();
+                        }
+                        header.payload_bytes = data == buffer ? grid_bytes + state_bytes
+                                                              : packed.size();
+                        std::string tmp = path + ".tmp";
+                        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                        bool ok = fd >= 0 &&
+                            write_all(fd, &header, sizeof(header)) &&
+                            write_all(fd, history.data(),
+                                      sizeof(double) * history.size()) &&
+                            write_all(fd, data, header.payload_bytes) &&
+                            fsync(fd) == 0;
+                        if (fd >= 0) close(fd);
+                        ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+                        pool->release(buffer);
+                        if (!ok) {
+                                fprintf(stderr, "Checkpoint: failed to write %s.\n",
+                                        path.c_str());
+                                failures++;
+                        }
+                }
+
+        public:
+                // Write every `interval` iterations
+                int interval = 1;
+                // Save the solver state in addition to the solution
+                bool state = false;
+                // Lossless compression of the solution and state, applied by
+                // the writer thread. COMPRESSION_LOSSY is written as
+                // COMPRESSION_LZ, since the restarted solve would not be exact.
+                compression_codec codec = COMPRESSION_NONE;
+                // Statistics: checkpoints written, writes that had to wait
+                // for a free snapshot buffer
+                int num_writes = 0, num_waits = 0;
+                // Failed writes, counted by the writer thread
+                std::atomic<int> failures{0};
+
+                Checkpoint(const Checkpoint&) = delete;
+                Checkpoint(const char *path, const int interval=1,
+                           const bool state=false)
+                    : path(path), writer(new WriterThread()), interval(interval),
+                      state(state) { }
+
+                template <typename F, typename P>
+                void operator()(F& solver, P& problem, SolverOptions& opts,
+                                SolverOutput& out) {
+                        if (interval <= 0 || out.iterations % interval != 0) return;
+                        write(solver, problem, opts, out);
+                }
+
+                // Snapshot the current state and write it in the background
+                template <typename F, typename P>
+                void write(F& solver, P& problem, SolverOptions& opts,
+                           SolverOutput& out) {
+                        if (!pool) {
+                                grid_bytes = sizeof(T) * problem.n * problem.n;
+                                state_bytes = state ? checkpoint_state_bytes(solver, 0) : 0;
+                                pool.reset(new SnapshotPool(2, grid_bytes + state_bytes));
+                        }
+
+                        bool waited = false;
+                        char *buffer = pool->acquire(&waited);
+                        num_waits += waited;
+                        parallel_copy(buffer, problem.u, grid_bytes);
+                        if (state_bytes > 0)
+                                checkpoint_save_state(solver, buffer + grid_bytes, 0);
+
+                        CheckpointHeader header;
+                        memset(&header, 0, sizeof(header));
+                        memcpy(header.magic, checkpoint_magic, 8);
+                        header.version = 1;
+                        header.type_size = sizeof(T);
+                        header.l = problem.l;
+                        header.iterations = out.iterations;
+                        header.h = problem.h;
+                        header.modes = problem.modes;
+                        header.eps = opts.eps;
+                        header.max_iterations = opts.max_iterations;
+                        header.history = out.history.size();
+                        header.state_bytes = state_bytes;
+                        header.codec = codec == COMPRESSION_LOSSY ? COMPRESSION_LZ : codec;
+                        // Long solver names are truncated
+                        const char *name = solver.name();
+                        size_t name_len = std::min(strlen(name), sizeof(header.solver) - 1);
+                        memcpy(header.solver, name, name_len);
+                        header.solver[name_len] = '\0';
+
+                        std::vector<double> history = out.history;
+                        writer->submit([this, header, history, buffer]() {
+                                write_file(header, history, buffer);
+                        });
+                        num_writes++;
+                }
+
+                // Load the checkpoint into the problem (and solver). Returns
+                // the output to resume from, or an output with zero
+                // iterations if there is no checkpoint. The stopping criteria
+                // of the checkpointed solve are restored into `opts`.
+                template <typename F, typename P>
+                SolverOutput restore(F& solver, P& problem, SolverOptions& opts) {
+                        SolverOutput out;
+                        FILE *fh = fopen(path.c_str(), "rb");
+                        if (fh == nullptr) return out;
+
+                        CheckpointHeader header;
+                        size_t num_bytes = sizeof(T) * problem.n * problem.n;
+                        bool ok = fread(&header, sizeof(header), 1, fh) == 1 &&
+                                  memcmp(header.magic, checkpoint_magic, 8) == 0 &&
+                                  header.version == 1 &&
+                                  header.type_size == sizeof(T) &&
+                                  header.l == problem.l && header.h == problem.h;
+                        // The sizes in the header are checked against the file
+                        // and the problem before anything is allocated
+                        struct stat st;
+                        ok = ok && fstat(fileno(fh), &st) == 0 &&
+                             (size_t)st.st_size >= sizeof(header);
+                        size_t file_bytes = ok ? st.st_size - sizeof(header) : 0;
+                        ok = ok && (header.state_bytes == 0 ||
+                                    (size_t)header.state_bytes ==
+                                    checkpoint_state_bytes(solver, 0));
+                        size_t payload_bytes = num_bytes + (ok ? header.state_bytes : 0);
+                        size_t max_payload_bytes = header.codec == COMPRESSION_NONE
+                                                   ? payload_bytes
+                                                   : compressed_bound(payload_bytes);
+                        ok = ok && header.history >= 0 &&
+                             (size_t)header.history <= file_bytes / sizeof(double) &&
+                             header.payload_bytes >= 0 &&
+                             (size_t)header.payload_bytes <= max_payload_bytes &&
+                             (size_t)header.payload_bytes ==
+                             file_bytes - sizeof(double) * header.history;
+                        std::vector<char> payload(ok ? header.payload_bytes : 0);
+                        if (ok) {
+                                out.history.resize(header.history);
+                                ok = fread(out.history.data(), sizeof(double),
+                                           header.history, fh) == (size_t)header.history &&
+                                     fread(payload.data(), 1, payload.size(), fh) ==
+                                     payload.size();
+                        }
+                        if (ok && header.codec != COMPRESSION_NONE) {
+                                std::vector<char> data(payload_bytes);
+                                ok = compressed_size(payload.data(), payload.size()) ==
+                                     (long)payload_bytes &&
+                                     decompress(data.data(), payload.data(), payload.size());
+                                payload.swap(data);
+                        }
+                        ok = ok && payload.size() == payload_bytes;
+                        if (ok) parallel_copy(problem.u, payload.data(), num_bytes);
+                        if (ok && header.state_bytes > 0) {
+                                ok = strncmp(header.solver, solver.name(),
+                                             sizeof(header.solver) - 1) == 0;
+                                if (ok) checkpoint_load_state(solver,
+                                                              payload.data() + num_bytes, 0);
+                        }
+                        fclose(fh);
+                        if (!ok) {
+                                fprintf(stderr, "Checkpoint: %s does not match the "
+                                        "problem or solver.\n", path.c_str());
+                                exit(EXIT_FAILURE);
+                        }
+
+                        opts.eps = header.eps;
+                        opts.max_iterations = header.max_iterations;
+                        out.iterations = header.iterations;
+                        if (!out.history.empty()) out.residual = out.history.back();
+                        return out;
+                }
+
+                // Block until all checkpoints have been written
+                void wait(void) {
+                        writer->wait();
+                }
+
+                // Pending writes finish before the buffers are freed
+                ~Checkpoint(void) {
+                        writer.reset();
+                }
+
+};
@@ -0,0 +1,601 @@
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+// Compression of grid data. The input is split into blocks that are
+// compressed independently (and in parallel).
+//
+// Lossless codecs: the bytes of the elements are shuffled so that byte k of
+// every element is stored contiguously and each byte stream is delta coded.
+// For smooth fields, the sign and exponent bytes of neighbouring values are
+// mostly equal. The result is run-length coded (COMPRESSION_SHUFFLE) or LZ
+// coded (COMPRESSION_LZ), which also captures repeated patterns.
+//
+// Lossy codec (COMPRESSION_LOSSY): each grid value is predicted from its
+// already coded west, south and south-west neighbours (Lorenzo predictor) and
+// the prediction error is quantized in steps of 2 * tolerance, so that every
+// value is reconstructed within `tolerance`. Values that cannot be quantized
+// within the bound are stored exactly. The quantization codes are variable
+// length coded and LZ coded. Blocks are groups of grid rows.
+//
+// A block whose coded size would reach its uncompressed size is stored as is
+// (without shuffling), so a compressed buffer is at most the size of the
+// input plus the header and block sizes.
+//
+// Layout of a compressed buffer:
+//   CompressionHeader, uint64 compressed size of each block, prefix (stored
+//   as is, e.g., a file header), block data
+
+enum compression_codec {
+        COMPRESSION_NONE = 0,
+        // Byte shuffle, delta and run-length coding
+        COMPRESSION_SHUFFLE = 1,
+        // Byte shuffle, delta and LZ coding
+        COMPRESSION_LZ = 2,
+        // Error-bounded Lorenzo prediction and quantization
+        COMPRESSION_LOSSY = 3
+};
+
+struct CompressionOptions {
+        compression_codec codec = COMPRESSION_LZ;
+        // Lossy: maximum absolute error of each value
+        double tolerance = 0.0;
+        // Lossy: number of grid points per row
+        int nx = 0;
+        // Leading bytes that are not compressed, e.g., a file header
+        size_t prefix_bytes = 0;
+        // Uncompressed bytes per block
+        size_t block_bytes = 1 << 20;
+};
+
+struct CompressionHeader {
+        char magic[4];
+        int32_t codec;
+        int32_t element_size;
+        int32_t num_blocks;
+        // Uncompressed size including the prefix
+        int64_t num_bytes;
+        int64_t block_bytes;
+        int64_t prefix_bytes;
+        double tolerance;
+        int32_t nx;
+        int32_t rows_per_block;
+};
+
+static const char compression_magic[4] = {'M', 'G', 'Z', '1'};
+
+// Tolerance for lossy compression of a solution with grid spacing h: a
+// fraction of the O(h^2) discretization error
+__inline__ double compression_tolerance(const double h, const double factor=0.01) {
+        return factor * h * h;
+}
+
+// Run-length coding. Control byte c < 128: c + 1 literal bytes follow,
+// c >= 128: the next byte is repeated c - 125 times (3 to 130). Returns the
+// number of coded bytes, or 0 if they exceed max_out.
+__inline__ size_t rle_encode(char *out, const size_t max_out,
+                             const unsigned char *in, const size_t n) {
+        size_t o = 0, i = 0, lit = 0;
+        while (i < n) {
+                size_t run = 1;
+                while (i + run < n && run < 130 && in[i + run] == in[i]) run++;
+                if (run >= 3) {
+                        if (o + 2 > max_out) return 0;
+                        out[o++] = (char)(125 + run);
+                        out[o++] = (char)in[i];
+                        i += run;
+                        continue;
+                }
+                // Literals until the next run of three
+                lit = 0;
+                size_t start = i;
+                while (i < n && lit < 128 &&
+                       !(i + 2 < n && in[i] == in[i + 1] && in[i] == in[i + 2])) {
+                        i++;
+                        lit++;
+                }
+                if (o + 1 + lit > max_out) return 0;
+                out[o++] = (char)(lit - 1);
+                memcpy(&out[o], &in[start], lit);
+                o += lit;
+        }
+        return o;
+}
+
+// Returns the number of decoded bytes, or 0 on malformed input
+__inline__ size_t rle_decode(unsigned char *out, const size_t max_out,
+                             const char *in, const size_t n) {
+        size_t o = 0, i = 0;
+        while (i < n) {
+                unsigned char c = in[i++];
+                if (c < 128) {
+                        size_t lit = c + 1;
+                        if (i + lit > n || o + lit > max_out) return 0;
+                        memcpy(&out[o], &in[i], lit);
+                        i += lit;
+                        o += lit;
+                } else {
+                        size_t run = c - 125;
+                        if (i >= n || o + run > max_out) return 0;
+                        memset(&out[o], (unsigned char)in[i++], run);
+                        o += run;
+                }
+        }
+        return o;
+}
+
+__inline__ size_t varint_size(uint64_t x) {
+        size_t o = 1;
+        for (; x >= 128; x >>= 7) o++;
+        return o;
+}
+
+__inline__ size_t varint_encode(char *out, uint64_t x) {
+        size_t o = 0;
+        while (x >= 128) {
+                out[o++] = (char)(x | 128);
+                x >>= 7;
+        }
+        out[o++] = (char)x;
+        return o;
+}
+
+// Returns false if the input ends within the integer
+__inline__ bool varint_decode(uint64_t& x, const char *in, const size_t n, size_t& i) {
+        x = 0;
+        for (int shift = 0; i < n && shift < 64; shift += 7) {
+                unsigned char b = in[i++];
+                x |= (uint64_t)(b & 127) << shift;
+                if (b < 128) return true;
+        }
+        return false;
+}
+
+// LZ coding. Sequences of: literal count, literals, match length - 4, match
+// offset (all counts variable length coded). The last sequence has no match.
+// Matches of at least 4 bytes are found with a hash table of the last
+// position of each 4-byte prefix. Returns the number of coded bytes, or 0 if
+// they exceed max_out.
+__inline__ size_t lz_encode(char *out, const size_t max_out,
+                            const unsigned char *in, const size_t n,
+                            std::vector<int64_t>& table) {
+        const int bits = 14;
+        table.assign(1 << bits, -1);
+        size_t o = 0, i = 0, lit = 0;
+        while (i + 4 <= n) {
+                uint32_t key;
+                memcpy(&key, &in[i], 4);
+                uint32_t hash = (key * 2654435761u) >> (32 - bits);
+                int64_t candidate = table[hash];
+                table[hash] = i;
+                if (candidate < 0 || memcmp(&in[candidate], &in[i], 4) != 0) {
+                        i++;
+                        continue;
+                }
+                size_t len = 4;
+                while (i + len < n && in[candidate + len] == in[i + len]) len++;
+                if (o + varint_size(i - lit) + i - lit + varint_size(len - 4) +
+                    varint_size(i - candidate) > max_out)
+                        return 0;
+                o += varint_encode(&out[o], i - lit);
+                memcpy(&out[o], &in[lit], i - lit);
+                o += i - lit;
+                o += varint_encode(&out[o], len - 4);
+                o += varint_encode(&out[o], i - candidate);
+                i += len;
+                lit = i;
+        }
+        if (o + varint_size(n - lit) + n - lit > max_out) return 0;
+        o += varint_encode(&out[o], n - lit);
+        memcpy(&out[o], &in[lit], n - lit);
+        return o + n - lit;
+}
+
+// Returns the number of decoded bytes, or 0 on malformed input
+__inline__ size_t lz_decode(unsigned char *out, const size_t max_out,
+                            const char *in, const size_t n) {
+        size_t o = 0, i = 0;
+        while (i < n) {
+                uint64_t lit, len, offset;
+                if (!varint_decode(lit, in, n, i) || i + lit > n || o + lit > max_out)
+                        return 0;
+                memcpy(&out[o], &in[i], lit);
+                i += lit;
+                o += lit;
+                if (i == n) break;
+                if (!varint_decode(len, in, n, i) || !varint_decode(offset, in, n, i))
+                        return 0;
+                len += 4;
+                if (offset == 0 || offset > o || o + len > max_out) return 0;
+                // Byte by byte, since the match may overlap the output
+                for (size_t k = 0; k < len; ++k, ++o)
+                        out[o] = out[o - offset];
+        }
+        return o;
+}
+
+// Shuffle and delta code n bytes of elements of size s
+__inline__ void shuffle_encode(unsigned char *out, const unsigned char *in,
+                               const size_t n, const int s) {
+        size_t m = n / s;
+        for (int k = 0; k < s; ++k) {
+                unsigned char prev = 0;
+                for (size_t i = 0; i < m; ++i) {
+                        unsigned char b = in[i * s + k];
+                        out[k * m + i] = b - prev;
+                        prev = b;
+                }
+        }
+        // Trailing bytes that do not form an element
+        memcpy(&out[m * s], &in[m * s], n - m * s);
+}
+
+__inline__ void shuffle_decode(unsigned char *out, const unsigned char *in,
+                               const size_t n, const int s) {
+        size_t m = n / s;
+        for (int k = 0; k < s; ++k) {
+                unsigned char prev = 0;
+                for (size_t i = 0; i < m; ++i) {
+                        prev += in[k * m + i];
+                        out[i * s + k] = prev;
+                }
+        }
+        memcpy(&out[m * s], &in[m * s], n - m * s);
+}
+
+// Lorenzo prediction of point (i, j) from the reconstructed values. The
+// encoder and decoder must use the same functions so that both compute
+// bitwise identical predictions.
+template <typename T>
+__inline__ double lossy_predict(const T *x, const int nx, const int i, const int j) {
+        if (i == 0) return j > 0 ? x[j - 1] : 0.0;
+        if (j == 0) return x[(i - 1) * nx];
+        return (double)x[j - 1 + i * nx] + (double)x[j + (i - 1) * nx] -
+               (double)x[j - 1 + (i - 1) * nx];
+}
+
+template <typename T>
+__inline__ T lossy_reconstruct(const double pred, const double step, const int64_t k) {
+        return (T)(pred + step * (double)k);
+}
+
+// Quantization codes of rows [0, rows) of an nx wide grid. Code 0 marks a
+// value that is stored exactly, otherwise the code is the zigzag coded
+// quantized prediction error plus one.
+template <typename T>
+size_t lossy_encode(char *out, const T *x, const int nx, const int rows,
+                    const double tolerance, T *recon) {
+        size_t o = 0;
+        double step = 2.0 * tolerance;
+        for (int i = 0; i < rows; ++i) {
+                for (int j = 0; j < nx; ++j) {
+                        double pred = lossy_predict(recon, nx, i, j);
+                        T value = x[j + i * nx];
+                        double q = step > 0 ? nearbyint((value - pred) / step) : 0.0;
+                        T r = lossy_reconstruct<T>(pred, step, (int64_t)q);
+                        if (step > 0 && fabs(q) < (1 << 30) &&
+                            fabs((double)r - (double)value) <= tolerance) {
+                                int64_t k = (int64_t)q;
+                                uint64_t zigzag = k < 0 ? -2 * k - 1 : 2 * k;
+                                o += varint_encode(&out[o], zigzag + 1);
+                                recon[j + i * nx] = r;
+                        } else {
+                                out[o++] = 0;
+                                memcpy(&out[o], &value, sizeof(T));
+                                o += sizeof(T);
+                                recon[j + i * nx] = value;
+                        }
+                }
+        }
+        return o;
+}
+
+template <typename T>
+bool lossy_decode(T *x, const int nx, const int rows, const double tolerance,
+                  const char *in, const size_t n) {
+        size_t i0 = 0;
+        double step = 2.0 * tolerance;
+        for (int i = 0; i < rows; ++i) {
+                for (int j = 0; j < nx; ++j) {
+                        uint64_t code;
+                        if (!varint_decode(code, in, n, i0)) return false;
+                        if (code == 0) {
+                                if (i0 + sizeof(T) > n) return false;
+                                memcpy(&x[j + i * nx], &in[i0], sizeof(T));
+                                i0 += sizeof(T);
+                                continue;
+                        }
+                        code -= 1;
+                        int64_t k = code & 1 ? -(int64_t)(code >> 1) - 1
+                                             : (int64_t)(code >> 1);
+                        double pred = lossy_predict(x, nx, i, j);
+                        x[j + i * nx] = lossy_reconstruct<T>(pred, step, k);
+                }
+        }
+        return i0 == n;
+}
+
+template <typename T>
+size_t compress_lossy_block(char *out, const size_t max_out, const T *x,
+                            const int nx, const int rows,
+                            const double tolerance, std::vector<char>& codes,
+                            std::vector<T>& recon, std::vector<int64_t>& table) {
+        size_t count = (size_t)nx * rows;
+        codes.resize(count * (1 + sizeof(T)));
+        recon.resize(count);
+        size_t len = lossy_encode(codes.data(), x, nx, rows, tolerance, recon.data());
+        return lz_encode(out, max_out, (const unsigned char*)codes.data(), len, table);
+}
+
+template <typename T>
+bool decompress_lossy_block(T *x, const int nx, const int rows,
+                            const double tolerance, const char *in, const size_t n,
+                            std::vector<char>& codes) {
+        codes.resize((size_t)nx * rows * (1 + sizeof(T)));
+        size_t len = lz_decode((unsigned char*)codes.data(), codes.size(), in, n);
+        return (len > 0 || n == 0) &&
+               lossy_decode(x, nx, rows, tolerance, codes.data(), len);
+}
+
+// Compress num_bytes of elements of size element_size (4 or 8 bytes for
+// lossy compression of float or double grids) into out
+void compress(std::vector<char>& out, const void *src, const size_t num_bytes,
+              const int element_size, const CompressionOptions& opts) {
+        compression_codec codec = opts.codec;
+        size_t data_bytes = num_bytes - opts.prefix_bytes;
+        // Lossy compression needs complete rows of floats or doubles
+        if (codec == COMPRESSION_LOSSY &&
+            (opts.nx <= 0 || (element_size != 4 && element_size != 8) ||
+             data_bytes % ((size_t)opts.nx * element_size) != 0))
+                codec = COMPRESSION_LZ;
+        CompressionHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, compression_magic, 4);
+        header.codec = codec;
+        header.element_size = element_size;
+        header.num_bytes = num_bytes;
+        // A single block is no larger than the data
+        size_t max_block_bytes = std::min(opts.block_bytes,
+                                          std::max(data_bytes, (size_t)1));
+        header.block_bytes = max_block_bytes;
+        header.prefix_bytes = opts.prefix_bytes;
+        header.tolerance = opts.tolerance;
+        int num_blocks;
+        int ny = 0, rows = 0;
+        if (codec == COMPRESSION_LOSSY) {
+                header.nx = opts.nx;
+                ny = data_bytes / ((size_t)opts.nx * element_size);
+                rows = std::max((size_t)1, opts.block_bytes /
+                                ((size_t)opts.nx * element_size));
+                header.rows_per_block = rows;
+                num_blocks = (ny + rows - 1) / rows;
+        } else {
+                num_blocks = (data_bytes + max_block_bytes - 1) / max_block_bytes;
+        }
+        header.num_blocks = num_blocks;
+
+        // Each block is coded into its own buffer of the uncompressed block
+        // size, since blocks that do not fit are stored
+        size_t block_bytes = codec == COMPRESSION_LOSSY
+                             ? (size_t)rows * opts.nx * element_size
+                             : max_block_bytes;
+        std::vector<char> blocks(codec == COMPRESSION_NONE ? 0 : block_bytes * num_blocks);
+        std::vector<uint64_t> sizes(num_blocks);
+        const unsigned char *in = (const unsigned char*)src + opts.prefix_bytes;
+        #pragma omp parallel if (num_blocks > 1)
+        {
+                std::vector<unsigned char> shuffled;
+                std::vector<char> codes;
+                std::vector<float> recon_float;
+                std::vector<double> recon_double;
+                std::vector<int64_t> table;
+                #pragma omp for schedule(dynamic)
+                for (int b = 0; b < num_blocks; ++b) {
+                        size_t begin = b * block_bytes;
+                        size_t n = std::min(block_bytes, data_bytes - begin);
+                        char *dst = &blocks[b * block_bytes];
+                        if (codec == COMPRESSION_NONE) {
+                                sizes[b] = n;
+                                continue;
+                        }
+                        // A coded block must be smaller than n to be told
+                        // apart from a stored one
+                        size_t max_out = n - 1;
+                        if (codec == COMPRESSION_LOSSY) {
+                                int num_rows = std::min(rows, ny - b * rows);
+                                if (element_size == 4)
+                                        sizes[b] = compress_lossy_block(
+                                            dst, max_out, (const float*)(in + begin),
+                                            opts.nx, num_rows, opts.tolerance, codes,
+                                            recon_float, table);
+                                else
+                                        sizes[b] = compress_lossy_block(
+                                            dst, max_out, (const double*)(in + begin),
+                                            opts.nx, num_rows, opts.tolerance, codes,
+                                            recon_double, table);
+                        } else {
+                                shuffled.resize(block_bytes);
+                                shuffle_encode(shuffled.data(), in + begin, n,
+                                               element_size);
+                                sizes[b] = codec == COMPRESSION_LZ
+                                    ? lz_encode(dst, max_out, shuffled.data(), n, table)
+                                    : rle_encode(dst, max_out, shuffled.data(), n);
+                        }
+                        if (sizes[b] == 0) {
+                                memcpy(dst, in + begin, n);
+                                sizes[b] = n;
+                        }
+                }
+        }
+
+        size_t start = sizeof(header) + sizeof(uint64_t) * num_blocks;
+        std::vector<size_t> offsets(num_blocks + 1);
+        offsets[0] = start + opts.prefix_bytes;
+        for (int b = 0; b < num_blocks; ++b) offsets[b + 1] = offsets[b] + sizes[b];
+        out.resize(offsets[num_blocks]);
+        memcpy(out.data(), &header, sizeof(header));
+        memcpy(out.data() + sizeof(header), sizes.data(), sizeof(uint64_t) * num_blocks);
+        memcpy(out.data() + start, src, opts.prefix_bytes);
+        #pragma omp parallel for schedule(static) if (num_blocks > 1)
+        for (int b = 0; b < num_blocks; ++b) {
+                const char *data = codec == COMPRESSION_NONE
+                                   ? (const char*)in + b * block_bytes
+                                   : &blocks[b * block_bytes];
+                memcpy(&out[offsets[b]], data, sizes[b]);
+        }
+}
+
+// Lossless compression
+void compress(std::vector<char>& out, const void *src, const size_t num_bytes,
+              const int element_size, const compression_codec codec=COMPRESSION_LZ,
+              const size_t block_bytes=1 << 20) {
+        CompressionOptions opts;
+        opts.codec = codec;
+        opts.block_bytes = block_bytes;
+        compress(out, src, num_bytes, element_size, opts);
+}
+
+// Largest compressed size of num_bytes of data. Blocks that do not compress
+// are stored, so only the header and the block table are added.
+size_t compressed_bound(const size_t num_bytes, const size_t block_bytes=1 << 20) {
+        size_t num_blocks = num_bytes / block_bytes + (num_bytes % block_bytes != 0);
+        return sizeof(CompressionHeader) + sizeof(uint64_t) * num_blocks + num_bytes;
+}
+
+// Size of the data in a compressed buffer, or -1 if it is not compressed
+long compressed_size(const char *in, const size_t n) {
+        CompressionHeader header;
+        if (n < sizeof(header)) return -1;
+        memcpy(&header, in, sizeof(header));
+        if (memcmp(header.magic, compression_magic, 4) != 0) return -1;
+        return header.num_bytes;
+}
+
+// Block layout of a compressed buffer
+class CompressedLayout {
+        public:
+                CompressionHeader header;
+                size_t data_bytes = 0;
+                size_t block_bytes = 0;
+                // Offset of the prefix
+                size_t start = 0;
+                // Coded size and offset of each block
+                std::vector<uint64_t> sizes;
+                std::vector<size_t> offsets;
+};
+
+// Reads and validates the header and block table of a compressed buffer
+// without decoding the blocks. Returns false on malformed input.
+bool compressed_layout(CompressedLayout& c, const char *in, const size_t n) {
+        CompressionHeader& header = c.header;
+        if (compressed_size(in, n) < 0) return false;
+        memcpy(&header, in, sizeof(header));
+        if (header.codec < COMPRESSION_NONE || header.codec > COMPRESSION_LOSSY ||
+            header.element_size <= 0 || header.num_blocks < 0 ||
+            header.prefix_bytes < 0 || header.prefix_bytes > header.num_bytes)
+                return false;
+        int num_blocks = header.num_blocks;
+        size_t prefix_bytes = header.prefix_bytes;
+        size_t data_bytes = header.num_bytes - prefix_bytes;
+        int es = header.element_size;
+        int nx = header.nx, rows = header.rows_per_block;
+        size_t block_bytes;
+        if (header.codec == COMPRESSION_LOSSY) {
+                if (nx <= 0 || rows <= 0 || (es != 4 && es != 8))
+                        return false;
+                size_t row_bytes = (size_t)nx * es;
+                if (data_bytes % row_bytes != 0) return false;
+                // More rows per block than the grid has would overflow
+                size_t ny = data_bytes / row_bytes;
+                block_bytes = std::min((size_t)rows, std::max(ny, (size_t)1)) * row_bytes;
+        } else {
+                if (header.block_bytes <= 0) return false;
+                block_bytes = header.block_bytes;
+                // The block size sizes the decoding buffers
+                if (num_blocks == 1 && block_bytes > data_bytes) return false;
+        }
+        // The blocks must cover the data exactly, which also keeps
+        // b * block_bytes from overflowing
+        if ((size_t)num_blocks != data_bytes / block_bytes +
+                                  (data_bytes % block_bytes != 0))
+                return false;
+        size_t start = sizeof(header) + sizeof(uint64_t) * num_blocks;
+        if (start > n || prefix_bytes > n - start) return false;
+
+        c.sizes.resize(num_blocks);
+        memcpy(c.sizes.data(), in + sizeof(header), sizeof(uint64_t) * num_blocks);
+        c.offsets.resize(num_blocks + 1);
+        c.offsets[0] = start + prefix_bytes;
+        for (int b = 0; b < num_blocks; ++b) {
+                size_t len = std::min(block_bytes, data_bytes - b * block_bytes);
+                if (c.sizes[b] > len || c.sizes[b] > n - c.offsets[b]) return false;
+                c.offsets[b + 1] = c.offsets[b] + c.sizes[b];
+        }
+        c.data_bytes = data_bytes;
+        c.block_bytes = block_bytes;
+        c.start = start;
+        return true;
+}
+
+// Decompress into dst, which must hold compressed_size(in, n) bytes. Returns
+// false on malformed input.
+bool decompress(void *dst, const char *in, const size_t n) {
+        CompressedLayout c;
+        if (!compressed_layout(c, in, n)) return false;
+        const CompressionHeader& header = c.header;
+        int num_blocks = header.num_blocks;
+        size_t prefix_bytes = header.prefix_bytes;
+        size_t data_bytes = c.data_bytes;
+        size_t block_bytes = c.block_bytes;
+        size_t start = c.start;
+        int es = header.element_size;
+        int nx = header.nx;
+        bool lossy = header.codec == COMPRESSION_LOSSY;
+        const std::vector<uint64_t>& sizes = c.sizes;
+        const std::vector<size_t>& offsets = c.offsets;
+        memcpy(dst, in + start, prefix_bytes);
+
+        unsigned char *out = (unsigned char*)dst + prefix_bytes;
+        int failed = 0;
+        #pragma omp parallel if (num_blocks > 1) reduction(|:failed)
+        {
+                std::vector<unsigned char> shuffled;
+                std::vector<char> codes;
+                #pragma omp for schedule(dynamic)
+                for (int b = 0; b < num_blocks; ++b) {
+                        size_t begin = b * block_bytes;
+                        size_t len = std::min(block_bytes, data_bytes - begin);
+                        const char *src = in + offsets[b];
+                        if (sizes[b] == len) {
+                                // Stored block
+                                memcpy(out + begin, src, len);
+                        } else if (header.codec == COMPRESSION_NONE) {
+                                failed = 1;
+                        } else if (lossy) {
+                                int num_rows = len / ((size_t)nx * es);
+                                bool ok = es == 4
+                                    ? decompress_lossy_block((float*)(out + begin), nx,
+                                                             num_rows, header.tolerance,
+                                                             src, sizes[b], codes)
+                                    : decompress_lossy_block((double*)(out + begin), nx,
+                                                             num_rows, header.tolerance,
+                                                             src, sizes[b], codes);
+                                if (!ok) failed = 1;
+                        } else {
+                                shuffled.resize(len);
+                                size_t k = header.codec == COMPRESSION_LZ
+                                    ? lz_decode(shuffled.data(), len, src, sizes[b])
+                                    : rle_decode(shuffled.data(), len, src, sizes[b]);
+                                if (k != len) {
+                                        failed = 1;
+                                        continue;
+                                }
+                                shuffle_decode(out + begin, shuffled.data(), len, es);
+                        }
+                }
+        }
+        return !failed;
+}
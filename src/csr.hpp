@@ -0,0 +1,241 @@
+#pragma once
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <grid.hpp>
+// Sparse matrices in compressed sparse row (CSR) format and the kernels used
+// by algebraic multigrid: matrix-vector products, residuals, transposition and
+// sparse matrix-matrix products. Column indices are sorted within each row.
+// Kernels that build matrices compute each row independently, so the result
+// does not depend on the number of threads.
+
+// Rows per matrix below which kernels run serially
+#ifndef CSR_OMP_MIN_ROWS
+#define CSR_OMP_MIN_ROWS (OMP_MIN_SIZE * OMP_MIN_SIZE)
+#endif
+
+template <typename T>
+class CSRMatrix {
+        public:
+                int rows = 0, cols = 0;
+                // Row i has the entries ptr[i] .. ptr[i + 1] - 1
+                std::vector<int> ptr, idx;
+                std::vector<T> val;
+
+                CSRMatrix() : ptr(1, 0) { }
+                CSRMatrix(const int rows, const int cols)
+                    : rows(rows), cols(cols), ptr(rows + 1, 0) { }
+
+                size_t nnz(void) const {
+                        return ptr[rows];
+                }
+
+                size_t bytes(void) const {
+                        return sizeof(int) * (ptr.capacity() + idx.capacity()) +
+                               sizeof(T) * val.capacity();
+                }
+};
+
+// y := A x
+template <typename T>
+void csr_spmv(T *y, const CSRMatrix<T>& A, const T *x) {
+        #pragma omp parallel for schedule(static) if (A.rows >= CSR_OMP_MIN_ROWS)
+        for (int i = 0; i < A.rows; ++i) {
+                T sum = 0.0;
+                for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k)
+                        sum += A.val[k] * x[A.idx[k]];
+                y[i] = sum;
+        }
+}
+
+// r := b - A x
+template <typename T>
+void csr_residual(T *r, const CSRMatrix<T>& A, const T *x, const T *b) {
+        #pragma omp parallel for schedule(static) if (A.rows >= CSR_OMP_MIN_ROWS)
+        for (int i = 0; i < A.rows; ++i) {
+                T sum = 0.0;
+                for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k)
+                        sum += A.val[k] * x[A.idx[k]];
+                r[i] = b[i] - sum;
+        }
+}
+
+// Damped Jacobi step y := x + omega D^-1 (b - A x) (y and x must not alias)
+template <typename T>
+void csr_jacobi(T *y, const CSRMatrix<T>& A, const T *x, const T *b,
+                const T *dinv, const T omega) {
+        #pragma omp parallel for schedule(static) if (A.rows >= CSR_OMP_MIN_ROWS)
+        for (int i = 0; i < A.rows; ++i) {
+                T sum = 0.0;
+                for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k)
+                        sum += A.val[k] * x[A.idx[k]];
+                y[i] = x[i] + omega * dinv[i] * (b[i] - sum);
+        }
+}
+
+template <typename T>
+std::vector<T> csr_diagonal(const CSRMatrix<T>& A) {
+        std::vector<T> d(A.rows, 0.0);
+        #pragma omp parallel for schedule(static) if (A.rows >= CSR_OMP_MIN_ROWS)
+        for (int i = 0; i < A.rows; ++i)
+                for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k)
+                        if (A.idx[k] == i) d[i] = A.val[k];
+        return d;
+}
+
+template <typename T>
+CSRMatrix<T> csr_transpose(const CSRMatrix<T>& A) {
+        CSRMatrix<T> B(A.cols, A.rows);
+        for (size_t k = 0; k < A.nnz(); ++k)
+                B.ptr[A.idx[k] + 1]++;
+        for (int i = 0; i < B.rows; ++i)
+                B.ptr[i + 1] += B.ptr[i];
+        B.idx.resize(A.nnz());
+        B.val.resize(A.nnz());
+        std::vector<int> next(B.ptr.begin(), B.ptr.end() - 1);
+        // Rows of A in order, so the columns of B are sorted
+        for (int i = 0; i < A.rows; ++i) {
+                for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k) {
+                        int p = next[A.idx[k]]++;
+                        B.idx[p] = i;
+                        B.val[p] = A.val[k];
+                }
+        }
+        return B;
+}
+
+// Build a matrix row by row in parallel. row(i, entries) appends the
+// (column, value) pairs of row i, in any order and with duplicates, which are
+// summed.
+template <typename T, typename F>
+CSRMatrix<T> csr_build(const int rows, const int cols, F row) {
+        CSRMatrix<T> C(rows, cols);
+        int num_threads = rows >= CSR_OMP_MIN_ROWS ? omp_get_max_threads() : 1;
+        std::vector<std::vector<int>> idx(num_threads);
+        std::vector<std::vector<T>> val(num_threads);
+        std::vector<int> first(num_threads + 1, rows);
+        #pragma omp parallel num_threads(num_threads) if (num_threads > 1)
+        {
+                int t = omp_get_thread_num();
+                int p = omp_get_num_threads();
+                int begin = (long)rows * t / p;
+                int end = (long)rows * (t + 1) / p;
+                first[t] = begin;
+                std::vector<std::pair<int, T>> entries;
+                for (int i = begin; i < end; ++i) {
+                        entries.clear();
+                        row(i, entries);
+                        std::sort(entries.begin(), entries.end(),
+                                  [](const std::pair<int, T>& a, const std::pair<int, T>& b) {
+                                          return a.first < b.first;
+                                  });
+                        int count = 0;
+                        for (size_t k = 0; k < entries.size(); ++k) {
+                                if (k > 0 && entries[k].first == entries[k - 1].first) {
+                                        val[t].back() += entries[k].second;
+                                        continue;
+                                }
+                                idx[t].push_back(entries[k].first);
+                                val[t].push_back(entries[k].second);
+                                count++;
+                        }
+                        C.ptr[i + 1] = count;
+                }
+        }
+        for (int i = 0; i < rows; ++i)
+                C.ptr[i + 1] += C.ptr[i];
+        C.idx.resize(C.ptr[rows]);
+        C.val.resize(C.ptr[rows]);
+        #pragma omp parallel for schedule(static) num_threads(num_threads) if (num_threads > 1)
+        for (int t = 0; t < num_threads; ++t) {
+                if (idx[t].empty()) continue;
+                std::copy(idx[t].begin(), idx[t].end(), C.idx.begin() + C.ptr[first[t]]);
+                std::copy(val[t].begin(), val[t].end(), C.val.begin() + C.ptr[first[t]]);
+        }
+        return C;
+}
+
+// C := A B
+template <typename T>
+CSRMatrix<T> csr_spgemm(const CSRMatrix<T>& A, const CSRMatrix<T>& B) {
+        return csr_build<T>(A.rows, B.cols,
+                [&](const int i, std::vector<std::pair<int, T>>& entries) {
+                        for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k) {
+                                int j = A.idx[k];
+                                for (int m = B.ptr[j]; m < B.ptr[j + 1]; ++m)
+                                        entries.push_back(std::make_pair(
+                                            B.idx[m], A.val[k] * B.val[m]));
+                        }
+                });
+}
+
+// Matrix of -L (five-point Laplacian) on the (n - 2)^2 interior points of an
+// n x n grid with homogeneous Dirichlet boundary conditions. Interior point
+// (i, j) is unknown (j - 1) + (i - 1) * (n - 2).
+template <typename T>
+CSRMatrix<T> poisson_csr(const int n, const T h) {
+        int m = n - 2;
+        T hi2 = 1.0 / (h * h);
+        return csr_build<T>(m * m, m * m,
+                [&](const int k, std::vector<std::pair<int, T>>& entries) {
+                        int i = k / m, j = k % m;
+                        if (i > 0) entries.push_back(std::make_pair(k - m, -hi2));
+                        if (j > 0) entries.push_back(std::make_pair(k - 1, -hi2));
+                        entries.push_back(std::make_pair(k, 4 * hi2));
+                        if (j < m - 1) entries.push_back(std::make_pair(k + 1, -hi2));
+                        if (i < m - 1) entries.push_back(std::make_pair(k + m, -hi2));
+                });
+}
+
+// Copy the interior points of an n x n grid to a vector and back
+template <typename T>
+void grid_to_interior(T *x, const T *u, const int n, const T scale=1.0) {
+        int m = n - 2;
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        x[(j - 1) + (i - 1) * m] = scale * u[j + i * n];
+}
+
+template <typename T>
+void interior_to_grid(T *u, const T *x, const int n, const T scale=1.0) {
+        int m = n - 2;
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        u[j + i * n] = scale * x[(j - 1) + (i - 1) * m];
+}
+
+// Sum of |x_i| * w over blocks of rows in order, so that the result does not
+// depend on the number of threads
+template <typename T>
+double vector_l1norm(const T *x, const int n, const double w=1.0) {
+        const int block = 4096;
+        int num_blocks = (n + block - 1) / block;
+        std::vector<double> sums(num_blocks, 0.0);
+        #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+        for (int b = 0; b < num_blocks; ++b)
+                for (int i = b * block; i < std::min(n, (b + 1) * block); ++i)
+                        sums[b] += fabs(x[i]) * w;
+        double out = 0.0;
+        for (int b = 0; b < num_blocks; ++b)
+                out += sums[b];
+        return out;
+}
+
+template <typename T>
+double vector_dot(const T *x, const T *y, const int n) {
+        const int block = 4096;
+        int num_blocks = (n + block - 1) / block;
+        std::vector<double> sums(num_blocks, 0.0);
+        #pragma omp parallel for schedule(static) if (n >= CSR_OMP_MIN_ROWS)
+        for (int b = 0; b < num_blocks; ++b)
+                for (int i = b * block; i < std::min(n, (b + 1) * block); ++i)
+                        sums[b] += x[i] * y[i];
+        double out = 0.0;
+        for (int b = 0; b < num_blocks; ++b)
+                out += sums[b];
+        return out;
+}
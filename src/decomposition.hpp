@@ -0,0 +1,530 @@
+#pragma once
+#include <poisson.hpp>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <omp.h>
+// Shared memory domain decomposition. The grid is split into blocks of rows,
+// one per thread. Each thread allocates and first-touches its own blocks, which
+// are stored with one halo row above and below. Halo rows are exchanged through
+// lock-free single-producer/single-consumer channels, and the exchange is
+// overlapped with the computation of the rows that do not depend on the halos.
+//
+// The multigrid hierarchy is decomposed in the same way until the blocks
+// become too small. At that point the coarse grid problem is agglomerated into
+// a single grid and solved by `multigrid_v_cycle` on one thread. Since all
+// kernels are pointwise (red-black Gauss-Seidel, residual, restriction and
+// prolongation), the result is identical to the serial `Multigrid` solver.
+
+// Rows [i0, i1) of an n x n grid, stored with one halo row above and below
+template <typename T>
+struct Subdomain {
+        int i0 = 0, i1 = 0, n = 0;
+        T *x = 0;
+
+        size_t num_bytes(void) const { return sizeof(T) * (i1 - i0 + 2) * n; }
+
+        // The calling thread first-touches the rows
+        void allocate(const int i0_, const int i1_, const int n_,
+                      const memory_category category=MEMORY_OTHER) {
+                i0 = i0_;
+                i1 = i1_;
+                n = n_;
+                x = (T*)memory_alloc(num_bytes(), category);
+                memset(x, 0, num_bytes());
+        }
+
+        void release(void) {
+                if (x != nullptr) memory_free(x, num_bytes());
+                x = 0;
+        }
+
+        T *row(const int i) { return &x[(i - i0 + 1) * n]; }
+        const T *row(const int i) const { return &x[(i - i0 + 1) * n]; }
+
+        // Owned rows, including the halo rows
+        void zero(void) {
+                memset(x, 0, num_bytes());
+        }
+};
+
+// Lock-free single-producer/single-consumer ring buffer of rows
+template <typename T>
+class HaloChannel {
+        private:
+                T *buffer = 0;
+                int slots = 0, width = 0;
+                std::atomic<size_t> head;
+                char padding0[64 - sizeof(std::atomic<size_t>)];
+                std::atomic<size_t> tail;
+                char padding1[64 - sizeof(std::atomic<size_t>)];
+        public:
+                HaloChannel() : head(0), tail(0) { }
+
+                void init(const int width_, const int slots_ = 2) {
+                        width = width_;
+                        slots = slots_;
+                        buffer = (T*)memory_alloc(sizeof(T) * width * slots,
+                                                  MEMORY_SCRATCH);
+                }
+
+                void send(const T *x, const int count) {
+                        size_t h = head.load(std::memory_order_relaxed);
+                        while (h - tail.load(std::memory_order_acquire) == (size_t)slots)
+                                std::this_thread::yield();
+                        memcpy(&buffer[(h % slots) * width], x, sizeof(T) * count);
+                        head.store(h + 1, std::memory_order_release);
+                }
+
+                void recv(T *x, const int count) {
+                        size_t t = tail.load(std::memory_order_relaxed);
+                        while (head.load(std::memory_order_acquire) == t)
+                                std::this_thread::yield();
+                        memcpy(x, &buffer[(t % slots) * width], sizeof(T) * count);
+                        tail.store(t + 1, std::memory_order_release);
+                }
+
+                ~HaloChannel(void) {
+                        if (buffer != nullptr)
+                                memory_free(buffer, sizeof(T) * width * slots);
+                }
+};
+
+// Channels between each pair of neighbouring subdomains. All threads must
+// perform the exchanges in the same order.
+template <typename T>
+class HaloExchange {
+        private:
+                int p = 0;
+                // down[t]: t -> t + 1, up[t]: t + 1 -> t
+                std::vector<HaloChannel<T>> down, up;
+        public:
+                void init(const int num_subdomains, const int width) {
+                        p = num_subdomains;
+                        down = std::vector<HaloChannel<T>>(p);
+                        up = std::vector<HaloChannel<T>>(p);
+                        for (int t = 0; t < p; ++t) {
+                                down[t].init(width);
+                                up[t].init(width);
+                        }
+                }
+
+                // Send the first and last row to the neighbours
+                void begin(const int t, Subdomain<T>& x) {
+                        if (t > 0) up[t - 1].send(x.row(x.i0), x.n);
+                        if (t < p - 1) down[t].send(x.row(x.i1 - 1), x.n);
+                }
+
+                // Receive the halo rows
+                void end(const int t, Subdomain<T>& x) {
+                        if (t > 0) down[t - 1].recv(x.row(x.i0 - 1), x.n);
+                        if (t < p - 1) up[t].recv(x.row(x.i1), x.n);
+                }
+};
+
+template <typename T>
+void decomposed_gauss_seidel(Subdomain<T>& u, const Subdomain<T>& f, const T h,
+                             const int color, const int ib, const int ie) {
+        int n = u.n;
+        int rows = std::min(ie, n - 1) - std::max(ib, 1);
+        if (rows > 0)
+                work_count(WORK_SMOOTH, 0.5 * rows * (n - 2), 6, 6 * sizeof(T),
+                           (double)(n - 2) * (n - 2));
+        for (int i = std::max(ib, 1); i < std::min(ie, n - 1); ++i) {
+                T *ui = u.row(i);
+                const T *uu = u.row(i - 1);
+                const T *ud = u.row(i + 1);
+                const T *fi = f.row(i);
+                for (int j = (i + 1) % 2 == color ? 1 : 2; j < n - 1; j += 2)
+                        ui[j] = -0.25 * (h * h * fi[j] - ui[j + 1] - ui[j - 1] -
+                                         ud[j] - uu[j]);
+        }
+}
+
+// Red points of rows [ib, ie) from a zero initial guess, as in
+// `gauss_seidel_red_black_zero`. Does not read u, so no halo is needed.
+template <typename T>
+void decomposed_gauss_seidel_zero(Subdomain<T>& u, const Subdomain<T>& f, const T h,
+                                  const int ib, const int ie) {
+        int n = u.n;
+        int rows = std::min(ie, n - 1) - std::max(ib, 1);
+        if (rows > 0)
+                work_count(WORK_SMOOTH, 0.5 * rows * (n - 2), 2, 4 * sizeof(T),
+                           (double)(n - 2) * (n - 2));
+        for (int i = std::max(ib, 1); i < std::min(ie, n - 1); ++i) {
+                T *ui = u.row(i);
+                const T *fi = f.row(i);
+                for (int j = (i + 1) % 2 == 0 ? 1 : 2; j < n - 1; j += 2)
+                        ui[j] = -0.25 * (h * h * fi[j]);
+        }
+}
+
+template <typename T>
+void decomposed_residual(Subdomain<T>& r, const Subdomain<T>& u,
+                         const Subdomain<T>& f, const T h, const int ib,
+                         const int ie) {
+        int n = u.n;
+        int rows = std::min(ie, n - 1) - std::max(ib, 1);
+        if (rows > 0)
+                work_count(WORK_RESIDUAL, (double)rows * (n - 2), 7, 3 * sizeof(T));
+        T hi2 = 1.0 / (h * h);
+        for (int i = std::max(ib, 1); i < std::min(ie, n - 1); ++i) {
+                T *ri = r.row(i);
+                const T *ui = u.row(i);
+                const T *uu = u.row(i - 1);
+                const T *ud = u.row(i + 1);
+                const T *fi = f.row(i);
+                for (int j = 1; j < n - 1; ++j)
+                        ri[j] = fi[j] - (ui[j + 1] + ui[j - 1] + -4.0 * ui[j] +
+                                         ud[j] + uu[j]) * hi2;
+        }
+}
+
+// Restricts the coarse rows [ib, ie)
+template <typename T>
+void decomposed_restrict(Subdomain<T>& yc, const Subdomain<T>& xf,
+                         const int ib, const int ie) {
+        int nc = yc.n;
+        int rows = std::min(ie, nc - 1) - std::max(ib, 1);
+        if (rows > 0)
+                work_count(WORK_RESTRICT, (double)rows * (nc - 2), 20, 5 * sizeof(T));
+        const T c0 = 0.25;
+        const T c1 = 0.5;
+        for (int i = std::max(ib, 1); i < std::min(ie, nc - 1); ++i) {
+                T *y = yc.row(i);
+                const T *x0 = xf.row(2 * i - 1);
+                const T *x1 = xf.row(2 * i);
+                const T *x2 = xf.row(2 * i + 1);
+                for (int j = 1; j < nc - 1; ++j)
+                        y[j] = c0 * c0 * x0[2 * j - 1] + c0 * c1 * x0[2 * j] +
+                               c0 * c0 * x0[2 * j + 1] + c1 * c0 * x1[2 * j - 1] +
+                               c1 * c1 * x1[2 * j] + c1 * c0 * x1[2 * j + 1] +
+                               c0 * c0 * x2[2 * j - 1] + c0 * c1 * x2[2 * j] +
+                               c0 * c0 * x2[2 * j + 1];
+        }
+}
+
+// Prolongates and adds the correction to the fine rows [ib, ie)
+template <typename T>
+void decomposed_prolongate(Subdomain<T>& yf, const Subdomain<T>& xc,
+                           const int ib, const int ie) {
+        int nf = yf.n;
+        if (ie > ib)
+                work_count(WORK_PROLONGATE, (double)(ie - ib) * nf, 5, 2.25 * sizeof(T));
+        const T a = 1.0;
+        const T b = 1.0;
+        for (int i = ib; i < ie; ++i) {
+                T *y = yf.row(i);
+                const T *x0 = xc.row(i / 2);
+                if (i % 2 == 0) {
+                        for (int j = 0; j < nf; j += 2)
+                                y[j] = a * y[j] + b * x0[j / 2];
+                        for (int j = 1; j < nf; j += 2)
+                                y[j] = a * y[j] + 0.5 * b *
+                                       (x0[j / 2] + x0[j / 2 + 1]);
+                        continue;
+                }
+                const T *x1 = xc.row(i / 2 + 1);
+                for (int j = 0; j < nf; j += 2)
+                        y[j] = a * y[j] + 0.5 * b * (x0[j / 2] + x1[j / 2]);
+                for (int j = 1; j < nf; j += 2)
+                        y[j] = +a * y[j] + 0.25 * b *
+                               (x0[j / 2] + x1[j / 2] + x0[j / 2 + 1] +
+                                x1[j / 2 + 1]);
+        }
+}
+
+void decomposition_check(const int num_subdomains) {
+        if (omp_get_num_threads() != num_subdomains) {
+                fprintf(stderr,
+                        "Domain decomposition: expected %d threads, got %d.\n",
+                        num_subdomains, omp_get_num_threads());
+                fflush(stderr);
+                exit(EXIT_FAILURE);
+        }
+}
+
+template <typename T>
+class DecomposedPoisson {
+        public:
+                int n;
+                int l;
+                T h;
+                T modes;
+                // One subdomain per thread
+                int num_subdomains;
+                // Levels kd..l are decomposed, the coarser ones are agglomerated
+                int kd;
+                std::vector<int> bounds;
+                std::vector<Subdomain<T>> u, f, r;
+                HaloExchange<T> exchange;
+
+        // Subdomains are agglomerated once they have fewer than `min_rows` rows
+        DecomposedPoisson(int l, T h, T modes, const int min_rows = 8,
+                          int num_subdomains = 0)
+            : l(l), h(h), modes(modes), num_subdomains(num_subdomains) {
+                assert(l > 1);
+                n = (1 << l) + 1;
+                int p = num_subdomains > 0 ? num_subdomains : omp_get_max_threads();
+                p = std::max(1, std::min(p, n / 2));
+                this->num_subdomains = p;
+
+                kd = 2;
+                while (kd < l && (1 << kd) + 1 < p * min_rows) kd++;
+
+                // Partition of level kd, the finer levels use the same partition
+                // scaled by a power of two
+                int nd = (1 << kd) + 1;
+                bounds.resize(p + 1);
+                for (int t = 0; t <= p; ++t)
+                        bounds[t] = (int)((long)nd * t / p);
+
+                exchange.init(p, n);
+                u.resize(p);
+                f.resize(p);
+                r.resize(p);
+
+                T s = 2.0 * M_PI * modes / (h * (n - 1));
+                #pragma omp parallel num_threads(p)
+                {
+                        decomposition_check(p);
+                        int t = omp_get_thread_num();
+                        int i0 = begin(t, l);
+                        int i1 = end(t, l);
+                        u[t].allocate(i0, i1, n, MEMORY_PROBLEM);
+                        f[t].allocate(i0, i1, n, MEMORY_PROBLEM);
+                        r[t].allocate(i0, i1, n, MEMORY_PROBLEM);
+                        for (int i = i0; i < i1; ++i)
+                                for (int j = 0; j < n; ++j)
+                                        f[t].row(i)[j] = -2 * s * s * sin(s * h * i) * sin(s * h * j);
+                }
+        }
+
+        // First row of subdomain t on level k
+        int begin(const int t, const int k) const {
+                return t == 0 ? 0 : bounds[t] << (k - kd);
+        }
+
+        int end(const int t, const int k) const {
+                return t == num_subdomains - 1 ? (1 << k) + 1 : begin(t + 1, k);
+        }
+
+        void residual(void) {
+                WorkCounts *work = &work_target();
+                #pragma omp parallel num_threads(num_subdomains)
+                {
+                        decomposition_check(num_subdomains);
+                        WorkScope scope(work);
+                        int t = omp_get_thread_num();
+                        int i0 = u[t].i0, i1 = u[t].i1;
+                        exchange.begin(t, u[t]);
+                        decomposed_residual(r[t], u[t], f[t], h, i0 + 1, i1 - 1);
+                        exchange.end(t, u[t]);
+                        decomposed_residual(r[t], u[t], f[t], h, i0, i0 + 1);
+                        if (i1 - 1 > i0)
+                                decomposed_residual(r[t], u[t], f[t], h, i1 - 1, i1);
+                }
+        }
+
+        // Row sums are added in order, as in `grid_l1norm`
+        T norm(void) {
+                std::vector<double> rows(n, 0.0);
+                #pragma omp parallel num_threads(num_subdomains)
+                {
+                        int t = omp_get_thread_num();
+                        for (int i = r[t].i0; i < r[t].i1; ++i)
+                                rows[i] = grid_l1norm(r[t].row(i), n, 1, h, h);
+                }
+                double out = 0.0;
+                for (int i = 0; i < n; ++i)
+                        out += rows[i];
+                return out;
+        }
+
+        T error(void) {
+                T *v = grid_alloc<T>(n, n, MEMORY_SCRATCH);
+                T *w = grid_alloc<T>(n, n, MEMORY_SCRATCH);
+                exact_solution(v, n, h, modes);
+                gather(w, u);
+                grid_subtract(w, w, v, n, n);
+                T err = grid_l1norm(w, n, n, h, h);
+                grid_free(v, n, n);
+                grid_free(w, n, n);
+                return err;
+        }
+
+        // Copy a decomposed field into an n x n grid
+        void gather(T *out, std::vector<Subdomain<T>>& x) {
+                for (int t = 0; t < num_subdomains; ++t)
+                        memcpy(&out[x[t].i0 * n], x[t].row(x[t].i0),
+                               sizeof(T) * (x[t].i1 - x[t].i0) * n);
+        }
+
+        ~DecomposedPoisson() {
+                for (int t = 0; t < num_subdomains; ++t) {
+                        u[t].release();
+                        f[t].release();
+                        r[t].release();
+                }
+        }
+};
+
+// With `zero`, u is a zero initial guess and the red half-sweep needs no halo
+template <typename T>
+void decomposed_smooth(HaloExchange<T>& exchange, const int t, Subdomain<T>& u,
+                       const Subdomain<T>& f, const T h, const bool zero=false) {
+        int i0 = u.i0, i1 = u.i1;
+        if (zero)
+                decomposed_gauss_seidel_zero(u, f, h, i0, i1);
+        for (int color = zero ? 1 : 0; color < 2; ++color) {
+                exchange.begin(t, u);
+                decomposed_gauss_seidel(u, f, h, color, i0 + 1, i1 - 1);
+                exchange.end(t, u);
+                decomposed_gauss_seidel(u, f, h, color, i0, i0 + 1);
+                if (i1 - 1 > i0)
+                        decomposed_gauss_seidel(u, f, h, color, i1 - 1, i1);
+        }
+}
+
+template <typename F, typename P, typename T>
+class DecomposedMultigrid {
+        // The decomposed levels always smooth with `decomposed_smooth`
+        static_assert(std::is_same<F, GaussSeidelRedBlack>::value,
+                      "DecomposedMultigrid requires the GaussSeidelRedBlack smoother");
+        private:
+                // Decomposed levels kd..l, indexed by [level][subdomain]
+                std::vector<std::vector<Subdomain<T>>> e, rhs, res;
+                // Agglomerated coarse grid problem on level kd - 1
+                Subdomain<T> ea, fa;
+                T *v = 0, *w = 0, *r = 0;
+                int l, kd, p;
+                size_t num_bytes = 0;
+                F smoother;
+
+                // With `zero`, u is a zero initial guess and is not read
+                void v_cycle(P& pr, const int k, const int t, Subdomain<T>& u,
+                             Subdomain<T>& f, const T h, const bool zero=false) {
+                        HaloExchange<T>& exchange = pr.exchange;
+                        Subdomain<T>& rk = res[k][t];
+                        int i0 = u.i0, i1 = u.i1;
+
+                        decomposed_smooth(exchange, t, u, f, h, zero);
+
+                        exchange.begin(t, u);
+                        decomposed_residual(rk, u, f, h, i0 + 1, i1 - 1);
+                        exchange.end(t, u);
+                        decomposed_residual(rk, u, f, h, i0, i0 + 1);
+                        if (i1 - 1 > i0)
+                                decomposed_residual(rk, u, f, h, i1 - 1, i1);
+
+                        // Coarse rows whose restriction stencil is centered in
+                        // the subdomain
+                        int ic0 = (i0 + 1) / 2;
+                        int ic1 = (i1 + 1) / 2;
+                        bool agglomerate = k == kd;
+                        Subdomain<T>& fc = agglomerate ? fa : rhs[k - 1][t];
+                        Subdomain<T>& ec = agglomerate ? ea : e[k - 1][t];
+                        exchange.begin(t, rk);
+                        decomposed_restrict(fc, rk, ic0 + 1, ic1 - 1);
+                        exchange.end(t, rk);
+                        if (ic1 > ic0)
+                                decomposed_restrict(fc, rk, ic0, ic0 + 1);
+                        if (ic1 - 1 > ic0)
+                                decomposed_restrict(fc, rk, ic1 - 1, ic1);
+
+                        if (agglomerate) {
+                                #pragma omp barrier
+                                #pragma omp master
+                                {
+                                        // The correction starts from zero
+                                        multigrid_v_cycle<T, F>(k - 1, smoother, ea.row(0),
+                                                                fa.row(0), r, v, w, 2 * h,
+                                                                true);
+                                }
+                                #pragma omp barrier
+                                decomposed_prolongate(u, ec, i0, i1);
+                        } else {
+                                // The correction starts from zero
+                                v_cycle(pr, k - 1, t, ec, fc, 2 * h, true);
+                                // Only the last row needs the coarse halo
+                                exchange.begin(t, ec);
+                                decomposed_prolongate(u, ec, i0, i1 - 1);
+                                exchange.end(t, ec);
+                                decomposed_prolongate(u, ec, i1 - 1, i1);
+                        }
+
+                        decomposed_smooth(exchange, t, u, f, h);
+                }
+
+        public:
+
+                DecomposedMultigrid() { }
+                DecomposedMultigrid(P& pr) : l(pr.l), kd(pr.kd), p(pr.num_subdomains) {
+                        e.resize(l + 1);
+                        rhs.resize(l + 1);
+                        res.resize(l + 1);
+                        for (int k = kd; k <= l; ++k) {
+                                e[k].resize(p);
+                                rhs[k].resize(p);
+                                res[k].resize(p);
+                        }
+
+                        #pragma omp parallel num_threads(p)
+                        {
+                                decomposition_check(p);
+                                int t = omp_get_thread_num();
+                                for (int k = kd; k <= l; ++k) {
+                                        int n = (1 << k) + 1;
+                                        int i0 = pr.begin(t, k);
+                                        int i1 = pr.end(t, k);
+                                        res[k][t].allocate(i0, i1, n, MEMORY_SCRATCH);
+                                        if (k == l) continue;
+                                        e[k][t].allocate(i0, i1, n, MEMORY_HIERARCHY);
+                                        rhs[k][t].allocate(i0, i1, n, MEMORY_HIERARCHY);
+                                }
+                        }
+
+                        int na = (1 << (kd - 1)) + 1;
+                        ea.allocate(0, na, na, MEMORY_HIERARCHY);
+                        fa.allocate(0, na, na, MEMORY_HIERARCHY);
+                        // The boundaries of the coarse grids stay zero
+                        num_bytes = multigrid_size(kd - 1) * sizeof(T);
+                        v = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        w = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        r = grid_alloc<T>(na, na, MEMORY_SCRATCH);
+                }
+
+                void operator()(P& pr) {
+                        // The subdomain threads count into the solve's counters
+                        WorkCounts *work = &work_target();
+                        #pragma omp parallel num_threads(p)
+                        {
+                                decomposition_check(p);
+                                WorkScope scope(work);
+                                int t = omp_get_thread_num();
+                                v_cycle(pr, l, t, pr.u[t], pr.f[t], pr.h);
+                        }
+                }
+
+                ~DecomposedMultigrid(void) {
+                        for (int k = kd; k <= l; ++k)
+                                for (int t = 0; t < p; ++t) {
+                                        e[k][t].release();
+                                        rhs[k][t].release();
+                                        res[k][t].release();
+                                }
+                        ea.release();
+                        fa.release();
+                        memory_free(v, num_bytes);
+                        memory_free(w, num_bytes);
+                        if (r != nullptr) grid_free(r, ea.n, ea.n);
+                }
+
+                const char *name() {
+                        static char name[2048];
+                        sprintf(name, "Decomposed Multi-Grid<%s>", smoother.name());
+                        return name;
+                }
+
+};
@@ -1,5 +1,14 @@
 #pragma once
 #include <assert.h>
+#include <algorithm>
+#include <stream.hpp>
+#include <work.hpp>
+#include <vector>
+
+// Grids with fewer rows than this are processed by a single thread
+#ifndef OMP_MIN_SIZE
+#define OMP_MIN_SIZE 129
+#endif
 
 template <typename T>
 void grid_x(T *x, const int nx, const int ny, const T h) {
@@ -19,13 +28,65 @@ void grid_y(T *y, const int nx, const int ny, const T h) {
         }
 }
 
+// yc := b R xf using streaming stores, rows of xf are prefetched `pf` elements
+// ahead
+template <typename T>
+void grid_restrict_stream(T *yc, const int nxc, const int nyc, const T *xf,
+                          const int nxf, const int nyf, const T b,
+                          const int pf) {
+        const T c0 = 0.25;
+        const T c1 = 0.5;
+        // Prefetch addresses stay inside xf
+        const long last = (long)nxf * nyf - 1;
+        #pragma omp parallel if (nyf >= OMP_MIN_SIZE)
+        {
+                #pragma omp for schedule(static)
+                for (int i = 1; i < nyc-1; ++i) {
+                        for (int j = 1; j < nxc-1; ++j) {
+                                if (pf > 0) {
+                                        long k = 2 * j + pf + (long)nxf * (2 * i - 1);
+                                        stream_prefetch(&xf[std::min(k, last)]);
+                                        stream_prefetch(&xf[std::min(k + nxf, last)]);
+                                        stream_prefetch(&xf[std::min(k + 2 * nxf, last)]);
+                                }
+                                stream_store(&yc[j + nxc * i], b *
+                                    (
+                                    c0 * c0 * xf[2 * j - 1 + nxf * (2 * i - 1)] +
+                                    c0 * c1 * xf[2 * j     + nxf * (2 * i - 1)] +
+                                    c0 * c0 * xf[2 * j + 1 + nxf * (2 * i - 1)] +
+                                    +
+                                    c1 * c0 * xf[2 * j - 1 + nxf * (2 * i + 0)] +
+                                    c1 * c1 * xf[2 * j     + nxf * (2 * i + 0)] +
+                                    c1 * c0 * xf[2 * j + 1 + nxf * (2 * i + 0)] +
+                                    +
+                                    c0 * c0 * xf[2 * j - 1 + nxf * (2 * i + 1)] +
+                                    c0 * c1 * xf[2 * j     + nxf * (2 * i + 1)] +
+                                    c0 * c0 * xf[2 * j + 1 + nxf * (2 * i + 1)]
+                                    ));
+                        }
+                }
+                stream_fence();
+        }
+}
+
 template <typename T>
 void grid_restrict(T *yc, const int nxc, const int nyc, const T *xf,
                    const int nxf, const int nyf, const T a = 0.0,
                    const T b = 1.0) {
         assert(nxf == 2 * (nxc - 1) + 1);
+        // Nine weighted fine points per coarse point, four of them new
+        work_count(WORK_RESTRICT, (double)(nxc - 2) * (nyc - 2), 20,
+                   (a == 0 ? 5 : 6) * sizeof(T));
+        // The output is write-only when a = 0
+        size_t working_set = sizeof(T) * ((size_t)nxf * nyf + (size_t)nxc * nyc);
+        if (a == 0 && stream_enabled(working_set)) {
+                grid_restrict_stream(yc, nxc, nyc, xf, nxf, nyf, b,
+                                     prefetch_distance(working_set));
+                return;
+        }
         const T c0 = 0.25;
         const T c1 = 0.5;
+        #pragma omp parallel for schedule(static) if (nyf >= OMP_MIN_SIZE)
         for (int i = 1; i < nyc-1; ++i) {
                 for (int j = 1; j < nxc-1; ++j) {
                         yc[j + nxc * i] =
@@ -52,7 +113,10 @@ void grid_prolongate(T *yf, const int nxf, const int nyf, const T *xc,
                      const int nxc, const int nyc, const T a = 0.0,
                      const T b = 1.0) {
         assert(nxf == 2 * (nxc - 1) + 1);
+        work_count(WORK_PROLONGATE, (double)nxf * nyf, 5,
+                   (a == 0 ? 1.25 : 2.25) * sizeof(T));
 
+        #pragma omp parallel for schedule(static) if (nyf >= OMP_MIN_SIZE)
         for (int i = 0; i < nyc; ++i) {
                 for (int j = 0; j < nxc; ++j) {
                         yf[2 * j + nxf * 2 * i] =
@@ -80,8 +144,145 @@ void grid_prolongate(T *yf, const int nxf, const int nyf, const T *xc,
         }
 }
 
+// yc := a yc + b R xf with injection, R xf = xf at the coarse points
+template <typename T>
+void grid_restrict_injection(T *yc, const int nxc, const int nyc, const T *xf,
+                             const int nxf, const int nyf, const T a = 0.0,
+                             const T b = 1.0) {
+        assert(nxf == 2 * (nxc - 1) + 1);
+        // The cache lines of every other fine row are read
+        work_count(WORK_RESTRICT, (double)(nxc - 2) * (nyc - 2), 3,
+                   (a == 0 ? 3 : 4) * sizeof(T));
+        #pragma omp parallel for schedule(static) if (nyf >= OMP_MIN_SIZE)
+        for (int i = 1; i < nyc-1; ++i) {
+                const T *x = &xf[nxf * 2 * i];
+                T *y = &yc[nxc * i];
+                #pragma omp simd
+                for (int j = 1; j < nxc-1; ++j)
+                        y[j] = a * y[j] + b * x[2 * j];
+        }
+}
+
+// yc := a yc + b R xf with half weighting (center 1/2, edge neighbors 1/8)
+template <typename T>
+void grid_restrict_half(T *yc, const int nxc, const int nyc, const T *xf,
+                        const int nxf, const int nyf, const T a = 0.0,
+                        const T b = 1.0) {
+        assert(nxf == 2 * (nxc - 1) + 1);
+        work_count(WORK_RESTRICT, (double)(nxc - 2) * (nyc - 2), 9,
+                   (a == 0 ? 5 : 6) * sizeof(T));
+        const T c0 = 0.125;
+        const T c1 = 0.5;
+        #pragma omp parallel for schedule(static) if (nyf >= OMP_MIN_SIZE)
+        for (int i = 1; i < nyc-1; ++i) {
+                const T *xm = &xf[nxf * (2 * i - 1)];
+                const T *x0 = &xf[nxf * 2 * i];
+                const T *xp = &xf[nxf * (2 * i + 1)];
+                T *y = &yc[nxc * i];
+                #pragma omp simd
+                for (int j = 1; j < nxc-1; ++j)
+                        y[j] = a * y[j] + b *
+                            (
+                            c1 * x0[2 * j] +
+                            c0 * (x0[2 * j - 1] + x0[2 * j + 1] + xm[2 * j] + xp[2 * j])
+                            );
+        }
+}
+
+// Weights of the cubic interpolation at the midpoint of coarse points i and
+// i + 1, applied to the coarse points first .. first + 3. One-sided next to
+// the boundary, linear on grids with fewer than four points.
+template <typename T>
+__inline__ int grid_cubic_weights(T *w, const int i, const int nc) {
+        if (nc < 4) {
+                w[0] = 0.5; w[1] = 0.5; w[2] = 0.0; w[3] = 0.0;
+                return i;
+        }
+        if (i == 0) {
+                w[0] = 5.0 / 16; w[1] = 15.0 / 16; w[2] = -5.0 / 16; w[3] = 1.0 / 16;
+                return 0;
+        }
+        if (i == nc - 2) {
+                w[0] = 1.0 / 16; w[1] = -5.0 / 16; w[2] = 15.0 / 16; w[3] = 5.0 / 16;
+                return nc - 4;
+        }
+        w[0] = -1.0 / 16; w[1] = 9.0 / 16; w[2] = 9.0 / 16; w[3] = -1.0 / 16;
+        return i - 1;
+}
+
+// Coarse row xc interpolated to a fine row y (cubic)
+template <typename T>
+__inline__ void grid_cubic_row(T *y, const T *xc, const int nxc) {
+        #pragma omp simd
+        for (int j = 0; j < nxc; ++j)
+                y[2 * j] = xc[j];
+        T w[4] = {0.0, 0.0, 0.0, 0.0};
+        if (nxc < 4) {
+                for (int j = 0; j < nxc - 1; ++j)
+                        y[2 * j + 1] = 0.5 * (xc[j] + xc[j + 1]);
+                return;
+        }
+        // One-sided next to the boundary
+        for (int j = 0; j < nxc - 1; j += nxc - 2) {
+                int first = grid_cubic_weights(w, j, nxc);
+                y[2 * j + 1] = w[0] * xc[first] + w[1] * xc[first + 1] +
+                               w[2] * xc[first + 2] + w[3] * xc[first + 3];
+        }
+        grid_cubic_weights(w, 1, nxc);
+        #pragma omp simd
+        for (int j = 1; j < nxc - 2; ++j)
+                y[2 * j + 1] = w[0] * xc[j - 1] + w[1] * xc[j] +
+                               w[2] * xc[j + 1] + w[3] * xc[j + 2];
+}
+
+// yf := a yf + b P xc with tensor product cubic interpolation. Each thread
+// keeps the last four coarse rows interpolated in x.
+template <typename T>
+void grid_prolongate_cubic(T *yf, const int nxf, const int nyf, const T *xc,
+                           const int nxc, const int nyc, const T a = 0.0,
+                           const T b = 1.0) {
+        assert(nxf == 2 * (nxc - 1) + 1);
+        work_count(WORK_PROLONGATE, (double)nxf * nyf, 8,
+                   (a == 0 ? 1.25 : 2.25) * sizeof(T));
+        #pragma omp parallel if (nyf >= OMP_MIN_SIZE)
+        {
+                std::vector<T> rows(4 * nxf);
+                int tag[4] = {-1, -1, -1, -1};
+                auto row = [&](const int k) {
+                        T *x = &rows[nxf * (k % 4)];
+                        if (tag[k % 4] != k) {
+                                grid_cubic_row(x, &xc[nxc * k], nxc);
+                                tag[k % 4] = k;
+                        }
+                        return x;
+                };
+                T w[4] = {0.0, 0.0, 0.0, 0.0};
+                #pragma omp for schedule(static)
+                for (int i = 0; i < nyc; ++i) {
+                        // Rows i - 1 .. i + 2 are kept
+                        int first = i < nyc - 1 ? grid_cubic_weights(w, i, nyc) : i;
+                        T *x0 = row(i);
+                        T *y = &yf[nxf * 2 * i];
+                        #pragma omp simd
+                        for (int j = 0; j < nxf; ++j)
+                                y[j] = a * y[j] + b * x0[j];
+                        if (i == nyc - 1) continue;
+                        const T *r0 = row(first);
+                        const T *r1 = row(first + 1);
+                        const T *r2 = nyc < 4 ? r1 : row(first + 2);
+                        const T *r3 = nyc < 4 ? r1 : row(first + 3);
+                        y = &yf[nxf * (2 * i + 1)];
+                        #pragma omp simd
+                        for (int j = 0; j < nxf; ++j)
+                                y[j] = a * y[j] + b * (w[0] * r0[j] + w[1] * r1[j] +
+                                                       w[2] * r2[j] + w[3] * r3[j]);
+                }
+        }
+}
+
 template<typename T>
 void grid_subtract(T *z, const T *x, const T *y, const int nx, const int ny) {
+        #pragma omp parallel for schedule(static) if (ny >= OMP_MIN_SIZE)
         for (int i = 0; i < nx * ny; ++i)
                 z[i] = x[i] - y[i];
 }
@@ -90,10 +291,16 @@ template <typename T>
 double grid_l1norm(const T *x, const int nx, const int ny, const T hx,
                    const T hy, const int bx = 0, const int by = 0,
                    const int ex = 0, const int ey = 0) {
-        double out = 0.0;
+        // Rows are summed in parallel, and the row sums in order, so that the
+        // result does not depend on the number of threads
+        std::vector<double> rows(ny, 0.0);
+        #pragma omp parallel for schedule(static) if (ny >= OMP_MIN_SIZE)
         for (int i = by; i < ny - ey; ++i) 
                 for (int j = bx; j < nx - ex; ++j) 
-                        out += fabs(x[j + nx * i]) * hx * hy;
+                        rows[i] += fabs(x[j + nx * i]) * hx * hy;
+        double out = 0.0;
+        for (int i = by; i < ny - ey; ++i)
+                out += rows[i];
         return out;
 }
 
@@ -101,10 +308,14 @@ template <typename T>
 double grid_l2norm(const T *x, const int nx, const int ny, const T hx,
                    const T hy, const int bx = 0, const int by = 0,
                    const int ex = 0, const int ey = 0) {
-        double out = 0.0;
+        std::vector<double> rows(ny, 0.0);
+        #pragma omp parallel for schedule(static) if (ny >= OMP_MIN_SIZE)
         for (int i = by; i < ny - ey; ++i) 
                 for (int j = bx; j < nx - ex; ++j) 
-                        out += x[j + nx * i] * x[j + nx * i];
+                        rows[i] += x[j + nx * i] * x[j + nx * i];
+        double out = 0.0;
+        for (int i = by; i < ny - ey; ++i)
+                out += rows[i];
         return out * hx * hy;
 }
 
@@ -116,3 +327,25 @@ void grid_print(const T *x, const int nx, const int ny) {
                 printf("\n");
         }
 }
+
+template <typename T>
+double grid_dot(const T *x, const T *y, const int nx, const int ny) {
+        std::vector<double> rows(ny, 0.0);
+        #pragma omp parallel for schedule(static) if (ny >= OMP_MIN_SIZE)
+        for (int i = 0; i < ny; ++i)
+                for (int j = 0; j < nx; ++j)
+                        rows[i] += x[j + nx * i] * y[j + nx * i];
+        double out = 0.0;
+        for (int i = 0; i < ny; ++i)
+                out += rows[i];
+        return out;
+}
+
+// y := a * x + b * y
+template <typename T>
+void grid_axpby(T *y, const T *x, const int nx, const int ny, const T a = 1.0,
+                const T b = 1.0) {
+        #pragma omp parallel for schedule(static) if (ny >= OMP_MIN_SIZE)
+        for (int i = 0; i < nx * ny; ++i)
+                y[i] = a * x[i] + b * y[i];
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <poisson.hpp>
+// Preconditioned conjugate gradient method for Lu = f. Each call performs one
+// iteration. The preconditioner M must be symmetric and provide
+// M.precondition(z, r, n, h) that computes z := M r.
+
+template <typename M, typename P, typename T>
+class ConjugateGradient {
+        private:
+                T *r = 0, *z = 0, *p = 0, *q = 0;
+                int n;
+                double rz = 0.0;
+                bool restart = true;
+                M preconditioner;
+        public:
+
+                ConjugateGradient() { }
+                ConjugateGradient(P& problem)
+                    : n(problem.n), preconditioner(problem) {
+                        r = grid_alloc<T>(n, n, MEMORY_KRYLOV);
+                        z = grid_alloc<T>(n, n, MEMORY_KRYLOV);
+                        p = grid_alloc<T>(n, n, MEMORY_KRYLOV);
+                        q = grid_alloc<T>(n, n, MEMORY_KRYLOV);
+                }
+
+                void operator()(P& problem) {
+                        T h = problem.h;
+                        if (restart) {
+                                poisson_residual(r, problem.u, problem.f, n, h);
+                                preconditioner.precondition(z, r, n, h);
+                                memcpy(p, z, sizeof(T) * n * n);
+                                rz = grid_dot(r, z, n, n);
+                                restart = false;
+                        }
+
+                        poisson_operator(q, p, n, h);
+                        T alpha = rz / grid_dot(p, q, n, n);
+                        grid_axpby(problem.u, p, n, n, alpha, (T)1.0);
+                        grid_axpby(r, q, n, n, -alpha, (T)1.0);
+                        preconditioner.precondition(z, r, n, h);
+                        double rz1 = grid_dot(r, z, n, n);
+                        grid_axpby(p, z, n, n, (T)1.0, (T)(rz1 / rz));
+                        rz = rz1;
+                }
+
+                // Call after modifying the solution outside of the solver
+                void reset(void) {
+                        restart = true;
+                }
+
+                // Search direction, residual and <r, z> of the current
+                // iteration, for checkpointing
+                size_t state_bytes(void) {
+                        return 2 * sizeof(T) * n * n + sizeof(double) + sizeof(int);
+                }
+
+                void save_state(char *out) {
+                        size_t num_bytes = sizeof(T) * n * n;
+                        int flag = restart;
+                        memcpy(out, r, num_bytes);
+                        memcpy(out + num_bytes, p, num_bytes);
+                        memcpy(out + 2 * num_bytes, &rz, sizeof(double));
+                        memcpy(out + 2 * num_bytes + sizeof(double), &flag, sizeof(int));
+                }
+
+                void load_state(const char *in) {
+                        size_t num_bytes = sizeof(T) * n * n;
+                        int flag;
+                        memcpy(r, in, num_bytes);
+                        memcpy(p, in + num_bytes, num_bytes);
+                        memcpy(&rz, in + 2 * num_bytes, sizeof(double));
+                        memcpy(&flag, in + 2 * num_bytes + sizeof(double), sizeof(int));
+                        restart = flag;
+                }
+
+                M& get_preconditioner(void) {
+                        return preconditioner;
+                }
+
+                ~ConjugateGradient(void) {
+                        if (r != nullptr) grid_free(r, n, n);
+                        if (z != nullptr) grid_free(z, n, n);
+                        if (p != nullptr) grid_free(p, n, n);
+                        if (q != nullptr) grid_free(q, n, n);
+                }
+
+                const char *name() {
+                        static char name[2048];
+                        // The preconditioner name is cut to fit
+                        snprintf(name, sizeof(name), "Conjugate Gradient<%.2000s>",
+                                 preconditioner.name());
+                        return name;
+                }
+
+};
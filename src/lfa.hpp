@@ -0,0 +1,383 @@
+#pragma once
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <complex>
+#include <poisson.hpp>
+// Local Fourier analysis (LFA) of two-grid cycles for constant stencils. The
+// error components e^(i (theta_x j + theta_y i)) are grouped into sets of four
+// harmonics that are coupled by coarsening,
+//
+//   theta, theta + (pi, pi), theta + (pi, 0), theta + (0, pi),
+//
+// for theta in [-pi/2, pi/2)^2. On each set, the smoother, the transfer
+// operators and the two-grid cycle are 4 x 4 matrices (symbols). Red-black
+// relaxation couples theta with theta + (pi, pi). The predicted factors are
+// the largest spectral radii over a grid of frequencies:
+//
+//   smoothing factor   mu  = max rho(Q S^nu)^(1/nu), Q removes theta
+//   two-grid factor    rho = max rho(S^post (I - P L_H^-1 R L_h) S^pre)
+//
+// where nu = pre + post and the coarse operator L_H is the stencil on 2h
+// (rediscretization, as in `Multigrid`). The analysis ignores boundaries, so
+// it predicts the asymptotic convergence of the interior, which multigrid
+// with V-cycles approaches when the coarse grid problems are solved well.
+//
+//   LFAOptions opts = lfa_options<GaussSeidelRedBlack, Transfer<>>(mg.cycle);
+//   double rho = lfa_two_grid_factor(opts);
+
+enum lfa_smoother {LFA_JACOBI, LFA_GAUSS_SEIDEL, LFA_RED_BLACK, LFA_CHEBYSHEV};
+enum lfa_restriction {LFA_FULL_WEIGHTING, LFA_HALF_WEIGHTING, LFA_INJECTION};
+enum lfa_prolongation {LFA_BILINEAR, LFA_CUBIC};
+
+class LFAOptions {
+        public:
+                // Coefficients of u(i + a, j + b) in stencil[a + 1][b + 1]
+                // (row offset a, column offset b), the default is
+                // L = u_xx + u_yy with h = 1
+                double stencil[3][3] = {{0.0, 1.0, 0.0}, {1.0, -4.0, 1.0}, {0.0, 1.0, 0.0}};
+                lfa_smoother smoother = LFA_RED_BLACK;
+                // Damping of Jacobi
+                double omega = 0.8;
+                // Chebyshev polynomial in D^-1 L, damps [lower rho, upper rho]
+                // (one sweep applies the whole polynomial)
+                int degree = 2;
+                double lower = 1.0 / 8.0;
+                double upper = 1.1;
+                int pre = 1;
+                int post = 1;
+                lfa_restriction restriction = LFA_FULL_WEIGHTING;
+                double injection_weight = 0.5;
+                lfa_prolongation prolongation = LFA_BILINEAR;
+                // Frequencies per dimension
+                int resolution = 64;
+
+                const char *name() {
+                        static char name[256];
+                        const char *smoothers[4] = {"Jacobi", "Gauss-Seidel",
+                                                    "Gauss-Seidel (red-black)", "Chebyshev"};
+                        const char *restrictions[3] = {"full weighting", "half weighting",
+                                                       "injection"};
+                        const char *prolongations[2] = {"bilinear", "cubic"};
+                        snprintf(name, sizeof(name), "%s, %s, %s", smoothers[smoother],
+                                 restrictions[restriction], prolongations[prolongation]);
+                        return name;
+                }
+};
+
+typedef std::complex<double> lfa_complex;
+
+// Operator on the four harmonics of a frequency
+class LFAMatrix {
+        public:
+                lfa_complex a[4][4];
+
+                LFAMatrix(const double diagonal=0.0) {
+                        for (int i = 0; i < 4; ++i)
+                                for (int j = 0; j < 4; ++j)
+                                        a[i][j] = i == j ? diagonal : 0.0;
+                }
+
+                LFAMatrix operator*(const LFAMatrix& b) const {
+                        LFAMatrix c;
+                        for (int i = 0; i < 4; ++i)
+                                for (int k = 0; k < 4; ++k)
+                                        for (int j = 0; j < 4; ++j)
+                                                c.a[i][j] += a[i][k] * b.a[k][j];
+                        return c;
+                }
+
+                LFAMatrix power(const int nu) const {
+                        LFAMatrix c(1.0);
+                        for (int k = 0; k < nu; ++k)
+                                c = c * *this;
+                        return c;
+                }
+
+                double norm(void) const {
+                        double s = 0.0;
+                        for (int i = 0; i < 4; ++i)
+                                for (int j = 0; j < 4; ++j)
+                                        s += std::norm(a[i][j]);
+                        return sqrt(s);
+                }
+};
+
+// Spectral radius from the norms of repeated squares, rho = lim |M^k|^(1/k)
+double lfa_spectral_radius(const LFAMatrix& m, const int squarings=14) {
+        LFAMatrix x = m;
+        double log_rho = 0.0, scale = 1.0;
+        for (int k = 0; k < squarings; ++k) {
+                double c = x.norm();
+                if (c == 0.0) return 0.0;
+                log_rho += scale * log(c);
+                for (int i = 0; i < 4; ++i)
+                        for (int j = 0; j < 4; ++j)
+                                x.a[i][j] /= c;
+                x = x * x;
+                scale *= 0.5;
+        }
+        log_rho += scale * log(x.norm());
+        return exp(log_rho);
+}
+
+// Harmonic k of theta
+__inline__ void lfa_harmonic(double *t, const double tx, const double ty, const int k) {
+        const double shift[4][2] = {{0.0, 0.0}, {M_PI, M_PI}, {M_PI, 0.0}, {0.0, M_PI}};
+        t[0] = tx + shift[k][0];
+        t[1] = ty + shift[k][1];
+}
+
+lfa_complex lfa_stencil_symbol(const LFAOptions& opts, const double tx, const double ty) {
+        lfa_complex s = 0.0;
+        for (int a = -1; a <= 1; ++a)
+                for (int b = -1; b <= 1; ++b)
+                        s += opts.stencil[a + 1][b + 1] *
+                             std::exp(lfa_complex(0.0, b * tx + a * ty));
+        return s;
+}
+
+// Largest |lambda| of D^-1 L over all frequencies (for Chebyshev)
+double lfa_jacobi_radius(const LFAOptions& opts) {
+        double rho = 0.0;
+        int m = 2 * opts.resolution;
+        for (int i = 0; i < m; ++i)
+                for (int j = 0; j < m; ++j) {
+                        double tx = -M_PI + (j + 0.5) * 2 * M_PI / m;
+                        double ty = -M_PI + (i + 0.5) * 2 * M_PI / m;
+                        rho = std::max(rho, std::abs(lfa_stencil_symbol(opts, tx, ty) /
+                                                     opts.stencil[1][1]));
+                }
+        return rho;
+}
+
+// Error reduction of one smoothing step for a single frequency (all smoothers
+// except red-black)
+lfa_complex lfa_point_smoother(const LFAOptions& opts, const double tx, const double ty,
+                               const double rho) {
+        double d = opts.stencil[1][1];
+        lfa_complex lambda = lfa_stencil_symbol(opts, tx, ty) / d;
+        if (opts.smoother == LFA_JACOBI)
+                return 1.0 - opts.omega * lambda;
+        if (opts.smoother == LFA_GAUSS_SEIDEL) {
+                // Points before (i, j) in lexicographic order are new
+                lfa_complex lo = d, up = 0.0;
+                for (int a = -1; a <= 1; ++a)
+                        for (int b = -1; b <= 1; ++b) {
+                                if (a == 0 && b == 0) continue;
+                                lfa_complex s = opts.stencil[a + 1][b + 1] *
+                                                std::exp(lfa_complex(0.0, b * tx + a * ty));
+                                if (a < 0 || (a == 0 && b < 0))
+                                        lo += s;
+                                else
+                                        up += s;
+                        }
+                return -up / lo;
+        }
+        // Chebyshev, the same recurrence as `SparseChebyshev` applied to the
+        // error e = 1 (the residual is -lambda e)
+        double a = opts.lower * rho, c = opts.upper * rho;
+        double theta = 0.5 * (c + a), delta = 0.5 * (c - a);
+        double sigma = theta / delta;
+        double rho_k = 1.0 / sigma;
+        lfa_complex e = 1.0;
+        lfa_complex step = -lambda * e / theta;
+        for (int k = 0; k < opts.degree; ++k) {
+                e += step;
+                if (k == opts.degree - 1) break;
+                double rho_next = 1.0 / (2.0 * sigma - rho_k);
+                step = rho_next * rho_k * step - 2.0 * rho_next / delta * lambda * e;
+                rho_k = rho_next;
+        }
+        return e;
+}
+
+LFAMatrix lfa_smoother_symbol(const LFAOptions& opts, const double tx, const double ty,
+                              const double rho) {
+        LFAMatrix s;
+        double t[4][2];
+        for (int k = 0; k < 4; ++k)
+                lfa_harmonic(t[k], tx, ty, k);
+        if (opts.smoother != LFA_RED_BLACK) {
+                for (int k = 0; k < 4; ++k)
+                        s.a[k][k] = lfa_point_smoother(opts, t[k][0], t[k][1], rho);
+                return s;
+        }
+        // Red (i + j even) then black points, each a Jacobi step on its
+        // points. The checkerboard mask maps harmonic p to q = p ^ 1.
+        LFAMatrix red, black;
+        for (int p = 0; p < 4; p += 2) {
+                int q = p + 1;
+                lfa_complex jp = 1.0 - lfa_stencil_symbol(opts, t[p][0], t[p][1]) /
+                                       opts.stencil[1][1];
+                lfa_complex jq = 1.0 - lfa_stencil_symbol(opts, t[q][0], t[q][1]) /
+                                       opts.stencil[1][1];
+                red.a[p][p] = 0.5 * (jp + 1.0);
+                red.a[p][q] = 0.5 * (jq - 1.0);
+                red.a[q][p] = 0.5 * (jp - 1.0);
+                red.a[q][q] = 0.5 * (jq + 1.0);
+                black.a[p][p] = 0.5 * (jp + 1.0);
+                black.a[p][q] = 0.5 * (1.0 - jq);
+                black.a[q][p] = 0.5 * (1.0 - jp);
+                black.a[q][q] = 0.5 * (jq + 1.0);
+        }
+        return black * red;
+}
+
+double lfa_restriction_symbol(const LFAOptions& opts, const double tx, const double ty) {
+        if (opts.restriction == LFA_FULL_WEIGHTING)
+                return 0.25 * (1.0 + cos(tx)) * (1.0 + cos(ty));
+        if (opts.restriction == LFA_HALF_WEIGHTING)
+                return 0.5 + 0.25 * (cos(tx) + cos(ty));
+        return opts.injection_weight;
+}
+
+double lfa_prolongation_symbol(const LFAOptions& opts, const double tx, const double ty) {
+        if (opts.prolongation == LFA_BILINEAR)
+                return 0.25 * (1.0 + cos(tx)) * (1.0 + cos(ty));
+        // Weights (-1, 9, 9, -1) / 16 at the midpoints
+        auto cubic = [](const double t) {
+                return 0.5 * (1.0 + (9.0 * cos(t) - cos(3.0 * t)) / 8.0);
+        };
+        return cubic(tx) * cubic(ty);
+}
+
+// Coarse grid correction I - P L_H^-1 R L_h
+LFAMatrix lfa_coarse_correction(const LFAOptions& opts, const double tx, const double ty) {
+        LFAMatrix k(1.0);
+        double t[4][2];
+        for (int m = 0; m < 4; ++m)
+                lfa_harmonic(t[m], tx, ty, m);
+        // Stencil on 2h
+        lfa_complex coarse = 0.25 * lfa_stencil_symbol(opts, 2 * tx, 2 * ty);
+        for (int i = 0; i < 4; ++i)
+                for (int j = 0; j < 4; ++j)
+                        k.a[i][j] -= lfa_prolongation_symbol(opts, t[i][0], t[i][1]) *
+                                     lfa_restriction_symbol(opts, t[j][0], t[j][1]) *
+                                     lfa_stencil_symbol(opts, t[j][0], t[j][1]) / coarse;
+        return k;
+}
+
+// Low frequency theta of sample (i, j), returns false for theta = 0
+__inline__ bool lfa_frequency(double *t, const LFAOptions& opts, const int i, const int j) {
+        int m = opts.resolution;
+        t[0] = -0.5 * M_PI + j * M_PI / m;
+        t[1] = -0.5 * M_PI + i * M_PI / m;
+        return 2 * i != m || 2 * j != m;
+}
+
+double lfa_smoothing_factor(const LFAOptions& opts) {
+        int nu = std::max(opts.pre + opts.post, 1);
+        double rho = opts.smoother == LFA_CHEBYSHEV ? lfa_jacobi_radius(opts) : 0.0;
+        double mu = 0.0;
+        for (int i = 0; i < opts.resolution; ++i)
+                for (int j = 0; j < opts.resolution; ++j) {
+                        double t[2];
+                        if (!lfa_frequency(t, opts, i, j)) continue;
+                        LFAMatrix q(1.0);
+                        q.a[0][0] = 0.0;
+                        LFAMatrix s = lfa_smoother_symbol(opts, t[0], t[1], rho);
+                        mu = std::max(mu, lfa_spectral_radius(q * s.power(nu)));
+                }
+        return pow(mu, 1.0 / nu);
+}
+
+double lfa_two_grid_factor(const LFAOptions& opts) {
+        double rho = opts.smoother == LFA_CHEBYSHEV ? lfa_jacobi_radius(opts) : 0.0;
+        double out = 0.0;
+        for (int i = 0; i < opts.resolution; ++i)
+                for (int j = 0; j < opts.resolution; ++j) {
+                        double t[2];
+                        if (!lfa_frequency(t, opts, i, j)) continue;
+                        LFAMatrix s = lfa_smoother_symbol(opts, t[0], t[1], rho);
+                        LFAMatrix m = s.power(opts.post) *
+                                      lfa_coarse_correction(opts, t[0], t[1]) *
+                                      s.power(opts.pre);
+                        out = std::max(out, lfa_spectral_radius(m));
+                }
+        return out;
+}
+
+// Two-grid factor per unit of work, counting one unit per sweep and one for
+// the residual and the transfers
+double lfa_factor_per_work(const LFAOptions& opts) {
+        return pow(lfa_two_grid_factor(opts), 1.0 / (opts.pre + opts.post + 1));
+}
+
+// Damping of Jacobi in [lo, hi] with the smallest two-grid factor
+double lfa_best_omega(LFAOptions opts, const double lo=0.5, const double hi=1.2,
+                      const int steps=70) {
+        opts.smoother = LFA_JACOBI;
+        double best = lo, best_rho = HUGE_VAL;
+        for (int k = 0; k <= steps; ++k) {
+                opts.omega = lo + (hi - lo) * k / steps;
+                double rho = lfa_two_grid_factor(opts);
+                if (rho < best_rho) {
+                        best = opts.omega;
+                        best_rho = rho;
+                }
+        }
+        return best;
+}
+
+// Sweeps nu = pre = post (1 .. max_sweeps) with the smallest factor per work
+int lfa_best_sweeps(LFAOptions opts, const int max_sweeps=4) {
+        int best = 1;
+        double best_factor = HUGE_VAL;
+        for (int nu = 1; nu <= max_sweeps; ++nu) {
+                opts.pre = opts.post = nu;
+                double factor = lfa_factor_per_work(opts);
+                if (factor < best_factor) {
+                        best = nu;
+                        best_factor = factor;
+                }
+        }
+        return best;
+}
+
+// Table of the predicted factors for several sweep counts
+void lfa_report(FILE *out, LFAOptions opts) {
+        const int sweeps[6][2] = {{1, 0}, {1, 1}, {2, 1}, {2, 2}, {3, 3}, {4, 4}};
+        fprintf(out, "LFA: %s \n", opts.name());
+        fprintf(out, "Sweeps \t Smoothing \t Two-grid \t Per work unit \n");
+        for (int k = 0; k < 6; ++k) {
+                opts.pre = sweeps[k][0];
+                opts.post = sweeps[k][1];
+                double rho = lfa_two_grid_factor(opts);
+                fprintf(out, "(%d,%d) \t %-8.4f \t %-8.4f \t %-8.4f \n", opts.pre, opts.post,
+                        lfa_smoothing_factor(opts), rho,
+                        pow(rho, 1.0 / (opts.pre + opts.post + 1)));
+        }
+}
+
+// Options for the smoothers and transfer operators of `Multigrid`
+void lfa_set(LFAOptions& opts, const GaussSeidel& s) { opts.smoother = LFA_GAUSS_SEIDEL; }
+void lfa_set(LFAOptions& opts, const GaussSeidelRedBlack& s) { opts.smoother = LFA_RED_BLACK; }
+void lfa_set(LFAOptions& opts, const GaussSeidelRedBlackResidual& s) {
+        opts.smoother = LFA_RED_BLACK;
+}
+void lfa_set(LFAOptions& opts, const Jacobi& s) {
+        opts.smoother = LFA_JACOBI;
+        opts.omega = s.omega;
+}
+void lfa_set(LFAOptions& opts, const FullWeighting& r) { opts.restriction = LFA_FULL_WEIGHTING; }
+void lfa_set(LFAOptions& opts, const HalfWeighting& r) { opts.restriction = LFA_HALF_WEIGHTING; }
+void lfa_set(LFAOptions& opts, const Injection& r) {
+        opts.restriction = LFA_INJECTION;
+        opts.injection_weight = r.weight;
+}
+void lfa_set(LFAOptions& opts, const Bilinear& p) { opts.prolongation = LFA_BILINEAR; }
+void lfa_set(LFAOptions& opts, const Cubic& p) { opts.prolongation = LFA_CUBIC; }
+
+template <typename F, typename X=Transfer<>>
+LFAOptions lfa_options(const CycleOptions& cycle=CycleOptions()) {
+        LFAOptions opts;
+        F smoother;
+        X transfer;
+        lfa_set(opts, smoother);
+        lfa_set(opts, transfer.restriction);
+        lfa_set(opts, transfer.prolongation);
+        opts.pre = cycle.pre;
+        opts.post = cycle.post;
+        return opts;
+}
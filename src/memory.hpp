@@ -0,0 +1,497 @@
+#pragma once
+#include <dirent.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+// NUMA-aware allocation of grids. Memory is mapped but not touched by the
+// allocating thread. Pages are then placed by the first thread that touches
+// them, using the same static row decomposition as the OpenMP kernels, or
+// interleaved across all nodes.
+//
+// Large allocations can be backed by huge pages, either transparent huge pages
+// (madvise) or explicit pages from the hugetlbfs pool. If the pool is empty,
+// the allocation falls back to transparent huge pages.
+//
+// The bytes mapped by memory_alloc are accounted per category (problem grids,
+// multigrid hierarchies, scratch, ...), with the current and the peak use of
+// each category and of all of them. Structures that are not allocated with
+// memory_alloc (e.g., the std::vector matrices of AMG) report their bytes with
+// memory_account.
+
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+enum memory_placement {
+        // Touched by the calling thread (what malloc + memset does)
+        SERIAL,
+        // Touched in parallel, matching the kernel decomposition
+        FIRST_TOUCH,
+        // Interleaved across all NUMA nodes
+        INTERLEAVE
+};
+
+enum pinning_policy {
+        NO_PINNING,
+        // Fill the cores of one node before moving to the next
+        COMPACT,
+        // Distribute the threads round-robin over the nodes
+        SCATTER
+};
+
+enum memory_pages {
+        SMALL_PAGES,
+        // Transparent huge pages, 2 MB
+        TRANSPARENT_HUGE_PAGES,
+        // Explicit huge pages, require a reserved hugetlbfs pool
+        HUGE_PAGES_2MB,
+        HUGE_PAGES_1GB
+};
+
+class MemoryOptions {
+        public:
+                memory_placement placement = FIRST_TOUCH;
+                memory_pages pages = SMALL_PAGES;
+};
+
+MemoryOptions memory_options;
+
+enum memory_category {
+        // Solution, right-hand side and residual of problems
+        MEMORY_PROBLEM,
+        // Coarse grids of multigrid solvers (geometric and algebraic)
+        MEMORY_HIERARCHY,
+        // Temporary grids of solvers and kernels
+        MEMORY_SCRATCH,
+        // Grids kept per problem size by services
+        MEMORY_PLAN,
+        // Vectors of Krylov methods
+        MEMORY_KRYLOV,
+        MEMORY_OTHER,
+        MEMORY_NUM_CATEGORIES
+};
+
+const char *memory_category_name(const int category) {
+        switch (category) {
+                case MEMORY_PROBLEM: return "problem";
+                case MEMORY_HIERARCHY: return "hierarchy";
+                case MEMORY_SCRATCH: return "scratch";
+                case MEMORY_PLAN: return "plans";
+                case MEMORY_KRYLOV: return "krylov";
+                case MEMORY_OTHER: return "other";
+        }
+        return "";
+}
+
+// Bytes in use per category and in total, and their peaks since the start or
+// the last memory_reset_peak
+class MemoryUsage {
+        public:
+                size_t current[MEMORY_NUM_CATEGORIES] = {0};
+                size_t peak[MEMORY_NUM_CATEGORIES] = {0};
+                size_t total = 0;
+                size_t total_peak = 0;
+};
+
+// Start, size, page size and category of each mapping, used to unmap and for
+// reporting
+struct MemoryMapping {
+        void *base;
+        size_t num_bytes;
+        memory_pages pages;
+        memory_category category;
+};
+
+std::map<void*, MemoryMapping> memory_mappings;
+MemoryUsage memory_counters;
+std::mutex memory_mutex;
+
+// Requires memory_mutex
+void memory_count(const memory_category category, const long long num_bytes) {
+        MemoryUsage& c = memory_counters;
+        c.current[category] += num_bytes;
+        c.total += num_bytes;
+        c.peak[category] = std::max(c.peak[category], c.current[category]);
+        c.total_peak = std::max(c.total_peak, c.total);
+}
+
+// Adds (num_bytes > 0) or removes (num_bytes < 0) bytes that are not mapped
+// by memory_alloc
+void memory_account(const memory_category category, const long long num_bytes) {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        memory_count(category, num_bytes);
+}
+
+MemoryUsage memory_usage(void) {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        return memory_counters;
+}
+
+// Peaks restart from the current use
+void memory_reset_peak(void) {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        MemoryUsage& c = memory_counters;
+        for (int k = 0; k < MEMORY_NUM_CATEGORIES; ++k)
+                c.peak[k] = c.current[k];
+        c.total_peak = c.total;
+}
+
+// Current and peak use of each category, also per unknown if num_unknowns > 0
+void memory_usage_report(FILE *out, const MemoryUsage& usage, const size_t num_unknowns=0) {
+        double m = num_unknowns > 0 ? 1.0 / num_unknowns : 0.0;
+        fprintf(out, "Category \t Current (bytes) \t Peak (bytes) \t Current per unknown \n");
+        for (int k = 0; k <= MEMORY_NUM_CATEGORIES; ++k) {
+                bool total = k == MEMORY_NUM_CATEGORIES;
+                size_t current = total ? usage.total : usage.current[k];
+                size_t peak = total ? usage.total_peak : usage.peak[k];
+                if (!total && peak == 0) continue;
+                fprintf(out, "%-9s \t %-15zu \t %-12zu \t %-8.2f \n",
+                        total ? "total" : memory_category_name(k), current, peak, m * current);
+        }
+}
+
+size_t memory_page_bytes(const memory_pages pages) {
+        switch (pages) {
+                case SMALL_PAGES: return sysconf(_SC_PAGESIZE);
+                case TRANSPARENT_HUGE_PAGES: return 1ul << 21;
+                case HUGE_PAGES_2MB: return 1ul << 21;
+                case HUGE_PAGES_1GB: return 1ul << 30;
+        }
+        return sysconf(_SC_PAGESIZE);
+}
+
+const char *memory_pages_name(const memory_pages pages) {
+        switch (pages) {
+                case SMALL_PAGES: return "small pages";
+                case TRANSPARENT_HUGE_PAGES: return "transparent huge pages";
+                case HUGE_PAGES_2MB: return "huge pages (2 MB)";
+                case HUGE_PAGES_1GB: return "huge pages (1 GB)";
+        }
+        return "";
+}
+
+// CPUs of each NUMA node, in node order
+std::vector<std::vector<int>> numa_nodes(void) {
+        std::vector<std::vector<int>> nodes;
+        DIR *dir = opendir("/sys/devices/system/node");
+        std::vector<int> ids;
+        if (dir != nullptr) {
+                struct dirent *entry;
+                while ((entry = readdir(dir)) != nullptr) {
+                        int id;
+                        if (sscanf(entry->d_name, "node%d", &id) == 1)
+                                ids.push_back(id);
+                }
+                closedir(dir);
+        }
+        std::sort(ids.begin(), ids.end());
+
+        for (size_t k = 0; k < ids.size(); ++k) {
+                char path[256];
+                sprintf(path, "/sys/devices/system/node/node%d/cpulist", ids[k]);
+                FILE *fh = fopen(path, "r");
+                std::vector<int> cpus;
+                if (fh != nullptr) {
+                        int a, b;
+                        char sep;
+                        while (fscanf(fh, "%d", &a) == 1) {
+                                b = a;
+                                if (fscanf(fh, "%c", &sep) == 1 && sep == '-') {
+                                        if (fscanf(fh, "%d", &b) != 1) b = a;
+                                        if (fscanf(fh, "%c", &sep) != 1) sep = 0;
+                                }
+                                for (int c = a; c <= b; ++c)
+                                        cpus.push_back(c);
+                                if (sep != ',') break;
+                        }
+                        fclose(fh);
+                }
+                nodes.push_back(cpus);
+        }
+
+        // No NUMA information: a single node with all CPUs
+        if (nodes.empty()) {
+                std::vector<int> cpus;
+                long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+                for (int c = 0; c < num_cpus; ++c)
+                        cpus.push_back(c);
+                nodes.push_back(cpus);
+        }
+        return nodes;
+}
+
+// Node that each CPU belongs to
+int numa_node_of_cpu(const std::vector<std::vector<int>>& nodes, const int cpu) {
+        for (size_t k = 0; k < nodes.size(); ++k)
+                for (size_t c = 0; c < nodes[k].size(); ++c)
+                        if (nodes[k][c] == cpu) return (int)k;
+        return -1;
+}
+
+// Pin each OpenMP thread to a CPU. Only CPUs in the current affinity mask are
+// used. Returns the CPU of each thread.
+std::vector<int> pin_threads(const pinning_policy policy) {
+        int num_threads = omp_get_max_threads();
+        std::vector<int> cpus(num_threads, -1);
+        if (policy == NO_PINNING) return cpus;
+
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        std::vector<std::vector<int>> nodes = numa_nodes();
+        std::vector<std::vector<int>> avail(nodes.size());
+        for (size_t k = 0; k < nodes.size(); ++k)
+                for (size_t c = 0; c < nodes[k].size(); ++c)
+                        if (CPU_ISSET(nodes[k][c], &allowed))
+                                avail[k].push_back(nodes[k][c]);
+
+        std::vector<int> order;
+        if (policy == COMPACT) {
+                for (size_t k = 0; k < avail.size(); ++k)
+                        order.insert(order.end(), avail[k].begin(), avail[k].end());
+        } else {
+                for (size_t c = 0; ; ++c) {
+                        bool any = false;
+                        for (size_t k = 0; k < avail.size(); ++k) {
+                                if (c >= avail[k].size()) continue;
+                                order.push_back(avail[k][c]);
+                                any = true;
+                        }
+                        if (!any) break;
+                }
+        }
+        if (order.empty()) return cpus;
+
+        #pragma omp parallel
+        {
+                int t = omp_get_thread_num();
+                int cpu = order[t % order.size()];
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                if (sched_setaffinity(0, sizeof(set), &set) == 0)
+                        cpus[t] = cpu;
+        }
+        return cpus;
+}
+
+// Zero an nx x ny grid using the same static row decomposition as the kernels
+template <typename T>
+void grid_first_touch(T *x, const int nx, const int ny) {
+        #pragma omp parallel
+        {
+                #pragma omp for schedule(static)
+                for (int i = 1; i < ny - 1; ++i)
+                        memset(&x[i * nx], 0, sizeof(T) * nx);
+                if (omp_get_thread_num() == 0)
+                        memset(x, 0, sizeof(T) * nx);
+                if (omp_get_thread_num() == omp_get_num_threads() - 1)
+                        memset(&x[(ny - 1) * nx], 0, sizeof(T) * nx);
+        }
+}
+
+size_t memory_round_up(const size_t num_bytes, const size_t page) {
+        return (num_bytes + page - 1) / page * page;
+}
+
+// Map `num_bytes` aligned to `page` and advise the kernel to back it with
+// transparent huge pages
+void *memory_map_transparent(const size_t num_bytes, const size_t page) {
+        size_t len = num_bytes + page;
+        char *ptr = (char*)mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) return MAP_FAILED;
+        char *begin = (char*)memory_round_up((size_t)ptr, page);
+        if (begin > ptr) munmap(ptr, begin - ptr);
+        size_t tail = ptr + len - (begin + num_bytes);
+        if (tail > 0) munmap(begin + num_bytes, tail);
+        madvise(begin, num_bytes, MADV_HUGEPAGE);
+        return begin;
+}
+
+void *memory_alloc(const size_t num_bytes,
+                   const memory_category category=MEMORY_OTHER) {
+        // Huge pages are only used for allocations of at least one huge page
+        memory_pages pages = memory_options.pages;
+        if (num_bytes < memory_page_bytes(pages)) pages = SMALL_PAGES;
+
+        // Huge page mappings are aligned to the huge page size, so all grids
+        // would map to the same cache sets and 4K alias each other. The
+        // returned pointer is staggered by a different number of cache lines
+        // for each allocation.
+        static std::atomic<int> count(0);
+        size_t offset = pages == SMALL_PAGES ? 0 : 64 * (1 + count++ % 63);
+
+        void *ptr = MAP_FAILED;
+        size_t len = num_bytes + offset;
+        if (pages == HUGE_PAGES_2MB || pages == HUGE_PAGES_1GB) {
+                int shift = pages == HUGE_PAGES_2MB ? 21 : 30;
+                len = memory_round_up(num_bytes + offset, memory_page_bytes(pages));
+                ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+                           (shift << MAP_HUGE_SHIFT), -1, 0);
+                if (ptr == MAP_FAILED) {
+                        static bool warned = false;
+                        if (!warned)
+                                fprintf(stderr, "memory_alloc: no %s available, "
+                                        "using transparent huge pages.\n",
+                                        memory_pages_name(pages));
+                        warned = true;
+                        pages = TRANSPARENT_HUGE_PAGES;
+                }
+        }
+        if (pages == TRANSPARENT_HUGE_PAGES) {
+                len = memory_round_up(num_bytes + offset, memory_page_bytes(pages));
+                ptr = memory_map_transparent(len, memory_page_bytes(pages));
+        }
+        if (pages == SMALL_PAGES) {
+                len = num_bytes;
+                ptr = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        if (ptr == MAP_FAILED) {
+                fprintf(stderr, "memory_alloc: failed to map %zu bytes.\n", num_bytes);
+                exit(EXIT_FAILURE);
+        }
+
+#ifdef SYS_mbind
+        if (memory_options.placement == INTERLEAVE) {
+                size_t num_nodes = numa_nodes().size();
+                std::vector<unsigned long> mask(num_nodes / (8 * sizeof(long)) + 1, 0);
+                for (size_t k = 0; k < num_nodes; ++k)
+                        mask[k / (8 * sizeof(long))] |= 1ul << (k % (8 * sizeof(long)));
+                syscall(SYS_mbind, ptr, len, MPOL_INTERLEAVE, mask.data(),
+                        mask.size() * 8 * sizeof(long), 0);
+        }
+#endif
+        void *out = (char*)ptr + offset;
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        memory_mappings[out] = {ptr, len, pages, category};
+        memory_count(category, len);
+        return out;
+}
+
+void memory_free(void *ptr, const size_t num_bytes) {
+        if (ptr == nullptr) return;
+        void *base = ptr;
+        size_t len = num_bytes;
+        {
+                std::lock_guard<std::mutex> lock(memory_mutex);
+                auto it = memory_mappings.find(ptr);
+                if (it != memory_mappings.end()) {
+                        base = it->second.base;
+                        len = it->second.num_bytes;
+                        memory_count(it->second.category, -(long long)len);
+                        memory_mappings.erase(it);
+                }
+        }
+        munmap(base, len);
+}
+
+// Page size that an allocation was mapped with
+memory_pages memory_pages_of(const void *ptr) {
+        std::lock_guard<std::mutex> lock(memory_mutex);
+        auto it = memory_mappings.find((void*)ptr);
+        return it == memory_mappings.end() ? SMALL_PAGES : it->second.pages;
+}
+
+// Number of bytes of the mapping that contains ptr that are backed by
+// transparent huge pages (AnonHugePages in /proc/self/smaps)
+size_t memory_transparent_bytes(const void *ptr) {
+        FILE *fh = fopen("/proc/self/smaps", "r");
+        if (fh == nullptr) return 0;
+        char line[512];
+        bool found = false;
+        size_t out = 0;
+        while (fgets(line, sizeof(line), fh) != nullptr) {
+                size_t begin, end;
+                if (sscanf(line, "%zx-%zx ", &begin, &end) == 2) {
+                        if (found) break;
+                        found = (size_t)ptr >= begin && (size_t)ptr < end;
+                        continue;
+                }
+                size_t kb;
+                if (found && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1)
+                        out = kb * 1024;
+        }
+        fclose(fh);
+        return out;
+}
+
+// Allocate and zero an nx x ny grid according to `memory_options.placement`
+template <typename T>
+T *grid_alloc(const int nx, const int ny, const memory_category category=MEMORY_OTHER) {
+        size_t num_bytes = sizeof(T) * nx * ny;
+        T *x = (T*)memory_alloc(num_bytes, category);
+        if (memory_options.placement == SERIAL)
+                memset(x, 0, num_bytes);
+        else
+                grid_first_touch(x, nx, ny);
+        return x;
+}
+
+template <typename T>
+void grid_free(T *x, const int nx, const int ny) {
+        memory_free(x, sizeof(T) * nx * ny);
+}
+
+// Number of pages of [ptr, ptr + num_bytes) that reside on each NUMA node.
+// Pages that have not been touched are not counted.
+std::vector<size_t> memory_pages_per_node(const void *ptr, const size_t num_bytes) {
+        std::vector<size_t> count(numa_nodes().size(), 0);
+#ifdef SYS_move_pages
+        size_t page = sysconf(_SC_PAGESIZE);
+        char *begin = (char*)((size_t)ptr / page * page);
+        size_t num_pages = ((char*)ptr + num_bytes - begin + page - 1) / page;
+        const size_t batch = 4096;
+        std::vector<void*> pages(batch);
+        std::vector<int> status(batch);
+        for (size_t p = 0; p < num_pages; p += batch) {
+                size_t m = std::min(batch, num_pages - p);
+                for (size_t k = 0; k < m; ++k)
+                        pages[k] = begin + (p + k) * page;
+                if (syscall(SYS_move_pages, 0, m, pages.data(), nullptr,
+                            status.data(), 0) != 0)
+                        break;
+                for (size_t k = 0; k < m; ++k)
+                        if (status[k] >= 0 && status[k] < (int)count.size())
+                                count[status[k]]++;
+        }
+#endif
+        return count;
+}
+
+void memory_placement_report(const char *label, const void *ptr,
+                             const size_t num_bytes) {
+        std::vector<size_t> count = memory_pages_per_node(ptr, num_bytes);
+        size_t total = 0;
+        for (size_t k = 0; k < count.size(); ++k)
+                total += count[k];
+        printf("%-8s", label);
+        for (size_t k = 0; k < count.size(); ++k)
+                printf(" \t node %zu: %5.1f%%", k,
+                       total > 0 ? 100.0 * count[k] / total : 0.0);
+        printf("\n");
+}
@@ -0,0 +1,568 @@
+#pragma once
+#include <mpi.h>
+#include <poisson.hpp>
+#include <type_traits>
+#include <vector>
+// Distributed memory Poisson problem and multigrid solver. The grid is split
+// into a 2D process grid of blocks. Each block is stored with a one point wide
+// halo. Smoothing and residual computations post nonblocking halo exchanges
+// and work on the interior of the block while the messages are in flight.
+//
+// The levels are decomposed using the partition of level kd scaled by powers of
+// two. Coarser levels are agglomerated: the coarse grid problem is gathered on
+// every rank and solved redundantly by `multigrid_v_cycle`, which ends in the
+// direct solve on the coarsest grid. The replicated solve avoids a broadcast of
+// the correction.
+//
+// All kernels are pointwise and the iterates are identical to the ones of the
+// serial solver. In deterministic mode, the norms are also computed in the
+// same order as in the serial code.
+//
+// Each rank counts the work of its own blocks and of the replicated coarse
+// grid solve, and its work units are relative to a sweep over its block.
+
+template <typename T>
+MPI_Datatype mpi_type(void);
+
+template <>
+MPI_Datatype mpi_type<double>(void) { return MPI_DOUBLE; }
+
+template <>
+MPI_Datatype mpi_type<float>(void) { return MPI_FLOAT; }
+
+// Points [i0, i1) x [j0, j1) of an n x n grid, stored with a halo of width one
+template <typename T>
+struct MPIBlock {
+        int i0 = 0, i1 = 0, j0 = 0, j1 = 0, ld = 0;
+        T *x = 0;
+
+        size_t num_bytes(void) const { return sizeof(T) * (i1 - i0 + 2) * ld; }
+
+        void allocate(const int i0_, const int i1_, const int j0_, const int j1_,
+                      const memory_category category=MEMORY_OTHER) {
+                i0 = i0_;
+                i1 = i1_;
+                j0 = j0_;
+                j1 = j1_;
+                ld = j1 - j0 + 2;
+                x = (T*)memory_alloc(num_bytes(), category);
+                zero();
+        }
+
+        void release(void) {
+                if (x != nullptr) memory_free(x, num_bytes());
+                x = 0;
+        }
+
+        void zero(void) {
+                memset(x, 0, num_bytes());
+        }
+
+        T& operator()(const int i, const int j) {
+                return x[(i - i0 + 1) * ld + j - j0 + 1];
+        }
+
+        const T& operator()(const int i, const int j) const {
+                return x[(i - i0 + 1) * ld + j - j0 + 1];
+        }
+};
+
+// Calls kernel(ib, ie, jb, je) for the points of the block that are next to
+// the halo, without visiting any point twice
+template <typename K>
+void mpi_block_boundary(const int i0, const int i1, const int j0, const int j1,
+                        K kernel) {
+        kernel(i0, i0 + 1, j0, j1);
+        if (i1 - 1 > i0) kernel(i1 - 1, i1, j0, j1);
+        kernel(i0 + 1, i1 - 1, j0, j0 + 1);
+        if (j1 - 1 > j0) kernel(i0 + 1, i1 - 1, j1 - 1, j1);
+}
+
+template <typename T>
+void mpi_gauss_seidel(MPIBlock<T>& u, const MPIBlock<T>& f, const int n,
+                      const T h, const int color, const int ib, const int ie,
+                      const int jb, const int je) {
+        int rows = std::min(ie, n - 1) - std::max(ib, 1);
+        int cols = std::min(je, n - 1) - std::max(jb, 1);
+        if (rows > 0 && cols > 0) {
+                double block = (double)(std::min(u.i1, n - 1) - std::max(u.i0, 1)) *
+                               (std::min(u.j1, n - 1) - std::max(u.j0, 1));
+                work_count(WORK_SMOOTH, 0.5 * rows * cols, 6, 6 * sizeof(T), block);
+        }
+        int ld = u.ld;
+        for (int i = std::max(ib, 1); i < std::min(ie, n - 1); ++i) {
+                int js = std::max(jb, 1);
+                if ((i + js) % 2 != color) js++;
+                for (int j = js; j < std::min(je, n - 1); j += 2) {
+                        T *p = &u(i, j);
+                        p[0] = -0.25 * (h * h * f(i, j) - p[1] - p[-1] - p[ld] -
+                                        p[-ld]);
+                }
+        }
+}
+
+// Red points from a zero initial guess, as in `gauss_seidel_red_black_zero`.
+// Does not read u, so no halo is needed.
+template <typename T>
+void mpi_gauss_seidel_zero(MPIBlock<T>& u, const MPIBlock<T>& f, const int n,
+                           const T h) {
+        int rows = std::min(u.i1, n - 1) - std::max(u.i0, 1);
+        int cols = std::min(u.j1, n - 1) - std::max(u.j0, 1);
+        if (rows > 0 && cols > 0)
+                work_count(WORK_SMOOTH, 0.5 * rows * cols, 2, 4 * sizeof(T),
+                           (double)rows * cols);
+        for (int i = std::max(u.i0, 1); i < std::min(u.i1, n - 1); ++i) {
+                int js = std::max(u.j0, 1);
+                if ((i + js) % 2 != 0) js++;
+                for (int j = js; j < std::min(u.j1, n - 1); j += 2)
+                        u(i, j) = -0.25 * (h * h * f(i, j));
+        }
+}
+
+template <typename T>
+void mpi_residual(MPIBlock<T>& r, const MPIBlock<T>& u, const MPIBlock<T>& f,
+                  const int n, const T h, const int ib, const int ie,
+                  const int jb, const int je) {
+        int rows = std::min(ie, n - 1) - std::max(ib, 1);
+        int cols = std::min(je, n - 1) - std::max(jb, 1);
+        if (rows > 0 && cols > 0)
+                work_count(WORK_RESIDUAL, (double)rows * cols, 7, 3 * sizeof(T));
+        int ld = u.ld;
+        T hi2 = 1.0 / (h * h);
+        for (int i = std::max(ib, 1); i < std::min(ie, n - 1); ++i) {
+                for (int j = std::max(jb, 1); j < std::min(je, n - 1); ++j) {
+                        const T *p = &u(i, j);
+                        r(i, j) = f(i, j) - (p[1] + p[-1] + -4.0 * p[0] + p[ld] +
+                                             p[-ld]) * hi2;
+                }
+        }
+}
+
+// Restricts the coarse points [ib, ie) x [jb, je)
+template <typename T>
+void mpi_restrict(MPIBlock<T>& yc, const int nc, const MPIBlock<T>& xf,
+                  const int ib, const int ie, const int jb, const int je) {
+        int rows = std::min(ie, nc - 1) - std::max(ib, 1);
+        int cols = std::min(je, nc - 1) - std::max(jb, 1);
+        if (rows > 0 && cols > 0)
+                work_count(WORK_RESTRICT, (double)rows * cols, 20, 5 * sizeof(T));
+        const T c0 = 0.25;
+        const T c1 = 0.5;
+        for (int i = std::max(ib, 1); i < std::min(ie, nc - 1); ++i) {
+                for (int j = std::max(jb, 1); j < std::min(je, nc - 1); ++j) {
+                        yc(i, j) = c0 * c0 * xf(2 * i - 1, 2 * j - 1) +
+                                   c0 * c1 * xf(2 * i - 1, 2 * j) +
+                                   c0 * c0 * xf(2 * i - 1, 2 * j + 1) +
+                                   c1 * c0 * xf(2 * i, 2 * j - 1) +
+                                   c1 * c1 * xf(2 * i, 2 * j) +
+                                   c1 * c0 * xf(2 * i, 2 * j + 1) +
+                                   c0 * c0 * xf(2 * i + 1, 2 * j - 1) +
+                                   c0 * c1 * xf(2 * i + 1, 2 * j) +
+                                   c0 * c0 * xf(2 * i + 1, 2 * j + 1);
+                }
+        }
+}
+
+// Prolongates and adds the correction to all points of the fine block
+template <typename T>
+void mpi_prolongate(MPIBlock<T>& yf, const MPIBlock<T>& xc) {
+        work_count(WORK_PROLONGATE, (double)(yf.i1 - yf.i0) * (yf.j1 - yf.j0), 5,
+                   2.25 * sizeof(T));
+        const T a = 1.0;
+        const T b = 1.0;
+        for (int i = yf.i0; i < yf.i1; ++i) {
+                for (int j = yf.j0; j < yf.j1; ++j) {
+                        int ic = i / 2, jc = j / 2;
+                        T& y = yf(i, j);
+                        if (i % 2 == 0 && j % 2 == 0)
+                                y = a * y + b * xc(ic, jc);
+                        else if (i % 2 == 0)
+                                y = a * y + 0.5 * b * (xc(ic, jc) + xc(ic, jc + 1));
+                        else if (j % 2 == 0)
+                                y = a * y + 0.5 * b * (xc(ic, jc) + xc(ic + 1, jc));
+                        else
+                                y = +a * y + 0.25 * b *
+                                    (xc(ic, jc) + xc(ic + 1, jc) +
+                                     xc(ic, jc + 1) + xc(ic + 1, jc + 1));
+                }
+        }
+}
+
+template <typename T>
+class MPIPoisson {
+        public:
+                int n;
+                int l;
+                T h;
+                T modes;
+                MPI_Comm comm;
+                int rank, size;
+                // Process grid: py x px, this rank is at (pi, pj)
+                int px, py, pi, pj;
+                int north, south, west, east;
+                // Levels kd..l are decomposed, the coarser ones are agglomerated
+                int kd;
+                std::vector<int> rbounds, cbounds;
+                // Compute the norms in the same order as the serial code
+                bool deterministic;
+                MPIBlock<T> u, f, r;
+
+        private:
+                MPI_Request requests[8];
+                T *send_west = 0, *send_east = 0, *recv_west = 0, *recv_east = 0;
+                size_t column_bytes = 0;
+
+                void pack(T *buf, const MPIBlock<T>& x, const int j, const int ib,
+                          const int ie) {
+                        for (int i = ib; i < ie; ++i)
+                                buf[i - ib] = x(i, j);
+                }
+
+                void unpack(MPIBlock<T>& x, const T *buf, const int j, const int ib,
+                            const int ie) {
+                        for (int i = ib; i < ie; ++i)
+                                x(i, j) = buf[i - ib];
+                }
+
+                void exchange_rows(MPIBlock<T>& x, const int jb, const int je,
+                                   MPI_Request *req) {
+                        MPI_Datatype type = mpi_type<T>();
+                        int count = je - jb;
+                        MPI_Irecv(&x(x.i0 - 1, jb), count, type, north, 1, comm, &req[0]);
+                        MPI_Irecv(&x(x.i1, jb), count, type, south, 0, comm, &req[1]);
+                        MPI_Isend(&x(x.i0, jb), count, type, north, 0, comm, &req[2]);
+                        MPI_Isend(&x(x.i1 - 1, jb), count, type, south, 1, comm, &req[3]);
+                }
+
+                void exchange_columns(MPIBlock<T>& x, MPI_Request *req) {
+                        MPI_Datatype type = mpi_type<T>();
+                        int count = x.i1 - x.i0;
+                        pack(send_west, x, x.j0, x.i0, x.i1);
+                        pack(send_east, x, x.j1 - 1, x.i0, x.i1);
+                        MPI_Irecv(recv_west, count, type, west, 3, comm, &req[0]);
+                        MPI_Irecv(recv_east, count, type, east, 2, comm, &req[1]);
+                        MPI_Isend(send_west, count, type, west, 2, comm, &req[2]);
+                        MPI_Isend(send_east, count, type, east, 3, comm, &req[3]);
+                }
+
+                void unpack_columns(MPIBlock<T>& x) {
+                        if (west != MPI_PROC_NULL)
+                                unpack(x, recv_west, x.j0 - 1, x.i0, x.i1);
+                        if (east != MPI_PROC_NULL)
+                                unpack(x, recv_east, x.j1, x.i0, x.i1);
+                }
+
+        public:
+
+        // Blocks are agglomerated once they have fewer than `min_size` rows or
+        // columns
+        MPIPoisson(int l, T h, T modes, const int min_size = 8,
+                   const bool deterministic = false, MPI_Comm comm = MPI_COMM_WORLD)
+            : l(l), h(h), modes(modes), comm(comm), deterministic(deterministic) {
+                assert(l > 1);
+                n = (1 << l) + 1;
+                MPI_Comm_rank(comm, &rank);
+                MPI_Comm_size(comm, &size);
+                int dims[2] = {0, 0};
+                MPI_Dims_create(size, 2, dims);
+                py = dims[0];
+                px = dims[1];
+                pi = rank / px;
+                pj = rank % px;
+                if (n < 2 * std::max(px, py)) {
+                        fprintf(stderr, "MPIPoisson: grid too small for %d x %d ranks.\n",
+                                py, px);
+                        MPI_Abort(comm, EXIT_FAILURE);
+                }
+                north = pi > 0 ? rank - px : MPI_PROC_NULL;
+                south = pi < py - 1 ? rank + px : MPI_PROC_NULL;
+                west = pj > 0 ? rank - 1 : MPI_PROC_NULL;
+                east = pj < px - 1 ? rank + 1 : MPI_PROC_NULL;
+
+                int pmax = std::max(px, py);
+                kd = 2;
+                while (kd < l && (1 << kd) + 1 < pmax * min_size) kd++;
+                int nd = (1 << kd) + 1;
+                rbounds.resize(py + 1);
+                cbounds.resize(px + 1);
+                for (int t = 0; t <= py; ++t)
+                        rbounds[t] = (int)((long)nd * t / py);
+                for (int t = 0; t <= px; ++t)
+                        cbounds[t] = (int)((long)nd * t / px);
+
+                int b[4];
+                range(rank, l, b);
+                u.allocate(b[0], b[1], b[2], b[3], MEMORY_PROBLEM);
+                f.allocate(b[0], b[1], b[2], b[3], MEMORY_PROBLEM);
+                r.allocate(b[0], b[1], b[2], b[3], MEMORY_PROBLEM);
+
+                T s = 2.0 * M_PI * modes / (h * (n - 1));
+                for (int i = u.i0; i < u.i1; ++i)
+                        for (int j = u.j0; j < u.j1; ++j)
+                                f(i, j) = -2 * s * s * sin(s * h * i) * sin(s * h * j);
+
+                column_bytes = sizeof(T) * (u.i1 - u.i0 + 2);
+                send_west = (T*)memory_alloc(column_bytes, MEMORY_SCRATCH);
+                send_east = (T*)memory_alloc(column_bytes, MEMORY_SCRATCH);
+                recv_west = (T*)memory_alloc(column_bytes, MEMORY_SCRATCH);
+                recv_east = (T*)memory_alloc(column_bytes, MEMORY_SCRATCH);
+        }
+
+        // Points [b[0], b[1]) x [b[2], b[3]) of the block owned by `rank` on
+        // level k >= kd
+        void range(const int rank, const int k, int *b) const {
+                int ti = rank / px, tj = rank % px;
+                int nk = (1 << k) + 1;
+                b[0] = ti == 0 ? 0 : rbounds[ti] << (k - kd);
+                b[1] = ti == py - 1 ? nk : rbounds[ti + 1] << (k - kd);
+                b[2] = tj == 0 ? 0 : cbounds[tj] << (k - kd);
+                b[3] = tj == px - 1 ? nk : cbounds[tj + 1] << (k - kd);
+        }
+
+        // Coarse points whose restriction stencil is centered in the block
+        // owned by `rank` on level k
+        void coarse_range(const int rank, const int k, int *b) const {
+                range(rank, k, b);
+                for (int i = 0; i < 4; ++i)
+                        b[i] = (b[i] + 1) / 2;
+        }
+
+        // Post the exchange of the edges of the block
+        void begin(MPIBlock<T>& x) {
+                exchange_rows(x, x.j0, x.j1, &requests[0]);
+                exchange_columns(x, &requests[4]);
+        }
+
+        void end(MPIBlock<T>& x) {
+                MPI_Waitall(8, requests, MPI_STATUSES_IGNORE);
+                unpack_columns(x);
+        }
+
+        // Exchange the edges and corners of the block
+        void exchange(MPIBlock<T>& x) {
+                exchange_columns(x, &requests[4]);
+                MPI_Waitall(4, &requests[4], MPI_STATUSES_IGNORE);
+                unpack_columns(x);
+                exchange_rows(x, x.j0 - 1, x.j1 + 1, &requests[0]);
+                MPI_Waitall(4, &requests[0], MPI_STATUSES_IGNORE);
+        }
+
+        // Gather the points in `x` owned by each rank according to `ranges`
+        // into the nk x nk grid `out`, on all ranks
+        template <typename R>
+        void allgather(T *out, const int nk, const MPIBlock<T>& x, R ranges) {
+                std::vector<int> counts(size), displs(size + 1);
+                int b[4];
+                displs[0] = 0;
+                for (int t = 0; t < size; ++t) {
+                        ranges(t, b);
+                        counts[t] = (b[1] - b[0]) * (b[3] - b[2]);
+                        displs[t + 1] = displs[t] + counts[t];
+                }
+                std::vector<T> sendbuf(counts[rank]), recvbuf(displs[size]);
+                ranges(rank, b);
+                for (int i = b[0]; i < b[1]; ++i)
+                        for (int j = b[2]; j < b[3]; ++j)
+                                sendbuf[(i - b[0]) * (b[3] - b[2]) + j - b[2]] = x(i, j);
+                MPI_Allgatherv(sendbuf.data(), counts[rank], mpi_type<T>(),
+                               recvbuf.data(), counts.data(), displs.data(),
+                               mpi_type<T>(), comm);
+                for (int t = 0; t < size; ++t) {
+                        ranges(t, b);
+                        for (int i = b[0]; i < b[1]; ++i)
+                                for (int j = b[2]; j < b[3]; ++j)
+                                        out[j + nk * i] = recvbuf[displs[t] +
+                                                (i - b[0]) * (b[3] - b[2]) + j - b[2]];
+                }
+        }
+
+        void gather(T *out, const MPIBlock<T>& x) {
+                allgather(out, n, x, [this](const int t, int *b) { range(t, l, b); });
+        }
+
+        void residual(void) {
+                auto kernel = [this](const int ib, const int ie, const int jb,
+                                     const int je) {
+                        mpi_residual(r, u, f, n, h, ib, ie, jb, je);
+                };
+                begin(u);
+                kernel(u.i0 + 1, u.i1 - 1, u.j0 + 1, u.j1 - 1);
+                end(u);
+                mpi_block_boundary(u.i0, u.i1, u.j0, u.j1, kernel);
+        }
+
+        // Sum of |x| * h^2 over all ranks
+        T l1norm(const MPIBlock<T>& x) {
+                if (deterministic) {
+                        T *y = grid_alloc<T>(n, n, MEMORY_SCRATCH);
+                        gather(y, x);
+                        T out = grid_l1norm(y, n, n, h, h);
+                        grid_free(y, n, n);
+                        return out;
+                }
+                double local = 0.0, out = 0.0;
+                for (int i = x.i0; i < x.i1; ++i)
+                        for (int j = x.j0; j < x.j1; ++j)
+                                local += fabs(x(i, j)) * h * h;
+                MPI_Allreduce(&local, &out, 1, MPI_DOUBLE, MPI_SUM, comm);
+                return out;
+        }
+
+        T norm(void) {
+                return l1norm(r);
+        }
+
+        T error(void) {
+                T *v = grid_alloc<T>(n, n, MEMORY_SCRATCH);
+                exact_solution(v, n, h, modes);
+                for (int i = r.i0; i < r.i1; ++i)
+                        for (int j = r.j0; j < r.j1; ++j)
+                                r(i, j) = u(i, j) - v[j + n * i];
+                grid_free(v, n, n);
+                return l1norm(r);
+        }
+
+        ~MPIPoisson() {
+                u.release();
+                f.release();
+                r.release();
+                memory_free(send_west, column_bytes);
+                memory_free(send_east, column_bytes);
+                memory_free(recv_west, column_bytes);
+                memory_free(recv_east, column_bytes);
+        }
+};
+
+// With `zero`, u is a zero initial guess and the red half-sweep needs no halo
+template <typename T>
+void mpi_smooth(MPIPoisson<T>& pr, MPIBlock<T>& u, const MPIBlock<T>& f,
+                const int n, const T h, const bool zero=false) {
+        if (zero)
+                mpi_gauss_seidel_zero(u, f, n, h);
+        for (int color = zero ? 1 : 0; color < 2; ++color) {
+                auto kernel = [&](const int ib, const int ie, const int jb,
+                                  const int je) {
+                        mpi_gauss_seidel(u, f, n, h, color, ib, ie, jb, je);
+                };
+                pr.begin(u);
+                kernel(u.i0 + 1, u.i1 - 1, u.j0 + 1, u.j1 - 1);
+                pr.end(u);
+                mpi_block_boundary(u.i0, u.i1, u.j0, u.j1, kernel);
+        }
+}
+
+template <typename F, typename P, typename T>
+class MPIMultigrid {
+        // The distributed levels always smooth with `mpi_smooth`
+        static_assert(std::is_same<F, GaussSeidelRedBlack>::value,
+                      "MPIMultigrid requires the GaussSeidelRedBlack smoother");
+        private:
+                // Decomposed levels kd..l
+                std::vector<MPIBlock<T>> e, rhs, res;
+                // Agglomerated coarse grid problem on level kd - 1, replicated
+                // on all ranks
+                MPIBlock<T> fb, eb;
+                T *ea = 0, *fa = 0, *v = 0, *w = 0, *r = 0;
+                int l, kd, na = 0;
+                size_t num_bytes = 0;
+                F smoother;
+
+                // With `zero`, u is a zero initial guess and is not read
+                void v_cycle(P& pr, const int k, MPIBlock<T>& u, MPIBlock<T>& f,
+                             const T h, const bool zero=false) {
+                        int nk = (1 << k) + 1;
+                        int nc = (1 << (k - 1)) + 1;
+                        MPIBlock<T>& rk = res[k];
+
+                        mpi_smooth(pr, u, f, nk, h, zero);
+
+                        auto kernel = [&](const int ib, const int ie, const int jb,
+                                          const int je) {
+                                mpi_residual(rk, u, f, nk, h, ib, ie, jb, je);
+                        };
+                        pr.begin(u);
+                        kernel(u.i0 + 1, u.i1 - 1, u.j0 + 1, u.j1 - 1);
+                        pr.end(u);
+                        mpi_block_boundary(u.i0, u.i1, u.j0, u.j1, kernel);
+
+                        pr.exchange(rk);
+                        int b[4];
+                        pr.coarse_range(pr.rank, k, b);
+
+                        if (k == kd) {
+                                mpi_restrict(fb, nc, rk, b[0], b[1], b[2], b[3]);
+                                pr.allgather(fa, nc, fb, [&](const int t, int *c) {
+                                        pr.coarse_range(t, k, c);
+                                });
+                                // The correction starts from zero
+                                multigrid_v_cycle<T, F>(k - 1, smoother, ea, fa, r,
+                                                        v, w, 2 * h, true);
+                                for (int i = 0; i < nc; ++i)
+                                        for (int j = 0; j < nc; ++j)
+                                                eb(i, j) = ea[j + nc * i];
+                                mpi_prolongate(u, eb);
+                        } else {
+                                mpi_restrict(rhs[k - 1], nc, rk, b[0], b[1], b[2], b[3]);
+                                // The correction starts from zero
+                                v_cycle(pr, k - 1, e[k - 1], rhs[k - 1], 2 * h, true);
+                                pr.exchange(e[k - 1]);
+                                mpi_prolongate(u, e[k - 1]);
+                        }
+
+                        mpi_smooth(pr, u, f, nk, h);
+                }
+
+        public:
+
+                MPIMultigrid() { }
+                MPIMultigrid(P& pr) : l(pr.l), kd(pr.kd) {
+                        e.resize(l + 1);
+                        rhs.resize(l + 1);
+                        res.resize(l + 1);
+                        int b[4];
+                        for (int k = kd; k <= l; ++k) {
+                                pr.range(pr.rank, k, b);
+                                res[k].allocate(b[0], b[1], b[2], b[3], MEMORY_SCRATCH);
+                                if (k == l) continue;
+                                e[k].allocate(b[0], b[1], b[2], b[3], MEMORY_HIERARCHY);
+                                rhs[k].allocate(b[0], b[1], b[2], b[3], MEMORY_HIERARCHY);
+                        }
+
+                        na = (1 << (kd - 1)) + 1;
+                        fb.allocate(0, na, 0, na, MEMORY_HIERARCHY);
+                        eb.allocate(0, na, 0, na, MEMORY_HIERARCHY);
+                        // The boundaries of the coarse grids stay zero
+                        num_bytes = multigrid_size(kd - 1) * sizeof(T);
+                        v = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        w = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        ea = grid_alloc<T>(na, na, MEMORY_HIERARCHY);
+                        fa = grid_alloc<T>(na, na, MEMORY_HIERARCHY);
+                        r = grid_alloc<T>(na, na, MEMORY_SCRATCH);
+                }
+
+                void operator()(P& pr) {
+                        v_cycle(pr, l, pr.u, pr.f, pr.h);
+                }
+
+                ~MPIMultigrid(void) {
+                        for (int k = kd; k <= l; ++k) {
+                                e[k].release();
+                                rhs[k].release();
+                                res[k].release();
+                        }
+                        fb.release();
+                        eb.release();
+                        memory_free(v, num_bytes);
+                        memory_free(w, num_bytes);
+                        if (ea != nullptr) grid_free(ea, na, na);
+                        if (fa != nullptr) grid_free(fa, na, na);
+                        if (r != nullptr) grid_free(r, na, na);
+                }
+
+                const char *name() {
+                        static char name[2048];
+                        sprintf(name, "MPI Multi-Grid<%s>", smoother.name());
+                        return name;
+                }
+
+};
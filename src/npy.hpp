@@ -0,0 +1,241 @@
+#pragma once
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <memory.hpp>
+// Memory-mapped NumPy (.npy) files. A 2D array of shape (ny, nx) is exposed as
+// an nx x ny grid. If the data type and memory order of the file match T, the
+// grid points directly into the mapping and no data is copied. Otherwise, the
+// data is converted (in parallel) into a grid, and converted back when the
+// array is synced or closed (if writable).
+//
+// Supported data types: little and big endian float32 and float64, C and
+// Fortran order.
+
+template <typename T>
+const char *npy_descr(void);
+template <> const char *npy_descr<float>(void) { return "<f4"; }
+template <> const char *npy_descr<double>(void) { return "<f8"; }
+
+struct NpyHeader {
+        std::string descr;
+        bool fortran_order = false;
+        int ny = 0, nx = 0;
+        // Offset of the data in bytes
+        size_t offset = 0;
+};
+
+// Parse the header at the beginning of a .npy file. Returns false on error.
+bool npy_parse_header(const char *data, const size_t size, NpyHeader& header) {
+        if (size < 10 || memcmp(data, "\x93NUMPY", 6) != 0) return false;
+        int major = (unsigned char)data[6];
+        size_t len, start;
+        if (major == 1) {
+                len = (unsigned char)data[8] | (unsigned char)data[9] << 8;
+                start = 10;
+        } else {
+                if (size < 12) return false;
+                len = (size_t)(unsigned char)data[8] |
+                      (size_t)(unsigned char)data[9] << 8 |
+                      (size_t)(unsigned char)data[10] << 16 |
+                      (size_t)(unsigned char)data[11] << 24;
+                start = 12;
+        }
+        if (start + len > size) return false;
+        std::string dict(data + start, len);
+        header.offset = start + len;
+
+        size_t pos = dict.find("'descr'");
+        if (pos == std::string::npos) return false;
+        size_t q0 = dict.find('\'', dict.find(':', pos) + 1);
+        size_t q1 = dict.find('\'', q0 + 1);
+        header.descr = dict.substr(q0 + 1, q1 - q0 - 1);
+
+        pos = dict.find("'fortran_order'");
+        if (pos == std::string::npos) return false;
+        header.fortran_order = dict.find("True", pos) ==
+                               dict.find_first_not_of(" :", pos + 15);
+
+        pos = dict.find("'shape'");
+        if (pos == std::string::npos) return false;
+        size_t p0 = dict.find('(', pos);
+        if (sscanf(dict.c_str() + p0, "(%d, %d)", &header.ny, &header.nx) != 2)
+                return false;
+        return true;
+}
+
+// Header (version 1.0) for an array of shape (ny, nx), padded to 64 bytes
+std::string npy_header(const char *descr, const int nx, const int ny) {
+        char dict[256];
+        sprintf(dict, "{'descr': '%s', 'fortran_order': False, 'shape': (%d, %d), }",
+                descr, ny, nx);
+        std::string out = std::string("\x93NUMPY\x01\x00", 8);
+        size_t len = strlen(dict) + 1;
+        size_t total = (10 + len + 63) / 64 * 64;
+        len = total - 10;
+        out += (char)(len & 0xff);
+        out += (char)(len >> 8);
+        out += dict;
+        out += std::string(total - out.size() - 1, ' ');
+        out += '\n';
+        return out;
+}
+
+template <typename T>
+__inline__ T npy_swap(T x) {
+        char *b = (char*)&x;
+        for (size_t k = 0; k < sizeof(T) / 2; ++k)
+                std::swap(b[k], b[sizeof(T) - 1 - k]);
+        return x;
+}
+
+template <typename S, typename T>
+__inline__ T npy_load(const char *src, const bool swap) {
+        S x;
+        memcpy(&x, src, sizeof(S));
+        return (T)(swap ? npy_swap(x) : x);
+}
+
+template <typename S, typename T>
+__inline__ void npy_store(char *dst, const T value, const bool swap) {
+        S x = (S)value;
+        if (swap) x = npy_swap(x);
+        memcpy(dst, &x, sizeof(S));
+}
+
+template <typename T>
+class NpyArray {
+        private:
+                char *map = 0;
+                size_t map_bytes = 0;
+                int fd = -1;
+                bool writable = false;
+                NpyHeader header;
+
+                // File element (i, j) of row i, column j
+                size_t index(const int i, const int j) {
+                        return header.fortran_order ? (size_t)j * ny + i
+                                                    : (size_t)i * nx + j;
+                }
+
+                void convert(const bool to_file) {
+                        char *data = map + header.offset;
+                        size_t size = header.descr[2] == '8' ? 8 : 4;
+                        bool swap = header.descr[0] == '>';
+                        #pragma omp parallel for schedule(static)
+                        for (int i = 0; i < ny; ++i) {
+                                for (int j = 0; j < nx; ++j) {
+                                        char *src = data + index(i, j) * size;
+                                        T *dst = &x[(size_t)i * nx + j];
+                                        if (size == 4) {
+                                                if (to_file) npy_store<float>(src, *dst, swap);
+                                                else *dst = npy_load<float, T>(src, swap);
+                                        } else {
+                                                if (to_file) npy_store<double>(src, *dst, swap);
+                                                else *dst = npy_load<double, T>(src, swap);
+                                        }
+                                }
+                        }
+                }
+
+                void map_file(const char *path, const size_t num_bytes) {
+                        map_bytes = num_bytes;
+                        // Without write access, the mapping is private so that
+                        // the grid can still be modified
+                        map = (char*)mmap(nullptr, map_bytes,
+                                          PROT_READ | PROT_WRITE,
+                                          writable ? MAP_SHARED : MAP_PRIVATE,
+                                          fd, 0);
+                        if (map == MAP_FAILED) {
+                                fprintf(stderr, "NpyArray: failed to map %s.\n", path);
+                                exit(EXIT_FAILURE);
+                        }
+                }
+
+        public:
+                T *x = 0;
+                int nx = 0, ny = 0;
+                // True if the data had to be converted into a separate grid
+                bool copied = false;
+
+                NpyArray(const NpyArray&) = delete;
+
+                // Open an existing file
+                NpyArray(const char *path, const bool writable=false)
+                    : writable(writable) {
+                        fd = open(path, writable ? O_RDWR : O_RDONLY);
+                        struct stat st;
+                        if (fd < 0 || fstat(fd, &st) != 0) {
+                                fprintf(stderr, "NpyArray: failed to open %s.\n", path);
+                                exit(EXIT_FAILURE);
+                        }
+                        map_file(path, st.st_size);
+                        if (!npy_parse_header(map, map_bytes, header) ||
+                            header.descr.size() != 3 ||
+                            header.descr[1] != 'f' ||
+                            (header.descr[2] != '4' && header.descr[2] != '8') ||
+                            header.offset + (size_t)header.nx * header.ny *
+                            (header.descr[2] - '0') > map_bytes) {
+                                fprintf(stderr, "NpyArray: unsupported file %s.\n", path);
+                                exit(EXIT_FAILURE);
+                        }
+                        nx = header.nx;
+                        ny = header.ny;
+
+                        if (header.descr == npy_descr<T>() && !header.fortran_order &&
+                            header.offset % sizeof(T) == 0) {
+                                x = (T*)(map + header.offset);
+                                madvise(map, map_bytes, MADV_WILLNEED);
+                        } else {
+                                copied = true;
+                                x = grid_alloc<T>(nx, ny);
+                                convert(false);
+                        }
+                }
+
+                // Create a new file of shape (ny, nx) with data type T
+                NpyArray(const char *path, const int nx, const int ny)
+                    : writable(true), nx(nx), ny(ny) {
+                        std::string head = npy_header(npy_descr<T>(), nx, ny);
+                        fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+                        size_t num_bytes = head.size() + sizeof(T) * nx * ny;
+                        if (fd < 0 || ftruncate(fd, num_bytes) != 0) {
+                                fprintf(stderr, "NpyArray: failed to create %s.\n", path);
+                                exit(EXIT_FAILURE);
+                        }
+                        map_file(path, num_bytes);
+                        memcpy(map, head.data(), head.size());
+                        npy_parse_header(map, map_bytes, header);
+                        x = (T*)(map + header.offset);
+                }
+
+                // Write converted data back to the file and flush the mapping
+                void sync(void) {
+                        if (!writable) return;
+                        if (copied) convert(true);
+                        msync(map, map_bytes, MS_SYNC);
+                }
+
+                ~NpyArray(void) {
+                        sync();
+                        if (copied) grid_free(x, nx, ny);
+                        if (map != nullptr && map != MAP_FAILED) munmap(map, map_bytes);
+                        if (fd >= 0) close(fd);
+                }
+};
+
+// Write an nx x ny grid to a .npy file
+template <typename T>
+void npy_write(const char *path, const T *x, const int nx, const int ny) {
+        NpyArray<T> out(path, nx, ny);
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < ny; ++i)
+                memcpy(&out.x[(size_t)i * nx], &x[(size_t)i * nx], sizeof(T) * nx);
+}
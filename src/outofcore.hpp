@@ -0,0 +1,392 @@
+#pragma once
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include <poisson.hpp>
+// Out-of-core multigrid. The fine grid u, f and r are stored in memory-mapped
+// files and are only accessed by row-block pipelines: each phase (smoothing,
+// residual + restriction, prolongation) passes over the fine grid once and
+// keeps at most a window of `block_rows` rows (plus halo rows) mapped. Rows
+// behind the window are dropped from the mapping, dirty pages are written back
+// by the kernel. The coarse levels are stored in memory and are solved by the
+// in-memory V-cycle.
+//
+// The iterates are identical to `Multigrid<GaussSeidelRedBlack, ...>`.
+
+template <typename T>
+class MappedGrid {
+        public:
+                T *x = 0;
+                int n = 0;
+                size_t num_bytes = 0;
+                int fd = -1;
+
+                MappedGrid(const MappedGrid&) = delete;
+                // Maps an n x n grid stored in `path`. The file is created if
+                // it does not exist, new files are zero. Unless `keep` is set,
+                // the file is removed once it is no longer mapped.
+                MappedGrid(const char *path, const int n, const bool keep=false)
+                    : n(n) {
+                        num_bytes = sizeof(T) * n * n;
+                        fd = open(path, O_RDWR | O_CREAT, 0644);
+                        if (fd < 0 || ftruncate(fd, num_bytes) != 0) {
+                                fprintf(stderr, "MappedGrid: failed to open %s.\n", path);
+                                exit(EXIT_FAILURE);
+                        }
+                        x = (T*)mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE,
+                                     MAP_SHARED, fd, 0);
+                        if (x == MAP_FAILED) {
+                                fprintf(stderr, "MappedGrid: failed to map %s.\n", path);
+                                exit(EXIT_FAILURE);
+                        }
+                        madvise(x, num_bytes, MADV_SEQUENTIAL);
+                        if (!keep) unlink(path);
+                }
+
+                // Drop rows [i0, i1) from the mapping
+                void release(const int i0, const int i1) {
+                        if (i1 <= i0) return;
+                        size_t page = sysconf(_SC_PAGESIZE);
+                        size_t begin = (size_t)&x[(size_t)i0 * n];
+                        size_t end = (size_t)&x[(size_t)i1 * n];
+                        begin = (begin + page - 1) / page * page;
+                        end = end / page * page;
+                        if (end > begin)
+                                madvise((void*)begin, end - begin, MADV_DONTNEED);
+                }
+
+                // Write back dirty pages and drop the entire mapping
+                void flush(void) {
+                        msync(x, num_bytes, MS_SYNC);
+                        release(0, n);
+                }
+
+                ~MappedGrid(void) {
+                        if (x != nullptr && x != MAP_FAILED) munmap(x, num_bytes);
+                        if (fd >= 0) close(fd);
+                }
+};
+
+// Relax the points of one color in row i, color = 0: red, (i + j) even.
+// Rows are addressed using 64-bit offsets, the fine grids can have more than
+// 2^31 points.
+template <typename T>
+__inline__ void ooc_relax_row(T *u, const T *f, const int n, const T h,
+                              const int i, const int color) {
+        T *row = &u[(size_t)i * n];
+        const T *frow = &f[(size_t)i * n];
+        for (int j = 2 - (i + color) % 2; j < n - 1; j += 2) {
+                row[j] =
+                    - 0.25 * (
+                            h * h * frow[j]
+                            -
+                            row[j + 1] - row[j - 1]
+                            -
+                            row[j + n] - row[j - n]);
+        }
+}
+
+// One red-black Gauss-Seidel sweep as a wavefront: the red points of a block
+// of rows are relaxed, followed by the black points one row behind.
+template <typename T>
+void ooc_gauss_seidel_red_black(MappedGrid<T>& u, MappedGrid<T>& f, const T h,
+                                const int block) {
+        int n = u.n;
+        // Both colors in one pass over u and f
+        work_count(WORK_SMOOTH, (double)(n - 2) * (n - 2), 6, 3 * sizeof(T));
+        for (int b0 = 1; b0 < n - 1; b0 += block) {
+                int b1 = std::min(b0 + block, n - 1);
+                #pragma omp parallel for schedule(static)
+                for (int i = b0; i < b1; ++i)
+                        ooc_relax_row(u.x, f.x, n, h, i, 0);
+                #pragma omp parallel for schedule(static)
+                for (int i = std::max(b0 - 1, 1); i < b1 - 1; ++i)
+                        ooc_relax_row(u.x, f.x, n, h, i, 1);
+                u.release(0, b0 - 2);
+                f.release(0, b0 - 1);
+        }
+        ooc_relax_row(u.x, f.x, n, h, n - 2, 1);
+        u.release(0, n);
+        f.release(0, n);
+}
+
+// Row i of r := f - Lu
+template <typename T>
+__inline__ void ooc_residual_row(T *r, const T *u, const T *f, const int n,
+                                 const T h, const int i) {
+        T hi2 = 1.0 / (h * h);
+        const T *row = &u[(size_t)i * n];
+        const T *frow = &f[(size_t)i * n];
+        for (int j = 1; j < n - 1; ++j) {
+                r[j] =
+                frow[j] - (
+                                row[j + 1] + row[j - 1] +
+                                - 4.0 * row[j] + row[j + n] +
+                                row[j - n]) * hi2;
+        }
+}
+
+// rc := R (f - Lu). The fine grid residual is only kept for the rows of the
+// current block of coarse rows.
+template <typename T>
+void ooc_residual_restrict(T *rc, MappedGrid<T>& u, MappedGrid<T>& f,
+                           const T h, const int block) {
+        int n = u.n;
+        int nc = (n - 1) / 2 + 1;
+        // The fine residual stays in the row buffer
+        work_count(WORK_RESIDUAL, (double)(n - 2) * (n - 2), 7, 2 * sizeof(T));
+        work_count(WORK_RESTRICT, (double)(nc - 2) * (nc - 2), 20, sizeof(T));
+        int cblock = std::max(block / 2, 1);
+        const T c0 = 0.25;
+        const T c1 = 0.5;
+        const T b = 1.0;
+        // Fine rows 2 * c0 - 1 .. 2 * c1 - 1
+        std::vector<T> buffer((size_t)(2 * cblock + 1) * n, 0.0);
+        T *xf = buffer.data();
+        for (int k0 = 1; k0 < nc - 1; k0 += cblock) {
+                int k1 = std::min(k0 + cblock, nc - 1);
+                int i0 = 2 * k0 - 1;
+                int i1 = 2 * k1;
+                #pragma omp parallel for schedule(static)
+                for (int i = i0; i < i1; ++i)
+                        ooc_residual_row(&xf[(size_t)(i - i0) * n], u.x, f.x,
+                                         n, h, i);
+                #pragma omp parallel for schedule(static)
+                for (int i = k0; i < k1; ++i) {
+                        // Row 2 * i - 1 of the fine grid is row 2 * (i - k0) of
+                        // the buffer
+                        const T *x = &xf[(size_t)2 * (i - k0) * n];
+                        for (int j = 1; j < nc - 1; ++j) {
+                                rc[j + nc * i] = b *
+                                    (
+                                    c0 * c0 * x[2 * j - 1 + n * 0] +
+                                    c0 * c1 * x[2 * j     + n * 0] +
+                                    c0 * c0 * x[2 * j + 1 + n * 0] +
+                                    +
+                                    c1 * c0 * x[2 * j - 1 + n * 1] +
+                                    c1 * c1 * x[2 * j     + n * 1] +
+                                    c1 * c0 * x[2 * j + 1 + n * 1] +
+                                    +
+                                    c0 * c0 * x[2 * j - 1 + n * 2] +
+                                    c0 * c1 * x[2 * j     + n * 2] +
+                                    c0 * c0 * x[2 * j + 1 + n * 2]
+                                    );
+                        }
+                }
+                u.release(0, i0 - 1);
+                f.release(0, i0);
+        }
+        u.release(0, n);
+        f.release(0, n);
+}
+
+// u := u + P e
+template <typename T>
+void ooc_prolongate(MappedGrid<T>& u, const T *e, const int block) {
+        int nxf = u.n;
+        int nxc = (nxf - 1) / 2 + 1;
+        work_count(WORK_PROLONGATE, (double)nxf * nxf, 5, 2.25 * sizeof(T));
+        int cblock = std::max(block / 2, 1);
+        const T a = 1.0;
+        const T b = 1.0;
+        for (int k0 = 0; k0 < nxc; k0 += cblock) {
+                int k1 = std::min(k0 + cblock, nxc);
+                #pragma omp parallel for schedule(static)
+                for (int i = k0; i < k1; ++i) {
+                        // Fine rows 2i, 2i + 1 and coarse rows i, i + 1
+                        T *y0 = &u.x[(size_t)2 * i * nxf];
+                        T *y1 = i < nxc - 1 ? y0 + nxf : y0;
+                        const T *x0 = &e[(size_t)i * nxc];
+                        const T *x1 = i < nxc - 1 ? x0 + nxc : x0;
+                        for (int j = 0; j < nxc; ++j) {
+                                y0[2 * j] = a * y0[2 * j] + b * x0[j];
+                                if (j < nxc - 1)
+                                        y0[2 * j + 1] =
+                                            a * y0[2 * j + 1] +
+                                            0.5 * b * (x0[j] + x0[j + 1]);
+                                if (i < nxc - 1)
+                                        y1[2 * j] =
+                                            a * y1[2 * j] +
+                                            0.5 * b * (x0[j] + x1[j]);
+                                if (i < nxc - 1 && j < nxc - 1)
+                                        y1[2 * j + 1] =
+                                            + a * y1[2 * j + 1] +
+                                            0.25 * b *
+                                                (x0[j] + x1[j] + x0[j + 1] +
+                                                 x1[j + 1]);
+                        }
+                }
+                u.release(0, 2 * k0);
+        }
+        u.release(0, nxf);
+}
+
+// v, w: buffers of size 2 * nc * nc, r: buffer of size nc * nc, where nc is
+// the number of grid points of level l - 1.
+template <typename T>
+void outofcore_v_cycle(const int l, MappedGrid<T>& u, MappedGrid<T>& f, T *r,
+                       T *v, T *w, const T h, const int block) {
+        int nv = (1 << (l - 1)) + 1;
+        T *el = &v[nv * nv];
+        T *rl = &w[nv * nv];
+
+        ooc_gauss_seidel_red_black(u, f, h, block);
+
+        // r^(l-1) := R (f - Lu^l)
+        ooc_residual_restrict(rl, u, f, h, block);
+
+        // The correction starts from zero
+        GaussSeidelRedBlack smoother;
+        multigrid_v_cycle(l - 1, smoother, el, rl, r, v, w, 2 * h, true);
+
+        ooc_prolongate(u, el, block);
+
+        ooc_gauss_seidel_red_black(u, f, h, block);
+}
+
+template <typename T>
+class OutOfCorePoisson {
+        public:
+                int n;
+                int l;
+                T h;
+                T modes;
+                size_t num_bytes;
+                // Rows per block of the pipelines
+                int block_rows;
+                MappedGrid<T> ufile, ffile, rfile;
+                T *u, *f, *r;
+
+        // The grids are stored in `<prefix>.u`, `<prefix>.f` and `<prefix>.r`
+        OutOfCorePoisson(int l, T h, T modes, const char *prefix,
+                         const int block_rows=64, const bool keep=false)
+            : n((1 << l) + 1), l(l), h(h), modes(modes),
+              num_bytes(sizeof(T) * n * n), block_rows(block_rows),
+              ufile(path(prefix, "u"), n, keep),
+              ffile(path(prefix, "f"), n, keep),
+              rfile(path(prefix, "r"), n, keep) {
+                u = ufile.x;
+                f = ffile.x;
+                r = rfile.x;
+                T s = 2.0 * M_PI * modes / (h * (n - 1));
+                for (int b0 = 0; b0 < n; b0 += block_rows) {
+                        int b1 = std::min(b0 + block_rows, n);
+                        #pragma omp parallel for schedule(static)
+                        for (int i = b0; i < b1; ++i) {
+                                T *row = &f[(size_t)i * n];
+                                for (int j = 0; j < n; ++j)
+                                        row[j] = -2 * s * s * sin(s * h * i) * sin(s * h * j);
+                        }
+                        ffile.release(0, b0);
+                }
+                ffile.release(0, n);
+        }
+
+        static const char *path(const char *prefix, const char *grid) {
+                static char out[3][4096];
+                int k = grid[0] == 'u' ? 0 : grid[0] == 'f' ? 1 : 2;
+                snprintf(out[k], sizeof(out[k]), "%s.%s", prefix, grid);
+                return out[k];
+        }
+
+        T error() {
+                T s = 2.0 * M_PI * modes / (h * (n - 1));
+                std::vector<double> rows(n, 0.0);
+                for (int b0 = 0; b0 < n; b0 += block_rows) {
+                        int b1 = std::min(b0 + block_rows, n);
+                        #pragma omp parallel for schedule(static)
+                        for (int i = b0; i < b1; ++i) {
+                                const T *row = &u[(size_t)i * n];
+                                for (int j = 0; j < n; ++j) {
+                                        T v = sin(s * h * j) * sin(s * h * i);
+                                        T e = row[j] - v;
+                                        rows[i] += fabs(e) * h * h;
+                                }
+                        }
+                        ufile.release(0, b0);
+                }
+                ufile.release(0, n);
+                double err = 0.0;
+                for (int i = 0; i < n; ++i)
+                        err += rows[i];
+                return err;
+        }
+
+        void residual(void) {
+                work_count(WORK_RESIDUAL, (double)(n - 2) * (n - 2), 7, 3 * sizeof(T));
+                for (int b0 = 1; b0 < n - 1; b0 += block_rows) {
+                        int b1 = std::min(b0 + block_rows, n - 1);
+                        #pragma omp parallel for schedule(static)
+                        for (int i = b0; i < b1; ++i)
+                                ooc_residual_row(&r[(size_t)i * n], u, f, n, h, i);
+                        ufile.release(0, b0 - 1);
+                        ffile.release(0, b0);
+                        rfile.release(0, b0);
+                }
+                ufile.release(0, n);
+                ffile.release(0, n);
+                rfile.release(0, n);
+        }
+
+        T norm(void) {
+                std::vector<double> rows(n, 0.0);
+                for (int b0 = 0; b0 < n; b0 += block_rows) {
+                        int b1 = std::min(b0 + block_rows, n);
+                        #pragma omp parallel for schedule(static)
+                        for (int i = b0; i < b1; ++i) {
+                                const T *row = &r[(size_t)i * n];
+                                for (int j = 0; j < n; ++j)
+                                        rows[i] += fabs(row[j]) * h * h;
+                        }
+                        rfile.release(0, b0);
+                }
+                rfile.release(0, n);
+                double out = 0.0;
+                for (int i = 0; i < n; ++i)
+                        out += rows[i];
+                return out;
+        }
+};
+
+template <typename P, typename T>
+class OutOfCoreMultigrid {
+        private:
+                // Levels l - 1 and below, see `outofcore_v_cycle`
+                T *v = 0, *w = 0, *r = 0;
+                int l = 0;
+                size_t num_bytes = 0;
+        public:
+
+                OutOfCoreMultigrid() { }
+                OutOfCoreMultigrid(P& p) : l(p.l) {
+                        int nv = (1 << (l - 1)) + 1;
+                        num_bytes = 2 * sizeof(T) * nv * nv;
+                        v = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        w = (T*)memory_alloc(num_bytes, MEMORY_HIERARCHY);
+                        r = grid_alloc<T>(nv, nv, MEMORY_SCRATCH);
+                }
+
+                void operator()(P& p) {
+                        outofcore_v_cycle(l, p.ufile, p.ffile, r, v, w, p.h,
+                                          p.block_rows);
+                }
+
+                ~OutOfCoreMultigrid(void) {
+                        if (r == nullptr) return;
+                        int nv = (1 << (l - 1)) + 1;
+                        memory_free(v, num_bytes);
+                        memory_free(w, num_bytes);
+                        grid_free(r, nv, nv);
+                }
+
+                const char *name() {
+                        return "Out-of-core Multi-Grid<Gauss-Seidel (red-black)>";
+                }
+
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <asyncio.hpp>
+#include <compression.hpp>
+#include <npy.hpp>
+// Asynchronous output of grids, e.g., the solution of each time step. `write`
+// copies the grid (in parallel) into a buffer from a pool and returns; a
+// background thread formats, optionally compresses and writes it. If all
+// buffers are still being written, `write` blocks until one is released.
+//
+//   OutputWriter<double> output(n, n, OUTPUT_NPY);
+//   for (int step = 0; step < num_steps; ++step) {
+//           solve(mg, problem, opts);
+//           sprintf(path, "u_%04d.npy", step);
+//           output.write(path, problem.u);
+//   }
+//
+// Compressed files (see compression.hpp) contain the compressed raw or .npy
+// file and are read back with `output_read`. The header of .npy files is
+// stored uncompressed.
+
+enum output_format {
+        // Grid values in row-major order
+        OUTPUT_RAW,
+        // NumPy array of shape (ny, nx)
+        OUTPUT_NPY
+};
+
+template <typename T>
+class OutputWriter {
+        private:
+                int nx, ny;
+                size_t grid_bytes;
+                std::string header;
+                std::unique_ptr<SnapshotPool> pool;
+                std::unique_ptr<WriterThread> writer;
+                std::mutex mutex;
+
+                void write_file(const std::string path, char *buffer) {
+                        std::vector<char> packed;
+                        const char *data = buffer;
+                        size_t num_bytes = header.size() + grid_bytes;
+                        if (codec != COMPRESSION_NONE) {
+                                CompressionOptions opts;
+                                opts.codec = codec;
+                                opts.tolerance = tolerance;
+                                opts.nx = nx;
+                                opts.prefix_bytes = header.size();
+                                compress(packed, buffer, num_bytes, sizeof(T), opts);
+                                data = packed.data();
+                                num_bytes = packed.size();
+                        }
+                        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                        bool ok = fd >= 0 && write_all(fd, data, num_bytes);
+                        if (fd >= 0) close(fd);
+                        pool->release(buffer);
+
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (ok) {
+                                bytes_written += num_bytes;
+                        } else {
+                                fprintf(stderr, "OutputWriter: failed to write %s.\n",
+                                        path.c_str());
+                                failures++;
+                        }
+                }
+
+        public:
+                output_format format;
+                compression_codec codec;
+                // Maximum error of COMPRESSION_LOSSY, e.g.,
+                // compression_tolerance(h)
+                double tolerance = 0.0;
+                // Statistics: grids written, writes that had to wait for a
+                // free buffer, failed writes, bytes written to disk
+                int num_writes = 0, num_waits = 0, failures = 0;
+                size_t bytes_written = 0;
+
+                OutputWriter(const OutputWriter&) = delete;
+                OutputWriter(const int nx, const int ny,
+                             const output_format format=OUTPUT_NPY,
+                             const compression_codec codec=COMPRESSION_NONE,
+                             const int num_buffers=2)
+                    : nx(nx), ny(ny), format(format), codec(codec) {
+                        grid_bytes = sizeof(T) * nx * ny;
+                        if (format == OUTPUT_NPY)
+                                header = npy_header(npy_descr<T>(), nx, ny);
+                        pool.reset(new SnapshotPool(num_buffers,
+                                                    header.size() + grid_bytes));
+                        writer.reset(new WriterThread());
+                }
+
+                // Snapshot x and write it to path in the background
+                void write(const char *path, const T *x) {
+                        bool waited = false;
+                        char *buffer = pool->acquire(&waited);
+                        memcpy(buffer, header.data(), header.size());
+                        parallel_copy(buffer + header.size(), x, grid_bytes);
+                        std::string file(path);
+                        writer->submit([this, file, buffer]() {
+                                write_file(file, buffer);
+                        });
+                        num_waits += waited;
+                        num_writes++;
+                }
+
+                // Block until all grids have been written
+                void wait(void) {
+                        writer->wait();
+                }
+
+                // Pending writes finish before the buffers are freed
+                ~OutputWriter(void) {
+                        writer.reset();
+                }
+
+};
+
+// Read a file written by OutputWriter (or any file), decompressing it if
+// needed. The size of the decompressed data is taken from the file, so files
+// that would decompress to more than `max_bytes` are rejected before
+// allocating. Returns false on error.
+bool output_read(const char *path, std::vector<char>& out,
+                 const size_t max_bytes=(size_t)1 << 32) {
+        FILE *fh = fopen(path, "rb");
+        if (fh == nullptr) return false;
+        std::vector<char> data;
+        char chunk[1 << 16];
+        size_t k;
+        while ((k = fread(chunk, 1, sizeof(chunk), fh)) > 0)
+                data.insert(data.end(), chunk, chunk + k);
+        fclose(fh);
+        if (compressed_size(data.data(), data.size()) < 0) {
+                out.swap(data);
+                return true;
+        }
+        CompressedLayout layout;
+        if (!compressed_layout(layout, data.data(), data.size()) ||
+            (size_t)layout.header.num_bytes > max_bytes)
+                return false;
+        out.resize(layout.header.num_bytes);
+        return decompress(out.data(), data.data(), data.size());
+}
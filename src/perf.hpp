@@ -0,0 +1,118 @@
+#pragma once
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <omp.h>
+#include <vector>
+// Hardware performance counters via perf_event_open. A counter is opened for
+// each OpenMP thread so that the events of the parallel kernels are included.
+// If the counters are not available (e.g., perf_event_paranoid, or inside a
+// virtual machine), `available()` returns false and `value()` returns -1.
+
+enum perf_counter_event {
+        PERF_CYCLES,
+        PERF_INSTRUCTIONS,
+        PERF_DTLB_LOAD_MISSES,
+        PERF_DTLB_STORE_MISSES,
+        PERF_LLC_LOAD_MISSES
+};
+
+class PerfCounter {
+        private:
+                std::vector<int> fds;
+
+                static void config(const perf_counter_event event,
+                                   uint32_t& type, uint64_t& value) {
+                        type = PERF_TYPE_HW_CACHE;
+                        switch (event) {
+                                case PERF_CYCLES:
+                                        type = PERF_TYPE_HARDWARE;
+                                        value = PERF_COUNT_HW_CPU_CYCLES;
+                                        break;
+                                case PERF_INSTRUCTIONS:
+                                        type = PERF_TYPE_HARDWARE;
+                                        value = PERF_COUNT_HW_INSTRUCTIONS;
+                                        break;
+                                case PERF_DTLB_LOAD_MISSES:
+                                        value = PERF_COUNT_HW_CACHE_DTLB |
+                                                PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                                PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+                                        break;
+                                case PERF_DTLB_STORE_MISSES:
+                                        value = PERF_COUNT_HW_CACHE_DTLB |
+                                                PERF_COUNT_HW_CACHE_OP_WRITE << 8 |
+                                                PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+                                        break;
+                                case PERF_LLC_LOAD_MISSES:
+                                        value = PERF_COUNT_HW_CACHE_LL |
+                                                PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                                PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+                                        break;
+                        }
+                }
+
+        public:
+                PerfCounter(const PerfCounter&) = delete;
+                PerfCounter(const perf_counter_event event) {
+                        struct perf_event_attr attr;
+                        memset(&attr, 0, sizeof(attr));
+                        attr.size = sizeof(attr);
+                        uint32_t type;
+                        uint64_t value;
+                        config(event, type, value);
+                        attr.type = type;
+                        attr.config = value;
+                        attr.disabled = 1;
+                        attr.exclude_kernel = 1;
+                        attr.exclude_hv = 1;
+
+                        fds.resize(omp_get_max_threads(), -1);
+                        #pragma omp parallel
+                        {
+                                int t = omp_get_thread_num();
+                                if (t < (int)fds.size())
+                                        fds[t] = syscall(SYS_perf_event_open,
+                                                         &attr, 0, -1, -1, 0);
+                        }
+                }
+
+                bool available(void) {
+                        for (size_t t = 0; t < fds.size(); ++t)
+                                if (fds[t] < 0) return false;
+                        return !fds.empty();
+                }
+
+                void start(void) {
+                        for (size_t t = 0; t < fds.size(); ++t) {
+                                if (fds[t] < 0) continue;
+                                ioctl(fds[t], PERF_EVENT_IOC_RESET, 0);
+                                ioctl(fds[t], PERF_EVENT_IOC_ENABLE, 0);
+                        }
+                }
+
+                void stop(void) {
+                        for (size_t t = 0; t < fds.size(); ++t)
+                                if (fds[t] >= 0)
+                                        ioctl(fds[t], PERF_EVENT_IOC_DISABLE, 0);
+                }
+
+                // Sum over all threads
+                long long value(void) {
+                        if (!available()) return -1;
+                        long long out = 0;
+                        for (size_t t = 0; t < fds.size(); ++t) {
+                                long long count = 0;
+                                if (read(fds[t], &count, sizeof(count)) == sizeof(count))
+                                        out += count;
+                        }
+                        return out;
+                }
+
+                ~PerfCounter(void) {
+                        for (size_t t = 0; t < fds.size(); ++t)
+                                if (fds[t] >= 0) close(fds[t]);
+                }
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <poisson.hpp>
+// Fused fine level pass of the V-cycle descent: pre-smoothing (red-black
+// Gauss-Seidel), residual and restriction in a single pass over the grid. The
+// grid is processed in blocks of rows as a wavefront:
+//
+//   red points of rows   [b0,     b1)
+//   black points of rows [b0 - 1, b1 - 1)
+//   residual of rows     [b0 - 2, b1 - 2)   -> rolling window of rows
+//   restriction of the coarse rows whose three fine rows are in the window
+//
+// Each row is final once the wavefront has passed it, so the results are
+// identical to calling the smoother, `poisson_residual` and `grid_restrict`
+// one after the other, but the full grid residual is never stored and u and f
+// are only read from memory once.
+
+// Relax the points of one color in row i, color = 0: red, (i + j) even
+template <typename T>
+__inline__ void pipeline_relax_row(T *u, const T *f, const int n, const T h,
+                                   const int i, const int color) {
+        for (int j = 2 - (i + color) % 2; j < n - 1; j += 2) {
+                u[j + i * n] =
+                    - 0.25 * (
+                            h * h * f[j + i * n]
+                            -
+                            u[j + 1 + i * n] - u[j - 1 + i * n]
+                            -
+                            u[j + (i + 1) * n] - u[j + (i - 1) * n]);
+        }
+}
+
+template <typename T>
+__inline__ void pipeline_residual_row(T *r, const T *u, const T *f,
+                                      const int n, const T h, const int i) {
+        T hi2 = 1.0 / (h * h);
+        for (int j = 1; j < n - 1; ++j) {
+                r[j] =
+                f[j + i * n] - (
+                                u[j + 1 + i * n] + u[j - 1 + i * n] +
+                                - 4.0 * u[j + i * n] + u[j + (i + 1) * n] +
+                                u[j + (i - 1) * n]) * hi2;
+        }
+}
+
+// Coarse row k from the fine residual rows 2k - 1, 2k, 2k + 1
+template <typename T>
+__inline__ void pipeline_restrict_row(T *rc, const int nc, const T *r0,
+                                      const T *r1, const T *r2, const int k) {
+        const T c0 = 0.25;
+        const T c1 = 0.5;
+        const T b = 1.0;
+        for (int j = 1; j < nc - 1; ++j) {
+                rc[j + nc * k] = b *
+                    (
+                    c0 * c0 * r0[2 * j - 1] +
+                    c0 * c1 * r0[2 * j    ] +
+                    c0 * c0 * r0[2 * j + 1] +
+                    +
+                    c1 * c0 * r1[2 * j - 1] +
+                    c1 * c1 * r1[2 * j    ] +
+                    c1 * c0 * r1[2 * j + 1] +
+                    +
+                    c0 * c0 * r2[2 * j - 1] +
+                    c0 * c1 * r2[2 * j    ] +
+                    c0 * c0 * r2[2 * j + 1]
+                    );
+        }
+}
+
+// Red points of row i from a zero initial guess, as in
+// `gauss_seidel_red_black_zero`
+template <typename T>
+__inline__ void pipeline_relax_row_zero(T *u, const T *f, const int n, const T h,
+                                        const int i) {
+        for (int j = 2 - i % 2; j < n - 1; j += 2)
+                u[j + i * n] = - 0.25 * (h * h * f[j + i * n]);
+}
+
+// u := S u, rc := R (f - Lu). window: buffer of (block + 2) * n elements
+// With `zero`, u is a zero initial guess and its interior is not read.
+template <typename T>
+void smooth_residual_restrict(T *u, const T *f, T *rc, const int n, const T h,
+                              const int block, T *window, const bool zero=false) {
+        int nc = (n - 1) / 2 + 1;
+        int w = block + 2;
+        // u and f are read once, the residual stays in the window
+        work_count(WORK_SMOOTH, (double)(n - 2) * (n - 2), zero ? 4 : 6,
+                   (zero ? 2 : 3) * sizeof(T));
+        work_count(WORK_RESIDUAL, (double)(n - 2) * (n - 2), 7, 0);
+        work_count(WORK_RESTRICT, (double)(nc - 2) * (nc - 2), 19, sizeof(T));
+        #pragma omp parallel if (n >= OMP_MIN_SIZE)
+        for (int b0 = 1; b0 - 2 < n - 1; b0 += block) {
+                int b1 = b0 + block;
+
+                #pragma omp for schedule(static)
+                for (int i = b0; i < std::min(b1, n - 1); ++i) {
+                        if (zero)
+                                pipeline_relax_row_zero(u, f, n, h, i);
+                        else
+                                pipeline_relax_row(u, f, n, h, i, 0);
+                }
+
+                #pragma omp for schedule(static)
+                for (int i = std::max(b0 - 1, 1); i < std::min(b1 - 1, n - 1); ++i)
+                        pipeline_relax_row(u, f, n, h, i, 1);
+
+                int a0 = std::max(b0 - 2, 1);
+                int a1 = std::min(b1 - 2, n - 1);
+                #pragma omp for schedule(static)
+                for (int i = a0; i < a1; ++i)
+                        pipeline_residual_row(&window[(i % w) * n], u, f, n, h, i);
+
+                // Coarse rows k with 2k + 1 in [a0, a1)
+                #pragma omp for schedule(static)
+                for (int k = std::max(a0 / 2, 1); k < std::min(a1 / 2, nc - 1); ++k)
+                        pipeline_restrict_row(rc, nc,
+                                              &window[((2 * k - 1) % w) * n],
+                                              &window[((2 * k) % w) * n],
+                                              &window[((2 * k + 1) % w) * n], k);
+        }
+}
+
+// Same as `multigrid_v_cycle` with red-black Gauss-Seidel smoothing, using the
+// fused pass on every level. window: buffer of (block + 2) * n elements
+// With `zero`, the initial guess u is zero and is not read. The coarse
+// corrections always start from zero, so v does not need to be cleared
+// between cycles, and w is overwritten.
+template <typename T>
+void multigrid_v_cycle_pipelined(const int l, T *u, T *f, T *v, T *w,
+                                 const T h, const int block, T *window,
+                                 const bool zero=false) {
+
+        if (l == 1) {
+                base_case(u, f, h);
+                return;
+        }
+
+        int nu = (1 << l) + 1;
+        int nv = (1 << (l - 1)) + 1;
+        T *el = &v[nv * nv];
+        T *rl = &w[nv * nv];
+
+        // u^l := S u^l, r^(l-1) := R (f - Lu^l)
+        smooth_residual_restrict(u, f, rl, nu, h, block, window, zero);
+
+        multigrid_v_cycle_pipelined(l - 1, el, rl, v, w, 2 * h, block,
+                                    window, true);
+
+        grid_prolongate(u, nu, nu, el, nv, nv, 1.0, 1.0);
+
+        gauss_seidel_red_black(u, f, nu, h);
+}
+
+template <typename P, typename T>
+class PipelinedMultigrid {
+        private:
+                T *v = 0, *w = 0;
+                int l = 0;
+                std::vector<T> window;
+        public:
+                // Rows per block of the wavefront
+                int block_rows = 16;
+
+                PipelinedMultigrid() { }
+                PipelinedMultigrid(P& p, const int block_rows=16)
+                    : l(p.l), block_rows(block_rows) {
+                        v = multigrid_alloc<T>(l);
+                        w = multigrid_alloc<T>(l);
+                }
+
+                void operator()(P& p) {
+                        window.resize((size_t)(block_rows + 2) * p.n);
+                        multigrid_v_cycle_pipelined(l, p.u, p.f, v, w, p.h,
+                                                    block_rows, window.data());
+                }
+
+                ~PipelinedMultigrid(void) {
+                        if (v == nullptr) return;
+                        multigrid_free(v, l);
+                        multigrid_free(w, l);
+                }
+
+                const char *name() {
+                        return "Pipelined Multi-Grid<Gauss-Seidel (red-black)>";
+                }
+
+};
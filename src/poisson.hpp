@@ -1,12 +1,18 @@
 #pragma once
+#include <omp.h>
 #include <grid.hpp>
+#include <memory.hpp>
+#include <adaptive.hpp>
 #include <algorithm>
 #include <cstring>
+#include <type_traits>
+#include <vector>
 // Solves Poisson's equation: Lu = f, Lu = u_xx + u_yy
 
 template <typename T>
 void gauss_seidel(T *u, const T *f, const int n, const T h) {
 
+        work_count(WORK_SMOOTH, (double)(n - 2) * (n - 2), 6, 3 * sizeof(T));
         for (int i = 1; i < n - 1; ++i) {
                 for (int j = 1; j < n - 1; ++j) {
                         u[j + i * n] =
@@ -24,6 +30,9 @@ void gauss_seidel(T *u, const T *f, const int n, const T h) {
 template <typename T>
 void gauss_seidel_red_black(T *u, const T *f, const int n, const T h) {
 
+        // One pass over u and f per color
+        work_count(WORK_SMOOTH, (double)(n - 2) * (n - 2), 6, 6 * sizeof(T));
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
         for (int i = 1; i < n - 1; ++i) {
                 for (int j = 1; j < n - 1; ++j) {
                         if ( (i + j) % 2 == 0) {
@@ -38,6 +47,7 @@ void gauss_seidel_red_black(T *u, const T *f, const int n, const T h) {
                 }
         }
 
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
         for (int i = 1; i < n - 1; ++i) {
                 for (int j = 1; j < n - 1; ++j) {
                         if ( (i + j) % 2 == 1) {
@@ -53,10 +63,195 @@ void gauss_seidel_red_black(T *u, const T *f, const int n, const T h) {
         }
 }
 
+// Red-black Gauss-Seidel from a zero initial guess: the red points are
+// u = -h^2 f / 4, and the black points are overwritten without being read,
+// so the interior of u is not read before it is written. The boundary must be
+// zero. Gives the same iterate as `gauss_seidel_red_black` on a cleared grid.
+template <typename T>
+void gauss_seidel_red_black_zero(T *u, const T *f, const int n, const T h) {
+
+        // The red points only read f
+        work_count(WORK_SMOOTH, (double)(n - 2) * (n - 2), 4, 5 * sizeof(T));
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 2 - i % 2; j < n - 1; j += 2)
+                        u[j + i * n] = - 0.25 * (h * h * f[j + i * n]);
+
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
+        for (int i = 1; i < n - 1; ++i) {
+                for (int j = 1; j < n - 1; ++j) {
+                        if ( (i + j) % 2 == 1) {
+                        u[j + i * n] =
+                            - 0.25 * (
+                                    h * h * f[j + i * n]
+                                    -
+                                    u[j + 1 + i * n] - u[j - 1 + i * n]
+                                    -
+                                    u[j + (i + 1) * n] - u[j + (i - 1) * n]);
+                        }
+                }
+        }
+}
+
+// Red-black Gauss-Seidel that also computes the residual r := f - Lu. After
+// the black half-sweep the residual at the black points is zero, and the
+// residual at the red points of a row is computed once the black points of
+// the row below have been updated, while its neighbors are still in cache.
+// Only the first and last row of each thread's block wait for a barrier. The
+// iterate is identical to `gauss_seidel_red_black`.
+// With `zero`, u is a zero initial guess as in `gauss_seidel_red_black_zero`.
+template <typename T>
+void gauss_seidel_red_black_residual(T *u, const T *f, T *r, const int n, const T h,
+                                     const bool zero=false) {
+
+        // The residual of the red points is computed while the rows are in
+        // cache, only r is written
+        work_count(WORK_SMOOTH, (double)(n - 2) * (n - 2), zero ? 4 : 6,
+                   (zero ? 5 : 6) * sizeof(T));
+        work_count(WORK_RESIDUAL, 0.5 * (n - 2) * (n - 2), 7, 2 * sizeof(T));
+        T hi2 = 1.0 / (h * h);
+        auto relax = [&](const int i, const int color) {
+                for (int j = 2 - (i + color) % 2; j < n - 1; j += 2) {
+                        u[j + i * n] =
+                            - 0.25 * (
+                                    h * h * f[j + i * n]
+                                    -
+                                    u[j + 1 + i * n] - u[j - 1 + i * n]
+                                    -
+                                    u[j + (i + 1) * n] - u[j + (i - 1) * n]);
+                }
+        };
+        auto red_residual = [&](const int i) {
+                for (int j = 2 - i % 2; j < n - 1; j += 2) {
+                        r[j + i * n] =
+                        f[j + i * n] - (
+                                        u[j + 1 + i * n] + u[j - 1 + i * n] +
+                                        - 4.0 * u[j + i * n] + u[j + (i + 1) * n] +
+                                        u[j + (i - 1) * n]) * hi2;
+                        if (j + 1 < n - 1) r[j + 1 + i * n] = 0.0;
+                }
+                if (i % 2 == 0) r[1 + i * n] = 0.0;
+        };
+
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
+        for (int i = 1; i < n - 1; ++i) {
+                if (zero) {
+                        for (int j = 2 - i % 2; j < n - 1; j += 2)
+                                u[j + i * n] = - 0.25 * (h * h * f[j + i * n]);
+                } else {
+                        relax(i, 0);
+                }
+        }
+
+        #pragma omp parallel if (n >= OMP_MIN_SIZE)
+        {
+                int t = omp_get_thread_num();
+                int p = omp_get_num_threads();
+                int begin = 1 + (long)(n - 2) * t / p;
+                int end = 1 + (long)(n - 2) * (t + 1) / p;
+                for (int i = begin; i < end; ++i) {
+                        relax(i, 1);
+                        // Rows i - 2 .. i are final
+                        if (i - 1 > begin) red_residual(i - 1);
+                }
+                // The first and last row need the neighboring blocks
+                #pragma omp barrier
+                if (end > begin) red_residual(begin);
+                if (end - 1 > begin) red_residual(end - 1);
+        }
+}
+
+// scratch holds 2 * n values, or is allocated for the call if it is null
+template <typename T>
+void jacobi(T *u, const T *f, const int n, const T h, const T omega=0.8,
+            T *scratch=nullptr) {
+
+        work_count(WORK_SMOOTH, (double)(n - 2) * (n - 2), 9, 3 * sizeof(T));
+        // Rolling copies of the previous and current (unrelaxed) rows keep the
+        // update in-place
+        T *rows = scratch != nullptr ? scratch : (T*)malloc(sizeof(T) * 2 * n);
+        T *prev = rows;
+        T *curr = rows + n;
+        memcpy(prev, u, sizeof(T) * n);
+        for (int i = 1; i < n - 1; ++i) {
+                memcpy(curr, &u[i * n], sizeof(T) * n);
+                for (int j = 1; j < n - 1; ++j) {
+                        T uj = - 0.25 * (
+                                    h * h * f[j + i * n]
+                                    -
+                                    curr[j + 1] - curr[j - 1]
+                                    -
+                                    u[j + (i + 1) * n] - prev[j]);
+                        u[j + i * n] = (1 - omega) * curr[j] + omega * uj;
+                }
+                T *tmp = prev;
+                prev = curr;
+                curr = tmp;
+        }
+        if (scratch == nullptr) free(rows);
+}
+
+template <typename T>
+void poisson_operator(T *y, const T *x, const int n, const T h) {
+
+        work_count(WORK_RESIDUAL, (double)(n - 2) * (n - 2), 6, 2 * sizeof(T));
+        T hi2 = 1.0 / (h * h);
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
+        for (int i = 1; i < n - 1; ++i) {
+                for (int j = 1; j < n - 1; ++j) {
+                        y[j + i * n] = (
+                                        x[j + 1 + i * n] + x[j - 1 + i * n] +
+                                        - 4.0 * x[j + i * n] + x[j + (i + 1) * n] +
+                                        x[j + (i - 1) * n]) * hi2;
+                }
+        }
+
+}
+
+// r := f - Lu using streaming stores, rows of u and f are prefetched `pf`
+// elements ahead
+template <typename T>
+void poisson_residual_stream(T *r, const T *u, const T *f, const int n,
+                             const T h, const int pf) {
+
+        T hi2 = 1.0 / (h * h);
+        // Prefetch addresses stay inside u and f
+        const long last = (long)n * n - 1;
+        #pragma omp parallel if (n >= OMP_MIN_SIZE)
+        {
+                #pragma omp for schedule(static)
+                for (int i = 1; i < n - 1; ++i) {
+                        for (int j = 1; j < n - 1; ++j) {
+                                if (pf > 0) {
+                                        long k = j + pf + (long)i * n;
+                                        stream_prefetch(&u[std::min(k + n, last)]);
+                                        stream_prefetch(&f[std::min(k, last)]);
+                                }
+                                stream_store(&r[j + i * n],
+                                f[j + i * n] - (
+                                                u[j + 1 + i * n] + u[j - 1 + i * n] +
+                                                - 4.0 * u[j + i * n] + u[j + (i + 1) * n] +
+                                                u[j + (i - 1) * n]) * hi2);
+                        }
+                }
+                stream_fence();
+        }
+
+}
+
 template <typename T>
 void poisson_residual(T *r, const T *u, const T *f, const int n, const T h) {
 
+        work_count(WORK_RESIDUAL, (double)(n - 2) * (n - 2), 7, 3 * sizeof(T));
+        size_t working_set = 3 * sizeof(T) * n * n;
+        if (stream_enabled(working_set)) {
+                poisson_residual_stream(r, u, f, n, h,
+                                        prefetch_distance(working_set));
+                return;
+        }
+
         T hi2 = 1.0 / (h * h);
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
         for (int i = 1; i < n - 1; ++i) {
                 for (int j = 1; j < n - 1; ++j) {
                         r[j + i * n] = 
@@ -73,7 +268,22 @@ template <typename T>
 void forcing_function(T *f, const int n, const T h, const T modes=1.0) {
 
         T s = 2.0 * M_PI * modes / (h * (n - 1));
-        memset(f, 0, n * n * sizeof(T));
+        if (stream_enabled(sizeof(T) * n * n)) {
+                #pragma omp parallel if (n >= OMP_MIN_SIZE)
+                {
+                        #pragma omp for schedule(static)
+                        for (int i = 0; i < n; ++i) {
+                                for (int j = 0; j < n; ++j) {
+                                        stream_store(&f[j + n * i],
+                                                     (T)(-2 * s * s * sin(s * h * i) * sin(s * h * j)));
+                                }
+                        }
+                        stream_fence();
+                }
+                return;
+        }
+
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
         for (int i = 0; i < n; ++i) {
                 for (int j = 0; j < n; ++j) {
                         f[j + n * i] = -2 * s * s * sin(s * h * i) * sin(s * h * j);
@@ -86,6 +296,7 @@ template <typename T>
 void exact_solution(T *u, const int n, const T h, const T modes=1.0) {
 
         T s = 2.0 * M_PI * modes / (h * (n - 1));
+        #pragma omp parallel for schedule(static) if (n >= OMP_MIN_SIZE)
         for (int i = 0; i < n; ++i) {
                 for (int j = 0; j < n; ++j) {
                         u[j + n * i] = sin(s * h * j) * sin(s * h * i);
@@ -95,11 +306,147 @@ void exact_solution(T *u, const int n, const T h, const T modes=1.0) {
 
 template <typename T>
 __inline__ void base_case(T *u, const T *f, const T h) {
+        work_count(WORK_BASE, 1, 3, 2 * sizeof(T));
         u[1 + 3 * 1] = -0.5 * f[1 + 3 * 1] * h * h;
 }
 
+// Smoothing followed by r := f - Lu. Smoothers that compute the residual as a
+// by-product provide operator()(u, f, r, n, h), which saves a pass over u and
+// f.
+template <typename T, typename S>
+auto smooth_residual(S& smoother, T *u, T *f, T *r, const int n, const T h, int)
+    -> decltype(smoother(u, f, r, n, h)) {
+        return smoother(u, f, r, n, h);
+}
 template <typename T, typename S>
-void multigrid_v_cycle(const int l, S& smoother, T *u, T *f, T *r, T *v, T *w, const T h) {
+void smooth_residual(S& smoother, T *u, T *f, T *r, const int n, const T h, long) {
+        smoother(u, f, n, h);
+        poisson_residual(r, u, f, n, h);
+}
+
+// Smoothing of a zero initial guess, see `smooth_residual_zero`
+template <typename T, typename S>
+auto smooth_zero(S& smoother, T *u, T *f, const int n, const T h, int)
+    -> decltype(smoother.zero(u, f, n, h)) {
+        return smoother.zero(u, f, n, h);
+}
+template <typename T, typename S>
+void smooth_zero(S& smoother, T *u, T *f, const int n, const T h, long) {
+        memset(u, 0, sizeof(T) * n * n);
+        smoother(u, f, n, h);
+}
+
+// Pre-smoothing of a zero initial guess followed by r := f - Lu. Smoothers
+// that can start from zero without reading u provide zero(u, f, r, n, h) or
+// zero(u, f, n, h); for the others, u is cleared first.
+template <typename T, typename S>
+auto smooth_residual_zero(S& smoother, T *u, T *f, T *r, const int n, const T h, int)
+    -> decltype(smoother.zero(u, f, r, n, h)) {
+        return smoother.zero(u, f, r, n, h);
+}
+template <typename T, typename S>
+auto smooth_residual_zero(S& smoother, T *u, T *f, T *r, const int n, const T h, long)
+    -> decltype(smoother.zero(u, f, n, h)) {
+        smoother.zero(u, f, n, h);
+        poisson_residual(r, u, f, n, h);
+}
+template <typename T, typename S>
+void smooth_residual_zero(S& smoother, T *u, T *f, T *r, const int n, const T h, ...) {
+        memset(u, 0, sizeof(T) * n * n);
+        smooth_residual(smoother, u, f, r, n, h, 0);
+}
+
+// Transfer operators of `Multigrid`. Restrictions map the fine residual to
+// the coarse grid, yc := R xf, and prolongations add the coarse correction,
+// yf := a yf + b P xc. All of them use the same grid hierarchy.
+class FullWeighting {
+        public:
+        template <typename T>
+        void operator()(T *yc, const int nc, const T *xf, const int nf) {
+                grid_restrict(yc, nc, nc, xf, nf, nf, (T)0.0, (T)1.0);
+        }
+        const char *name() {
+                return "full weighting";
+        }
+};
+
+// Cheaper than full weighting: reads the coarse point and its four fine
+// neighbours. After red-black Gauss-Seidel the residual is zero at the black
+// points, which include the four neighbours, so half weighting equals half
+// injection.
+class HalfWeighting {
+        public:
+        template <typename T>
+        void operator()(T *yc, const int nc, const T *xf, const int nf) {
+                grid_restrict_half(yc, nc, nc, xf, nf, nf, (T)0.0, (T)1.0);
+        }
+        const char *name() {
+                return "half weighting";
+        }
+};
+
+// Reads only the coarse points. `weight` = 0.5 (half injection) matches half
+// weighting after red-black Gauss-Seidel.
+class Injection {
+        public:
+                double weight = 0.5;
+        template <typename T>
+        void operator()(T *yc, const int nc, const T *xf, const int nf) {
+                grid_restrict_injection(yc, nc, nc, xf, nf, nf, (T)0.0, (T)weight);
+        }
+        const char *name() {
+                return "injection";
+        }
+};
+
+class Bilinear {
+        public:
+        template <typename T>
+        void operator()(T *yf, const int nf, const T *xc, const int nc, const T a,
+                        const T b) {
+                grid_prolongate(yf, nf, nf, xc, nc, nc, a, b);
+        }
+        const char *name() {
+                return "bilinear";
+        }
+};
+
+// Exact for cubic polynomials, e.g., to interpolate the solution in full
+// multigrid
+class Cubic {
+        public:
+        template <typename T>
+        void operator()(T *yf, const int nf, const T *xc, const int nc, const T a,
+                        const T b) {
+                grid_prolongate_cubic(yf, nf, nf, xc, nc, nc, a, b);
+        }
+        const char *name() {
+                return "cubic";
+        }
+};
+
+template <typename R=FullWeighting, typename I=Bilinear>
+class Transfer {
+        public:
+                R restriction;
+                I prolongation;
+
+                const char *name() {
+                        static char name[256];
+                        snprintf(name, sizeof(name), "%s, %s", restriction.name(),
+                                 prolongation.name());
+                        return name;
+                }
+};
+
+// Multigrid cycle of the given shape. The V-cycle visits the coarse grid
+// once, the W-cycle twice, and the F-cycle with an F-cycle followed by a
+// V-cycle. With `zero`, the initial guess u is zero and is not read (the
+// boundary must be zero). The coarse corrections always start from zero, so v
+// does not need to be cleared between cycles.
+template <typename T, typename S, typename X>
+void multigrid_cycle(const int l, S& smoother, X& transfer, const CycleOptions& cycle,
+                     T *u, T *f, T *r, T *v, T *w, const T h, const bool zero=false) {
 
         if (l == 1) {
                 base_case(u, f, h);
@@ -112,21 +459,95 @@ void multigrid_v_cycle(const int l, S& smoother, T *u, T *f, T *r, T *v, T *w, c
         T *el = &v[nv * nv];
         T *rl = &w[nv * nv];
 
-        smoother(u, f, nu, h);
-
-        // r^l := f - Lu^l
-        poisson_residual(r, u, f, nu, h);
+        // Pre-smoothing and r^l := f - Lu^l
+        int pre = cycle.pre;
+        if (pre == 0) {
+                // Without pre-smoothing, a zero initial guess is cleared
+                if (zero)
+                        memset(u, 0, sizeof(T) * nu * nu);
+                poisson_residual(r, u, f, nu, h);
+        }
+        for (int s = 0; s < pre - 1; ++s) {
+                if (zero && s == 0)
+                        smooth_zero(smoother, u, f, nu, h, 0);
+                else
+                        smoother(u, f, nu, h);
+        }
+        if (pre == 1 && zero)
+                smooth_residual_zero(smoother, u, f, r, nu, h, 0);
+        else if (pre > 0)
+                smooth_residual(smoother, u, f, r, nu, h, 0);
 
         // r^(l-1) := R * r 
-        grid_restrict(rl, nv, nv, r, nu, nu, 0.0, 1.0);
+        transfer.restriction(rl, nv, r, nu);
 
         // Solve: A^(l-1) e^(l-1) = r^(l-1)
-        multigrid_v_cycle(l - 1, smoother, el, rl, r, v, w, 2 * h); 
+        multigrid_cycle(l - 1, smoother, transfer, cycle, el, rl, r, v, w, 2 * h, true);
+        if (cycle.type != V_CYCLE) {
+                CycleOptions second = cycle;
+                if (cycle.type == F_CYCLE) second.type = V_CYCLE;
+                multigrid_cycle(l - 1, smoother, transfer, second, el, rl, r, v, w, 2 * h);
+        }
 
         // Prolongate and add correction u^l := u^l +  Pe^(l-1)
-        grid_prolongate(u, nu, nu, el, nv, nv, 1.0, 1.0);
+        transfer.prolongation(u, nu, el, nv, (T)1.0, (T)1.0);
+
+        for (int s = 0; s < cycle.post; ++s)
+                smoother(u, f, nu, h);
+}
 
-        smoother(u, f, nu, h);
+template <typename T, typename S, typename X>
+void multigrid_v_cycle(const int l, S& smoother, X& transfer, T *u, T *f, T *r,
+                       T *v, T *w, const T h, const bool zero=false) {
+        CycleOptions cycle;
+        multigrid_cycle(l, smoother, transfer, cycle, u, f, r, v, w, h, zero);
+}
+
+// Full weighting and bilinear interpolation
+template <typename T, typename S>
+void multigrid_v_cycle(const int l, S& smoother, T *u, T *f, T *r, T *v, T *w, const T h,
+                       const bool zero=false) {
+        Transfer<> transfer;
+        multigrid_v_cycle(l, smoother, transfer, u, f, r, v, w, h, zero);
+}
+
+// Full multigrid: the right-hand side is restricted to all grids (full
+// weighting, since restrictions such as half injection are only suitable for
+// residuals), and the solution of each grid, interpolated with the
+// prolongation of the transfer policy, is the initial guess of `cycles`
+// V-cycles on the next finer grid.
+// Grid k of the hierarchy is stored at offset n_k^2 of v (solution) and w
+// (right-hand side), which the V-cycles on grid k do not use. The boundary of
+// u is overwritten (homogeneous Dirichlet conditions), and the boundaries of
+// the grids in v and w must be zero.
+template <typename T, typename S, typename X>
+void multigrid_fmg(const int l, S& smoother, X& transfer, T *u, T *f, T *r, T *v,
+                   T *w, const T h, const int cycles=1) {
+
+        if (l == 1) {
+                base_case(u, f, h);
+                return;
+        }
+        auto grid = [&](T *x, const int k) {
+                int n = (1 << k) + 1;
+                return &x[n * n];
+        };
+        for (int k = l - 1; k >= 1; --k) {
+                int n = (1 << k) + 1;
+                T *fine = k == l - 1 ? f : grid(w, k + 1);
+                grid_restrict(grid(w, k), n, n, fine, 2 * n - 1, 2 * n - 1, (T)0.0, (T)1.0);
+        }
+        base_case(grid(v, 1), grid(w, 1), h * (1 << (l - 1)));
+        for (int k = 2; k <= l; ++k) {
+                int n = (1 << k) + 1;
+                T *uk = k == l ? u : grid(v, k);
+                T *fk = k == l ? f : grid(w, k);
+                int nc = (n + 1) / 2;
+                transfer.prolongation(uk, n, grid(v, k - 1), nc, (T)0.0, (T)1.0);
+                for (int c = 0; c < cycles; ++c)
+                        multigrid_v_cycle(k, smoother, transfer, uk, fk, r, v, w,
+                                          h * (1 << (l - k)));
+        }
 }
 
 // Size of all of the combined grids
@@ -139,7 +560,32 @@ size_t multigrid_size(const int l) {
         return size;
 }
 
-template <typename F, typename P, typename T>
+// Offset of grid l in a buffer of size multigrid_size
+size_t multigrid_offset(const int l) {
+        return multigrid_size(l - 1);
+}
+
+// Allocate a buffer of size multigrid_size(l). The grids used by
+// `multigrid_v_cycle` are first-touched in the same way as the kernels access
+// them. The remaining pages are zero.
+template <typename T>
+T *multigrid_alloc(const int l) {
+        T *v = (T*)memory_alloc(multigrid_size(l) * sizeof(T), MEMORY_HIERARCHY);
+        for (int k = 1; k < l; ++k) {
+                int n = (1 << k) + 1;
+                if (memory_options.placement != SERIAL)
+                        grid_first_touch(&v[n * n], n, n);
+        }
+        return v;
+}
+
+template <typename T>
+void multigrid_free(T *v, const int l) {
+        memory_free(v, multigrid_size(l) * sizeof(T));
+}
+
+// X is the transfer operator policy (restriction and prolongation)
+template <typename F, typename P, typename T, typename X=Transfer<>>
 class Multigrid {
         private:
                 // v and w are buffers of size (l + 1) * log (l + 1), 
@@ -150,31 +596,62 @@ class Multigrid {
                 size_t num_bytes = 0;
                 F smoother;
         public:
+                X transfer;
+                // Shape and sweeps of the cycle, see adaptive.hpp
+                CycleOptions cycle;
 
                 Multigrid() { }
                 Multigrid(P& p) : l(p.l) {
                         num_bytes = multigrid_size(l) * sizeof(T);
-                        v = (T*)malloc(num_bytes);
-                        w = (T*)malloc(num_bytes);
+                        v = multigrid_alloc<T>(l);
+                        w = multigrid_alloc<T>(l);
                         int n = (1 << p.l) + 1;
-                        r = (T*)malloc(sizeof(T) * n * n);
+                        r = grid_alloc<T>(n, n, MEMORY_SCRATCH);
                 }
 
+                // The coarse grids are overwritten before they are read, so
+                // v and w are not cleared (only their boundaries, which stay
+                // zero, are assumed)
                 void operator()(P& p) {
-                        memset(v, 0, num_bytes);
-                        memset(w, 0, num_bytes);
-                        multigrid_v_cycle<T, F>(l, smoother, p.u, p.f, r, v, w, p.h);
+                        multigrid_cycle(l, smoother, transfer, cycle, p.u, p.f, r, v, w,
+                                        p.h);
+                }
+
+                // Full multigrid from scratch (replaces p.u)
+                void fmg(P& p, const int cycles=1) {
+                        multigrid_fmg(l, smoother, transfer, p.u, p.f, r, v, w, p.h, cycles);
+                }
+
+                // Hierarchy of the last cycle (coarse corrections and
+                // residuals), for checkpointing
+                size_t state_bytes(void) {
+                        return 2 * num_bytes;
+                }
+
+                void save_state(char *out) {
+                        memcpy(out, v, num_bytes);
+                        memcpy(out + num_bytes, w, num_bytes);
+                }
+
+                void load_state(const char *in) {
+                        memcpy(v, in, num_bytes);
+                        memcpy(w, in + num_bytes, num_bytes);
                 }
 
                 ~Multigrid(void) {
-                        if (v != nullptr) free(v);
-                        if (w != nullptr) free(w);
-                        if (r != nullptr) free(r);
+                        int n = (1 << l) + 1;
+                        if (v != nullptr) multigrid_free(v, l);
+                        if (w != nullptr) multigrid_free(w, l);
+                        if (r != nullptr) grid_free(r, n, n);
                 }
 
                 const char *name() {
                         static char name[2048];
-                        sprintf(name, "Multi-Grid<%s>", smoother.name());
+                        if (std::is_same<X, Transfer<>>::value)
+                                sprintf(name, "Multi-Grid<%s>", smoother.name());
+                        else
+                                sprintf(name, "Multi-Grid<%s, %s>", smoother.name(),
+                                        transfer.name());
                         return name;
                 }
 
@@ -211,6 +688,12 @@ class GaussSeidelRedBlack {
                 gauss_seidel_red_black(u, f, n, h);
         }
 
+        // Smoothing of a zero initial guess
+        template <typename T>
+        void zero(T *u, const T *f, const int n, const T h) {
+                gauss_seidel_red_black_zero(u, f, n, h);
+        }
+
         template <typename P>
         void operator()(P& p) {
                 gauss_seidel_red_black(p.u, p.f, p.n, p.h);
@@ -221,6 +704,76 @@ class GaussSeidelRedBlack {
 
 };
 
+// Red-black Gauss-Seidel that provides the residual after pre-smoothing, so
+// that `multigrid_v_cycle` skips the separate residual pass
+class GaussSeidelRedBlackResidual {
+        public:
+                GaussSeidelRedBlackResidual() { }
+        template <typename P>
+                GaussSeidelRedBlackResidual(P& p) { }
+        template <typename T>
+        void operator()(T *u, const T *f, const int n, const T h) {
+                gauss_seidel_red_black(u, f, n, h);
+        }
+
+        template <typename T>
+        void operator()(T *u, const T *f, T *r, const int n, const T h) {
+                gauss_seidel_red_black_residual(u, f, r, n, h);
+        }
+
+        template <typename T>
+        void zero(T *u, const T *f, const int n, const T h) {
+                gauss_seidel_red_black_zero(u, f, n, h);
+        }
+
+        template <typename T>
+        void zero(T *u, const T *f, T *r, const int n, const T h) {
+                gauss_seidel_red_black_residual(u, f, r, n, h, true);
+        }
+
+        template <typename P>
+        void operator()(P& p) {
+                gauss_seidel_red_black(p.u, p.f, p.n, p.h);
+        }
+        const char *name() {
+                return "Gauss-Seidel (red-black, residual)";
+        }
+
+};
+
+class Jacobi {
+        private:
+                // Rolling rows of `jacobi`, sized for the finest grid seen
+                std::vector<char> scratch;
+
+                template <typename T>
+                T *rows(const int n) {
+                        if (scratch.size() < sizeof(T) * 2 * n)
+                                scratch.resize(sizeof(T) * 2 * n);
+                        return (T*)scratch.data();
+                }
+
+        public:
+                double omega = 0.8;
+                Jacobi() { }
+        template <typename P>
+                Jacobi(P& p) { }
+        template <typename T>
+        void operator()(T *u, const T *f, const int n, const T h) {
+                jacobi(u, f, n, h, (T)omega, rows<T>(n));
+        }
+
+        template <typename P>
+        void operator()(P& p) {
+                typedef decltype(p.h) T;
+                jacobi(p.u, p.f, p.n, p.h, (T)omega, rows<T>(p.n));
+        }
+        const char *name() {
+                return "Jacobi";
+        }
+
+};
+
 template <typename T>
 class Poisson {
         public:
@@ -230,26 +783,38 @@ class Poisson {
                 T modes;
                 T *u, *f, *r;
                 size_t num_bytes;
+                // Grids that are freed by the destructor
+                bool owns_u = true, owns_f = true, owns_r = true;
 
         Poisson(int l, T h, T modes) : l(l), h(h), modes(modes) {
                 n = (1 << l) + 1;
                 num_bytes = sizeof(T) * n * n;
-                u = (T*)malloc(num_bytes);
-                f = (T*)malloc(num_bytes);
-                r = (T*)malloc(num_bytes);
-                memset(u, 0, num_bytes);
-                memset(f, 0, num_bytes);
-                memset(r, 0, num_bytes);
+                u = grid_alloc<T>(n, n, MEMORY_PROBLEM);
+                f = grid_alloc<T>(n, n, MEMORY_PROBLEM);
+                r = grid_alloc<T>(n, n, MEMORY_PROBLEM);
                 forcing_function(f, n, h, modes);
         }
 
+        // View of existing grids (e.g., memory-mapped files). The right-hand
+        // side is not initialized. Grids that are not given are allocated.
+        Poisson(int l, T h, T modes, T *u, T *f, T *r=nullptr)
+            : l(l), h(h), modes(modes), u(u), f(f), r(r) {
+                n = (1 << l) + 1;
+                num_bytes = sizeof(T) * n * n;
+                owns_u = u == nullptr;
+                owns_f = f == nullptr;
+                owns_r = r == nullptr;
+                if (owns_u) this->u = grid_alloc<T>(n, n, MEMORY_PROBLEM);
+                if (owns_f) this->f = grid_alloc<T>(n, n, MEMORY_PROBLEM);
+                if (owns_r) this->r = grid_alloc<T>(n, n, MEMORY_PROBLEM);
+        }
+
         T error() {
-                T *v = (T*)malloc(num_bytes);
-                memset(v, 0, num_bytes);
+                T *v = grid_alloc<T>(n, n, MEMORY_SCRATCH);
                 exact_solution(v, n, h, modes);
                 grid_subtract(r, u, v, n, n);
                 T err = grid_l1norm(r, n, n, h, h);
-                free(v);
+                grid_free(v, n, n);
                 return err;
         }
 
@@ -262,9 +827,9 @@ class Poisson {
         }
 
         ~Poisson() {
-                free(u);
-                free(f);
-                free(r);
+                if (owns_u) grid_free(u, n, n);
+                if (owns_f) grid_free(f, n, n);
+                if (owns_r) grid_free(r, n, n);
         }
 };
 
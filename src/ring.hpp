@@ -0,0 +1,325 @@
+#pragma once
+#include <assert.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <poisson.hpp>
+#include <solver.hpp>
+// Ring of grid slots in shared memory for handing right-hand sides from an
+// external simulation (producer) to the solver (consumer) without copying.
+// Each slot holds u and f of a (2^l + 1)^2 grid. The producer fills f (and
+// the initial guess u) of a free slot and submits it, the solver solves in
+// place on a `Poisson` view of the slot, and the producer reads the solution
+// from u before releasing the slot.
+//
+// Three counters in the shared header order the slots: submitted (producer),
+// completed (solver) and released (producer). They are only incremented by
+// one side each, so no locks are needed. The number of slots is a power of
+// two and the slot of a count is count & (num_slots - 1), which stays
+// continuous when the 32-bit counters wrap around. A side that has to wait
+// spins briefly and then sleeps on the counter with a (process shared) futex;
+// the other side wakes it after incrementing.
+//
+//   Producer: SharedRing ring("/mg_ring", l, 4);
+//             int k = ring.acquire();
+//             (fill ring.f(k) and ring.u(k))
+//             ring.submit(k, opts);
+//             k = ring.wait_solution();
+//             (read ring.u(k))
+//             ring.release(k);      (slots are released in order)
+//
+//   Solver:   SharedRing ring("/mg_ring");
+//             ring_serve<Multigrid<GaussSeidelRedBlack, Poisson<double>, double>>(ring);
+
+struct RingSlotInfo {
+        // Request
+        double eps;
+        int32_t max_iterations;
+        // Result
+        int32_t iterations;
+        double residual;
+};
+
+struct RingHeader {
+        uint32_t magic;
+        int32_t l;
+        int32_t num_slots;
+        int32_t type_size;
+        uint64_t slot_bytes;
+        uint64_t header_bytes;
+        // Each counter on its own cache line
+        alignas(64) std::atomic<uint32_t> submitted;
+        alignas(64) std::atomic<uint32_t> completed;
+        alignas(64) std::atomic<uint32_t> released;
+        alignas(64) std::atomic<uint32_t> closed;
+};
+
+static const uint32_t ring_magic = 0x4d47524e;
+
+// Sleeps while *word == value. The timeout bounds the wait if the ring is
+// closed between checking the flag and sleeping.
+__inline__ void ring_futex_wait(std::atomic<uint32_t> *word, const uint32_t value) {
+        struct timespec timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_nsec = 10000000;
+        syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, value, &timeout, nullptr, 0);
+}
+
+__inline__ void ring_futex_wake(std::atomic<uint32_t> *word) {
+        syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+class SharedRing {
+        private:
+                int fd = -1;
+                char *map = 0;
+                size_t map_bytes = 0;
+                std::string name;
+                bool owner = false;
+
+                size_t round_up(const size_t num_bytes) {
+                        return (num_bytes + 4095) / 4096 * 4096;
+                }
+
+                void map_fd(const size_t num_bytes) {
+                        map_bytes = num_bytes;
+                        map = (char*)mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED, fd, 0);
+                        if (map == MAP_FAILED) {
+                                fprintf(stderr, "SharedRing: failed to map the ring.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        header = (RingHeader*)map;
+                        info = (RingSlotInfo*)(map + sizeof(RingHeader));
+                }
+
+                void create(const int l, const int num_slots) {
+                        if (num_slots < 1 || (num_slots & (num_slots - 1)) != 0) {
+                                fprintf(stderr, "SharedRing: the number of slots must be "
+                                        "a power of two.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        int n = (1 << l) + 1;
+                        size_t slot_bytes = round_up(2 * sizeof(double) * n * n);
+                        size_t header_bytes = round_up(sizeof(RingHeader) +
+                                                       num_slots * sizeof(RingSlotInfo));
+                        size_t num_bytes = header_bytes + slot_bytes * num_slots;
+                        if (ftruncate(fd, num_bytes) != 0) {
+                                fprintf(stderr, "SharedRing: failed to create the ring.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        map_fd(num_bytes);
+                        header->l = l;
+                        header->num_slots = num_slots;
+                        header->type_size = sizeof(double);
+                        header->slot_bytes = slot_bytes;
+                        header->header_bytes = header_bytes;
+                        header->submitted.store(0);
+                        header->completed.store(0);
+                        header->released.store(0);
+                        header->closed.store(0);
+                        std::atomic_thread_fence(std::memory_order_release);
+                        header->magic = ring_magic;
+                }
+
+                void attach(void) {
+                        struct stat st;
+                        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RingHeader)) {
+                                fprintf(stderr, "SharedRing: not a ring.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        map_fd(st.st_size);
+                        if (header->magic != ring_magic ||
+                            header->type_size != sizeof(double) ||
+                            header->num_slots < 1 ||
+                            (header->num_slots & (header->num_slots - 1)) != 0 ||
+                            header->header_bytes + header->slot_bytes * header->num_slots >
+                            map_bytes) {
+                                fprintf(stderr, "SharedRing: not a ring.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                }
+
+                // Wait until counter != value
+                void wait_change(std::atomic<uint32_t> *counter, const uint32_t value) {
+                        for (int spin = 0; spin < spin_count; ++spin)
+                                if (counter->load(std::memory_order_acquire) != value ||
+                                    header->closed.load(std::memory_order_acquire))
+                                        return;
+                        while (counter->load(std::memory_order_acquire) == value &&
+                               !header->closed.load(std::memory_order_acquire))
+                                ring_futex_wait(counter, value);
+                }
+
+        public:
+                RingHeader *header = 0;
+                RingSlotInfo *info = 0;
+                // Polls before sleeping on a futex
+                int spin_count = 1000;
+
+                SharedRing(const SharedRing&) = delete;
+
+                // Create an anonymous ring (memfd). Other processes attach to
+                // it through its file descriptor, e.g., passed over a Unix
+                // domain socket (see service.hpp).
+                SharedRing(const int l, const int num_slots) {
+                        fd = memfd_create("multigrid_ring", MFD_CLOEXEC);
+                        if (fd < 0) {
+                                fprintf(stderr, "SharedRing: failed to create the ring.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        create(l, num_slots);
+                }
+
+                // Create a named ring (shm_open)
+                SharedRing(const char *name, const int l, const int num_slots)
+                    : name(name), owner(true) {
+                        fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+                        if (fd < 0) {
+                                fprintf(stderr, "SharedRing: failed to create %s.\n", name);
+                                exit(EXIT_FAILURE);
+                        }
+                        create(l, num_slots);
+                }
+
+                // Attach to a named ring
+                SharedRing(const char *name) {
+                        fd = shm_open(name, O_RDWR, 0600);
+                        if (fd < 0) {
+                                fprintf(stderr, "SharedRing: failed to open %s.\n", name);
+                                exit(EXIT_FAILURE);
+                        }
+                        attach();
+                }
+
+                // Attach to a ring through its file descriptor
+                SharedRing(const int ring_fd) {
+                        fd = dup(ring_fd);
+                        attach();
+                }
+
+                int file_descriptor(void) { return fd; }
+                int l(void) { return header->l; }
+                int n(void) { return (1 << header->l) + 1; }
+                int num_slots(void) { return header->num_slots; }
+                bool closed(void) { return header->closed.load(std::memory_order_acquire); }
+
+                // Slot of a counter value
+                int slot(const uint32_t count) {
+                        return count & (uint32_t)(header->num_slots - 1);
+                }
+
+                double *u(const int k) {
+                        return (double*)(map + header->header_bytes + header->slot_bytes * k);
+                }
+
+                double *f(const int k) {
+                        return u(k) + (size_t)n() * n();
+                }
+
+                // Producer: wait for a free slot
+                int acquire(void) {
+                        uint32_t s = header->submitted.load(std::memory_order_relaxed);
+                        for (;;) {
+                                uint32_t r = header->released.load(std::memory_order_acquire);
+                                if (s - r < (uint32_t)header->num_slots)
+                                        return slot(s);
+                                wait_change(&header->released, r);
+                        }
+                }
+
+                // Producer: hand the slot to the solver
+                void submit(const int k, const SolverOptions& opts) {
+                        info[k].eps = opts.eps;
+                        info[k].max_iterations = opts.max_iterations;
+                        header->submitted.fetch_add(1, std::memory_order_release);
+                        ring_futex_wake(&header->submitted);
+                }
+
+                // Producer: wait for the oldest submitted slot to be solved.
+                // Returns -1 if the ring was closed.
+                int wait_solution(void) {
+                        uint32_t r = header->released.load(std::memory_order_relaxed);
+                        for (;;) {
+                                uint32_t c = header->completed.load(std::memory_order_acquire);
+                                if (c != r) return slot(r);
+                                if (closed()) return -1;
+                                wait_change(&header->completed, c);
+                        }
+                }
+
+                // Producer: the solution has been read, the slot can be reused.
+                // k must be the oldest slot that has not been released.
+                void release(const int k) {
+                        assert(k == slot(header->released.load(std::memory_order_relaxed)));
+                        header->released.fetch_add(1, std::memory_order_release);
+                        ring_futex_wake(&header->released);
+                }
+
+                // Solver: wait for the next submitted slot. Returns -1 once the
+                // ring is closed and all submitted slots are solved.
+                int next(void) {
+                        uint32_t c = header->completed.load(std::memory_order_relaxed);
+                        for (;;) {
+                                uint32_t s = header->submitted.load(std::memory_order_acquire);
+                                if (s != c) return slot(c);
+                                if (closed()) return -1;
+                                wait_change(&header->submitted, s);
+                        }
+                }
+
+                // Solver: the slot holds the solution
+                void complete(const int k, const SolverOutput& out) {
+                        info[k].iterations = out.iterations;
+                        info[k].residual = out.residual;
+                        header->completed.fetch_add(1, std::memory_order_release);
+                        ring_futex_wake(&header->completed);
+                }
+
+                // No more slots will be submitted
+                void close_ring(void) {
+                        header->closed.store(1, std::memory_order_release);
+                        ring_futex_wake(&header->submitted);
+                        ring_futex_wake(&header->completed);
+                        ring_futex_wake(&header->released);
+                }
+
+                ~SharedRing(void) {
+                        if (map != nullptr && map != MAP_FAILED) munmap(map, map_bytes);
+                        if (fd >= 0) close(fd);
+                        if (owner) shm_unlink(name.c_str());
+                }
+};
+
+// Solve the slots of a ring in place until it is closed. Returns the number
+// of solves.
+template <typename S>
+long ring_serve(SharedRing& ring) {
+        int l = ring.l();
+        int n = ring.n();
+        double h = 1.0 / (n - 1);
+        double *r = grid_alloc<double>(n, n, MEMORY_PROBLEM);
+        Poisson<double> first(l, h, 1.0, ring.u(0), ring.f(0), r);
+        S solver(first);
+        long count = 0;
+        int k;
+        while ((k = ring.next()) >= 0) {
+                Poisson<double> problem(l, h, 1.0, ring.u(k), ring.f(k), r);
+                SolverOptions opts;
+                opts.eps = ring.info[k].eps;
+                opts.max_iterations = ring.info[k].max_iterations;
+                ring.complete(k, solve(solver, problem, opts));
+                count++;
+        }
+        grid_free(r, n, n);
+        return count;
+}
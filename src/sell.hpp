@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <csr.hpp>
+// Sparse matrices in SELL-C-sigma (sliced ELLPACK) format. Rows are sorted by
+// length within windows of sigma rows and grouped into slices of C rows. Each
+// slice is padded to its longest row and stored column by column, so that the
+// C rows of a slice are processed together in SIMD lanes:
+//
+//   val[slice_ptr[s] + k * C + c] is entry k of row perm[s * C + c].
+//
+// Padding entries are zero and refer to column 0. The entries of each row are
+// summed in the same order as in CSR, so the kernels give the same results as
+// their CSR counterparts.
+
+template <typename T, int C=8>
+class SELLMatrix {
+        public:
+                int rows = 0, cols = 0, num_slices = 0;
+                // Original row of each sorted row (padded to whole slices)
+                std::vector<int> perm;
+                std::vector<int> slice_ptr, slice_len;
+                std::vector<int> idx;
+                std::vector<T> val;
+
+                SELLMatrix() { }
+                SELLMatrix(const CSRMatrix<T>& A, const int sigma=16 * C)
+                    : rows(A.rows), cols(A.cols) {
+                        num_slices = (rows + C - 1) / C;
+                        perm.resize(num_slices * C);
+                        for (int i = 0; i < rows; ++i)
+                                perm[i] = i;
+                        // Padding rows are empty
+                        for (int i = rows; i < num_slices * C; ++i)
+                                perm[i] = -1;
+                        auto length = [&](const int i) {
+                                return i < 0 ? 0 : A.ptr[i + 1] - A.ptr[i];
+                        };
+                        for (int w = 0; w < rows; w += sigma)
+                                std::stable_sort(perm.begin() + w,
+                                                 perm.begin() + std::min(rows, w + sigma),
+                                                 [&](const int a, const int b) {
+                                                         return length(a) > length(b);
+                                                 });
+                        slice_ptr.resize(num_slices + 1, 0);
+                        slice_len.resize(num_slices, 0);
+                        for (int s = 0; s < num_slices; ++s) {
+                                for (int c = 0; c < C; ++c)
+                                        slice_len[s] = std::max(slice_len[s], length(perm[s * C + c]));
+                                slice_ptr[s + 1] = slice_ptr[s] + slice_len[s] * C;
+                        }
+                        idx.assign(slice_ptr[num_slices], 0);
+                        val.assign(slice_ptr[num_slices], 0.0);
+                        #pragma omp parallel for schedule(static) if (rows >= CSR_OMP_MIN_ROWS)
+                        for (int s = 0; s < num_slices; ++s) {
+                                for (int c = 0; c < C; ++c) {
+                                        int i = perm[s * C + c];
+                                        if (i < 0) continue;
+                                        for (int k = 0; k < length(i); ++k) {
+                                                idx[slice_ptr[s] + k * C + c] = A.idx[A.ptr[i] + k];
+                                                val[slice_ptr[s] + k * C + c] = A.val[A.ptr[i] + k];
+                                        }
+                                }
+                        }
+                }
+
+                // Stored entries (including padding)
+                size_t size(void) const {
+                        return slice_ptr[num_slices];
+                }
+
+                size_t bytes(void) const {
+                        return sizeof(int) * (perm.capacity() + slice_ptr.capacity() +
+                                              slice_len.capacity() + idx.capacity()) +
+                               sizeof(T) * val.capacity();
+                }
+};
+
+// Row sums of slice s, sum[c] = (A x)_perm[s * C + c]
+template <typename T, int C>
+__inline__ void sell_slice(T *sum, const SELLMatrix<T, C>& A, const T *x, const int s) {
+        const int *idx = &A.idx[A.slice_ptr[s]];
+        const T *val = &A.val[A.slice_ptr[s]];
+        #pragma omp simd
+        for (int c = 0; c < C; ++c)
+                sum[c] = 0.0;
+        for (int k = 0; k < A.slice_len[s]; ++k) {
+                #pragma omp simd
+                for (int c = 0; c < C; ++c)
+                        sum[c] += val[k * C + c] * x[idx[k * C + c]];
+        }
+}
+
+// y := A x
+template <typename T, int C>
+void sell_spmv(T *y, const SELLMatrix<T, C>& A, const T *x) {
+        #pragma omp parallel for schedule(static) if (A.rows >= CSR_OMP_MIN_ROWS)
+        for (int s = 0; s < A.num_slices; ++s) {
+                T sum[C];
+                sell_slice(sum, A, x, s);
+                for (int c = 0; c < C; ++c) {
+                        int i = A.perm[s * C + c];
+                        if (i >= 0) y[i] = sum[c];
+                }
+        }
+}
+
+// r := b - A x
+template <typename T, int C>
+void sell_residual(T *r, const SELLMatrix<T, C>& A, const T *x, const T *b) {
+        #pragma omp parallel for schedule(static) if (A.rows >= CSR_OMP_MIN_ROWS)
+        for (int s = 0; s < A.num_slices; ++s) {
+                T sum[C];
+                sell_slice(sum, A, x, s);
+                for (int c = 0; c < C; ++c) {
+                        int i = A.perm[s * C + c];
+                        if (i >= 0) r[i] = b[i] - sum[c];
+                }
+        }
+}
+
+// Damped Jacobi step y := x + omega D^-1 (b - A x) (y and x must not alias)
+template <typename T, int C>
+void sell_jacobi(T *y, const SELLMatrix<T, C>& A, const T *x, const T *b,
+                 const T *dinv, const T omega) {
+        #pragma omp parallel for schedule(static) if (A.rows >= CSR_OMP_MIN_ROWS)
+        for (int s = 0; s < A.num_slices; ++s) {
+                T sum[C];
+                sell_slice(sum, A, x, s);
+                for (int c = 0; c < C; ++c) {
+                        int i = A.perm[s * C + c];
+                        if (i >= 0) y[i] = x[i] + omega * dinv[i] * (b[i] - sum[c]);
+                }
+        }
+}
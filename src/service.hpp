@@ -0,0 +1,459 @@
+#pragma once
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <poisson.hpp>
+#include <solver.hpp>
+// Local solve service. A long-running process (`SolveService`) accepts solve
+// requests over a Unix domain socket so that several processes on a node can
+// share one set of threads and warm multigrid hierarchies. The grids are not
+// sent over the socket: the client creates a shared memory file (memfd)
+// holding u followed by f and passes its file descriptor with the request.
+// The service maps it, solves in place and replies when u holds the solution.
+//
+// Requests for the same grid size that arrive within `batch_window` seconds of
+// each other are solved as one batch. Small grids are solved concurrently
+// (one grid per thread), large grids one after the other with all threads.
+// Each grid size keeps a plan with one solver (hierarchy) and residual grid
+// per batch slot, so repeated requests do not allocate.
+//
+//   Service:  SolveService service("/tmp/mg.sock");
+//             service.run();
+//
+//   Client:   SolveClient client("/tmp/mg.sock");
+//             ServiceBuffer buffer(l);
+//             (fill buffer.f and the initial guess buffer.u)
+//             ServiceReply reply = client.solve(buffer, opts);
+
+enum service_request_type {
+        SERVICE_SOLVE = 0,
+        // Stop the service after the pending requests
+        SERVICE_SHUTDOWN = 1
+};
+
+enum service_status {
+        SERVICE_OK = 0,
+        SERVICE_BAD_REQUEST = 1,
+        SERVICE_BAD_BUFFER = 2
+};
+
+struct ServiceRequest {
+        uint32_t magic;
+        int32_t type;
+        int32_t l;
+        int32_t type_size;
+        int32_t max_iterations;
+        int32_t reserved;
+        double eps;
+        uint64_t id;
+};
+
+struct ServiceReply {
+        uint64_t id;
+        int32_t status;
+        int32_t iterations;
+        double residual;
+};
+
+static const uint32_t service_magic = 0x4d47534c;
+
+// Send a message with an optional file descriptor
+bool service_send(int socket, const void *msg, const size_t len, const int fd=-1) {
+        struct iovec iov;
+        iov.iov_base = (void*)msg;
+        iov.iov_len = len;
+        struct msghdr header;
+        memset(&header, 0, sizeof(header));
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        char control[CMSG_SPACE(sizeof(int))];
+        if (fd >= 0) {
+                memset(control, 0, sizeof(control));
+                header.msg_control = control;
+                header.msg_controllen = sizeof(control);
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+                memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+        }
+        return sendmsg(socket, &header, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+// Receive a message of exactly len bytes. fd is set to the received file
+// descriptor or -1. Returns false on error or if the peer has disconnected.
+bool service_recv(int socket, void *msg, const size_t len, int *fd) {
+        struct iovec iov;
+        iov.iov_base = msg;
+        iov.iov_len = len;
+        struct msghdr header;
+        memset(&header, 0, sizeof(header));
+        header.msg_iov = &iov;
+        header.msg_iovlen = 1;
+        char control[CMSG_SPACE(sizeof(int))];
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+        ssize_t k = recvmsg(socket, &header, MSG_CMSG_CLOEXEC);
+        if (fd != nullptr) *fd = -1;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header);
+        if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_RIGHTS) {
+                int received;
+                memcpy(&received, CMSG_DATA(cmsg), sizeof(int));
+                if (fd != nullptr) *fd = received;
+                else close(received);
+        }
+        return k == (ssize_t)len;
+}
+
+sockaddr_un service_address(const char *path) {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+        return address;
+}
+
+// Shared memory holding u and f of a (2^l + 1)^2 grid
+class ServiceBuffer {
+        private:
+                size_t num_bytes = 0;
+        public:
+                int fd = -1;
+                int l, n;
+                double *u = 0, *f = 0;
+
+                ServiceBuffer(const ServiceBuffer&) = delete;
+                ServiceBuffer(const int l) : l(l) {
+                        n = (1 << l) + 1;
+                        num_bytes = 2 * sizeof(double) * n * n;
+                        fd = memfd_create("multigrid", MFD_CLOEXEC);
+                        if (fd < 0 || ftruncate(fd, num_bytes) != 0) {
+                                fprintf(stderr, "ServiceBuffer: failed to create "
+                                        "shared memory.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        u = (double*)mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE,
+                                          MAP_SHARED, fd, 0);
+                        if ((void*)u == MAP_FAILED) {
+                                fprintf(stderr, "ServiceBuffer: failed to map "
+                                        "shared memory.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        f = u + (size_t)n * n;
+                }
+
+                ~ServiceBuffer(void) {
+                        if (u != nullptr && (void*)u != MAP_FAILED) munmap(u, num_bytes);
+                        if (fd >= 0) close(fd);
+                }
+};
+
+class SolveClient {
+        private:
+                int sock = -1;
+                uint64_t next_id = 0;
+
+                void send(const ServiceRequest& request, const int fd) {
+                        if (!service_send(sock, &request, sizeof(request), fd)) {
+                                fprintf(stderr, "SolveClient: failed to send request.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                }
+
+        public:
+                SolveClient(const SolveClient&) = delete;
+                SolveClient(const char *path) {
+                        sockaddr_un address = service_address(path);
+                        sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+                        if (sock < 0 || connect(sock, (sockaddr*)&address,
+                                                sizeof(address)) != 0) {
+                                fprintf(stderr, "SolveClient: failed to connect to "
+                                        "%s.\n", path);
+                                exit(EXIT_FAILURE);
+                        }
+                }
+
+                // Solve L u = f in place, starting from the initial guess in
+                // buffer.u. Blocks until the service replies.
+                ServiceReply solve(ServiceBuffer& buffer, const SolverOptions& opts) {
+                        ServiceRequest request;
+                        memset(&request, 0, sizeof(request));
+                        request.magic = service_magic;
+                        request.type = SERVICE_SOLVE;
+                        request.l = buffer.l;
+                        request.type_size = sizeof(double);
+                        request.max_iterations = opts.max_iterations;
+                        request.eps = opts.eps;
+                        request.id = next_id++;
+                        send(request, buffer.fd);
+
+                        ServiceReply reply;
+                        if (!service_recv(sock, &reply, sizeof(reply), nullptr) ||
+                            reply.id != request.id) {
+                                fprintf(stderr, "SolveClient: no reply from the service.\n");
+                                exit(EXIT_FAILURE);
+                        }
+                        return reply;
+                }
+
+                // Ask the service to stop
+                void shutdown(void) {
+                        ServiceRequest request;
+                        memset(&request, 0, sizeof(request));
+                        request.magic = service_magic;
+                        request.type = SERVICE_SHUTDOWN;
+                        send(request, -1);
+                }
+
+                ~SolveClient(void) {
+                        if (sock >= 0) close(sock);
+                }
+};
+
+class SolveService {
+        private:
+                using Problem = Poisson<double>;
+                using Solver = Multigrid<GaussSeidelRedBlack, Problem, double>;
+
+                struct Pending {
+                        int client;
+                        int fd;
+                        ServiceRequest request;
+                        double arrival;
+                };
+
+                // Warm solvers and residual grids for one grid size
+                struct Plan {
+                        int l = 0;
+                        std::vector<std::unique_ptr<Solver>> solvers;
+                        std::vector<double*> residuals;
+                };
+
+                int sock = -1;
+                std::string path;
+                std::vector<int> clients;
+                std::vector<Pending> pending;
+                std::map<int, Plan> plans;
+                bool stopping = false;
+
+                void reply(const Pending& p, const int status, const int iterations=0,
+                           const double residual=0.0) {
+                        ServiceReply r;
+                        r.id = p.request.id;
+                        r.status = status;
+                        r.iterations = iterations;
+                        r.residual = residual;
+                        // The client may have disconnected
+                        service_send(p.client, &r, sizeof(r));
+                }
+
+                void receive(const int client) {
+                        Pending p;
+                        p.client = client;
+                        p.arrival = omp_get_wtime();
+                        if (!service_recv(client, &p.request, sizeof(p.request), &p.fd)) {
+                                if (p.fd >= 0) close(p.fd);
+                                disconnect(client);
+                                return;
+                        }
+                        if (p.request.magic != service_magic) {
+                                if (p.fd >= 0) close(p.fd);
+                                reply(p, SERVICE_BAD_REQUEST);
+                                return;
+                        }
+                        if (p.request.type == SERVICE_SHUTDOWN) {
+                                if (p.fd >= 0) close(p.fd);
+                                stopping = true;
+                                return;
+                        }
+                        if (p.request.type != SERVICE_SOLVE || p.fd < 0 ||
+                            p.request.l < 1 || p.request.l > 15 ||
+                            p.request.type_size != sizeof(double)) {
+                                if (p.fd >= 0) close(p.fd);
+                                reply(p, SERVICE_BAD_REQUEST);
+                                return;
+                        }
+                        pending.push_back(p);
+                        num_requests++;
+                }
+
+                void disconnect(const int client) {
+                        close(client);
+                        clients.erase(std::find(clients.begin(), clients.end(), client));
+                        // Requests of the client can no longer be answered
+                        for (size_t k = 0; k < pending.size(); ++k)
+                                if (pending[k].client == client) pending[k].client = -1;
+                }
+
+                Plan& plan(const int l, Problem& problem, const int batch) {
+                        Plan& p = plans[l];
+                        p.l = l;
+                        int n = (1 << l) + 1;
+                        while ((int)p.solvers.size() < batch) {
+                                p.solvers.emplace_back(new Solver(problem));
+                                p.residuals.push_back(grid_alloc<double>(n, n, MEMORY_PLAN));
+                        }
+                        return p;
+                }
+
+                // Solve up to max_batch pending requests of the same size as
+                // the oldest one
+                void solve_batch(void) {
+                        int l = pending[0].request.l;
+                        int n = (1 << l) + 1;
+                        double h = 1.0 / (n - 1);
+                        size_t num_bytes = 2 * sizeof(double) * n * n;
+                        std::vector<Pending> batch;
+                        std::vector<Pending> rest;
+                        for (size_t k = 0; k < pending.size(); ++k) {
+                                if (pending[k].request.l == l && (int)batch.size() < max_batch)
+                                        batch.push_back(pending[k]);
+                                else
+                                        rest.push_back(pending[k]);
+                        }
+                        pending.swap(rest);
+
+                        // Map the buffers
+                        int size = batch.size();
+                        std::vector<double*> maps(size, nullptr);
+                        for (int k = 0; k < size; ++k) {
+                                struct stat st;
+                                if (fstat(batch[k].fd, &st) == 0 &&
+                                    (size_t)st.st_size >= num_bytes) {
+                                        void *m = mmap(nullptr, num_bytes,
+                                                       PROT_READ | PROT_WRITE, MAP_SHARED,
+                                                       batch[k].fd, 0);
+                                        if (m != MAP_FAILED) maps[k] = (double*)m;
+                                }
+                                close(batch[k].fd);
+                        }
+
+                        std::vector<std::unique_ptr<Problem>> problems(size);
+                        Plan *p = nullptr;
+                        for (int k = 0; k < size; ++k) {
+                                if (maps[k] == nullptr) continue;
+                                double *u = maps[k];
+                                double *f = u + (size_t)n * n;
+                                if (p == nullptr) {
+                                        Problem tmp(l, h, 1.0, u, f, u);
+                                        p = &plan(l, tmp, size);
+                                }
+                                problems[k].reset(new Problem(l, h, 1.0, u, f,
+                                                              p->residuals[k]));
+                        }
+
+                        // Small grids: one grid per thread
+                        bool across = size > 1 && n < batch_min_size;
+                        std::vector<SolverOutput> outputs(size);
+                        #pragma omp parallel for schedule(dynamic) if (across)
+                        for (int k = 0; k < size; ++k) {
+                                if (!problems[k]) continue;
+                                SolverOptions opts;
+                                opts.eps = batch[k].request.eps;
+                                opts.max_iterations = batch[k].request.max_iterations;
+                                outputs[k] = solve(*p->solvers[k], *problems[k], opts);
+                        }
+
+                        for (int k = 0; k < size; ++k) {
+                                problems[k].reset();
+                                if (maps[k] != nullptr) munmap(maps[k], num_bytes);
+                                if (batch[k].client < 0) continue;
+                                if (maps[k] == nullptr)
+                                        reply(batch[k], SERVICE_BAD_BUFFER);
+                                else
+                                        reply(batch[k], SERVICE_OK, outputs[k].iterations,
+                                              outputs[k].residual);
+                        }
+                        num_batches++;
+                }
+
+        public:
+                // Maximum number of requests solved together
+                int max_batch = 16;
+                // Time (s) to wait for more requests of the same size
+                double batch_window = 1e-4;
+                // Grids with fewer points per side are solved concurrently
+                int batch_min_size = 1025;
+                // Statistics
+                long num_requests = 0, num_batches = 0;
+
+                SolveService(const SolveService&) = delete;
+                SolveService(const char *path) : path(path) {
+                        sockaddr_un address = service_address(path);
+                        unlink(path);
+                        sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+                        if (sock < 0 ||
+                            bind(sock, (sockaddr*)&address, sizeof(address)) != 0 ||
+                            listen(sock, 64) != 0) {
+                                fprintf(stderr, "SolveService: failed to listen on %s.\n",
+                                        path);
+                                exit(EXIT_FAILURE);
+                        }
+                }
+
+                // Serve requests until a client sends SERVICE_SHUTDOWN
+                void run(void) {
+                        while (!stopping || !pending.empty()) {
+                                // Wait for requests, or until the batch window of
+                                // the oldest pending request has passed
+                                timespec timeout;
+                                timespec *wait = nullptr;
+                                if (!pending.empty()) {
+                                        double t = pending[0].arrival + batch_window -
+                                                   omp_get_wtime();
+                                        if (t < 0 || (int)pending.size() >= max_batch)
+                                                t = 0;
+                                        timeout.tv_sec = (time_t)t;
+                                        timeout.tv_nsec = (long)(1e9 * (t - timeout.tv_sec));
+                                        wait = &timeout;
+                                }
+                                std::vector<pollfd> fds(clients.size() + 1);
+                                fds[0].fd = sock;
+                                fds[0].events = POLLIN;
+                                for (size_t k = 0; k < clients.size(); ++k) {
+                                        fds[k + 1].fd = clients[k];
+                                        fds[k + 1].events = POLLIN;
+                                }
+                                if (!stopping) ppoll(fds.data(), fds.size(), wait, nullptr);
+
+                                for (size_t k = 1; k < fds.size(); ++k)
+                                        if (fds[k].revents & (POLLIN | POLLHUP | POLLERR))
+                                                receive(fds[k].fd);
+                                if (fds[0].revents & POLLIN) {
+                                        int client = accept4(sock, nullptr, nullptr,
+                                                             SOCK_CLOEXEC);
+                                        if (client >= 0) clients.push_back(client);
+                                }
+
+                                if (!pending.empty() &&
+                                    ((int)pending.size() >= max_batch || stopping ||
+                                     omp_get_wtime() >= pending[0].arrival + batch_window))
+                                        solve_batch();
+                        }
+                }
+
+                ~SolveService(void) {
+                        for (size_t k = 0; k < clients.size(); ++k) close(clients[k]);
+                        for (auto& p : plans) {
+                                int n = (1 << p.first) + 1;
+                                for (size_t k = 0; k < p.second.residuals.size(); ++k)
+                                        grid_free(p.second.residuals[k], n, n);
+                        }
+                        if (sock >= 0) close(sock);
+                        unlink(path.c_str());
+                }
+};
@@ -1,4 +1,8 @@
 #pragma once
+#include <omp.h>
+#include <vector>
+#include <adaptive.hpp>
+#include <work.hpp>
 
 class SolverOptions {
        public:
@@ -7,39 +11,107 @@ class SolverOptions {
         double eps = 1e-12;
         int info = 1.0;
         int mms = 0;
+        // Choose the cycle of solvers that have one (e.g., `Multigrid`) from
+        // the observed convergence, see adaptive.hpp
+        int adaptive = 0;
 };
 
 class SolverOutput {
         public:
-                double residual;
-                int iterations;
-                double error;
+                double residual = 0.0;
+                int iterations = 0;
+                double error = 0.0;
+                // Residual norm after each iteration
+                std::vector<double> history;
+                // Changes of the cycle with SolverOptions::adaptive
+                std::vector<CycleDecision> decisions;
+                // Operation counts of the kernels, see work.hpp
+                WorkCounts work;
 };
 
+// Called after each iteration, for example to write checkpoints
+class NoObserver {
+        public:
+                template <typename F, typename P>
+                void operator()(F& solver, P& problem, SolverOptions& opts,
+                                SolverOutput& out) { }
+};
 
-template <typename F, typename P, typename T=double>
-SolverOutput solve(F& solver, P& problem, SolverOptions opts) {
+
+// Solvers with a configurable cycle (member `cycle`) are adapted after each
+// iteration, the decisions are logged in `out`
+template <typename F>
+auto adapt_cycle(F& solver, CycleController& controller, SolverOptions& opts,
+                 SolverOutput& out, const double prev, const double res,
+                 const double seconds, int) -> decltype(solver.cycle, void()) {
+        CycleDecision d;
+        if (!controller.update(solver.cycle, out.iterations, prev, res, seconds,
+                               opts.eps, d))
+                return;
+        out.decisions.push_back(d);
+        char from[32], to[32];
+        if (opts.verbose)
+                printf("Cycle: %s -> %s after iteration %d (%s, rate %g, %g s per cycle) \n",
+                       d.from.name(from, sizeof(from)), d.to.name(to, sizeof(to)),
+                       d.iteration, d.reason, d.rate, d.seconds);
+}
+template <typename F>
+void adapt_cycle(F& solver, CycleController& controller, SolverOptions& opts,
+                 SolverOutput& out, const double prev, const double res,
+                 const double seconds, long) { }
+
+// Continues from the iteration count and residual history in `start`
+template <typename F, typename P, typename O, typename T=double>
+SolverOutput solve(F& solver, P& problem, SolverOptions opts, O& observer,
+                   SolverOutput start) {
 
         if (opts.verbose) {
                 printf("Solver: %s \n", solver.name());
                 printf("Iteration \t Residual\n");
         }
         
-        T res = 0.0;
-        int iter = 0;
-        do {
-                solver(problem);
-                problem.residual();
-                res = problem.norm();
-                iter++;
-                if (iter % opts.info == 0 && opts.verbose)
-                printf("%-7d \t %-7.7g \n", iter, res);
-
-        } while (res > opts.eps && (iter < opts.max_iterations || opts.max_iterations < 0));
-
-        SolverOutput out;
+        SolverOutput out = start;
+        T res = out.history.empty() ? 0.0 : out.history.back();
+        int iter = out.iterations;
+        // A resumed solve may already have converged
+        bool done = iter > 0 && (res <= opts.eps ||
+                                 (iter >= opts.max_iterations &&
+                                  opts.max_iterations >= 0));
+        CycleController controller;
+        // Counts of this solve only, also when solves run concurrently
+        WorkCounts work;
+        {
+                WorkScope scope(&work);
+                if (!done) do {
+                        double begin = omp_get_wtime();
+                        T prev = res;
+                        solver(problem);
+                        problem.residual();
+                        res = problem.norm();
+                        double seconds = omp_get_wtime() - begin;
+                        iter++;
+                        if (iter % opts.info == 0 && opts.verbose)
+                        printf("%-7d \t %-7.7g \n", iter, res);
+
+                        out.iterations = iter;
+                        out.residual = res;
+                        out.history.push_back(res);
+                        if (opts.adaptive)
+                                adapt_cycle(solver, controller, opts, out, prev, res, seconds, 0);
+                        observer(solver, problem, opts, out);
+
+                } while (res > opts.eps &&
+                         (iter < opts.max_iterations || opts.max_iterations < 0));
+        }
+        // The counters of the caller (e.g., its work_start) include the solve
+        work_add(work);
+
         out.iterations = iter;
         out.residual = res;
+        out.work += work;
+        if (opts.verbose)
+                printf("Work units: %.2f, GFLOP: %.3f, GB: %.3f \n", out.work.work_units(),
+                       1e-9 * out.work.total_flops(), 1e-9 * out.work.total_bytes());
 
         if (opts.mms) {
                 out.error = problem.error();
@@ -48,3 +120,9 @@ SolverOutput solve(F& solver, P& problem, SolverOptions opts) {
         return out;
 }
 
+template <typename F, typename P, typename T=double>
+SolverOutput solve(F& solver, P& problem, SolverOptions opts) {
+        NoObserver observer;
+        SolverOutput start;
+        return solve<F, P, NoObserver, T>(solver, problem, opts, observer, start);
+}
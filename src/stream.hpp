@@ -0,0 +1,103 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// Non-temporal (streaming) stores and software prefetching for kernels whose
+// working set does not fit into the last level cache. A streaming store
+// writes the cache line to memory without reading it first, which saves the
+// read-for-ownership traffic of write-only outputs. Small grids keep using
+// regular stores so that the output stays in cache for the next kernel.
+
+enum stream_mode {
+        // Stream when the working set exceeds the last level cache
+        STREAM_AUTO,
+        STREAM_ALWAYS,
+        STREAM_NEVER
+};
+
+class StreamOptions {
+        public:
+                stream_mode stores = STREAM_AUTO;
+                // Prefetch distance in elements, -1: choose automatically
+                int prefetch_distance = -1;
+                // Last level cache size in bytes, 0: query the system
+                size_t llc_bytes = 0;
+};
+
+StreamOptions stream_options;
+
+// Size of the last level cache in bytes
+size_t llc_bytes(void) {
+        if (stream_options.llc_bytes > 0) return stream_options.llc_bytes;
+        static size_t bytes = 0;
+        if (bytes > 0) return bytes;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+        long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (size <= 0) size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (size > 0) bytes = size;
+#endif
+        for (int index = 3; bytes == 0 && index >= 2; --index) {
+                char path[256];
+                sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+                FILE *fh = fopen(path, "r");
+                if (fh == nullptr) continue;
+                size_t kb;
+                if (fscanf(fh, "%zuK", &kb) == 1) bytes = kb * 1024;
+                fclose(fh);
+        }
+        if (bytes == 0) bytes = 8 << 20;
+        return bytes;
+}
+
+// Use streaming stores for a kernel that touches `working_set` bytes
+bool stream_enabled(const size_t working_set) {
+        switch (stream_options.stores) {
+                case STREAM_ALWAYS: return true;
+                case STREAM_NEVER: return false;
+                case STREAM_AUTO: return working_set > llc_bytes();
+        }
+        return false;
+}
+
+// Prefetch distance (in elements) for a kernel that touches `working_set`
+// bytes. Grids that fit into the last level cache are not prefetched.
+int prefetch_distance(const size_t working_set) {
+        if (stream_options.prefetch_distance >= 0)
+                return stream_options.prefetch_distance;
+        return working_set > llc_bytes() ? 64 : 0;
+}
+
+__inline__ void stream_store(double *x, const double value) {
+#if defined(__SSE2__) && defined(__x86_64__)
+        long long bits;
+        memcpy(&bits, &value, sizeof(bits));
+        _mm_stream_si64((long long*)x, bits);
+#else
+        *x = value;
+#endif
+}
+
+__inline__ void stream_store(float *x, const float value) {
+#if defined(__SSE2__)
+        int bits;
+        memcpy(&bits, &value, sizeof(bits));
+        _mm_stream_si32((int*)x, bits);
+#else
+        *x = value;
+#endif
+}
+
+// Streaming stores are weakly ordered, make them visible before returning
+__inline__ void stream_fence(void) {
+#if defined(__SSE2__)
+        _mm_sfence();
+#endif
+}
+
+template <typename T>
+__inline__ void stream_prefetch(const T *x) {
+        __builtin_prefetch(x, 0, 3);
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <stdio.h>
+#include <algorithm>
+// Operation counts of the grid kernels: calls, stencil applications (points
+// updated), floating-point operations and an estimate of the bytes moved
+// between memory and the cores. The byte estimate assumes that each grid is
+// streamed once per pass and that the neighbors of a point are in cache.
+// Every kernel call adds its counts to the counters of the calling thread's
+// scope (see WorkScope), or to `work_counters` outside of any scope. `solve`
+// opens a scope, so concurrent solves keep their own counts, and reports them
+// in SolverOutput::work. Work units measure the cost relative to one smoothing
+// sweep on the finest grid of the solve, so that configurations can be ranked
+// independently of the hardware.
+
+enum work_kernel {
+        WORK_SMOOTH,
+        WORK_RESIDUAL,
+        WORK_RESTRICT,
+        WORK_PROLONGATE,
+        WORK_BASE,
+        WORK_NUM_KERNELS
+};
+
+const char *work_kernel_name(const int kernel) {
+        switch (kernel) {
+                case WORK_SMOOTH: return "smoothing";
+                case WORK_RESIDUAL: return "residual";
+                case WORK_RESTRICT: return "restriction";
+                case WORK_PROLONGATE: return "prolongation";
+                case WORK_BASE: return "base case";
+        }
+        return "";
+}
+
+class WorkCounts {
+        public:
+                double calls[WORK_NUM_KERNELS] = {0};
+                double stencils[WORK_NUM_KERNELS] = {0};
+                double flops[WORK_NUM_KERNELS] = {0};
+                double bytes[WORK_NUM_KERNELS] = {0};
+                // Flops of the largest smoothing sweep (one work unit)
+                double sweep_flops = 0.0;
+
+                double total_stencils(void) const {
+                        double s = 0.0;
+                        for (int k = 0; k < WORK_NUM_KERNELS; ++k)
+                                s += stencils[k];
+                        return s;
+                }
+
+                double total_flops(void) const {
+                        double s = 0.0;
+                        for (int k = 0; k < WORK_NUM_KERNELS; ++k)
+                                s += flops[k];
+                        return s;
+                }
+
+                double total_bytes(void) const {
+                        double s = 0.0;
+                        for (int k = 0; k < WORK_NUM_KERNELS; ++k)
+                                s += bytes[k];
+                        return s;
+                }
+
+                double work_units(void) const {
+                        return sweep_flops > 0.0 ? total_flops() / sweep_flops : 0.0;
+                }
+
+                // Arithmetic intensity (flops per byte)
+                double intensity(void) const {
+                        double b = total_bytes();
+                        return b > 0.0 ? total_flops() / b : 0.0;
+                }
+
+                WorkCounts& operator+=(const WorkCounts& other) {
+                        for (int k = 0; k < WORK_NUM_KERNELS; ++k) {
+                                calls[k] += other.calls[k];
+                                stencils[k] += other.stencils[k];
+                                flops[k] += other.flops[k];
+                                bytes[k] += other.bytes[k];
+                        }
+                        sweep_flops = std::max(sweep_flops, other.sweep_flops);
+                        return *this;
+                }
+};
+
+// Counts of the threads outside of any scope
+WorkCounts work_counters;
+// Counters of the scope of the calling thread, or null
+thread_local WorkCounts *work_context = nullptr;
+
+WorkCounts& work_target(void) {
+        return work_context != nullptr ? *work_context : work_counters;
+}
+
+// Directs the counts of the calling thread to `counts` while the scope is
+// alive. Threads that call kernels for a solve open a scope with the
+// counters of the thread that started it:
+//
+//   WorkCounts *work = &work_target();
+//   #pragma omp parallel
+//   {
+//           WorkScope scope(work);
+//           ...
+//   }
+class WorkScope {
+        private:
+                WorkCounts *parent;
+        public:
+                WorkScope(WorkCounts *counts) : parent(work_context) {
+                        work_context = counts;
+                }
+                WorkScope(const WorkScope&) = delete;
+                ~WorkScope(void) {
+                        work_context = parent;
+                }
+};
+
+// Adds a kernel call that updates `points` points with the given flops and
+// bytes per point. Smoothing calls that update part of a grid (e.g., one
+// color or one subdomain) pass the points of the whole sweep, which defines
+// the work unit.
+void work_count(const work_kernel kernel, const double points, const double flops,
+                const double bytes, const double sweep_points=-1.0) {
+        WorkCounts& c = work_target();
+        #pragma omp critical (work_counters)
+        {
+                c.calls[kernel] += 1;
+                c.stencils[kernel] += points;
+                c.flops[kernel] += points * flops;
+                c.bytes[kernel] += points * bytes;
+                if (kernel == WORK_SMOOTH)
+                        c.sweep_flops = std::max(c.sweep_flops, flops *
+                                                 (sweep_points >= 0.0 ? sweep_points
+                                                                      : points));
+        }
+}
+
+// Adds the counts of a finished scope to the counters of the calling thread
+void work_add(const WorkCounts& work) {
+        WorkCounts& c = work_target();
+        #pragma omp critical (work_counters)
+        c += work;
+}
+
+// Counts of the calling thread since `start` (a copy of its counters). The
+// largest sweep is tracked from the call of work_start.
+WorkCounts work_start(void) {
+        WorkCounts start;
+        WorkCounts& c = work_target();
+        #pragma omp critical (work_counters)
+        {
+                start = c;
+                c.sweep_flops = 0.0;
+        }
+        return start;
+}
+
+WorkCounts work_since(const WorkCounts& start) {
+        WorkCounts out;
+        WorkCounts& c = work_target();
+        #pragma omp critical (work_counters)
+        {
+                for (int k = 0; k < WORK_NUM_KERNELS; ++k) {
+                        out.calls[k] = c.calls[k] - start.calls[k];
+                        out.stencils[k] = c.stencils[k] - start.stencils[k];
+                        out.flops[k] = c.flops[k] - start.flops[k];
+                        out.bytes[k] = c.bytes[k] - start.bytes[k];
+                }
+                out.sweep_flops = c.sweep_flops;
+                c.sweep_flops = std::max(c.sweep_flops, start.sweep_flops);
+        }
+        return out;
+}
+
+// Counts per kernel, with the achieved rates if `seconds` > 0 (the inputs of
+// a roofline plot: intensity against GFLOP/s)
+void work_report(FILE *out, const WorkCounts& work, const double seconds=0.0) {
+        fprintf(out, "Kernel \t\t Calls \t Stencils \t GFLOP \t\t GB \t\t Flops/byte \n");
+        for (int k = 0; k <= WORK_NUM_KERNELS; ++k) {
+                bool total = k == WORK_NUM_KERNELS;
+                double flops = total ? work.total_flops() : work.flops[k];
+                double bytes = total ? work.total_bytes() : work.bytes[k];
+                double calls = 0.0;
+                for (int m = 0; m < WORK_NUM_KERNELS; ++m)
+                        if (total || m == k) calls += work.calls[m];
+                fprintf(out, "%-12s \t %-6.0f \t %-8.3g \t %-8.4f \t %-8.4f \t %-6.3f \n",
+                        total ? "total" : work_kernel_name(k), calls,
+                        total ? work.total_stencils() : work.stencils[k], 1e-9 * flops,
+                        1e-9 * bytes, bytes > 0.0 ? flops / bytes : 0.0);
+        }
+        fprintf(out, "Work units: %.2f \n", work.work_units());
+        if (seconds > 0.0)
+                fprintf(out, "GFLOP/s: %.3f, GB/s: %.3f \n",
+                        1e-9 * work.total_flops() / seconds,
+                        1e-9 * work.total_bytes() / seconds);
+}
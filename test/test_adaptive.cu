@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <adaptive.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Each cycle shape must converge, more sweeps and W/F-cycles must contract
+// at least as well as V(1,1), and on two levels all shapes are the same
+int test_cycles(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing cycle shapes with n = %d \n", n);
+        SolverOptions opts;
+        opts.eps = 1e-9;
+        opts.max_iterations = 50;
+
+        const cycle_type types[3] = {V_CYCLE, W_CYCLE, F_CYCLE};
+        double rates[3][2];
+        std::vector<double> u;
+        int num_unconverged = 0, num_diff = 0;
+        for (int t = 0; t < 3; ++t) {
+                for (int s = 1; s <= 2; ++s) {
+                        Poisson<double> problem(l, h, 1.0);
+                        for (int i = 1; i < n - 1; ++i)
+                                for (int j = 1; j < n - 1; ++j)
+                                        problem.u[j + i * n] = sin(7.0 * i * j * h);
+                        Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(problem);
+                        mg.cycle = CycleOptions(types[t], s, s);
+                        SolverOutput out = solve(mg, problem, opts);
+                        num_unconverged += out.residual > opts.eps;
+                        rates[t][s - 1] = pow(out.history.back() / out.history[0],
+                                              1.0 / (out.history.size() - 1));
+                        char name[32];
+                        printf("%s: iterations: %d, convergence rate: %g \n",
+                               mg.cycle.name(name, sizeof(name)), out.iterations,
+                               rates[t][s - 1]);
+                        if (u.empty())
+                                u.assign(problem.u, problem.u + n * n);
+                        else if (s == 1)
+                                for (int k = 0; k < n * n; ++k)
+                                        num_diff += u[k] != problem.u[k];
+                }
+        }
+        equals(num_unconverged, 0);
+        equals(rates[0][1] < rates[0][0], true);
+        equals(rates[1][0] <= 1.05 * rates[0][0], true);
+        equals(rates[2][0] <= 1.05 * rates[0][0], true);
+        if (l == 2)
+                equals(num_diff, 0);
+        return test_report();
+}
+
+// Cycles without pre-smoothing must run as configured (not as V(1,post)) and
+// converge
+int test_no_presmoothing(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing cycles without pre-smoothing with n = %d \n", n);
+        SolverOptions opts;
+        opts.eps = 1e-9;
+        opts.max_iterations = 50;
+
+        const cycle_type types[3] = {V_CYCLE, W_CYCLE, F_CYCLE};
+        int num_unconverged = 0, num_same = 0;
+        for (int t = 0; t < 3; ++t) {
+                Poisson<double> problem(l, h, 1.0), presmoothed(l, h, 1.0);
+                Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(problem),
+                    pmg(presmoothed);
+                mg.cycle = CycleOptions(types[t], 0, 2);
+                pmg.cycle = CycleOptions(types[t], 1, 2);
+                mg(problem);
+                pmg(presmoothed);
+                int num_diff = 0;
+                for (int k = 0; k < n * n; ++k)
+                        num_diff += problem.u[k] != presmoothed.u[k];
+                num_same += num_diff == 0;
+                SolverOutput out = solve(mg, problem, opts);
+                num_unconverged += out.residual > opts.eps;
+        }
+        equals(num_unconverged, 0);
+        equals(num_same, 0);
+
+        char name[32];
+        CycleOptions cycle(V_CYCLE, 0, 2);
+        equals(strcmp(cycle.name(name, sizeof(name)), "V(0,2)"), 0);
+        return test_report();
+}
+
+// The controller must try the candidates, choose the best predicted time to
+// tolerance, explore again when the chosen configuration degrades and make no
+// decisions when convergence has stalled. Contraction factors and times are
+// synthetic.
+int test_controller(void) {
+        printf("Testing cycle controller \n");
+        // Rate and seconds per cycle of V(1,1), V(2,2), F(1,1), F(2,2),
+        // W(1,1) and W(2,2)
+        double rate[6] = {0.3, 0.1, 0.25, 0.08, 0.25, 0.08};
+        double seconds[6] = {1.0, 1.5, 1.4, 2.2, 1.8, 2.6};
+        CycleController controller;
+        auto index = [&](const CycleOptions& c) {
+                for (int k = 0; k < 6; ++k)
+                        if (controller.candidates[k] == c) return k;
+                return -1;
+        };
+        CycleOptions cycle;
+        std::vector<CycleDecision> decisions;
+        double res = 1.0;
+        auto run = [&](const int cycles) {
+                for (int it = 0; it < cycles; ++it) {
+                        double prev = res;
+                        int k = index(cycle);
+                        res *= rate[k];
+                        // Keep the residual in range
+                        if (res < 1e-200) res = prev = 1.0;
+                        CycleDecision d;
+                        if (controller.update(cycle, it, it == 0 ? 0.0 : prev, res,
+                                              seconds[k], 1e-300, d))
+                                decisions.push_back(d);
+                }
+        };
+
+        run(40);
+        equals(index(cycle), 1);
+        equals((int)decisions.size(), 6);
+        int num_explore = 0;
+        for (size_t k = 0; k < decisions.size(); ++k)
+                num_explore += std::string(decisions[k].reason) == "explore";
+        equals(num_explore, 5);
+
+        // V(2,2) degrades, V(1,1) is now the best
+        rate[1] = 0.7;
+        run(60);
+        equals(index(cycle), 0);
+
+        // Stalled: no decisions
+        for (int k = 0; k < 6; ++k)
+                rate[k] = 0.99;
+        size_t num_decisions = decisions.size();
+        run(60);
+        equals(decisions.size() == num_decisions, true);
+        return test_report();
+}
+
+// Adaptive solves must converge and only switch between the candidates;
+// solvers without a cycle are not adapted
+template <typename S>
+int test_adaptive(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        SolverOptions opts;
+        opts.eps = 1e-9;
+        opts.max_iterations = 100;
+        opts.adaptive = 1;
+
+        Poisson<double> problem(l, h, 1.0);
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        problem.u[j + i * n] = sin(7.0 * i * j * h);
+        Multigrid<S, Poisson<double>, double> mg(problem);
+        printf("Testing adaptive %s with n = %d \n", mg.name(), n);
+        SolverOutput out = solve(mg, problem, opts);
+        char name[32];
+        printf("Iterations: %d, decisions: %d, final cycle: %s \n", out.iterations,
+               (int)out.decisions.size(), mg.cycle.name(name, sizeof(name)));
+        equals(out.residual <= opts.eps, true);
+        CycleController controller;
+        int num_unknown = 0;
+        for (size_t k = 0; k < out.decisions.size(); ++k) {
+                bool found = false;
+                for (size_t c = 0; c < controller.candidates.size(); ++c)
+                        found |= controller.candidates[c] == out.decisions[k].to;
+                num_unknown += !found;
+        }
+        equals(num_unknown, 0);
+        if (!out.decisions.empty())
+                equals(out.decisions.back().to == mg.cycle, true);
+
+        Poisson<double> smoothed(l, h, 1.0);
+        GaussSeidelRedBlack smoother;
+        opts.max_iterations = 3;
+        SolverOutput plain = solve(smoother, smoothed, opts);
+        equals((int)plain.decisions.size(), 0);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_cycles(2);
+        err |= test_cycles(7);
+        err |= test_no_presmoothing(7);
+        err |= test_controller();
+        err |= test_adaptive<GaussSeidelRedBlack>(8);
+        err |= test_adaptive<Jacobi>(8);
+
+        return err;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <additive.hpp>
+#include <krylov.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// AFACx as a stand-alone iteration and BPX as a preconditioner of conjugate
+// gradients must converge to eps within `max_iterations`
+template <typename S, typename T>
+int test_additive_convergence(const int l, const int max_afacx, const int max_bpx) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        printf("Testing additive multigrid convergence, n = %d \n", n);
+
+        SolverOptions opts;
+        opts.eps = 1e-8;
+        {
+                using Problem = Poisson<T>;
+                Problem problem(l, h, 1.0);
+                AdditiveMultigrid<S, Problem, T> mg(problem, AFACX);
+                opts.max_iterations = max_afacx;
+                SolverOutput out = solve(mg, problem, opts);
+                printf("AFACx: %d iterations \n", out.iterations);
+                equals(out.residual <= opts.eps, true);
+        }
+        {
+                using Problem = Poisson<T>;
+                using CG = ConjugateGradient<AdditiveMultigrid<Jacobi, Problem, T>,
+                                             Problem, T>;
+                Problem problem(l, h, 1.0);
+                CG cg(problem);
+                cg.get_preconditioner().type = BPX;
+                opts.max_iterations = max_bpx;
+                SolverOutput out = solve(cg, problem, opts);
+                printf("CG + BPX: %d iterations \n", out.iterations);
+                equals(out.residual <= opts.eps, true);
+        }
+        return test_report();
+}
+
+template <typename F, typename P, typename T>
+void run(F& solver, P& problem, const int threads, const int num_iterations,
+         T *u) {
+        int max_threads = omp_get_max_threads();
+        omp_set_num_threads(threads);
+        for (int i = 0; i < num_iterations; ++i)
+                solver(problem);
+        omp_set_num_threads(max_threads);
+        memcpy(u, problem.u, sizeof(T) * problem.n * problem.n);
+}
+
+// The levels are corrected concurrently in dynamic order, the iterates must
+// not depend on the number of threads
+template <typename T>
+int test_additive_threads(const int l, const int threads) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        int num_iterations = 5;
+        printf("Testing additive multigrid with 1 and %d threads, n = %d \n", threads, n);
+
+        using Problem = Poisson<T>;
+        using MG = AdditiveMultigrid<GaussSeidelRedBlack, Problem, T>;
+        using CG = ConjugateGradient<AdditiveMultigrid<Jacobi, Problem, T>, Problem, T>;
+        T *u1 = (T*)malloc(sizeof(T) * n * n);
+        T *up = (T*)malloc(sizeof(T) * n * n);
+
+        {
+                Problem problem(l, h, 1.0), pproblem(l, h, 1.0);
+                MG mg(problem), pmg(pproblem);
+                run(mg, problem, 1, num_iterations, u1);
+                run(pmg, pproblem, threads, num_iterations, up);
+                int num_diff = 0;
+                for (int i = 0; i < n * n; ++i)
+                        num_diff += u1[i] != up[i];
+                equals(num_diff, 0);
+        }
+        {
+                Problem problem(l, h, 1.0), pproblem(l, h, 1.0);
+                CG cg(problem), pcg(pproblem);
+                cg.get_preconditioner().type = BPX;
+                pcg.get_preconditioner().type = BPX;
+                run(cg, problem, 1, num_iterations, u1);
+                run(pcg, pproblem, threads, num_iterations, up);
+                int num_diff = 0;
+                for (int i = 0; i < n * n; ++i)
+                        num_diff += u1[i] != up[i];
+                equals(num_diff, 0);
+        }
+
+        free(u1);
+        free(up);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        omp_set_dynamic(0);
+        err |= test_additive_convergence<GaussSeidelRedBlack, double>(4, 30, 30);
+        err |= test_additive_convergence<GaussSeidelRedBlack, double>(7, 30, 30);
+        err |= test_additive_threads<double>(6, 3);
+        err |= test_additive_threads<double>(9, 8);
+
+        return err;
+}
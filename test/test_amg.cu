@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <amg.hpp>
+#include <csr.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// The assembled Poisson matrix applied to the interior of a grid must match
+// the matrix-free operator, and the sparse residual norm must match
+// `Poisson::norm`.
+int test_poisson_csr(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        int m = (n - 2) * (n - 2);
+        printf("Testing Poisson CSR matrix with n = %d \n", n);
+
+        Poisson<double> problem(l, h, 1.0);
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        problem.u[j + i * n] = sin(3.0 * i * h) * cos(2.0 * j * h) + j * h;
+        problem.residual();
+
+        SparseProblem<double> sparse(problem);
+        equals((int)sparse.A.nnz(), 5 * m - 4 * (n - 2));
+        sparse.residual();
+        approx(sparse.norm() / problem.norm(), 1.0);
+
+        double *x = grid_alloc<double>(m, 1);
+        double *y = grid_alloc<double>(m, 1);
+        double *v = grid_alloc<double>(n, n);
+        grid_to_interior(x, problem.u, n);
+        csr_spmv(y, sparse.A, x);
+        poisson_operator(v, problem.u, n, h);
+        grid_to_interior(x, v, n, -1.0);
+        double diff = 0.0, norm = 0.0;
+        for (int i = 0; i < m; ++i) {
+                diff = std::max(diff, fabs(y[i] - x[i]));
+                norm = std::max(norm, fabs(x[i]));
+        }
+        approx(diff / norm, 0.0);
+        grid_free(x, m, 1);
+        grid_free(y, m, 1);
+        grid_free(v, n, n);
+        return test_report();
+}
+
+// Sparse products and transposition against dense products
+int test_spgemm(const int rows, const int inner, const int cols) {
+        printf("Testing sparse products with sizes %d x %d x %d \n", rows, inner, cols);
+        auto random = [](const int r, const int c, const int seed) {
+                return csr_build<double>(r, c,
+                        [&](const int i, std::vector<std::pair<int, double>>& entries) {
+                                for (int k = 0; k < 4; ++k) {
+                                        int j = (i * 7 + k * 13 + seed) % c;
+                                        entries.push_back(std::make_pair(j, 1.0 + (i + k + seed) % 5));
+                                }
+                        });
+        };
+        CSRMatrix<double> A = random(rows, inner, 1);
+        CSRMatrix<double> B = random(inner, cols, 2);
+        CSRMatrix<double> C = csr_spgemm(A, B);
+        CSRMatrix<double> At = csr_transpose(csr_transpose(A));
+
+        std::vector<double> a(rows * inner, 0.0), b(inner * cols, 0.0), c(rows * cols, 0.0);
+        for (int i = 0; i < rows; ++i)
+                for (int k = A.ptr[i]; k < A.ptr[i + 1]; ++k)
+                        a[A.idx[k] + inner * i] += A.val[k];
+        for (int i = 0; i < inner; ++i)
+                for (int k = B.ptr[i]; k < B.ptr[i + 1]; ++k)
+                        b[B.idx[k] + cols * i] += B.val[k];
+        int num_diff = 0, num_unsorted = 0;
+        for (int i = 0; i < rows; ++i) {
+                for (int j = 0; j < cols; ++j)
+                        for (int k = 0; k < inner; ++k)
+                                c[j + cols * i] += a[k + inner * i] * b[j + cols * k];
+                for (int k = C.ptr[i]; k < C.ptr[i + 1]; ++k) {
+                        num_diff += C.val[k] != c[C.idx[k] + cols * i];
+                        c[C.idx[k] + cols * i] = 0.0;
+                        num_unsorted += k > C.ptr[i] && C.idx[k] <= C.idx[k - 1];
+                }
+                for (int j = 0; j < cols; ++j)
+                        num_diff += c[j + cols * i] != 0.0;
+        }
+        equals(num_diff, 0);
+        equals(num_unsorted, 0);
+        equals(At.ptr == A.ptr && At.idx == A.idx && At.val == A.val, true);
+        return test_report();
+}
+
+// Smoothed aggregation must converge at a rate independent of the grid size
+// to the solution of the geometric problem, with a hierarchy and iterates
+// that do not depend on the number of threads
+template <typename S>
+int test_amg(const int l, const double max_rate) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        using Solver = AlgebraicMultigrid<S, SparseProblem<double>, double>;
+        SolverOptions opts;
+        opts.eps = 1e-9;
+        opts.max_iterations = 100;
+        opts.mms = 1;
+
+        Poisson<double> problem(l, h, 1.0);
+        SparseProblem<double> sparse(problem);
+        Solver amg(sparse);
+        printf("Testing %s with n = %d, levels = %d, operator complexity = %g \n",
+               amg.name(), n, amg.num_levels(), amg.operator_complexity());
+        SolverOutput out = solve(amg, sparse, opts);
+        double rate = pow(out.history.back() / out.history[0],
+                          1.0 / (out.history.size() - 1));
+        printf("Iterations: %d, convergence rate: %g \n", out.iterations, rate);
+        equals(out.residual <= opts.eps, true);
+        equals(rate < max_rate, true);
+
+        Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(problem);
+        SolverOutput ref = solve(mg, problem, opts);
+        equals(fabs(out.error / ref.error - 1.0) < 1e-6, true);
+
+        int num_threads = omp_get_max_threads();
+        omp_set_num_threads(3);
+        SparseProblem<double> sparse3(problem);
+        memset(sparse3.u, 0, sizeof(double) * sparse3.n);
+        Solver amg3(sparse3);
+        SolverOutput out3 = solve(amg3, sparse3, opts);
+        omp_set_num_threads(num_threads);
+        equals(amg3.num_levels(), amg.num_levels());
+        equals(out3.history == out.history, true);
+        return test_report();
+}
+
+// When aggregation makes no progress (no strong connections), the fine level
+// must be smoothed instead of factored, and the solver must still converge
+int test_amg_no_coarsening(const int n) {
+        printf("Testing algebraic multigrid without coarsening, n = %d \n", n);
+        // Diagonally dominant with weak couplings
+        CSRMatrix<double> A = csr_build<double>(n, n,
+                [&](const int i, std::vector<std::pair<int, double>>& entries) {
+                        if (i > 0) entries.push_back(std::make_pair(i - 1, -0.01));
+                        entries.push_back(std::make_pair(i, 1.0 + i % 3));
+                        if (i < n - 1) entries.push_back(std::make_pair(i + 1, -0.01));
+                });
+        SparseProblem<double> problem(A);
+        for (int i = 0; i < n; ++i)
+                problem.f[i] = sin(0.1 * i);
+
+        AMGOptions amg_opts;
+        amg_opts.coarse_size = 16;
+        MemoryUsage before = memory_usage();
+        AlgebraicMultigrid<SparseJacobi, SparseProblem<double>, double> amg(problem, amg_opts);
+        MemoryUsage after = memory_usage();
+        equals(amg.num_levels(), 1);
+        // No dense n x n factorization
+        equals(after.current[MEMORY_HIERARCHY] - before.current[MEMORY_HIERARCHY] <
+               sizeof(double) * n * n / 8, true);
+
+        SolverOptions opts;
+        opts.eps = 1e-10;
+        opts.max_iterations = 100;
+        SolverOutput out = solve(amg, problem, opts);
+        equals(out.residual <= opts.eps, true);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_poisson_csr(3);
+        err |= test_poisson_csr(7);
+        err |= test_spgemm(17, 23, 11);
+        err |= test_spgemm(64, 40, 90);
+        err |= test_amg<SparseJacobi>(5, 0.75);
+        err |= test_amg<SparseJacobi>(8, 0.75);
+        err |= test_amg<SparseChebyshev>(8, 0.55);
+        err |= test_amg_no_coarsening(4000);
+
+        return err;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <async.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Multigrid with the asynchronous smoother must converge to eps, for one and
+// several tiles
+template <typename T>
+int test_async_multigrid(const int l, const int threads) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        printf("Testing multigrid with asynchronous Gauss-Seidel, n = %d, threads = %d \n",
+               n, threads);
+
+        int max_threads = omp_get_max_threads();
+        omp_set_num_threads(threads);
+        SolverOptions opts;
+        opts.eps = 1e-8;
+        opts.max_iterations = 100;
+        Poisson<T> problem(l, h, 1.0);
+        Multigrid<AsyncGaussSeidel, Poisson<T>, T> mg(problem);
+        SolverOutput out = solve(mg, problem, opts);
+        omp_set_num_threads(max_threads);
+
+        equals(out.residual <= opts.eps, true);
+        equals(out.iterations < opts.max_iterations, true);
+        return test_report();
+}
+
+// The convergence monitor must stop all tiles before `max_sweeps` once the
+// monitored residual drops below eps, and the tiles must report their sweeps
+template <typename T>
+int test_async_monitor(const int l, const int threads) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        printf("Testing asynchronous convergence monitor, n = %d, threads = %d \n", n,
+               threads);
+
+        int max_threads = omp_get_max_threads();
+        omp_set_num_threads(threads);
+        Poisson<T> problem(l, h, 1.0);
+        problem.residual();
+        T res0 = problem.norm();
+        AsyncGaussSeidel smoother;
+        smoother.max_sweeps = 100000;
+        smoother.eps = 1e-3 * res0;
+        smoother.check = 10;
+        smoother(problem);
+        omp_set_num_threads(max_threads);
+
+        AsyncStats stats = smoother.stats;
+        equals(stats.residual < smoother.eps, true);
+        equals(stats.min_sweeps >= smoother.check, true);
+        equals(stats.max_sweeps < smoother.max_sweeps, true);
+        equals(stats.min_sweeps <= stats.max_sweeps, true);
+
+        // The monitored residual is an estimate from stale halos
+        problem.residual();
+        equals(problem.norm() < 1e-2 * res0, true);
+        return test_report();
+}
+
+// No tile may start a sweep more than `max_staleness` sweeps ahead of its
+// neighbours. A single tile has no neighbours.
+template <typename T>
+int test_async_staleness(const int l, const int threads, const int max_staleness) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        printf("Testing asynchronous staleness bound, n = %d, threads = %d, "
+               "max staleness = %d \n", n, threads, max_staleness);
+
+        int max_threads = omp_get_max_threads();
+        omp_set_num_threads(threads);
+        int sweeps = 200;
+        Poisson<T> problem(l, h, 1.0);
+        AsyncStats stats = async_gauss_seidel(problem.u, problem.f, n, h, sweeps,
+                                              max_staleness);
+        omp_set_num_threads(max_threads);
+
+        equals(stats.max_lag <= max_staleness, true);
+        equals(stats.min_sweeps, sweeps);
+        equals(stats.max_sweeps, sweeps);
+        if (threads == 1) {
+                equals(stats.max_lag, 0);
+                equals(stats.waits == 0, true);
+        }
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        omp_set_dynamic(0);
+        err |= test_async_multigrid<double>(6, 1);
+        err |= test_async_multigrid<double>(7, 4);
+        err |= test_async_monitor<double>(5, 1);
+        err |= test_async_monitor<double>(5, 4);
+        err |= test_async_staleness<double>(7, 1, 1);
+        err |= test_async_staleness<double>(7, 4, 1);
+        err |= test_async_staleness<double>(7, 4, 3);
+        err |= test_async_staleness<double>(8, 7, 2);
+
+        return err;
+}
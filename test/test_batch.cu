@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <batch.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Thread groups cover all levels and threads, with the fine grid in a group
+// of its own when there are enough threads
+int test_batch_groups(const int l, const int p) {
+        printf("Testing batch thread groups with l = %d, p = %d \n", l, p);
+        std::vector<int> group, threads;
+        batch_groups(l, p, group, threads);
+        int total = 0, num_empty = 0, num_unordered = 0;
+        for (size_t g = 0; g < threads.size(); ++g) {
+                total += threads[g];
+                num_empty += threads[g] < 1;
+        }
+        for (int k = 2; k <= l; ++k)
+                num_unordered += group[k] > group[k - 1];
+        equals(total, p);
+        equals(num_empty, 0);
+        equals(num_unordered, 0);
+        equals(group[1], (int)threads.size() - 1);
+        if (p >= 4 && l > 1)
+                equals(group[l] != group[l - 1], true);
+        return test_report();
+}
+
+// Each right-hand side must get the iterates and iteration count of solving
+// it alone with `Multigrid`, for batches smaller and larger than the pipeline
+template <typename S>
+int test_batch(const int l, const int m, const int num_threads) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        SolverOptions opts;
+        opts.eps = 1e-8;
+        opts.max_iterations = 20;
+        opts.mms = 1;
+
+        std::vector<Poisson<double>*> problems, refs;
+        for (int j = 0; j < m; ++j) {
+                problems.push_back(new Poisson<double>(l, h, 1.0 + j % 3));
+                refs.push_back(new Poisson<double>(l, h, 1.0 + j % 3));
+                for (int i = 1; i < n - 1; ++i)
+                        for (int k = 1; k < n - 1; ++k)
+                                problems[j]->u[k + i * n] = refs[j]->u[k + i * n] =
+                                        j * sin(3.0 * i * k * h);
+        }
+
+        int threads = omp_get_max_threads();
+        omp_set_num_threads(num_threads);
+        BatchMultigrid<S, Poisson<double>, double> batch(*problems[0]);
+        std::vector<SolverOutput> out = batch.solve(problems, opts);
+        omp_set_num_threads(threads);
+        printf("Testing %s with n = %d, right-hand sides = %d, threads = %d, groups = %d \n",
+               batch.name(), n, m, num_threads, (int)batch.threads.size());
+
+        int num_diff = 0, num_iterations = 0, num_unconverged = 0;
+        for (int j = 0; j < m; ++j) {
+                Multigrid<S, Poisson<double>, double> mg(*refs[j]);
+                SolverOutput ref = solve(mg, *refs[j], opts);
+                num_iterations += ref.iterations != out[j].iterations;
+                num_unconverged += out[j].residual > opts.eps;
+                for (int k = 0; k < n * n; ++k)
+                        num_diff += problems[j]->u[k] != refs[j]->u[k];
+        }
+        equals(num_iterations, 0);
+        equals(num_unconverged, 0);
+        equals(num_diff, 0);
+        for (int j = 0; j < m; ++j) {
+                delete problems[j];
+                delete refs[j];
+        }
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_batch_groups(1, 1);
+        err |= test_batch_groups(8, 1);
+        err |= test_batch_groups(8, 4);
+        err |= test_batch_groups(10, 64);
+        err |= test_batch<GaussSeidelRedBlack>(1, 3, 1);
+        err |= test_batch<GaussSeidelRedBlack>(5, 4, 1);
+        err |= test_batch<GaussSeidelRedBlack>(6, 16, 4);
+        err |= test_batch<GaussSeidelRedBlackResidual>(8, 20, 3);
+
+        return err;
+}
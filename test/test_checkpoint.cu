@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <additive.hpp>
+#include <krylov.hpp>
+#include <checkpoint.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// A solve that is interrupted after `stop` iterations and restarted from its
+// last checkpoint must produce the same iterates and residual history as an
+// uninterrupted solve
+template <typename S, typename T>
+int test_checkpoint(const int l, const int stop, const int interval,
+                    const bool state,
+                    const compression_codec codec=COMPRESSION_NONE) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        T modes = 1.0;
+        const char *path = "test_checkpoint.bin";
+        remove(path);
+
+        using Problem = Poisson<T>;
+        SolverOptions opts;
+        opts.max_iterations = 12;
+        opts.eps = 1e-14;
+
+        Problem problem(l, h, modes);
+        S reference(problem);
+        SolverOutput ref = solve(reference, problem, opts);
+
+        printf("Testing checkpoint/restart of %s with n = %d, stop = %d, "
+               "interval = %d, state = %d, codec = %d \n", reference.name(), n,
+               stop, interval, state, codec);
+
+        // Interrupted solve
+        {
+                Problem p(l, h, modes);
+                S solver(p);
+                Checkpoint<T> checkpoint(path, interval, state);
+                checkpoint.codec = codec;
+                SolverOptions first = opts;
+                first.max_iterations = stop;
+                SolverOutput start = checkpoint.restore(solver, p, first);
+                equals(start.iterations, 0);
+                solve(solver, p, first, checkpoint, start);
+                checkpoint.wait();
+                equals(checkpoint.num_writes, stop / interval);
+                equals(checkpoint.failures.load(), 0);
+        }
+
+        // Restarted solve
+        Problem p(l, h, modes);
+        S solver(p);
+        Checkpoint<T> checkpoint(path, interval, state);
+        SolverOptions resumed;
+        SolverOutput start = checkpoint.restore(solver, p, resumed);
+        equals(start.iterations, stop / interval * interval);
+        equals(resumed.max_iterations, stop);
+        resumed.max_iterations = opts.max_iterations;
+        SolverOutput out = solve(solver, p, resumed, checkpoint, start);
+        checkpoint.wait();
+
+        equals(out.iterations, ref.iterations);
+        equals((int)out.history.size(), (int)ref.history.size());
+        int num_diff = 0;
+        for (size_t i = 0; i < out.history.size(); ++i)
+                num_diff += out.history[i] != ref.history[i];
+        for (int i = 0; i < n * n; ++i)
+                num_diff += p.u[i] != problem.u[i];
+        equals(num_diff, 0);
+
+        remove(path);
+        return test_report();
+}
+
+// A checkpoint whose header claims more history or payload than the file
+// holds must be rejected with the mismatch error instead of being allocated.
+// The restore runs in a child process since it exits on a bad checkpoint.
+template <typename S, typename T>
+int test_checkpoint_corrupt(const int l, const int64_t history,
+                            const int64_t payload_bytes,
+                            const compression_codec codec=COMPRESSION_NONE) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        const char *path = "test_checkpoint_corrupt.bin";
+        remove(path);
+        printf("Testing corrupt checkpoint with n = %d, history = %ld, "
+               "payload = %ld, codec = %d \n", n, (long)history, (long)payload_bytes,
+               codec);
+
+        using Problem = Poisson<T>;
+        {
+                Problem p(l, h, 1.0);
+                S solver(p);
+                Checkpoint<T> checkpoint(path, 1, true);
+                checkpoint.codec = codec;
+                SolverOptions opts;
+                opts.max_iterations = 2;
+                solve(solver, p, opts, checkpoint, SolverOutput());
+                checkpoint.wait();
+        }
+
+        CheckpointHeader header;
+        FILE *fh = fopen(path, "r+b");
+        equals(fread(&header, sizeof(header), 1, fh), (size_t)1);
+        if (history >= 0) header.history = history;
+        if (payload_bytes >= 0) header.payload_bytes = payload_bytes;
+        fseek(fh, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, fh);
+        fclose(fh);
+
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+                Problem p(l, h, 1.0);
+                S solver(p);
+                Checkpoint<T> checkpoint(path, 1, true);
+                SolverOptions opts;
+                checkpoint.restore(solver, p, opts);
+                _exit(0);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        equals(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE, true);
+
+        remove(path);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        using Number = double;
+        using Problem = Poisson<Number>;
+        using MG = Multigrid<GaussSeidelRedBlack, Problem, Number>;
+        using CG = ConjugateGradient<AdditiveMultigrid<Jacobi, Problem, Number>,
+                                     Problem, Number>;
+
+        int err = 0;
+        err |= test_checkpoint<MG, Number>(5, 5, 1, false);
+        err |= test_checkpoint<MG, Number>(6, 7, 3, true);
+        err |= test_checkpoint<CG, Number>(5, 4, 2, true);
+        err |= test_checkpoint<CG, Number>(6, 6, 1, true);
+        err |= test_checkpoint<MG, Number>(6, 5, 2, true, COMPRESSION_LZ);
+        err |= test_checkpoint<CG, Number>(5, 4, 1, true, COMPRESSION_SHUFFLE);
+        err |= test_checkpoint_corrupt<MG, Number>(5, (int64_t)1 << 60, -1);
+        err |= test_checkpoint_corrupt<MG, Number>(5, -1, (int64_t)1 << 60);
+        err |= test_checkpoint_corrupt<MG, Number>(5, -1, (int64_t)1 << 60, COMPRESSION_LZ);
+        err |= test_checkpoint_corrupt<MG, Number>(5, 1, -1);
+
+        return err;
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <compression.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+
+// Lossless codecs must reproduce smooth, random and constant data exactly
+template <typename T>
+int test_lossless(const int n, const compression_codec codec, const size_t block_bytes) {
+        printf("Testing lossless compression with n = %d, codec = %d, block size = %zu \n",
+               n, codec, block_bytes);
+        T h = 1.0 / (n - 1);
+        size_t num_bytes = sizeof(T) * n * n;
+        T *x = (T*)malloc(num_bytes);
+        T *y = (T*)malloc(num_bytes);
+        int num_diff = 0;
+        srand(1);
+        for (int kind = 0; kind < 3; ++kind) {
+                if (kind == 0) exact_solution(x, n, h, (T)1.0);
+                for (int i = 0; i < n * n; ++i) {
+                        if (kind == 1) x[i] = (T)rand() / RAND_MAX;
+                        if (kind == 2) x[i] = 1.0;
+                }
+                std::vector<char> packed;
+                compress(packed, x, num_bytes, sizeof(T), codec, block_bytes);
+                num_diff += !decompress(y, packed.data(), packed.size());
+                num_diff += memcmp(x, y, num_bytes) != 0;
+                // Constant data compresses by orders of magnitude
+                if (kind == 2) equals(packed.size() < num_bytes / 20, true);
+                // Malformed input is rejected
+                num_diff += decompress(y, packed.data(), packed.size() - 1);
+        }
+        equals(num_diff, 0);
+
+        free(x);
+        free(y);
+        return test_report();
+}
+
+// Every value must be reconstructed within the tolerance, the prefix must be
+// kept and the compressed size must decrease with the tolerance
+template <typename T>
+int test_lossy(const int n, const size_t block_bytes) {
+        printf("Testing lossy compression with n = %d, sizeof(T) = %zu, block size = %zu \n",
+               n, sizeof(T), block_bytes);
+        T h = 1.0 / (n - 1);
+        size_t prefix = 16;
+        size_t num_bytes = prefix + sizeof(T) * n * n;
+        char *x = (char*)malloc(num_bytes);
+        char *y = (char*)malloc(num_bytes);
+        for (size_t i = 0; i < prefix; ++i) x[i] = i;
+        T *u = (T*)(x + prefix);
+        T *v = (T*)(y + prefix);
+        exact_solution(u, n, h, (T)1.0);
+        // Values that cannot be predicted
+        u[n + 1] = 1e30;
+        u[n + 2] = NAN;
+
+        size_t last = num_bytes;
+        for (int k = 0; k < 3; ++k) {
+                CompressionOptions opts;
+                opts.codec = COMPRESSION_LOSSY;
+                opts.tolerance = compression_tolerance(h, pow(10.0, k - 2));
+                opts.nx = n;
+                opts.prefix_bytes = prefix;
+                opts.block_bytes = block_bytes;
+                std::vector<char> packed;
+                compress(packed, x, num_bytes, sizeof(T), opts);
+                equals(decompress(y, packed.data(), packed.size()), true);
+                equals(memcmp(x, y, prefix), 0);
+
+                int num_violations = 0;
+                for (int i = 0; i < n * n; ++i) {
+                        if (i == n + 2) continue;
+                        num_violations += !(fabs((double)u[i] - (double)v[i]) <=
+                                            opts.tolerance);
+                }
+                equals(num_violations, 0);
+                equals(isnan(v[n + 2]) != 0, true);
+                equals(packed.size() < last, true);
+                last = packed.size();
+        }
+
+        free(x);
+        free(y);
+        return test_report();
+}
+
+// Data that does not compress must not overflow the coded blocks: random
+// bytes, and shuffled data of 4-byte units repeated at large offsets, whose
+// LZ matches cost more than the bytes they cover. Such blocks are stored.
+int test_incompressible(const compression_codec codec, const size_t block_bytes) {
+        printf("Testing incompressible data with codec = %d, block size = %zu \n",
+               codec, block_bytes);
+        size_t num_bytes = 1 << 20;
+        unsigned char *x = (unsigned char*)malloc(num_bytes);
+        unsigned char *y = (unsigned char*)malloc(num_bytes);
+        size_t num_units = 1 << 12;
+        std::vector<unsigned char> units(4 * num_units);
+        int num_diff = 0;
+        srand(1);
+        for (size_t i = 0; i < units.size(); ++i) units[i] = rand();
+        for (int kind = 0; kind < 2; ++kind) {
+                for (size_t i = 0; i < num_bytes; ++i) x[i] = rand();
+                if (kind == 1) {
+                        for (size_t i = 0; i < num_bytes; i += 4)
+                                memcpy(&y[i], &units[4 * (rand() % num_units)], 4);
+                        shuffle_decode(x, y, num_bytes, 8);
+                }
+                CompressionOptions opts;
+                opts.codec = codec;
+                opts.block_bytes = block_bytes;
+                opts.nx = 1 << 10;
+                std::vector<char> packed;
+                compress(packed, x, num_bytes, 8, opts);
+                size_t num_blocks = (num_bytes + block_bytes - 1) / block_bytes;
+                equals(packed.size() <= sizeof(CompressionHeader) +
+                       sizeof(uint64_t) * num_blocks + num_bytes, true);
+                num_diff += !decompress(y, packed.data(), packed.size());
+                num_diff += memcmp(x, y, num_bytes) != 0;
+        }
+        equals(num_diff, 0);
+
+        free(x);
+        free(y);
+        return test_report();
+}
+
+// Truncated buffers and corrupted headers and block sizes must be rejected
+// without reading or writing out of bounds
+int test_malformed(void) {
+        printf("Testing malformed input \n");
+        int n = 65;
+        double h = 1.0 / (n - 1);
+        size_t num_bytes = sizeof(double) * n * n;
+        double *x = (double*)malloc(num_bytes);
+        double *y = (double*)malloc(num_bytes);
+        exact_solution(x, n, h, 1.0);
+        std::vector<char> packed;
+        compress(packed, x, num_bytes, sizeof(double), COMPRESSION_LZ, 1 << 12);
+        size_t start = sizeof(CompressionHeader) + sizeof(uint64_t) *
+                       ((num_bytes + (1 << 12) - 1) >> 12);
+
+        int num_accepted = 0;
+        for (size_t k = 0; k < start; ++k)
+                num_accepted += decompress(y, packed.data(), k);
+
+        CompressionHeader header;
+        memcpy(&header, packed.data(), sizeof(header));
+        std::vector<CompressionHeader> corrupt(7, header);
+        corrupt[0].prefix_bytes = header.num_bytes + 1;
+        corrupt[1].prefix_bytes = -1;
+        corrupt[2].num_blocks = header.num_blocks - 1;
+        corrupt[3].num_blocks = header.num_blocks * 2;
+        corrupt[4].block_bytes = 0;
+        corrupt[5].block_bytes = (int64_t)1 << 62;
+        corrupt[6].codec = 7;
+        for (size_t k = 0; k < corrupt.size(); ++k) {
+                std::vector<char> bad = packed;
+                memcpy(bad.data(), &corrupt[k], sizeof(header));
+                num_accepted += decompress(y, bad.data(), bad.size());
+        }
+
+        // A block size that exceeds the block or the buffer
+        uint64_t sizes[] = {(1 << 12) + 1, packed.size(), ~(uint64_t)0};
+        for (int k = 0; k < 3; ++k) {
+                std::vector<char> bad = packed;
+                memcpy(bad.data() + sizeof(header), &sizes[k], sizeof(uint64_t));
+                num_accepted += decompress(y, bad.data(), bad.size());
+        }
+        // A single block whose size exceeds the data (would size the
+        // decoding buffer)
+        std::vector<char> small;
+        compress(small, x, 1 << 12, sizeof(double), COMPRESSION_LZ, 1 << 12);
+        memcpy(&header, small.data(), sizeof(header));
+        equals((int)header.num_blocks, 1);
+        header.block_bytes = (int64_t)1 << 50;
+        memcpy(small.data(), &header, sizeof(header));
+        num_accepted += decompress(y, small.data(), small.size());
+        equals(num_accepted, 0);
+
+        // Any single bit flip must be handled without overflow
+        for (size_t k = 0; k < 8 * start; ++k) {
+                std::vector<char> bad = packed;
+                bad[k / 8] ^= 1 << (k % 8);
+                decompress(y, bad.data(), bad.size());
+        }
+
+        free(x);
+        free(y);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_lossless<double>(33, COMPRESSION_SHUFFLE, 1 << 10);
+        err |= test_lossless<double>(129, COMPRESSION_LZ, 1 << 12);
+        err |= test_lossless<float>(257, COMPRESSION_LZ, 1 << 20);
+        err |= test_lossy<double>(65, 1 << 10);
+        err |= test_lossy<double>(257, 1 << 20);
+        err |= test_lossy<float>(129, 1 << 12);
+        err |= test_incompressible(COMPRESSION_SHUFFLE, 1 << 20);
+        err |= test_incompressible(COMPRESSION_LZ, 1 << 20);
+        err |= test_incompressible(COMPRESSION_LZ, 1000);
+        err |= test_incompressible(COMPRESSION_LOSSY, 1 << 16);
+        err |= test_malformed();
+
+        return err;
+}
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <decomposition.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// The decomposed solver must reproduce the serial solver exactly
+template <typename T>
+int test_decomposed_multigrid(const int l, const int threads, const int min_rows) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        T modes = 1.0;
+        int num_cycles = 4;
+
+        using Problem = Poisson<T>;
+        using DProblem = DecomposedPoisson<T>;
+        using Smoother = GaussSeidelRedBlack;
+        Problem problem(l, h, modes);
+        Multigrid<Smoother, Problem, T> mg(problem);
+        DProblem dproblem(l, h, modes, min_rows, threads);
+        DecomposedMultigrid<Smoother, DProblem, T> dmg(dproblem);
+
+        printf("Testing decomposed multigrid with n = %d, subdomains = %d, "
+               "agglomeration level = %d \n",
+               n, dproblem.num_subdomains, dproblem.kd - 1);
+
+        T *u = (T*)malloc(sizeof(T) * n * n);
+        for (int i = 0; i < num_cycles; ++i) {
+                mg(problem);
+                dmg(dproblem);
+        }
+        dproblem.gather(u, dproblem.u);
+
+        int num_diff = 0;
+        for (int i = 0; i < n * n; ++i)
+                num_diff += u[i] != problem.u[i];
+        equals(num_diff, 0);
+
+        problem.residual();
+        dproblem.residual();
+        approx(dproblem.norm(), problem.norm());
+
+        free(u);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        omp_set_dynamic(0);
+        err |= test_decomposed_multigrid<double>(6, 1, 8);
+        err |= test_decomposed_multigrid<double>(6, 3, 8);
+        err |= test_decomposed_multigrid<double>(7, 4, 8);
+        err |= test_decomposed_multigrid<double>(7, 5, 2);
+        err |= test_decomposed_multigrid<double>(3, 4, 1);
+
+        return err;
+}
@@ -230,6 +230,38 @@ int test_restriction_prolongation(const int nxc, const int nyc, const T hc) {
         return test_report();
 }
 
+template <typename T>
+int test_streaming_restriction(const int nxc, const int nyc) {
+        int nxf = 2 * (nxc - 1) + 1;
+        int nyf = 2 * (nyc - 1) + 1;
+        printf("Testing streaming restriction with fine grid [%d %d] \n", nxf, nyf);
+        T *xf = (T*)malloc(sizeof(T) * nxf * nyf);
+        T *yc = (T*)malloc(sizeof(T) * nxc * nyc);
+        T *zc = (T*)malloc(sizeof(T) * nxc * nyc);
+        for (int i = 0; i < nxf * nyf; ++i)
+                xf[i] = sin(0.1 * i);
+
+        StreamOptions options = stream_options;
+        stream_options.stores = STREAM_NEVER;
+        grid_restrict(yc, nxc, nyc, xf, nxf, nyf, (T)0.0, (T)2.0);
+        stream_options.stores = STREAM_ALWAYS;
+        stream_options.prefetch_distance = 16;
+        grid_restrict(zc, nxc, nyc, xf, nxf, nyf, (T)0.0, (T)2.0);
+        stream_options = options;
+
+        T err = 0.0;
+        for (int i = 1; i < nyc - 1; ++i)
+                for (int j = 1; j < nxc - 1; ++j)
+                        err = fmax(err, fabs(yc[j + nxc * i] - zc[j + nxc * i]));
+        approx(err, (T)0.0);
+
+        free(xf);
+        free(yc);
+        free(zc);
+
+        return test_report();
+}
+
 template <typename T>
 void cuda_restriction(const char *axis, const T *xc, T *yc, T *zc, const int nxc,
                  const int nyc, const T hc, const T *xf, const int nxf, const int nyf, const T hf) {
@@ -343,6 +375,12 @@ int main(int argc, char **argv) {
                 err |= cuda_test_restriction_prolongation(nxc, nyc, hf);
         }
 
+        {
+                int nxc = 129;
+                int nyc = 65;
+                err |= test_streaming_restriction<double>(nxc, nyc);
+        }
+
         return err;
 
 }
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <poisson.hpp>
+#include <assertions.hpp>
+#include <lfa.hpp>
+#include <solver.hpp>
+
+// Smoothing and two-grid factors of the five-point Laplacian with known values
+// (Trottenberg, Oosterlee and Schueller, Multigrid, 2001)
+int test_known(void) {
+        printf("Testing LFA of known configurations \n");
+        LFAOptions opts;
+        opts.pre = 1;
+        opts.post = 0;
+        opts.smoother = LFA_JACOBI;
+        equals(fabs(lfa_smoothing_factor(opts) - 0.6) < 1e-3, true);
+        opts.smoother = LFA_GAUSS_SEIDEL;
+        equals(fabs(lfa_smoothing_factor(opts) - 0.5) < 1e-3, true);
+        opts.smoother = LFA_RED_BLACK;
+        equals(fabs(lfa_smoothing_factor(opts) - 0.25) < 1e-3, true);
+        equals(fabs(lfa_two_grid_factor(opts) - 0.25) < 1e-3, true);
+        opts.post = 1;
+        equals(fabs(lfa_two_grid_factor(opts) - 0.074) < 1e-3, true);
+        opts.pre = opts.post = 2;
+        equals(fabs(lfa_two_grid_factor(opts) - 0.041) < 1e-3, true);
+        opts.pre = opts.post = 1;
+        opts.smoother = LFA_CHEBYSHEV;
+        equals(lfa_two_grid_factor(opts) < 0.5, true);
+        return test_report();
+}
+
+// Setup decisions without trial solves and options from the solver types
+int test_setup(void) {
+        printf("Testing LFA setup \n");
+        LFAOptions opts;
+        opts.pre = 1;
+        opts.post = 0;
+        equals(fabs(lfa_best_omega(opts) - 0.8) < 0.015, true);
+        opts.smoother = LFA_RED_BLACK;
+        equals(lfa_best_sweeps(opts), 1);
+
+        LFAOptions jacobi = lfa_options<Jacobi, Transfer<Injection, Cubic>>(
+            CycleOptions(V_CYCLE, 2, 3));
+        equals((int)jacobi.smoother, (int)LFA_JACOBI);
+        equals((int)jacobi.restriction, (int)LFA_INJECTION);
+        equals((int)jacobi.prolongation, (int)LFA_CUBIC);
+        equals(jacobi.omega == 0.8 && jacobi.injection_weight == 0.5, true);
+        equals(jacobi.pre, 2);
+        equals(jacobi.post, 3);
+        return test_report();
+}
+
+// The predicted two-grid factor must match the asymptotic convergence rate of
+// `Multigrid` on `Poisson` with W-cycles, which are close to two-grid cycles
+template <typename S, typename X>
+int test_measured(const int l, const int pre, const int post) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        Poisson<double> problem(l, h, 1.0);
+        srand(1);
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        problem.u[j + i * n] = (double)rand() / RAND_MAX;
+        Multigrid<S, Poisson<double>, double, X> mg(problem);
+        mg.cycle = CycleOptions(W_CYCLE, pre, post);
+        SolverOptions opts;
+        opts.eps = 1e-9;
+        opts.max_iterations = 50;
+        SolverOutput out = solve(mg, problem, opts);
+        // Skip the first cycles and the cycles at the round-off level
+        int k = out.history.size() - 1;
+        while (k > 0 && out.history[k] < 1e-7 * out.history[0])
+                k--;
+        double measured = pow(out.history[k] / out.history[2], 1.0 / (k - 2));
+
+        LFAOptions lfa = lfa_options<S, X>(mg.cycle);
+        double predicted = lfa_two_grid_factor(lfa);
+        char name[32];
+        printf("Testing LFA of %s %s: predicted %.4f, measured %.4f \n", lfa.name(),
+               mg.cycle.name(name, sizeof(name)), predicted, measured);
+        equals(k > 4, true);
+        equals(measured > 0.7 * predicted && measured < 1.15 * predicted, true);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_known();
+        err |= test_setup();
+        err |= test_measured<GaussSeidelRedBlack, Transfer<>>(7, 1, 1);
+        err |= test_measured<GaussSeidelRedBlack, Transfer<>>(7, 1, 0);
+        err |= test_measured<GaussSeidelRedBlack, Transfer<HalfWeighting>>(7, 1, 1);
+        err |= test_measured<GaussSeidelRedBlack, Transfer<FullWeighting, Cubic>>(7, 1, 1);
+        err |= test_measured<GaussSeidel, Transfer<>>(7, 1, 1);
+        err |= test_measured<GaussSeidel, Transfer<>>(7, 2, 2);
+        err |= test_measured<Jacobi, Transfer<>>(7, 1, 1);
+        err |= test_measured<Jacobi, Transfer<>>(7, 2, 2);
+
+        return err;
+}
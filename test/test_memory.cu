@@ -0,0 +1,110 @@
+#include <stdio.h>
+
+#include <poisson.hpp>
+#include <additive.hpp>
+#include <amg.hpp>
+#include <assertions.hpp>
+#include <krylov.hpp>
+#include <memory.hpp>
+
+// Bytes of each category of a Poisson problem, its multigrid solver and a
+// conjugate gradient method; all bytes must be released by the destructors
+int test_accounting(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing memory accounting with n = %d \n", n);
+        size_t grid = sizeof(double) * n * n;
+        MemoryUsage before = memory_usage();
+        {
+                Poisson<double> problem(l, h, 1.0);
+                Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(problem);
+                MemoryUsage usage = memory_usage();
+                equals(usage.current[MEMORY_PROBLEM] - before.current[MEMORY_PROBLEM] ==
+                       3 * grid, true);
+                equals(usage.current[MEMORY_HIERARCHY] - before.current[MEMORY_HIERARCHY] ==
+                       2 * sizeof(double) * multigrid_size(l), true);
+                equals(usage.current[MEMORY_SCRATCH] - before.current[MEMORY_SCRATCH] == grid,
+                       true);
+                equals(usage.total - before.total ==
+                       4 * grid + 2 * sizeof(double) * multigrid_size(l), true);
+
+                using MG = AdditiveMultigrid<Jacobi, Poisson<double>, double>;
+                ConjugateGradient<MG, Poisson<double>, double> cg(problem);
+                usage = memory_usage();
+                equals(usage.current[MEMORY_KRYLOV] - before.current[MEMORY_KRYLOV] == 4 * grid,
+                       true);
+        }
+        MemoryUsage after = memory_usage();
+        for (int k = 0; k < MEMORY_NUM_CATEGORIES; ++k)
+                equals(after.current[k] == before.current[k], true);
+        equals(after.total == before.total, true);
+        equals(after.total_peak >= before.total + 8 * grid, true);
+        return test_report();
+}
+
+// Peaks follow the largest use since the last reset, and bytes that are not
+// mapped by memory_alloc are added with memory_account
+int test_peak(void) {
+        printf("Testing memory peaks \n");
+        memory_reset_peak();
+        MemoryUsage start = memory_usage();
+        equals(start.total_peak == start.total, true);
+        double *x = grid_alloc<double>(1000, 1000, MEMORY_SCRATCH);
+        grid_free(x, 1000, 1000);
+        memory_account(MEMORY_OTHER, 100);
+        MemoryUsage usage = memory_usage();
+        equals(usage.peak[MEMORY_SCRATCH] - start.current[MEMORY_SCRATCH] ==
+               sizeof(double) * 1000 * 1000, true);
+        equals(usage.current[MEMORY_SCRATCH] == start.current[MEMORY_SCRATCH], true);
+        equals(usage.current[MEMORY_OTHER] - start.current[MEMORY_OTHER] == 100, true);
+        equals(usage.total_peak - start.total == sizeof(double) * 1000 * 1000, true);
+        memory_account(MEMORY_OTHER, -100);
+        memory_reset_peak();
+        usage = memory_usage();
+        equals(usage.total_peak == start.total, true);
+        return test_report();
+}
+
+// The hierarchy of algebraic multigrid is accounted while it exists
+int test_amg(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing memory accounting of algebraic multigrid with n = %d \n", n);
+        Poisson<double> problem(l, h, 1.0);
+        MemoryUsage before = memory_usage();
+        size_t matrix = 0;
+        {
+                // The matrix, the exact solution and the vectors
+                SparseProblem<double> sparse(problem);
+                matrix = sparse.A.bytes();
+                size_t bytes = memory_usage().current[MEMORY_PROBLEM] -
+                               before.current[MEMORY_PROBLEM];
+                equals(bytes >= matrix + 4 * sizeof(double) * sparse.n, true);
+        }
+        equals(memory_usage().current[MEMORY_PROBLEM] == before.current[MEMORY_PROBLEM],
+               true);
+        equals(matrix > 0, true);
+
+        SparseProblem<double> sparse(problem);
+        before = memory_usage();
+        size_t hierarchy = 0;
+        {
+                AlgebraicMultigrid<SparseJacobi, SparseProblem<double>, double> amg(sparse);
+                hierarchy = memory_usage().current[MEMORY_HIERARCHY] -
+                            before.current[MEMORY_HIERARCHY];
+                equals(hierarchy >= amg.level(0).A.bytes(), true);
+        }
+        equals(memory_usage().current[MEMORY_HIERARCHY] == before.current[MEMORY_HIERARCHY],
+               true);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_accounting(8);
+        err |= test_peak();
+        err |= test_amg(6);
+
+        return err;
+}
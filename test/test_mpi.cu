@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <mpi.h>
+
+#include <poisson.hpp>
+#include <mpi_poisson.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Run with: mpirun -np 4 test_mpi
+// The distributed solver must reproduce the serial solver exactly
+
+int report(const int rank) {
+        int num_fail_all = 0;
+        MPI_Allreduce(&num_fail, &num_fail_all, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        if (rank == 0) {
+                num_fail = num_fail_all;
+                return test_report();
+        }
+        num_pass = num_fail = num_tests = 0;
+        return num_fail_all;
+}
+
+template <typename T>
+int test_mpi_multigrid(const int l, const int min_size) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        T modes = 1.0;
+        int num_cycles = 4;
+
+        using Problem = Poisson<T>;
+        using MPIProblem = MPIPoisson<T>;
+        using Smoother = GaussSeidelRedBlack;
+        Problem problem(l, h, modes);
+        Multigrid<Smoother, Problem, T> mg(problem);
+        MPIProblem mproblem(l, h, modes, min_size, true);
+        MPIMultigrid<Smoother, MPIProblem, T> mmg(mproblem);
+
+        if (mproblem.rank == 0)
+                printf("Testing MPI multigrid with n = %d, ranks = %d x %d, "
+                       "agglomeration level = %d \n",
+                       n, mproblem.py, mproblem.px, mproblem.kd - 1);
+
+        T *u = (T*)malloc(sizeof(T) * n * n);
+        for (int i = 0; i < num_cycles; ++i) {
+                mg(problem);
+                mmg(mproblem);
+        }
+        mproblem.gather(u, mproblem.u);
+
+        int num_diff = 0;
+        for (int i = 0; i < n * n; ++i)
+                num_diff += u[i] != problem.u[i];
+        equals(num_diff, 0);
+
+        problem.residual();
+        mproblem.residual();
+        equals(mproblem.norm() == problem.norm(), true);
+
+        SolverOptions opts;
+        opts.verbose = 0;
+        opts.eps = 1e-8;
+        opts.mms = 1;
+        Problem problem2(l, h, modes);
+        Multigrid<Smoother, Problem, T> mg2(problem2);
+        MPIProblem mproblem2(l, h, modes, min_size, true);
+        MPIMultigrid<Smoother, MPIProblem, T> mmg2(mproblem2);
+        SolverOutput out = solve(mg2, problem2, opts);
+        SolverOutput mout = solve(mmg2, mproblem2, opts);
+        equals(mout.iterations, out.iterations);
+        equals(mout.residual == out.residual, true);
+        equals(mout.error == out.error, true);
+
+        free(u);
+        return report(mproblem.rank);
+}
+
+int main(int argc, char **argv) {
+
+        MPI_Init(&argc, &argv);
+        int err = 0;
+        err |= test_mpi_multigrid<double>(6, 8);
+        err |= test_mpi_multigrid<double>(7, 4);
+        err |= test_mpi_multigrid<double>(3, 1);
+        MPI_Finalize();
+
+        return err;
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <npy.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Round trip through .npy files, with and without conversion
+template <typename T, typename S>
+int test_npy(const int nx, const int ny) {
+        printf("Testing .npy files with nx = %d ny = %d, sizeof(T) = %zu, "
+               "sizeof(file) = %zu \n", nx, ny, sizeof(T), sizeof(S));
+        const char *path = "test_npy.npy";
+        T *x = (T*)malloc(sizeof(T) * nx * ny);
+        for (int i = 0; i < nx * ny; ++i)
+                x[i] = (S)sin(0.1 * i);
+
+        {
+                NpyArray<S> out(path, nx, ny);
+                for (int i = 0; i < nx * ny; ++i)
+                        out.x[i] = x[i];
+        }
+
+        int num_diff = 0;
+        {
+                NpyArray<T> in(path);
+                equals(in.nx, nx);
+                equals(in.ny, ny);
+                equals((int)in.copied, (int)(sizeof(T) != sizeof(S)));
+                for (int i = 0; i < nx * ny; ++i)
+                        num_diff += in.x[i] != x[i];
+                equals(num_diff, 0);
+        }
+
+        // Modify through a writable view, converting back if needed
+        {
+                NpyArray<T> inout(path, true);
+                for (int i = 0; i < nx * ny; ++i)
+                        inout.x[i] = -inout.x[i];
+        }
+        {
+                NpyArray<S> in(path);
+                num_diff = 0;
+                for (int i = 0; i < nx * ny; ++i)
+                        num_diff += in.x[i] != (S)-x[i];
+                equals(num_diff, 0);
+        }
+
+        unlink(path);
+        free(x);
+        return test_report();
+}
+
+// Solve with the right-hand side read from, and the solution written to, .npy
+// files
+template <typename T>
+int test_npy_poisson(const int l) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        T modes = 1.0;
+        printf("Testing Poisson views of .npy files with n = %d \n", n);
+
+        using Problem = Poisson<T>;
+        Problem problem(l, h, modes);
+        npy_write("test_npy_f.npy", problem.f, n, n);
+
+        SolverOptions opts;
+        opts.eps = 1e-8;
+        {
+                NpyArray<T> f("test_npy_f.npy");
+                NpyArray<T> u("test_npy_u.npy", n, n);
+                Problem view(l, h, modes, u.x, f.x);
+                Multigrid<GaussSeidelRedBlack, Problem, T> mg(view);
+                solve(mg, view, opts);
+        }
+        Multigrid<GaussSeidelRedBlack, Problem, T> mg(problem);
+        solve(mg, problem, opts);
+
+        NpyArray<T> u("test_npy_u.npy");
+        int num_diff = 0;
+        for (int i = 0; i < n * n; ++i)
+                num_diff += u.x[i] != problem.u[i];
+        equals(num_diff, 0);
+
+        unlink("test_npy_f.npy");
+        unlink("test_npy_u.npy");
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_npy<double, double>(21, 31);
+        err |= test_npy<double, float>(21, 31);
+        err |= test_npy<float, double>(64, 3);
+        err |= test_npy_poisson<double>(6);
+
+        return err;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <outofcore.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// The out-of-core solver must reproduce the in-memory solver exactly
+template <typename T>
+int test_outofcore_multigrid(const int l, const int block_rows) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        T modes = 1.0;
+        int num_cycles = 4;
+
+        using Problem = Poisson<T>;
+        using OProblem = OutOfCorePoisson<T>;
+        Problem problem(l, h, modes);
+        Multigrid<GaussSeidelRedBlack, Problem, T> mg(problem);
+        OProblem oproblem(l, h, modes, "test_outofcore", block_rows);
+        OutOfCoreMultigrid<OProblem, T> omg(oproblem);
+
+        printf("Testing out-of-core multigrid with n = %d, block rows = %d \n",
+               n, block_rows);
+
+        int num_diff = 0;
+        for (int i = 0; i < n * n; ++i)
+                num_diff += oproblem.f[i] != problem.f[i];
+        equals(num_diff, 0);
+
+        for (int i = 0; i < num_cycles; ++i) {
+                mg(problem);
+                omg(oproblem);
+        }
+
+        num_diff = 0;
+        for (int i = 0; i < n * n; ++i)
+                num_diff += oproblem.u[i] != problem.u[i];
+        equals(num_diff, 0);
+
+        problem.residual();
+        oproblem.residual();
+        approx(oproblem.norm(), problem.norm());
+        approx(oproblem.error(), problem.error());
+
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_outofcore_multigrid<double>(2, 1);
+        err |= test_outofcore_multigrid<double>(6, 4);
+        err |= test_outofcore_multigrid<double>(7, 5);
+        err |= test_outofcore_multigrid<double>(8, 64);
+
+        return err;
+}
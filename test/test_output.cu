@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <output.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+
+// Compression must reproduce the input exactly, also for data that does not
+// compress and for sizes that are not multiples of the block or element size
+int test_compression(const size_t num_bytes, const size_t block_bytes, const int kind) {
+        printf("Testing compression with %zu bytes, block size = %zu, data = %d \n",
+               num_bytes, block_bytes, kind);
+        std::vector<char> in(num_bytes), out(num_bytes);
+        srand(1);
+        for (size_t i = 0; i < num_bytes; ++i)
+                in[i] = kind == 0 ? 7 : kind == 1 ? rand() : (char)(i / 300);
+
+        int num_diff = 0;
+        std::vector<char> packed;
+        compress(packed, in.data(), num_bytes, 8, COMPRESSION_SHUFFLE, block_bytes);
+        equals((int)compressed_size(packed.data(), packed.size()), (int)num_bytes);
+        equals(decompress(out.data(), packed.data(), packed.size()), true);
+        for (size_t i = 0; i < num_bytes; ++i)
+                num_diff += in[i] != out[i];
+        equals(num_diff, 0);
+        if (kind == 0 && num_bytes > 1000)
+                equals(packed.size() < num_bytes / 20, true);
+        // Truncated input is rejected
+        if (packed.size() > sizeof(CompressionHeader) + 16)
+                equals(decompress(out.data(), packed.data(), packed.size() - 1), false);
+        return test_report();
+}
+
+// Grids written by the output stage must read back unchanged
+template <typename T>
+int test_output(const int l, const output_format format,
+                const compression_codec codec, const int num_buffers) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        int num_steps = 5;
+        printf("Testing output with n = %d, format = %d, codec = %d, buffers = %d \n",
+               n, format, codec, num_buffers);
+
+        T *u = (T*)malloc(sizeof(T) * n * n);
+        OutputWriter<T> output(n, n, format, codec, num_buffers);
+        char path[256];
+        for (int step = 0; step < num_steps; ++step) {
+                exact_solution(u, n, h, (T)(1.0 + step));
+                sprintf(path, "test_output_%d.bin", step);
+                output.write(path, u);
+        }
+        output.wait();
+        equals(output.num_writes, num_steps);
+        equals(output.failures, 0);
+
+        int num_diff = 0;
+        size_t num_bytes = 0;
+        for (int step = 0; step < num_steps; ++step) {
+                exact_solution(u, n, h, (T)(1.0 + step));
+                sprintf(path, "test_output_%d.bin", step);
+                std::vector<char> data;
+                equals(output_read(path, data), true);
+                size_t offset = 0;
+                if (format == OUTPUT_NPY) {
+                        NpyHeader header;
+                        equals(npy_parse_header(data.data(), data.size(), header), true);
+                        equals(header.nx, n);
+                        equals(header.ny, n);
+                        offset = header.offset;
+                }
+                num_diff += data.size() != offset + sizeof(T) * n * n;
+                num_diff += memcmp(data.data() + offset, u, sizeof(T) * n * n) != 0;
+                num_bytes += data.size();
+                remove(path);
+        }
+        equals(num_diff, 0);
+        if (codec != COMPRESSION_NONE)
+                equals(output.bytes_written < num_bytes, true);
+
+        free(u);
+        return test_report();
+}
+
+// A compressed file whose header claims more data than `max_bytes` must be
+// rejected before the output is allocated
+int test_output_corrupt(const size_t num_bytes) {
+        printf("Testing output_read of a corrupt header with %zu bytes \n", num_bytes);
+        const char *path = "test_output_corrupt.bin";
+        std::vector<char> in(num_bytes, 7), packed, data;
+        compress(packed, in.data(), num_bytes, 8, COMPRESSION_LZ);
+
+        FILE *fh = fopen(path, "wb");
+        fwrite(packed.data(), 1, packed.size(), fh);
+        fclose(fh);
+        equals(output_read(path, data), true);
+        equals(data.size() == num_bytes, true);
+        equals(output_read(path, data, num_bytes - 1), false);
+
+        // One block that decodes to 1 TiB
+        CompressionHeader header;
+        memcpy(&header, packed.data(), sizeof(header));
+        header.num_bytes = (int64_t)1 << 40;
+        header.block_bytes = header.num_bytes;
+        header.num_blocks = 1;
+        fh = fopen(path, "wb");
+        fwrite(&header, sizeof(header), 1, fh);
+        fwrite(packed.data() + sizeof(header), 1, packed.size() - sizeof(header), fh);
+        fclose(fh);
+        equals(output_read(path, data), false);
+
+        remove(path);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_compression(0, 1 << 10, 0);
+        err |= test_compression(5, 1 << 10, 1);
+        err |= test_compression(100003, 1 << 12, 0);
+        err |= test_compression(100003, 1 << 12, 1);
+        err |= test_compression(100003, 1 << 20, 2);
+        err |= test_output<double>(5, OUTPUT_RAW, COMPRESSION_NONE, 2);
+        err |= test_output<double>(6, OUTPUT_NPY, COMPRESSION_NONE, 1);
+        err |= test_output<double>(8, OUTPUT_NPY, COMPRESSION_SHUFFLE, 2);
+        err |= test_output<float>(7, OUTPUT_RAW, COMPRESSION_SHUFFLE, 3);
+        err |= test_output<double>(7, OUTPUT_NPY, COMPRESSION_LZ, 2);
+        err |= test_output_corrupt(1 << 16);
+
+        return err;
+}
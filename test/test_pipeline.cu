@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <pipeline.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// The fused pass must produce the same smoothed solution and coarse residual
+// as the smoother, residual and restriction kernels, and the pipelined V-cycle
+// the same iterates as `multigrid_v_cycle`
+template <typename T>
+int test_pipeline(const int l, const int block_rows) {
+        int n = (1 << l) + 1;
+        int nc = (1 << (l - 1)) + 1;
+        T h = 1.0 / (n - 1);
+        T modes = 1.0;
+        int num_cycles = 4;
+
+        printf("Testing pipelined multigrid with n = %d, block rows = %d \n", n,
+               block_rows);
+
+        using Problem = Poisson<T>;
+        Problem problem(l, h, modes);
+        Problem pproblem(l, h, modes);
+        exact_solution(problem.u, n, h, 2 * modes);
+        exact_solution(pproblem.u, n, h, 2 * modes);
+
+        T *rc = (T*)calloc(nc * nc, sizeof(T));
+        T *prc = (T*)calloc(nc * nc, sizeof(T));
+        T *window = (T*)malloc(sizeof(T) * (block_rows + 2) * n);
+        gauss_seidel_red_black(problem.u, problem.f, n, h);
+        poisson_residual(problem.r, problem.u, problem.f, n, h);
+        grid_restrict(rc, nc, nc, problem.r, n, n, 0.0, 1.0);
+        smooth_residual_restrict(pproblem.u, pproblem.f, prc, n, h, block_rows,
+                                 window);
+
+        int num_diff = 0;
+        for (int i = 0; i < n * n; ++i)
+                num_diff += problem.u[i] != pproblem.u[i];
+        for (int i = 0; i < nc * nc; ++i)
+                num_diff += rc[i] != prc[i];
+        equals(num_diff, 0);
+
+        Multigrid<GaussSeidelRedBlack, Problem, T> mg(problem);
+        PipelinedMultigrid<Problem, T> pmg(pproblem, block_rows);
+        for (int i = 0; i < num_cycles; ++i) {
+                mg(problem);
+                pmg(pproblem);
+        }
+
+        num_diff = 0;
+        for (int i = 0; i < n * n; ++i)
+                num_diff += problem.u[i] != pproblem.u[i];
+        equals(num_diff, 0);
+
+        free(rc);
+        free(prc);
+        free(window);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_pipeline<double>(2, 1);
+        err |= test_pipeline<double>(6, 1);
+        err |= test_pipeline<double>(6, 5);
+        err |= test_pipeline<double>(8, 16);
+        err |= test_pipeline<double>(9, 300);
+
+        return err;
+}
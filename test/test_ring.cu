@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <thread>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <ring.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+using Solver = Multigrid<GaussSeidelRedBlack, Poisson<double>, double>;
+
+// Right-hand sides submitted through the ring must be solved in place, in
+// order, with the same result as a solve in the same process. The producer
+// keeps up to `depth` slots in flight. The counters start at `start`, e.g.,
+// just before they wrap around.
+int test_ring(const int l, const int num_slots, const int depth, const int num_solves,
+              const bool named, const uint32_t start=0) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        const char *name = "/test_ring";
+        printf("Testing shared ring with n = %d, slots = %d, depth = %d, named = %d \n",
+               n, num_slots, depth, named);
+
+        SharedRing *producer = named ? new SharedRing(name, l, num_slots)
+                                     : new SharedRing(l, num_slots);
+        producer->header->submitted.store(start);
+        producer->header->completed.store(start);
+        producer->header->released.store(start);
+        int num_order = 0;
+        long num_served = 0;
+        std::thread server([&]() {
+                SharedRing *ring = named ? new SharedRing(name)
+                                         : new SharedRing(producer->file_descriptor());
+                num_served = ring_serve<Solver>(*ring);
+                delete ring;
+        });
+
+        SolverOptions opts;
+        opts.max_iterations = 6;
+        opts.eps = 1e-12;
+        int num_diff = 0, num_failed = 0;
+        int submitted = 0, received = 0;
+        while (received < num_solves) {
+                while (submitted < num_solves && submitted - received < depth) {
+                        int k = producer->acquire();
+                        forcing_function(producer->f(k), n, h, 1.0 + submitted);
+                        memset(producer->u(k), 0, sizeof(double) * n * n);
+                        producer->submit(k, opts);
+                        submitted++;
+                }
+                int k = producer->wait_solution();
+                // Slots are used in turn, also across the wrap around
+                num_order += k != (int)((start + received) % num_slots);
+                Poisson<double> problem(l, h, 1.0 + received);
+                Solver mg(problem);
+                SolverOutput out = solve(mg, problem, opts);
+                num_failed += producer->info[k].iterations != out.iterations ||
+                              producer->info[k].residual != out.residual;
+                for (int i = 0; i < n * n; ++i)
+                        num_diff += producer->u(k)[i] != problem.u[i];
+                producer->release(k);
+                received++;
+        }
+        producer->close_ring();
+        server.join();
+        delete producer;
+
+        equals(num_failed, 0);
+        equals(num_diff, 0);
+        equals(num_order, 0);
+        equals((int)num_served, num_solves);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_ring(4, 1, 1, 5, false);
+        err |= test_ring(5, 8, 3, 10, false);
+        err |= test_ring(6, 4, 2, 9, true);
+        err |= test_ring(3, 2, 2, 200, false);
+        err |= test_ring(3, 4, 4, 20, false, 0xfffffff6u);
+
+        return err;
+}
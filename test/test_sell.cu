@@ -0,0 +1,86 @@
+#include <stdio.h>
+
+#include <poisson.hpp>
+#include <amg.hpp>
+#include <csr.hpp>
+#include <sell.hpp>
+#include <assertions.hpp>
+#include <solver.hpp>
+
+// SELL-C-sigma kernels must give the same results as the CSR kernels, for
+// any slice size and sorting window
+template <int C>
+int test_sell(const CSRMatrix<double>& A, const int sigma) {
+        printf("Testing SELL-%d-%d with %d rows \n", C, sigma, A.rows);
+        SELLMatrix<double, C> S(A, sigma);
+        int n = A.rows;
+        std::vector<double> x(A.cols), b(n), dinv(n), y(n), z(n);
+        for (int i = 0; i < A.cols; ++i)
+                x[i] = sin(0.1 * i) + 0.01 * (i % 7);
+        for (int i = 0; i < n; ++i) {
+                b[i] = cos(0.3 * i);
+                dinv[i] = 1.0 / (1.0 + i % 3);
+        }
+
+        int num_diff = 0;
+        csr_spmv(y.data(), A, x.data());
+        sell_spmv(z.data(), S, x.data());
+        for (int i = 0; i < n; ++i)
+                num_diff += y[i] != z[i];
+        csr_residual(y.data(), A, x.data(), b.data());
+        sell_residual(z.data(), S, x.data(), b.data());
+        for (int i = 0; i < n; ++i)
+                num_diff += y[i] != z[i];
+        csr_jacobi(y.data(), A, x.data(), b.data(), dinv.data(), 0.7);
+        sell_jacobi(z.data(), S, x.data(), b.data(), dinv.data(), 0.7);
+        for (int i = 0; i < n; ++i)
+                num_diff += y[i] != z[i];
+        equals(num_diff, 0);
+        equals(S.size() >= A.nnz(), true);
+        equals((int)S.size() % C, 0);
+        return test_report();
+}
+
+// Rows of different lengths, including empty rows
+CSRMatrix<double> irregular(const int n) {
+        return csr_build<double>(n, n,
+                [&](const int i, std::vector<std::pair<int, double>>& entries) {
+                        for (int k = 0; k < (i * 7) % 11; ++k)
+                                entries.push_back(std::make_pair((i * 13 + k * 5) % n, 1.0 + k));
+                });
+}
+
+// Algebraic multigrid with SELL-C-sigma operators must reproduce the CSR
+// iterates
+int test_amg_sell(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing algebraic multigrid with SELL-C-sigma operators, n = %d \n", n);
+        SolverOptions opts;
+        opts.eps = 1e-9;
+        opts.max_iterations = 100;
+        Poisson<double> problem(l, h, 1.0);
+        SolverOutput out[2];
+        for (int k = 0; k < 2; ++k) {
+                AMGOptions amg_opts;
+                amg_opts.sell = k == 1;
+                SparseProblem<double> sparse(problem);
+                AlgebraicMultigrid<SparseChebyshev, SparseProblem<double>, double> amg(sparse, amg_opts);
+                out[k] = solve(amg, sparse, opts);
+        }
+        equals(out[0].iterations, out[1].iterations);
+        equals(out[0].history == out[1].history, true);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_sell<8>(poisson_csr<double>(33, 1.0 / 32), 128);
+        err |= test_sell<4>(poisson_csr<double>(65, 1.0 / 64), 1);
+        err |= test_sell<8>(irregular(1001), 64);
+        err |= test_sell<16>(irregular(777), 1024);
+        err |= test_amg_sell(7);
+
+        return err;
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <thread>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <service.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Solutions returned by the service, with requests from several clients
+// batched together, must equal those of a solve in the same process
+int test_service(const int num_clients, const int num_solves, const int max_batch) {
+        const char *path = "test_service.sock";
+        printf("Testing solve service with %d clients, %d solves each, max batch = %d \n",
+               num_clients, num_solves, max_batch);
+
+        SolveService service(path);
+        service.max_batch = max_batch;
+        service.batch_window = 2e-3;
+        std::thread server([&service]() { service.run(); });
+
+        SolverOptions opts;
+        opts.max_iterations = 8;
+        opts.eps = 1e-10;
+        std::vector<int> num_diff(num_clients, 0), num_failed(num_clients, 0);
+        std::vector<std::thread> clients;
+        for (int c = 0; c < num_clients; ++c) {
+                clients.emplace_back([&, c]() {
+                        SolveClient client(path);
+                        for (int s = 0; s < num_solves; ++s) {
+                                int l = 4 + (c + s) % 3;
+                                int n = (1 << l) + 1;
+                                double h = 1.0 / (n - 1);
+                                double modes = 1.0 + c;
+                                ServiceBuffer buffer(l);
+                                forcing_function(buffer.f, n, h, modes);
+                                memset(buffer.u, 0, sizeof(double) * n * n);
+                                ServiceReply reply = client.solve(buffer, opts);
+
+                                Poisson<double> problem(l, h, modes);
+                                Multigrid<GaussSeidelRedBlack, Poisson<double>, double>
+                                    mg(problem);
+                                SolverOutput out = solve(mg, problem, opts);
+                                num_failed[c] += reply.status != SERVICE_OK ||
+                                                 reply.iterations != out.iterations ||
+                                                 reply.residual != out.residual;
+                                for (int i = 0; i < n * n; ++i)
+                                        num_diff[c] += buffer.u[i] != problem.u[i];
+                        }
+                });
+        }
+        for (auto& t : clients) t.join();
+        SolveClient(path).shutdown();
+        server.join();
+
+        for (int c = 0; c < num_clients; ++c) {
+                equals(num_failed[c], 0);
+                equals(num_diff[c], 0);
+        }
+        equals((int)service.num_requests, num_clients * num_solves);
+        equals(service.num_batches <= service.num_requests, true);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_service(1, 3, 1);
+        err |= test_service(4, 3, 4);
+        err |= test_service(6, 4, 16);
+
+        return err;
+}
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// The red-black smoother with residual output must produce the same iterate
+// as `gauss_seidel_red_black`, the same residual as `poisson_residual` at the
+// red points and zero residual at the black points, for any number of threads.
+// Multigrid with it must converge as with the plain smoother.
+template <typename T>
+int test_smoother_residual(const int l, const int num_threads) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        printf("Testing red-black smoother with residual, n = %d, threads = %d \n", n,
+               num_threads);
+
+        T *u = grid_alloc<T>(n, n);
+        T *v = grid_alloc<T>(n, n);
+        T *f = grid_alloc<T>(n, n);
+        T *r = grid_alloc<T>(n, n);
+        T *s = grid_alloc<T>(n, n);
+        forcing_function(f, n, h, (T)1.0);
+        exact_solution(u, n, h, (T)2.0);
+        exact_solution(v, n, h, (T)2.0);
+
+        int threads = omp_get_max_threads();
+        omp_set_num_threads(num_threads);
+        gauss_seidel_red_black(u, f, n, h);
+        poisson_residual(r, u, f, n, h);
+        gauss_seidel_red_black_residual(v, f, s, n, h);
+        omp_set_num_threads(threads);
+
+        int num_diff = 0, num_red = 0;
+        T black = 0.0, scale = 0.0;
+        for (int i = 0; i < n; ++i) {
+                for (int j = 0; j < n; ++j) {
+                        num_diff += u[j + i * n] != v[j + i * n];
+                        scale = std::max(scale, (T)fabs(f[j + i * n]));
+                        if ((i + j) % 2 == 0 || i == 0 || j == 0 || i == n - 1 || j == n - 1) {
+                                num_red += r[j + i * n] != s[j + i * n];
+                        } else {
+                                num_diff += s[j + i * n] != 0.0;
+                                black = std::max(black, (T)fabs(r[j + i * n]));
+                        }
+                }
+        }
+        equals(num_diff, 0);
+        equals(num_red, 0);
+        // Black residuals of the separate pass are round-off only
+        equals(black <= 1e-6 * scale, true);
+
+        SolverOptions opts;
+        opts.eps = 1e-8;
+        Poisson<T> problem(l, h, 1.0), fused_problem(l, h, 1.0);
+        Multigrid<GaussSeidelRedBlack, Poisson<T>, T> mg(problem);
+        Multigrid<GaussSeidelRedBlackResidual, Poisson<T>, T> fused(fused_problem);
+        SolverOutput out = solve(mg, problem, opts);
+        SolverOutput fused_out = solve(fused, fused_problem, opts);
+        equals(fused_out.iterations, out.iterations);
+        equals(fabs(fused_out.residual / out.residual - 1.0) < 1e-3, true);
+
+        grid_free(u, n, n);
+        grid_free(v, n, n);
+        grid_free(f, n, n);
+        grid_free(r, n, n);
+        grid_free(s, n, n);
+        return test_report();
+}
+
+// Reads the initial guess in the first sweep, as before coarse corrections
+// started from zero without clearing
+class ClearedRedBlack {
+        public:
+        template <typename T>
+        void operator()(T *u, const T *f, const int n, const T h) {
+                gauss_seidel_red_black(u, f, n, h);
+        }
+        const char *name() {
+                return "Gauss-Seidel (red-black, cleared)";
+        }
+};
+
+// Smoothing from a zero initial guess must not read the interior of u and
+// must give the iterate (and residual) of smoothing a cleared grid. Multigrid
+// without clearing the hierarchy must give the iterates of clearing it before
+// every cycle.
+template <typename T>
+int test_smoother_zero(const int l, const int num_threads) {
+        int n = (1 << l) + 1;
+        T h = 1.0 / (n - 1);
+        printf("Testing red-black smoother from zero, n = %d, threads = %d \n", n,
+               num_threads);
+
+        T *u = grid_alloc<T>(n, n);
+        T *v = grid_alloc<T>(n, n);
+        T *f = grid_alloc<T>(n, n);
+        T *r = grid_alloc<T>(n, n);
+        T *s = grid_alloc<T>(n, n);
+        forcing_function(f, n, h, (T)1.0);
+        // Interior of v is garbage
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        v[j + i * n] = 1e3 * (i - j);
+
+        int threads = omp_get_max_threads();
+        omp_set_num_threads(num_threads);
+        gauss_seidel_red_black(u, f, n, h);
+        gauss_seidel_red_black_zero(v, f, n, h);
+        int num_diff = 0;
+        for (int k = 0; k < n * n; ++k)
+                num_diff += u[k] != v[k];
+        equals(num_diff, 0);
+
+        memset(u, 0, sizeof(T) * n * n);
+        gauss_seidel_red_black_residual(u, f, r, n, h);
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        v[j + i * n] = 1e3 * (i + j);
+        gauss_seidel_red_black_residual(v, f, s, n, h, true);
+        omp_set_num_threads(threads);
+        num_diff = 0;
+        for (int k = 0; k < n * n; ++k)
+                num_diff += u[k] != v[k] || r[k] != s[k];
+        equals(num_diff, 0);
+
+        Poisson<T> problem(l, h, 1.0), cleared_problem(l, h, 1.0);
+        Multigrid<GaussSeidelRedBlack, Poisson<T>, T> mg(problem);
+        T *cv = multigrid_alloc<T>(l);
+        T *cw = multigrid_alloc<T>(l);
+        ClearedRedBlack cleared;
+        num_diff = 0;
+        for (int c = 0; c < 4; ++c) {
+                mg(problem);
+                memset(cv, 0, sizeof(T) * multigrid_size(l));
+                memset(cw, 0, sizeof(T) * multigrid_size(l));
+                multigrid_v_cycle(l, cleared, cleared_problem.u, cleared_problem.f, r,
+                                  cv, cw, h);
+                for (int k = 0; k < n * n; ++k)
+                        num_diff += problem.u[k] != cleared_problem.u[k];
+        }
+        equals(num_diff, 0);
+
+        multigrid_free(cv, l);
+        multigrid_free(cw, l);
+        grid_free(u, n, n);
+        grid_free(v, n, n);
+        grid_free(f, n, n);
+        grid_free(r, n, n);
+        grid_free(s, n, n);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_smoother_residual<double>(2, 1);
+        err |= test_smoother_residual<double>(5, 1);
+        err |= test_smoother_residual<double>(8, 1);
+        err |= test_smoother_residual<double>(8, 3);
+        err |= test_smoother_residual<double>(9, 7);
+        err |= test_smoother_zero<double>(2, 1);
+        err |= test_smoother_zero<double>(7, 1);
+        err |= test_smoother_zero<double>(8, 3);
+
+        return err;
+}
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <omp.h>
+
+#include <poisson.hpp>
+#include <assertions.hpp>
+#include <grid.hpp>
+#include <solver.hpp>
+
+// Injection and half weighting against their stencils, and cubic
+// interpolation, which must be exact for cubic polynomials
+template <typename T>
+int test_transfer_kernels(const int l) {
+        int nc = (1 << l) + 1;
+        int nf = 2 * nc - 1;
+        printf("Testing transfer kernels with nc = %d \n", nc);
+        T hf = 1.0 / (nf - 1);
+
+        T *xf = grid_alloc<T>(nf, nf);
+        T *yc = grid_alloc<T>(nc, nc);
+        T *zc = grid_alloc<T>(nc, nc);
+        for (int i = 0; i < nf; ++i)
+                for (int j = 0; j < nf; ++j)
+                        xf[j + i * nf] = sin(3.0 * i * hf) + j * j * hf;
+
+        grid_restrict_injection(yc, nc, nc, xf, nf, nf, (T)0.0, (T)0.5);
+        grid_restrict_half(zc, nc, nc, xf, nf, nf, (T)0.0, (T)1.0);
+        T inj = 0.0, half = 0.0;
+        for (int i = 1; i < nc - 1; ++i) {
+                for (int j = 1; j < nc - 1; ++j) {
+                        const T *x = &xf[2 * j + 2 * i * nf];
+                        inj = std::max(inj, (T)fabs(yc[j + i * nc] - 0.5 * x[0]));
+                        half = std::max(half, (T)fabs(zc[j + i * nc] - 0.5 * x[0] -
+                                        0.125 * (x[-1] + x[1] + x[-nf] + x[nf])));
+                }
+        }
+        approx(inj, 0.0);
+        approx(half, 0.0);
+
+        // p(x, y) = x^3 - 2 x y^2 + y on the coarse grid (spacing 2 hf)
+        auto p = [](const T x, const T y) { return x * x * x - 2 * x * y * y + y; };
+        for (int i = 0; i < nc; ++i)
+                for (int j = 0; j < nc; ++j)
+                        yc[j + i * nc] = p(2 * j * hf, 2 * i * hf);
+        for (int k = 0; k < nf * nf; ++k)
+                xf[k] = 1.0;
+        grid_prolongate_cubic(xf, nf, nf, yc, nc, nc, (T)2.0, (T)1.0);
+        T cubic = 0.0;
+        for (int i = 0; i < nf; ++i)
+                for (int j = 0; j < nf; ++j)
+                        cubic = std::max(cubic, (T)fabs(xf[j + i * nf] - 2.0 -
+                                                        p(j * hf, i * hf)));
+        if (nc >= 4)
+                approx(cubic, 0.0);
+
+        grid_free(xf, nf, nf);
+        grid_free(yc, nc, nc);
+        grid_free(zc, nc, nc);
+        return test_report();
+}
+
+// Multigrid must converge with each policy, the default policy must give the
+// iterates of the plain V-cycle, and full multigrid must reach the
+// discretization error
+template <typename X>
+int test_transfer_multigrid(const int l, const double max_rate) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        using Solver = Multigrid<GaussSeidelRedBlack, Poisson<double>, double, X>;
+        SolverOptions opts;
+        opts.eps = 1e-9;
+        opts.max_iterations = 100;
+        opts.mms = 1;
+
+        Poisson<double> problem(l, h, 1.0);
+        for (int i = 1; i < n - 1; ++i)
+                for (int j = 1; j < n - 1; ++j)
+                        problem.u[j + i * n] = sin(7.0 * i * j * h);
+        Solver mg(problem);
+        printf("Testing %s with n = %d \n", mg.name(), n);
+        SolverOutput out = solve(mg, problem, opts);
+        double rate = pow(out.history.back() / out.history[0],
+                          1.0 / (out.history.size() - 1));
+        printf("Iterations: %d, convergence rate: %g \n", out.iterations, rate);
+        equals(out.residual <= opts.eps, true);
+        equals(rate < max_rate, true);
+
+        Poisson<double> fmg_problem(l, h, 1.0);
+        Solver fmg(fmg_problem);
+        fmg.fmg(fmg_problem);
+        double error = fmg_problem.error();
+        printf("Full multigrid error: %g, discretization error: %g \n", error, out.error);
+        equals(error < 2.0 * out.error, true);
+
+        if (std::is_same<X, Transfer<>>::value) {
+                Poisson<double> ref(l, h, 1.0);
+                for (int i = 1; i < n - 1; ++i)
+                        for (int j = 1; j < n - 1; ++j)
+                                ref.u[j + i * n] = sin(7.0 * i * j * h);
+                double *r = grid_alloc<double>(n, n);
+                double *v = multigrid_alloc<double>(l);
+                double *w = multigrid_alloc<double>(l);
+                GaussSeidelRedBlack smoother;
+                for (int k = 0; k < out.iterations; ++k) {
+                        memset(v, 0, sizeof(double) * multigrid_size(l));
+                        memset(w, 0, sizeof(double) * multigrid_size(l));
+                        multigrid_v_cycle(l, smoother, ref.u, ref.f, r, v, w, h);
+                }
+                int num_diff = 0;
+                for (int k = 0; k < n * n; ++k)
+                        num_diff += ref.u[k] != problem.u[k];
+                equals(num_diff, 0);
+                grid_free(r, n, n);
+                multigrid_free(v, l);
+                multigrid_free(w, l);
+        }
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_transfer_kernels<double>(1);
+        err |= test_transfer_kernels<double>(2);
+        err |= test_transfer_kernels<double>(6);
+        err |= test_transfer_multigrid<Transfer<>>(8, 0.15);
+        err |= test_transfer_multigrid<Transfer<HalfWeighting, Bilinear>>(8, 0.2);
+        err |= test_transfer_multigrid<Transfer<Injection, Bilinear>>(8, 0.2);
+        err |= test_transfer_multigrid<Transfer<FullWeighting, Cubic>>(8, 0.1);
+        err |= test_transfer_multigrid<Transfer<Injection, Cubic>>(8, 0.3);
+
+        return err;
+}
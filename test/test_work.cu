@@ -0,0 +1,204 @@
+#include <stdio.h>
+
+#include <poisson.hpp>
+#include <amg.hpp>
+#include <assertions.hpp>
+#include <batch.hpp>
+#include <decomposition.hpp>
+#include <pipeline.hpp>
+#include <solver.hpp>
+#include <work.hpp>
+
+// One V(1,1)-cycle calls each kernel once per level, and the stencil
+// applications are the interior points of the levels
+int test_cycle_counts(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing work counts of a V-cycle with n = %d \n", n);
+        Poisson<double> problem(l, h, 1.0);
+        Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(problem);
+        WorkCounts start = work_start();
+        mg(problem);
+        WorkCounts work = work_since(start);
+        double points = 0.0;
+        for (int k = 2; k <= l; ++k) {
+                int m = (1 << k) + 1;
+                points += (double)(m - 2) * (m - 2);
+        }
+        equals((int)work.calls[WORK_SMOOTH], 2 * (l - 1));
+        equals((int)work.calls[WORK_RESIDUAL], l - 1);
+        equals((int)work.calls[WORK_RESTRICT], l - 1);
+        equals((int)work.calls[WORK_PROLONGATE], l - 1);
+        equals((int)work.calls[WORK_BASE], 1);
+        equals(work.stencils[WORK_SMOOTH] == 2 * points, true);
+        equals(work.stencils[WORK_RESIDUAL] == points, true);
+        equals(work.sweep_flops == 6.0 * (n - 2) * (n - 2), true);
+        // Two sweeps on the fine grid, a residual, transfers and the coarse
+        // grids (a third of the fine grid)
+        equals(work.work_units() > 6.0 && work.work_units() < 7.0, true);
+        return test_report();
+}
+
+template <typename S>
+SolverOutput run(const int l, const CycleOptions cycle, const int iterations) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        Poisson<double> problem(l, h, 1.0);
+        S mg(problem);
+        mg.cycle = cycle;
+        SolverOptions opts;
+        opts.max_iterations = iterations;
+        opts.eps = 0.0;
+        return solve(mg, problem, opts);
+}
+
+// Solves report their counts: more sweeps cost more work units, the fused
+// smoother moves fewer bytes for the same stencils, and the counts of a
+// resumed solve add up to those of a single solve
+int test_solve(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing work counts of solves with n = %d \n", n);
+        using MG = Multigrid<GaussSeidelRedBlack, Poisson<double>, double>;
+        using Fused = Multigrid<GaussSeidelRedBlackResidual, Poisson<double>, double>;
+        SolverOutput v11 = run<MG>(l, CycleOptions(V_CYCLE, 1, 1), 4);
+        SolverOutput v22 = run<MG>(l, CycleOptions(V_CYCLE, 2, 2), 4);
+        SolverOutput w11 = run<MG>(l, CycleOptions(W_CYCLE, 1, 1), 4);
+        SolverOutput fused = run<Fused>(l, CycleOptions(V_CYCLE, 1, 1), 4);
+        printf("Work units per cycle: V(1,1) %.2f, V(2,2) %.2f, W(1,1) %.2f \n",
+               v11.work.work_units() / 4, v22.work.work_units() / 4,
+               w11.work.work_units() / 4);
+        equals(v22.work.work_units() > v11.work.work_units(), true);
+        equals(w11.work.work_units() > v11.work.work_units(), true);
+        equals(fused.work.total_bytes() < v11.work.total_bytes(), true);
+        equals(fused.work.stencils[WORK_SMOOTH] == v11.work.stencils[WORK_SMOOTH], true);
+
+        Poisson<double> problem(l, h, 1.0);
+        MG mg(problem);
+        SolverOptions opts;
+        opts.max_iterations = 2;
+        opts.eps = 0.0;
+        SolverOutput first = solve(mg, problem, opts);
+        opts.max_iterations = 4;
+        NoObserver observer;
+        SolverOutput resumed = solve(mg, problem, opts, observer, first);
+        equals(resumed.work.total_flops() == v11.work.total_flops(), true);
+        equals(resumed.work.total_bytes() == v11.work.total_bytes(), true);
+        equals(resumed.work.work_units() == v11.work.work_units(), true);
+        return test_report();
+}
+
+// The fused pass of the pipelined cycle does the same operations with fewer
+// bytes, and solvers outside the multigrid kernels report no work
+int test_pipeline(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing work counts of the pipelined cycle with n = %d \n", n);
+        Poisson<double> problem(l, h, 1.0);
+        Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(problem);
+        PipelinedMultigrid<Poisson<double>, double> pipelined(problem);
+        WorkCounts start = work_start();
+        mg(problem);
+        WorkCounts plain = work_since(start);
+        start = work_start();
+        pipelined(problem);
+        WorkCounts fused = work_since(start);
+        equals(fused.stencils[WORK_SMOOTH] == plain.stencils[WORK_SMOOTH], true);
+        equals(fused.total_bytes() < plain.total_bytes(), true);
+
+        SparseProblem<double> sparse(problem);
+        AlgebraicMultigrid<SparseJacobi, SparseProblem<double>, double> amg(sparse);
+        SolverOptions opts;
+        opts.max_iterations = 2;
+        SolverOutput out = solve(amg, sparse, opts);
+        equals(out.work.work_units() == 0.0, true);
+        return test_report();
+}
+
+bool same_counts(const WorkCounts& a, const WorkCounts& b) {
+        return fabs(a.total_flops() - b.total_flops()) <= 1e-12 * b.total_flops() &&
+               fabs(a.total_bytes() - b.total_bytes()) <= 1e-12 * b.total_bytes() &&
+               a.sweep_flops == b.sweep_flops;
+}
+
+// The decomposed solver updates the points of the serial solver, spread over
+// the subdomain threads, and its work units refer to the full fine grid sweep.
+// It does not skip the reads of the zero initial coarse corrections, so it
+// does slightly more flops.
+int test_decomposed(const int l, const int threads) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing work counts of the decomposed solver with n = %d, threads = %d \n",
+               n, threads);
+        SolverOptions opts;
+        opts.max_iterations = 2;
+        opts.eps = 0.0;
+        Poisson<double> problem(l, h, 1.0);
+        Multigrid<GaussSeidelRedBlack, Poisson<double>, double> mg(problem);
+        SolverOutput serial = solve(mg, problem, opts);
+        DecomposedPoisson<double> dproblem(l, h, 1.0, 8, threads);
+        DecomposedMultigrid<GaussSeidelRedBlack, DecomposedPoisson<double>, double>
+            dmg(dproblem);
+        SolverOutput decomposed = solve(dmg, dproblem, opts);
+        int num_diff = 0;
+        for (int k = 0; k < WORK_NUM_KERNELS; ++k)
+                num_diff += decomposed.work.stencils[k] != serial.work.stencils[k];
+        equals(num_diff, 0);
+        equals(decomposed.work.sweep_flops == serial.work.sweep_flops, true);
+        double ratio = decomposed.work.total_flops() / serial.work.total_flops();
+        equals(ratio >= 1.0 && ratio < 1.05, true);
+        return test_report();
+}
+
+// Concurrent solves and the problems of a batch report their own counts
+int test_concurrent(const int l) {
+        int n = (1 << l) + 1;
+        double h = 1.0 / (n - 1);
+        printf("Testing work counts of concurrent solves with n = %d \n", n);
+        using MG = Multigrid<GaussSeidelRedBlack, Poisson<double>, double>;
+        SolverOutput ref = run<MG>(l, CycleOptions(), 3);
+
+        int m = 4;
+        std::vector<SolverOutput> out(m);
+        #pragma omp parallel for num_threads(m)
+        for (int j = 0; j < m; ++j)
+                out[j] = run<MG>(l - j % 2, CycleOptions(), 3 - j % 2);
+        SolverOutput small = run<MG>(l - 1, CycleOptions(), 2);
+        int num_diff = 0;
+        for (int j = 0; j < m; ++j)
+                num_diff += !same_counts(out[j].work, j % 2 ? small.work : ref.work);
+        equals(num_diff, 0);
+
+        std::vector<Poisson<double>*> problems;
+        for (int j = 0; j < m; ++j)
+                problems.push_back(new Poisson<double>(l, h, 1.0));
+        SolverOptions opts;
+        opts.max_iterations = 3;
+        opts.eps = 0.0;
+        BatchMultigrid<GaussSeidelRedBlack, Poisson<double>, double> batch(*problems[0]);
+        WorkCounts start = work_start();
+        std::vector<SolverOutput> batched = batch.solve(problems, opts);
+        WorkCounts total = work_since(start);
+        num_diff = 0;
+        WorkCounts sum;
+        for (int j = 0; j < m; ++j) {
+                num_diff += !same_counts(batched[j].work, ref.work);
+                sum += batched[j].work;
+                delete problems[j];
+        }
+        equals(num_diff, 0);
+        equals(total.total_flops() == sum.total_flops(), true);
+        return test_report();
+}
+
+int main(int argc, char **argv) {
+
+        int err = 0;
+        err |= test_cycle_counts(7);
+        err |= test_solve(7);
+        err |= test_pipeline(7);
+        err |= test_decomposed(8, 4);
+        err |= test_concurrent(7);
+
+        return err;
+}